@@ -1,4 +1,7 @@
 #include "annotationgraphicsview.h"
+#include "datasetsource.h"
+#include "framecache.h"
+#include "labelformat.h"
 #include <QGraphicsScene>
 #include <QGraphicsRectItem>
 #include <QMouseEvent>
@@ -9,9 +12,43 @@
 #include <QMenu>
 #include <QAction>
 #include <QApplication>
+#include <QTimer>
 #include <cmath>
+#include <cstring>
+#include <vector>
 #include <QDebug>
 
+namespace {
+// 整张图片并行计算时每块的最少行数
+const int kMinBandRows = 256;
+
+// 调整显示用的原图格式：DisplayAdjuster 只处理 Grayscale8 与 32 位
+QImage source_image(const QImage &image) {
+    if (image.isNull() || image.format() == QImage::Format_Grayscale8 || image.depth() == 32) {
+        return image;
+    }
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+}
+
+// 取 rect 区域，每 step 个像素取一个
+QImage sample_image(const QImage &image, const QRect &rect, int step) {
+    const QRect area = rect & image.rect();
+    if (area.isEmpty() || step <= 1) {
+        return image.copy(area);
+    }
+    const int bytes = image.depth() / 8;
+    QImage result((area.width() + step - 1) / step, (area.height() + step - 1) / step, image.format());
+    for (int y = 0; y < result.height(); ++y) {
+        const uchar *src = image.constScanLine(area.y() + y * step) + area.x() * bytes;
+        uchar *dst = result.scanLine(y);
+        for (int x = 0; x < result.width(); ++x) {
+            memcpy(dst + x * bytes, src + x * step * bytes, bytes);
+        }
+    }
+    return result;
+}
+}
+
 AnnotationRectItem::AnnotationRectItem(int classId, QGraphicsItem *parent)
     : QGraphicsRectItem(parent), m_classId(classId) {
     setFlag(QGraphicsItem::ItemIsSelectable, true);
@@ -245,7 +282,16 @@ AnnotationGraphicsView::AnnotationGraphicsView(QWidget *parent)
       , m_resizeHandle(NoHandle)
       , m_vertexEditing(false)
       , m_vertexEditHandle(NoVertexHandle)
-      , m_contextMenu(new QMenu(this)) {
+      , m_contextMenu(new QMenu(this))
+      , m_labelFormat(LabelFormat::default_format())
+      , m_readOnly(false)
+      , m_frameCache(nullptr)
+      , m_previewItem(nullptr)
+      , m_previewTimer(new QTimer(this))
+      , m_renderJobs(JobScheduler::CurrentImage)
+      , m_preloadGeneration(0)
+      , m_preloadJobs(JobScheduler::Neighbour)
+      , m_loadJobs(JobScheduler::CurrentImage) {
     setScene(m_scene);
     setRenderHint(QPainter::Antialiasing, false); // 默认禁用抗锯齿以提高性能
     setRenderHint(QPainter::SmoothPixmapTransform, true);
@@ -260,19 +306,91 @@ AnnotationGraphicsView::AnnotationGraphicsView(QWidget *parent)
 
     // 确保视图可以接收鼠标事件
     setMouseTracking(true);
+
+    // 缩放后可见区域改变
+    connect(this, &AnnotationGraphicsView::scale_changed, this, [this]() {
+        emit viewport_changed(get_visible_rect());
+    });
+
+    // 停止调整显示后更新整张图片
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(300);
+    connect(m_previewTimer, &QTimer::timeout, this, &AnnotationGraphicsView::refresh_display_image);
 }
 
 QStringList AnnotationGraphicsView::get_classes() const {
     return m_classes;
 }
 
+QSize AnnotationGraphicsView::get_image_size() const {
+    if (!m_pixmapItem) {
+        return QSize();
+    }
+    return m_pixmapItem->pixmap().size();
+}
+
+QMap<int, int> AnnotationGraphicsView::get_class_counts() const {
+    QMap<int, int> counts;
+    for (const auto &rect: m_rectangles) {
+        counts[rect.classId]++;
+    }
+    for (const auto &polygon: m_polygons) {
+        counts[polygon.classId]++;
+    }
+    return counts;
+}
+
 void AnnotationGraphicsView::load_image(const QString &imagePath) {
     clear();
+    m_loadingPath.clear();
+
+    // 已在后台预解码时直接使用
+    QImage image = m_preloaded.take(imagePath);
+    if (image.isNull() && !DatasetSource::is_local(imagePath)) {
+        // 对象存储中还没有下载的图片在后台读取，主线程不等待网络；读取完成前显示提示
+        m_loadingPath = imagePath;
+        QGraphicsTextItem *placeholder = m_scene->addText(tr("正在读取图片..."));
+        m_scene->setSceneRect(placeholder->boundingRect());
+        FrameCache *cache = m_frameCache;
+        m_loadJobs.start([this, cache, imagePath]() {
+            QImage image = cache ? cache->load(imagePath) : SourceImageReader(imagePath).read();
+            QMetaObject::invokeMethod(this, [this, imagePath, image]() {
+                if (imagePath != m_loadingPath) {
+                    return;
+                }
+                m_loadingPath.clear();
+                clear();
+                show_image(imagePath, image);
+            }, Qt::QueuedConnection);
+        });
+        reset_view();
+        return;
+    }
+    if (image.isNull()) {
+        // 解码慢的图片可从解码缓存读取
+        image = m_frameCache ? m_frameCache->load(imagePath) : SourceImageReader(imagePath).read();
+    }
+    show_image(imagePath, image);
+}
 
-    QPixmap pixmap(imagePath);
-    if (pixmap.isNull()) {
-        QImage image(imagePath);
-        if (!image.isNull()) {
+void AnnotationGraphicsView::show_image(const QString &imagePath, const QImage &image) {
+    // 16 位图片保留原始数据，按显示窗口映射为 8 位，避免 QPixmap 直接截断
+    QPixmap pixmap;
+    if (DisplayMapper::is_high_bit_depth(image.format()) && m_displayMapper.set_image(image)) {
+        QRect full(QPoint(0, 0), m_displayMapper.size());
+        if (m_adjuster.clahe()) {
+            m_adjuster.set_statistics(m_displayMapper.render(full));
+        }
+        pixmap = QPixmap::fromImage(render_parallel(full));
+    } else if (!image.isNull()) {
+        // 调整显示时保留原图，调整结果只用于显示
+        if (!m_adjuster.is_identity()) {
+            m_sourceImage = source_image(image);
+            if (m_adjuster.clahe()) {
+                m_adjuster.set_statistics(m_sourceImage);
+            }
+            pixmap = QPixmap::fromImage(render_parallel(m_sourceImage.rect()));
+        } else {
             pixmap = QPixmap::fromImage(image);
         }
     }
@@ -291,131 +409,307 @@ void AnnotationGraphicsView::load_image(const QString &imagePath) {
     }
 
     reset_view();
+    emit image_changed();
 }
 
 void AnnotationGraphicsView::load_annotations(const QString &imagePath) {
     m_rectangles.clear();
     m_polygons.clear();
-    QString txtPath = QFileInfo(imagePath).absolutePath() + "/" + QFileInfo(imagePath).completeBaseName() + ".txt";
 
-    QFile file(txtPath);
-    if (!file.exists()) {
+    QPixmap pixmap = m_pixmapItem->pixmap();
+    if (pixmap.isNull() ||
+        (m_labelFormat->per_image_files() && !QFile::exists(m_labelFormat->label_path(imagePath)))) {
         update_rect_items();
         return;
     }
 
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    QStringList classes = m_classes;
+    QList<LabelShape> shapes;
+    if (!m_labelFormat->read(imagePath, pixmap.size(), &classes, &shapes)) {
+        // 保存空标注会覆盖无法解析的文件，改为只读
+        qWarning() << "无法读取标注文件:" << m_labelFormat->label_path(imagePath);
+        m_readOnly = true;
         update_rect_items();
+        emit annotations_unreadable(m_labelFormat->label_path(imagePath));
         return;
     }
 
-    QPixmap pixmap = m_pixmapItem->pixmap();
-    if (pixmap.isNull()) {
-        update_rect_items();
-        return;
+    for (const LabelShape &shape: shapes) {
+        if (shape.is_polygon()) {
+            m_polygons.append(GraphicsAnnotationPolygon(shape.points, shape.class_id));
+        } else {
+            // 与原 YOLO 读取一致，像素坐标向零取整
+            m_rectangles.append(GraphicsAnnotationRect(static_cast<int>(shape.box.x()),
+                                                       static_cast<int>(shape.box.y()),
+                                                       static_cast<int>(shape.box.width()),
+                                                       static_cast<int>(shape.box.height()),
+                                                       shape.class_id));
+        }
     }
 
-    int img_w = pixmap.width();
-    int img_h = pixmap.height();
-
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        QStringList parts = line.split(" ", Qt::SkipEmptyParts);
-        if (parts.size() >= 5) {
-            int class_id = parts[0].toInt();
-
-            // 判断是矩形还是多边形
-            if (parts.size() == 5) {
-                // 矩形格式: class_id x_center y_center width height
-                double x_center = parts[1].toDouble();
-                double y_center = parts[2].toDouble();
-                double width = parts[3].toDouble();
-                double height = parts[4].toDouble();
-
-                // Convert to pixel coordinates
-                x_center *= img_w;
-                y_center *= img_h;
-                width *= img_w;
-                height *= img_h;
-
-                int x = static_cast<int>(x_center - width / 2);
-                int y = static_cast<int>(y_center - height / 2);
-                int w = static_cast<int>(width);
-                int h = static_cast<int>(height);
-
-                m_rectangles.append(GraphicsAnnotationRect(x, y, w, h, class_id));
-            } else if (parts.size() % 2 == 1) {
-                // 多边形格式: class_id x1 y1 x2 y2 ... xn yn
-                QVector<QPointF> points;
-                for (int i = 1; i < parts.size(); i += 2) {
-                    double x = parts[i].toDouble() * img_w;
-                    double y = parts[i + 1].toDouble() * img_h;
-                    points.append(QPointF(x, y));
-                }
-                if (points.size() >= 3) {
-                    m_polygons.append(GraphicsAnnotationPolygon(points, class_id));
-                }
-            }
-        }
+    // 按名称保存的格式中出现了新的类别
+    if (classes.size() > m_classes.size()) {
+        m_classes = classes;
+        emit classes_discovered(classes);
     }
 
-    file.close();
     update_rect_items();
 }
 
 void AnnotationGraphicsView::save_annotations(const QString &imagePath) {
-    if (!m_pixmapItem) return;
+    if (!m_pixmapItem || m_readOnly) return;
+
+    QPixmap pixmap = m_pixmapItem->pixmap();
+    if (pixmap.isNull() && !(m_rectangles.isEmpty() && m_polygons.isEmpty())) {
+        return;
+    }
 
-    QString txtPath = QFileInfo(imagePath).absolutePath() + "/" + QFileInfo(imagePath).completeBaseName() + ".txt";
+    if (!m_labelFormat->write(imagePath, pixmap.size(), m_classes, get_shapes())) {
+        qWarning() << "无法保存标注文件:" << m_labelFormat->label_path(imagePath);
+    }
+}
 
-    if (m_rectangles.isEmpty() && m_polygons.isEmpty()) {
-        QFile::remove(txtPath);
+QList<LabelShape> AnnotationGraphicsView::get_shapes() const {
+    QList<LabelShape> shapes;
+    // 矩形注释
+    for (const auto &rect: m_rectangles) {
+        LabelShape shape;
+        shape.class_id = rect.classId;
+        shape.box = QRectF(rect.x, rect.y, rect.width, rect.height);
+        shapes.append(shape);
+    }
+
+    // 多边形注释
+    for (const auto &polygon: m_polygons) {
+        LabelShape shape;
+        shape.class_id = polygon.classId;
+        shape.points = polygon.points;
+        shape.box = QPolygonF(polygon.points).boundingRect();
+        shapes.append(shape);
+    }
+    return shapes;
+}
+
+QPixmap AnnotationGraphicsView::get_pixmap() const {
+    return m_pixmapItem ? m_pixmapItem->pixmap() : QPixmap();
+}
+
+QRectF AnnotationGraphicsView::get_visible_rect() const {
+    return mapToScene(viewport()->rect()).boundingRect();
+}
+
+void AnnotationGraphicsView::center_on(const QPointF &pos) {
+    centerOn(pos);
+}
+
+bool AnnotationGraphicsView::is_high_bit_depth() const {
+    return !m_displayMapper.is_null();
+}
+
+void AnnotationGraphicsView::set_window(int low, int high) {
+    if (m_displayMapper.is_null() || !m_pixmapItem) {
         return;
     }
+    m_displayMapper.set_window(low, high);
+    update_preview();
+}
 
-    QPixmap pixmap = m_pixmapItem->pixmap();
-    if (pixmap.isNull()) {
+void AnnotationGraphicsView::auto_window() {
+    if (m_displayMapper.is_null()) {
         return;
     }
+    m_displayMapper.set_percentile_window(0.5, 99.5);
+    set_window(m_displayMapper.window_low(), m_displayMapper.window_high());
+}
+
+int AnnotationGraphicsView::window_low() const {
+    return m_displayMapper.window_low();
+}
+
+int AnnotationGraphicsView::window_high() const {
+    return m_displayMapper.window_high();
+}
+
+void AnnotationGraphicsView::set_frame_cache(FrameCache *cache) {
+    // 预解码与后台读取任务使用旧的缓存，切换前等待其结束
+    m_preloadJobs.clear();
+    m_preloadJobs.wait();
+    m_loadJobs.wait();
+    m_preloading.clear();
+    m_frameCache = cache;
+    start_preload();
+}
 
-    int img_w = pixmap.width();
-    int img_h = pixmap.height();
+void AnnotationGraphicsView::preload(const QStringList &paths) {
+    m_preloadPaths = paths;
+    ++m_preloadGeneration;
+    for (auto it = m_preloaded.begin(); it != m_preloaded.end();) {
+        if (paths.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_preloaded.erase(it);
+        }
+    }
+    start_preload();
+}
 
-    QFile file(txtPath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+void AnnotationGraphicsView::start_preload() {
+    const int generation = m_preloadGeneration.load();
+    FrameCache *cache = m_frameCache;
+    for (int i = 0; i < m_preloadPaths.size(); ++i) {
+        const QString path = m_preloadPaths.at(i);
+        if (m_preloaded.contains(path) || m_preloading.contains(path)) {
+            continue;
+        }
+        m_preloading.insert(path);
+        // 靠前的图片先解码；导航后排队中的旧任务不再解码
+        m_preloadJobs.start([this, cache, path, generation]() {
+            const bool skipped = generation != m_preloadGeneration;
+            QImage image;
+            if (!skipped) {
+                image = cache ? cache->load(path) : SourceImageReader(path).read();
+            }
+            QMetaObject::invokeMethod(this, [this, path, image, skipped]() {
+                on_preloaded(path, image, skipped);
+            }, Qt::QueuedConnection);
+        }, m_preloadPaths.size() - i);
+    }
+}
+
+void AnnotationGraphicsView::on_preloaded(const QString &path, const QImage &image, bool skipped) {
+    m_preloading.remove(path);
+    if (!m_preloadPaths.contains(path)) {
         return;
     }
+    if (!image.isNull()) {
+        m_preloaded.insert(path, image);
+    } else if (skipped) {
+        // 跳过的旧任务中有仍需要的图片，重新提交
+        start_preload();
+    }
+}
 
-    QTextStream out(&file);
+void AnnotationGraphicsView::set_adjustment(int brightness, int contrast, double gamma, bool clahe) {
+    const bool clahe_changed = clahe != m_adjuster.clahe();
+    m_adjuster.set_levels(brightness, contrast, gamma);
+    m_adjuster.set_clahe(clahe);
+    if (!m_pixmapItem) {
+        return;
+    }
 
-    // 保存矩形注释
-    for (const auto &rect: m_rectangles) {
-        double x_center = (rect.x + rect.width / 2.0) / img_w;
-        double y_center = (rect.y + rect.height / 2.0) / img_h;
-        double width = static_cast<double>(rect.width) / img_w;
-        double height = static_cast<double>(rect.height) / img_h;
+    // 8 位图片恢复为不调整时显示原图并释放保留的原图；16 位图片仍需按显示窗口映射
+    if (m_displayMapper.is_null() && m_adjuster.is_identity()) {
+        if (!m_sourceImage.isNull()) {
+            m_previewTimer->stop();
+            m_pixmapItem->setPixmap(QPixmap::fromImage(m_sourceImage));
+            m_sourceImage = QImage();
+            if (m_previewItem) {
+                m_previewItem->hide();
+            }
+            emit image_changed();
+        }
+        return;
+    }
 
-        out << rect.classId << " "
-                << QString::number(x_center, 'f', 6) << " "
-                << QString::number(y_center, 'f', 6) << " "
-                << QString::number(width, 'f', 6) << " "
-                << QString::number(height, 'f', 6) << "\n";
+    // 8 位图片第一次调整时保留原图，此时显示的还是未调整的图片
+    if (m_displayMapper.is_null() && m_sourceImage.isNull()) {
+        m_sourceImage = source_image(m_pixmapItem->pixmap().toImage());
+    }
+    if (clahe && (clahe_changed || !m_adjuster.has_statistics())) {
+        m_adjuster.set_statistics(m_displayMapper.is_null()
+                                      ? m_sourceImage
+                                      : m_displayMapper.render(QRect(QPoint(0, 0), m_displayMapper.size())));
     }
+    update_preview();
+}
 
-    // 保存多边形注释
-    for (const auto &polygon: m_polygons) {
-        out << polygon.classId;
-        for (const auto &point: polygon.points) {
-            double x = point.x() / img_w;
-            double y = point.y() / img_h;
-            out << " " << QString::number(x, 'f', 6)
-                    << " " << QString::number(y, 'f', 6);
+QImage AnnotationGraphicsView::render_display(const QRect &rect, int step) const {
+    QImage image = m_displayMapper.is_null() ? sample_image(m_sourceImage, rect, step)
+                                             : m_displayMapper.render(rect, step);
+    m_adjuster.apply(image, rect.topLeft(), step);
+    return image;
+}
+
+// 整张图片按行分块并行计算：分块作为当前图片任务优先于其他后台任务运行，
+// 主线程计算第一块后接着计算还没有线程取走的分块，线程都被占用时不会空等
+QImage AnnotationGraphicsView::render_parallel(const QRect &rect) {
+    const int bands = qMin(JobScheduler::instance()->thread_count(), rect.height() / kMinBandRows);
+    if (bands <= 1) {
+        return render_display(rect, 1);
+    }
+    auto band = [&rect, bands](int i) {
+        const int top = rect.top() + rect.height() * i / bands;
+        const int bottom = rect.top() + rect.height() * (i + 1) / bands;
+        return QRect(rect.left(), top, rect.width(), bottom - top);
+    };
+
+    std::vector<QImage> parts(bands);
+    for (int i = 1; i < bands; ++i) {
+        const QRect part = band(i);
+        QImage *target = &parts[i];
+        m_renderJobs.start([this, part, target]() {
+            *target = render_display(part, 1);
+        });
+    }
+    parts[0] = render_display(band(0), 1);
+    m_renderJobs.run_pending();
+    m_renderJobs.wait();
+
+    QImage image(rect.size(), parts[0].format());
+    int y = 0;
+    for (const QImage &part: parts) {
+        if (part.isNull() || part.format() != image.format() || part.width() != image.width()) {
+            return render_display(rect, 1);
         }
-        out << "\n";
+        for (int row = 0; row < part.height(); ++row) {
+            memcpy(image.scanLine(y + row), part.constScanLine(row), static_cast<size_t>(part.bytesPerLine()));
+        }
+        y += part.height();
+    }
+    return image;
+}
+
+void AnnotationGraphicsView::update_preview() {
+    // 只计算可见区域，缩小显示时按屏幕像素隔点采样
+    QRect visible = get_visible_rect().toAlignedRect() & QRect(QPoint(0, 0), get_image_size());
+    int step = qMax(1, static_cast<int>(1.0 / transform().m11()));
+    if (!m_previewItem) {
+        m_previewItem = m_scene->addPixmap(QPixmap());
+        m_previewItem->setZValue(-0.5);
+    }
+    m_previewItem->setPixmap(QPixmap::fromImage(render_display(visible, step)));
+    m_previewItem->setPos(visible.topLeft());
+    m_previewItem->setScale(step);
+    m_previewItem->show();
+    m_previewTimer->start();
+}
+
+void AnnotationGraphicsView::refresh_display_image() {
+    if (!m_pixmapItem || (m_displayMapper.is_null() && m_sourceImage.isNull())) {
+        return;
+    }
+    QRect full(QPoint(0, 0), get_image_size());
+    // 显示窗口改变后 CLAHE 的统计也随之改变
+    if (!m_displayMapper.is_null() && m_adjuster.clahe()) {
+        m_adjuster.set_statistics(m_displayMapper.render(full));
     }
+    m_pixmapItem->setPixmap(QPixmap::fromImage(render_parallel(full)));
+    if (m_previewItem) {
+        m_previewItem->hide();
+    }
+    emit image_changed();
+}
+
+void AnnotationGraphicsView::set_label_format(const LabelFormat *format) {
+    m_labelFormat = format ? format : LabelFormat::default_format();
+}
 
-    file.close();
+const LabelFormat *AnnotationGraphicsView::label_format() const {
+    return m_labelFormat;
+}
+
+bool AnnotationGraphicsView::is_read_only() const {
+    return m_readOnly;
 }
 
 void AnnotationGraphicsView::clear() {
@@ -453,8 +747,17 @@ void AnnotationGraphicsView::clear() {
 
     m_selectedItem = nullptr;
     m_selectedIndex = -1;
+    m_readOnly = false;
+
+    // 预览项随场景一起删除
+    m_previewItem = nullptr;
+    m_previewTimer->stop();
+    m_displayMapper.clear();
+    m_adjuster.clear_statistics();
+    m_sourceImage = QImage();
 
     m_scene->clear();
+    emit image_changed();
 }
 
 void AnnotationGraphicsView::set_current_class(int classId) {
@@ -554,7 +857,10 @@ void AnnotationGraphicsView::update_rect_items() {
     qDeleteAll(m_polygonItems);
     m_polygonItems.clear();
 
-    if (!m_pixmapItem) return;
+    if (!m_pixmapItem) {
+        emit annotations_changed();
+        return;
+    }
 
     // 创建新的矩形项
     for (const auto &rect: m_rectangles) {
@@ -577,6 +883,7 @@ void AnnotationGraphicsView::update_rect_items() {
         m_scene->addItem(item);
         m_polygonItems.append(item);
     }
+    emit annotations_changed();
 }
 
 int AnnotationGraphicsView::get_selected_rectangle_index() const {
@@ -655,7 +962,8 @@ void AnnotationGraphicsView::delete_selected_rectangle() {
 }
 
 void AnnotationGraphicsView::mousePressEvent(QMouseEvent *event) {
-    if (!m_pixmapItem) {
+    // 只读时不响应绘制、编辑与类别菜单
+    if (!m_pixmapItem || (m_readOnly && (event->button() == Qt::LeftButton || event->button() == Qt::RightButton))) {
         QGraphicsView::mousePressEvent(event);
         return;
     }
@@ -1202,8 +1510,18 @@ void AnnotationGraphicsView::wheelEvent(QWheelEvent *event) {
     event->accept();
 }
 
+void AnnotationGraphicsView::scrollContentsBy(int dx, int dy) {
+    QGraphicsView::scrollContentsBy(dx, dy);
+    emit viewport_changed(get_visible_rect());
+}
+
+void AnnotationGraphicsView::resizeEvent(QResizeEvent *event) {
+    QGraphicsView::resizeEvent(event);
+    emit viewport_changed(get_visible_rect());
+}
+
 void AnnotationGraphicsView::keyPressEvent(QKeyEvent *event) {
-    if (event->key() == Qt::Key_Delete && m_selectedIndex >= 0) {
+    if (event->key() == Qt::Key_Delete && m_selectedIndex >= 0 && !m_readOnly) {
         delete_selected_rectangle();
     } else {
         QGraphicsView::keyPressEvent(event);
@@ -3,8 +3,20 @@
 
 #include <QGraphicsView>
 #include <QGraphicsRectItem>
+#include <QHash>
 #include <QList>
+#include <QMap>
 #include <QMenu>
+#include <QSet>
+#include <atomic>
+#include "displayadjuster.h"
+#include "displaymapper.h"
+#include "jobscheduler.h"
+
+class FrameCache;
+class LabelFormat;
+class QTimer;
+struct LabelShape;
 
 // 图形注释矩形结构体
 struct GraphicsAnnotationRect {
@@ -77,6 +89,31 @@ public:
     double get_scale_factor() const;
     void delete_selected_rectangle();
     QStringList get_classes() const; // 添加此方法
+    QSize get_image_size() const;
+    QMap<int, int> get_class_counts() const; // 类别ID -> 标注数量，用于更新数据集索引
+    void set_label_format(const LabelFormat *format);
+    const LabelFormat *label_format() const;
+    // 标注文件无法解析时当前图片只读，不保存，避免覆盖原文件
+    bool is_read_only() const;
+
+    // 导航图使用：当前图片、全部标注（像素坐标）与可见区域（场景坐标）
+    QPixmap get_pixmap() const;
+    QList<LabelShape> get_shapes() const;
+    QRectF get_visible_rect() const;
+    void center_on(const QPointF &pos);
+
+    // 16 位图片的显示窗口（原始数值），8 位图片无效
+    bool is_high_bit_depth() const;
+    void set_window(int low, int high);
+    void auto_window();
+    int window_low() const;
+    int window_high() const;
+    // 解码缓存，为空时直接解码
+    void set_frame_cache(FrameCache *cache);
+    // 在后台预先解码即将显示的图片（按显示顺序排列），之后 load_image 直接使用解码结果
+    void preload(const QStringList &paths);
+    // 亮度 / 对比度 / gamma / CLAHE 显示调整，切换图片后保持
+    void set_adjustment(int brightness, int contrast, double gamma, bool clahe);
 
     // 添加多边形相关方法
     void set_drawing_mode(DrawingMode mode);
@@ -88,6 +125,11 @@ signals:
     void rectangle_selected(int index);        // 矩形选中信号
     void rectangle_class_changed(int index, int classId);  // 矩形类别更改信号
     void scale_changed(double scale);          // 添加缩放变化信号
+    void classes_discovered(const QStringList &classes); // 标注文件中出现了新的类别名称
+    void annotations_unreadable(const QString &labelPath); // 标注文件无法解析，当前图片只读
+    void image_changed();                      // 加载或清除了图片
+    void annotations_changed();                // 标注增删改、撤销重做后
+    void viewport_changed(const QRectF &rect); // 可见区域（场景坐标）改变
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
@@ -95,6 +137,8 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private slots:
     void on_action_class_changed();
@@ -157,7 +201,38 @@ private:
     // 上下文菜单
     QMenu *m_contextMenu;
 
+    // 标注文件格式，由主窗口按文件夹设置
+    const LabelFormat *m_labelFormat;
+    bool m_readOnly;
+
+    // 16 位图片：原始数据与显示窗口；8 位图片调整显示时保留原图 m_sourceImage。
+    // 调整时只重新计算可见区域并显示在 m_previewItem 上，停止调整后再更新整张图片
+    FrameCache *m_frameCache;
+    DisplayMapper m_displayMapper;
+    DisplayAdjuster m_adjuster;
+    QImage m_sourceImage;
+    QGraphicsPixmapItem *m_previewItem;
+    QTimer *m_previewTimer;
+    JobGroup m_renderJobs;
+
+    // 相邻图片的预解码结果；m_preloading 为已提交、还没有返回的图片
+    QStringList m_preloadPaths;
+    QHash<QString, QImage> m_preloaded;
+    QSet<QString> m_preloading;
+    std::atomic<int> m_preloadGeneration;
+    JobGroup m_preloadJobs;
+    // 正在后台读取的当前图片（对象存储中尚未下载的图片）
+    QString m_loadingPath;
+    JobGroup m_loadJobs;
+
+    void show_image(const QString &imagePath, const QImage &image);
     void load_annotations(const QString &imagePath);
+    QImage render_display(const QRect &rect, int step) const;
+    QImage render_parallel(const QRect &rect);
+    void start_preload();
+    void on_preloaded(const QString &path, const QImage &image, bool skipped);
+    void update_preview();
+    void refresh_display_image();
     void save_state();
     void update_rect_items();
     void show_context_menu(const QPoint &pos);
@@ -0,0 +1,417 @@
+#include "archivesource.h"
+#include "folderscanner.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+#include <zlib.h>
+
+namespace {
+const quint32 kZipEndSignature = 0x06054b50;
+const quint32 kZip64LocatorSignature = 0x07064b50;
+const quint32 kZip64EndSignature = 0x06064b50;
+const quint32 kZipCentralSignature = 0x02014b50;
+const quint32 kZipLocalSignature = 0x04034b50;
+const int kZipEndSize = 22;
+const int kZipMaxComment = 0xFFFF;
+const int kZipCentralSize = 46;
+const int kZipLocalSize = 30;
+const int kTarBlock = 512;
+// 挂载时解压到文件夹的非图片成员的大小上限
+const qint64 kMaxExtractSize = 16 << 20;
+
+template <typename T>
+T le(const char *data) {
+    return qFromLittleEndian<T>(reinterpret_cast<const uchar *>(data));
+}
+
+// tar 数字字段：八进制文本；最高位为 1 时为 base-256 二进制（GNU 大文件）
+// 损坏的头中出现负数或溢出时返回 -1
+qint64 tar_number(const char *field, int size) {
+    qint64 value = 0;
+    if (static_cast<uchar>(field[0]) & 0x80) {
+        // base-256 编码，0x40 位表示负数
+        if (field[0] & 0x40) {
+            return -1;
+        }
+        value = field[0] & 0x3F;
+        for (int i = 1; i < size; ++i) {
+            if (value > (std::numeric_limits<qint64>::max() >> 8)) {
+                return -1;
+            }
+            value = (value << 8) | static_cast<uchar>(field[i]);
+        }
+        return value;
+    }
+    for (int i = 0; i < size && field[i]; ++i) {
+        if (field[i] == ' ') {
+            continue;
+        }
+        if (field[i] < '0' || field[i] > '7') {
+            break;
+        }
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+QString tar_string(const char *field, int size) {
+    return QString::fromUtf8(field, static_cast<int>(qstrnlen(field, static_cast<uint>(size))));
+}
+
+bool tar_checksum_valid(const char *header) {
+    qint64 sum = 0;
+    for (int i = 0; i < kTarBlock; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<uchar>(header[i]);
+    }
+    return sum == tar_number(header + 148, 8);
+}
+
+// 解压 raw deflate 数据；limit 小于原始大小时只解压开头部分
+QByteArray inflate_raw(const char *data, qint64 size, qint64 output_size) {
+    if (output_size <= 0 || output_size > std::numeric_limits<int>::max()) {
+        return QByteArray();
+    }
+    QByteArray output(static_cast<int>(output_size), Qt::Uninitialized);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    const char *input = data;
+    qint64 remaining = size;
+    int result = Z_OK;
+    while (result == Z_OK && stream.avail_out > 0) {
+        if (stream.avail_in == 0 && remaining > 0) {
+            uInt chunk = static_cast<uInt>(qMin<qint64>(remaining, 1 << 30));
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input));
+            stream.avail_in = chunk;
+            input += chunk;
+            remaining -= chunk;
+        }
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+    inflateEnd(&stream);
+    if ((result != Z_STREAM_END && result != Z_OK) || static_cast<qint64>(stream.total_out) != output_size) {
+        return QByteArray();
+    }
+    return output;
+}
+}
+
+ArchiveSource::ArchiveSource()
+    : m_base(nullptr), m_size(0), m_mtime(0), m_zip(false) {
+}
+
+ArchiveSource::~ArchiveSource() {
+    close();
+}
+
+bool ArchiveSource::open(const QString &path) {
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法打开压缩包:" << path;
+        return false;
+    }
+    m_path = path;
+    m_size = m_file.size();
+    m_mtime = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+    // 32 位系统上大文件可能无法映射，此时退回按位置读取
+    m_base = m_file.map(0, m_size);
+
+    m_zip = m_file.peek(2) == "PK";
+    if (!(m_zip ? load_zip() : load_tar())) {
+        qWarning() << "无法读取压缩包目录:" << path;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ArchiveSource::close() {
+    if (m_base) {
+        m_file.unmap(const_cast<uchar *>(m_base));
+        m_base = nullptr;
+    }
+    m_file.close();
+    m_path.clear();
+    m_size = 0;
+    m_mtime = 0;
+    m_members.clear();
+    m_files.clear();
+}
+
+bool ArchiveSource::is_open() const {
+    return m_file.isOpen();
+}
+
+QString ArchiveSource::path() const {
+    return m_path;
+}
+
+QStringList ArchiveSource::files() const {
+    return m_files;
+}
+
+bool ArchiveSource::contains(const QString &member) const {
+    return m_members.contains(member);
+}
+
+bool ArchiveSource::stat(const QString &member, qint64 *size, qint64 *mtime) const {
+    auto it = m_members.constFind(member);
+    if (it == m_members.constEnd()) {
+        return false;
+    }
+    *size = it->size;
+    *mtime = m_mtime;
+    return true;
+}
+
+bool ArchiveSource::is_archive_file(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray header = file.read(kTarBlock);
+    if (header.startsWith("PK\x03\x04") || header.startsWith("PK\x05\x06")) {
+        return true;
+    }
+    return header.size() == kTarBlock && tar_checksum_valid(header.constData());
+}
+
+QByteArray ArchiveSource::read_range(qint64 offset, qint64 size) const {
+    if (offset < 0 || size < 0 || offset + size > m_size || size > std::numeric_limits<int>::max()) {
+        return QByteArray();
+    }
+    if (m_base) {
+        return QByteArray(reinterpret_cast<const char *>(m_base + offset), static_cast<int>(size));
+    }
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.seek(offset)) {
+        return QByteArray();
+    }
+    return m_file.read(size);
+}
+
+void ArchiveSource::add_member(QString name, const Member &member) {
+    // 去掉开头的 "./" 与 "/"，忽略包含 ".." 的路径
+    while (name.startsWith("./") || name.startsWith('/')) {
+        name.remove(0, name.startsWith('/') ? 1 : 2);
+    }
+    if (name.isEmpty() || name.endsWith('/') || name.split('/').contains("..")) {
+        return;
+    }
+    if (!m_members.contains(name)) {
+        m_files.append(name);
+    }
+    m_members.insert(name, member);
+}
+
+bool ArchiveSource::load_zip() {
+    // 从文件末尾向前查找中央目录结束记录（后面可能有注释）
+    const qint64 tail_offset = qMax<qint64>(0, m_size - kZipEndSize - kZipMaxComment);
+    const QByteArray tail = read_range(tail_offset, m_size - tail_offset);
+    int end = -1;
+    for (int i = tail.size() - kZipEndSize; i >= 0; --i) {
+        if (le<quint32>(tail.constData() + i) == kZipEndSignature) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) {
+        return false;
+    }
+
+    const char *record = tail.constData() + end;
+    qint64 count = le<quint16>(record + 10);
+    qint64 directory_size = le<quint32>(record + 12);
+    qint64 directory_offset = le<quint32>(record + 16);
+    if (count == 0xFFFF || directory_size == 0xFFFFFFFF || directory_offset == 0xFFFFFFFF) {
+        // zip64：结束记录之前是 zip64 定位记录，指向 zip64 结束记录
+        QByteArray locator = read_range(tail_offset + end - 20, 20);
+        if (locator.size() != 20 || le<quint32>(locator.constData()) != kZip64LocatorSignature) {
+            return false;
+        }
+        QByteArray zip64_end = read_range(static_cast<qint64>(le<quint64>(locator.constData() + 8)), 56);
+        if (zip64_end.size() != 56 || le<quint32>(zip64_end.constData()) != kZip64EndSignature) {
+            return false;
+        }
+        count = static_cast<qint64>(le<quint64>(zip64_end.constData() + 32));
+        directory_size = static_cast<qint64>(le<quint64>(zip64_end.constData() + 40));
+        directory_offset = static_cast<qint64>(le<quint64>(zip64_end.constData() + 48));
+    }
+
+    const QByteArray directory = read_range(directory_offset, directory_size);
+    if (directory.size() != directory_size) {
+        return false;
+    }
+    const char *data = directory.constData();
+    qint64 pos = 0;
+    for (qint64 n = 0; n < count; ++n) {
+        if (pos + kZipCentralSize > directory_size || le<quint32>(data + pos) != kZipCentralSignature) {
+            return false;
+        }
+        const char *entry = data + pos;
+        const quint16 flags = le<quint16>(entry + 8);
+        Member member;
+        member.method = le<quint16>(entry + 10);
+        member.compressed_size = le<quint32>(entry + 20);
+        member.size = le<quint32>(entry + 24);
+        const int name_size = le<quint16>(entry + 28);
+        const int extra_size = le<quint16>(entry + 30);
+        const int comment_size = le<quint16>(entry + 32);
+        member.offset = le<quint32>(entry + 42);
+        if (pos + kZipCentralSize + name_size + extra_size + comment_size > directory_size) {
+            return false;
+        }
+        // 通用标志第 11 位表示文件名为 UTF-8，否则为创建压缩包的系统的本地编码
+        const QString name = (flags & 0x800) ? QString::fromUtf8(entry + kZipCentralSize, name_size)
+                                             : QString::fromLocal8Bit(entry + kZipCentralSize, name_size);
+
+        // zip64 扩展字段依次保存取值为 0xFFFFFFFF 的原始大小、压缩大小与本地文件头位置
+        const char *extra = entry + kZipCentralSize + name_size;
+        for (int x = 0; x + 4 <= extra_size;) {
+            const int id = le<quint16>(extra + x);
+            const int size = le<quint16>(extra + x + 2);
+            if (id == 0x0001) {
+                const char *field = extra + x + 4;
+                int k = 0;
+                if (member.size == 0xFFFFFFFF && k + 8 <= size) {
+                    member.size = static_cast<qint64>(le<quint64>(field + k));
+                    k += 8;
+                }
+                if (member.compressed_size == 0xFFFFFFFF && k + 8 <= size) {
+                    member.compressed_size = static_cast<qint64>(le<quint64>(field + k));
+                    k += 8;
+                }
+                if (member.offset == 0xFFFFFFFF && k + 8 <= size) {
+                    member.offset = static_cast<qint64>(le<quint64>(field + k));
+                }
+            }
+            x += 4 + size;
+        }
+        pos += kZipCentralSize + name_size + extra_size + comment_size;
+
+        // 跳过加密成员与不支持的压缩方式
+        if ((flags & 0x1) || (member.method != 0 && member.method != Z_DEFLATED)) {
+            continue;
+        }
+        add_member(name, member);
+    }
+    return true;
+}
+
+bool ArchiveSource::load_tar() {
+    qint64 pos = 0;
+    QString next_name;  // GNU 长文件名或 pax 路径，作用于下一个成员
+    while (pos + kTarBlock <= m_size) {
+        const QByteArray block = read_range(pos, kTarBlock);
+        const char *header = block.constData();
+        if (header[0] == '\0') {
+            break;  // 结束块
+        }
+        if (!tar_checksum_valid(header)) {
+            return false;
+        }
+
+        const qint64 size = tar_number(header + 124, 12);
+        const char type = header[156];
+        const qint64 data = pos + kTarBlock;
+        if (size < 0 || size > m_size - data) {
+            return false;
+        }
+        QString name = next_name;
+        next_name.clear();
+        if (name.isEmpty()) {
+            name = tar_string(header, 100);
+            // POSIX ustar 的 prefix 字段；旧 GNU 格式（"ustar  "）该位置是其他字段
+            if (memcmp(header + 257, "ustar", 6) == 0 && header[345]) {
+                name = tar_string(header + 345, 155) + "/" + name;
+            }
+        }
+
+        if (type == 'L') {
+            const QByteArray long_name = read_range(data, size);
+            next_name = tar_string(long_name.constData(), long_name.size());
+        } else if (type == 'x') {
+            // pax 扩展头："长度 键=值\n"
+            const QByteArray records = read_range(data, size);
+            int i = 0;
+            while (i < records.size()) {
+                const int space = records.indexOf(' ', i);
+                const int length = space > i ? records.mid(i, space - i).toInt() : 0;
+                if (length <= 0 || i + length > records.size()) {
+                    break;
+                }
+                const QByteArray record = records.mid(space + 1, i + length - space - 2);
+                if (record.startsWith("path=")) {
+                    next_name = QString::fromUtf8(record.mid(5));
+                }
+                i += length;
+            }
+        } else if (type == '0' || type == '\0' || type == '7') {
+            add_member(name, {data, size, size, 0});
+        }
+        // 位置必须前进，否则损坏的头会导致死循环
+        const qint64 next = data + (size + kTarBlock - 1) / kTarBlock * kTarBlock;
+        if (next <= pos) {
+            return false;
+        }
+        pos = next;
+    }
+    return true;
+}
+
+QByteArray ArchiveSource::read(const QString &member, qint64 limit) const {
+    auto it = m_members.constFind(member);
+    if (it == m_members.constEnd()) {
+        return QByteArray();
+    }
+    const qint64 size = limit >= 0 ? qMin(limit, it->size) : it->size;
+    if (!m_zip) {
+        return read_range(it->offset, size);
+    }
+
+    // 数据位于本地文件头之后，本地文件头的扩展字段长度可能与中央目录不同
+    const QByteArray local = read_range(it->offset, kZipLocalSize);
+    if (local.size() != kZipLocalSize || le<quint32>(local.constData()) != kZipLocalSignature) {
+        return QByteArray();
+    }
+    const qint64 data = it->offset + kZipLocalSize + le<quint16>(local.constData() + 26) +
+                        le<quint16>(local.constData() + 28);
+    if (it->method == 0) {
+        return read_range(data, size);
+    }
+    if (data + it->compressed_size > m_size) {
+        return QByteArray();
+    }
+    if (m_base) {
+        return inflate_raw(reinterpret_cast<const char *>(m_base + data), it->compressed_size, size);
+    }
+    const QByteArray compressed = read_range(data, it->compressed_size);
+    return inflate_raw(compressed.constData(), compressed.size(), size);
+}
+
+void ArchiveSource::extract_missing(const QString &folder) {
+    // 压缩包中已有的标注、classes.txt 等小文件解压出来，之后在文件夹中修改
+    for (const QString &file: m_files) {
+        if (FolderScanner::is_image_file(file) || m_members.value(file).size > kMaxExtractSize) {
+            continue;
+        }
+        const QString path = folder + "/" + file;
+        if (QFile::exists(path)) {
+            continue;
+        }
+        QFile output(path);
+        if (output.open(QIODevice::WriteOnly)) {
+            output.write(read(file));
+        }
+    }
+}
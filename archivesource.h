@@ -0,0 +1,60 @@
+#ifndef ARCHIVESOURCE_H
+#define ARCHIVESOURCE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include "datasetsource.h"
+
+// 压缩包数据源
+// 不解压直接使用 zip / tar 压缩包中的图片。打开时建立一次成员索引：zip 读取中央目录（支持 zip64），
+// tar 依次跳过各个文件头（支持 GNU 长文件名与 pax 路径）；之后按需读取单个成员，
+// zip 成员支持存储与 deflate。压缩包整体内存映射，可在多个线程中同时读取。
+// 挂载到压缩包旁边的同名文件夹，挂载时解压压缩包中已有的标注。
+class ArchiveSource : public DatasetSource {
+public:
+    ArchiveSource();
+    ~ArchiveSource();
+
+    bool open(const QString &path);
+    void close();
+    bool is_open() const;
+    QString path() const;
+
+    QStringList files() const override;
+    bool contains(const QString &member) const override;
+    QByteArray read(const QString &member, qint64 limit = -1) const override;
+    // 大小为成员原始大小，修改时间为压缩包的修改时间，替换压缩包后随之改变
+    bool stat(const QString &member, qint64 *size, qint64 *mtime) const override;
+
+    // 按文件内容判断是否为支持的压缩包
+    static bool is_archive_file(const QString &path);
+
+protected:
+    void extract_missing(const QString &folder) override;
+
+private:
+    struct Member {
+        qint64 offset;           // zip 为本地文件头位置，tar 为数据位置
+        qint64 compressed_size;
+        qint64 size;
+        quint16 method;          // 0 存储，8 deflate
+    };
+
+    bool load_zip();
+    bool load_tar();
+    void add_member(QString name, const Member &member);
+    QByteArray read_range(qint64 offset, qint64 size) const;
+
+    QString m_path;
+    mutable QFile m_file;
+    mutable QMutex m_mutex;    // 无法内存映射时保护 m_file 的读取位置
+    const uchar *m_base;
+    qint64 m_size;
+    qint64 m_mtime;
+    bool m_zip;
+    QHash<QString, Member> m_members;
+    QStringList m_files;
+};
+
+#endif // ARCHIVESOURCE_H
@@ -0,0 +1,261 @@
+#include "batchoperation.h"
+#include "imagetrash.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+// 每个任务处理的文件数量
+const int kBatchChunkSize = 256;
+
+// 目标路径中保留相对路径，标注文件与图片同名，扩展名不变
+QString label_path_for(const QString &image_path, const QString &label_path) {
+    QFileInfo info(image_path);
+    return info.absolutePath() + "/" + info.completeBaseName() + "." + QFileInfo(label_path).suffix();
+}
+
+// 标注保存在共用容器中时不能直接移动文件，读出后按目标文件夹的格式写入
+bool transfer_shared_labels(const LabelFormat *source, const QString &image_path, const QString &target_image_path,
+                            const QString &target_folder, const QStringList &classes, bool remove_source,
+                            QString *target_label_path) {
+    QSize size = ImageProbe::image_size(QFile::exists(target_image_path) ? target_image_path : image_path);
+    QStringList known_classes = classes;
+    QList<LabelShape> shapes;
+    if (size.isEmpty() || !source->read(image_path, size, &known_classes, &shapes)) {
+        return false;
+    }
+    if (shapes.isEmpty()) {
+        return true;
+    }
+
+    const LabelFormat *destination = LabelFormat::folder_format(target_folder);
+    if (!destination->write(target_image_path, size, known_classes, shapes)) {
+        return false;
+    }
+    *target_label_path = destination->label_path(target_image_path);
+    return !remove_source || source->write(image_path, size, known_classes, QList<LabelShape>());
+}
+}
+
+// 后台任务：依次处理一块文件，结果一次发回主线程
+class BatchOperation::Task : public QRunnable {
+public:
+    Task(BatchOperation *operation, Type type, const QString &folder, const QString &target,
+         const QStringList &files, const QSharedPointer<ClassRegistry> &registry)
+        : m_operation(operation), m_type(type), m_folder(folder), m_target(target), m_files(files),
+          m_registry(registry) {
+    }
+
+    void run() override {
+        QList<Result> results;
+        for (const QString &file: m_files) {
+            if (m_operation->m_cancelled.load()) {
+                break;
+            }
+            results.append(BatchOperation::process(m_type, m_folder, m_target, file, m_registry.data()));
+        }
+
+        BatchOperation *operation = m_operation;
+        QMetaObject::invokeMethod(operation, [operation, results]() {
+            operation->on_task_finished(results);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    BatchOperation *m_operation;
+    Type m_type;
+    QString m_folder;
+    QString m_target;
+    QStringList m_files;
+    QSharedPointer<ClassRegistry> m_registry;
+};
+
+BatchOperation::BatchOperation(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_cancelled(false)
+      , m_type(MoveToTrash)
+      , m_pendingTasks(0)
+      , m_done(0)
+      , m_total(0) {
+}
+
+BatchOperation::~BatchOperation() {
+    cancel();
+    m_jobs.wait();
+}
+
+void BatchOperation::start(Type type, const QString &folder, const QStringList &files, const QString &target) {
+    if (is_running()) {
+        return;
+    }
+
+    m_cancelled = false;
+    // 移动到图片文件夹内部会被再次扫描到，也可能覆盖其他图片
+    if (type == MoveToFolder && is_inside_folder(target, folder)) {
+        qWarning() << "目标文件夹位于图片文件夹内:" << target;
+        m_results.clear();
+        emit finished(m_results);
+        return;
+    }
+
+    m_type = type;
+    m_done = 0;
+    m_total = files.size();
+    m_results.clear();
+    m_results.reserve(files.size());
+    // 所有任务共用类别表，不同文件中的同一新类别得到相同的序号
+    m_registry.reset(new ClassRegistry(folder, m_classes));
+
+    for (int start = 0; start < files.size(); start += kBatchChunkSize) {
+        m_jobs.start(new Task(this, type, folder, target, files.mid(start, kBatchChunkSize), m_registry));
+        ++m_pendingTasks;
+    }
+    if (m_pendingTasks == 0) {
+        emit finished(m_results);
+    }
+}
+
+bool BatchOperation::is_inside_folder(const QString &path, const QString &folder) {
+    // 目标文件夹可能还不存在，此时按清理后的绝对路径比较
+    QFileInfo path_info(path);
+    QFileInfo folder_info(folder);
+    const QString canonical_path = path_info.exists() ? path_info.canonicalFilePath() : path_info.absoluteFilePath();
+    const QString canonical_folder = folder_info.exists() ? folder_info.canonicalFilePath() : folder_info.absoluteFilePath();
+    const QString cleaned_path = QDir::cleanPath(canonical_path);
+    QString prefix = QDir::cleanPath(canonical_folder);
+    if (cleaned_path == prefix) {
+        return true;
+    }
+    if (!prefix.endsWith('/')) {
+        prefix += '/';
+    }
+    return cleaned_path.startsWith(prefix);
+}
+
+void BatchOperation::set_classes(const QStringList &classes) {
+    m_classes = classes;
+}
+
+QStringList BatchOperation::classes() const {
+    return m_registry ? m_registry->classes() : m_classes;
+}
+
+void BatchOperation::cancel() {
+    m_cancelled = true;
+}
+
+bool BatchOperation::is_running() const {
+    return m_pendingTasks > 0;
+}
+
+BatchOperation::Type BatchOperation::type() const {
+    return m_type;
+}
+
+BatchOperation::Result BatchOperation::process(Type type, const QString &folder, const QString &target,
+                                               const QString &file, ClassRegistry *registry) {
+    const QStringList classes = registry->classes();
+    Result result;
+    result.file = file;
+    QString image_path = folder + "/" + file;
+    const LabelFormat *format = LabelFormat::folder_format(folder);
+    QString label_path = format->label_path(image_path);
+
+    switch (type) {
+        case MoveToTrash: {
+            ImageTrash::Entry entry;
+            entry.file = file;
+            result.ok = ImageTrash::move_files(folder, &entry);
+            result.image_path = entry.image_path;
+            result.label_path = entry.label_path;
+            break;
+        }
+        case MoveToFolder: {
+            result.image_path = target + "/" + file;
+            if (QFile::exists(result.image_path)) {
+                break;
+            }
+            QDir().mkpath(QFileInfo(result.image_path).absolutePath());
+            // 同一文件系统内只是重命名
+            if (!QFile::rename(image_path, result.image_path)) {
+                break;
+            }
+            result.ok = true;
+            if (!format->per_image_files()) {
+                transfer_shared_labels(format, image_path, result.image_path, target, classes, true,
+                                       &result.label_path);
+            } else if (QFile::exists(label_path)) {
+                result.label_path = label_path_for(result.image_path, label_path);
+                QFile::remove(result.label_path);
+                if (!QFile::rename(label_path, result.label_path)) {
+                    result.label_path.clear();
+                }
+            }
+            break;
+        }
+        case CopyLabels: {
+            if (!format->per_image_files()) {
+                result.ok = transfer_shared_labels(format, image_path, target + "/" + file, target, classes, false,
+                                                   &result.label_path);
+                break;
+            }
+            if (!QFile::exists(label_path)) {
+                result.ok = true;
+                break;
+            }
+            result.label_path = label_path_for(target + "/" + file, label_path);
+            QDir().mkpath(QFileInfo(result.label_path).absolutePath());
+            QFile::remove(result.label_path);
+            result.ok = QFile::copy(label_path, result.label_path);
+            break;
+        }
+        case ClearLabels:
+            if (!format->per_image_files()) {
+                result.ok = format->write(image_path, QSize(), classes, QList<LabelShape>());
+                break;
+            }
+            result.ok = !QFile::exists(label_path) || QFile::remove(label_path);
+            break;
+        case ConvertLabels: {
+            // 原标注文件保留，没有标注时删除目标格式中过期的文件
+            const LabelFormat *source = format;
+            const LabelFormat *destination = LabelFormat::format(target);
+            if (!destination) {
+                break;
+            }
+            result.label_path = destination->label_path(image_path);
+            if (destination == source) {
+                result.ok = true;
+                break;
+            }
+
+            QList<LabelShape> shapes;
+            QStringList known_classes = classes;
+            QSize size = ImageProbe::image_size(image_path);
+            bool has_labels = !source->per_image_files() || QFile::exists(label_path);
+            if (has_labels &&
+                (size.isEmpty() || !registry->read(source, image_path, size, &known_classes, &shapes))) {
+                break;
+            }
+            result.ok = destination->write(image_path, size, known_classes, shapes);
+            break;
+        }
+    }
+    return result;
+}
+
+void BatchOperation::on_task_finished(const QList<Result> &results) {
+    m_results.append(results);
+    m_done += results.size();
+    emit progress(m_done, m_total);
+
+    if (--m_pendingTasks == 0) {
+        QList<Result> all_results;
+        all_results.swap(m_results);
+        emit finished(all_results);
+    }
+}
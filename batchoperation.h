@@ -0,0 +1,76 @@
+#ifndef BATCHOPERATION_H
+#define BATCHOPERATION_H
+
+#include <QObject>
+#include <QList>
+#include <QSharedPointer>
+#include <QStringList>
+#include <atomic>
+#include "jobscheduler.h"
+
+class ClassRegistry;
+
+// 批量文件操作类
+// 将选中的图片分块交给线程池处理，只通过 progress 信号报告进度，
+// 全部完成（或取消）后一次性发出 finished 信号，由调用方统一更新列表与索引。
+class BatchOperation : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Type {
+        MoveToTrash,   // 移入回收站（bak 目录），可撤销
+        MoveToFolder,  // 图片与标注文件移动到其他文件夹
+        CopyLabels,    // 标注文件复制到其他文件夹
+        ClearLabels,   // 删除标注文件
+        ConvertLabels  // 标注文件转换为 target 指定的格式，原文件保留
+    };
+
+    // 单个文件的处理结果
+    struct Result {
+        QString file;        // 相对于图片文件夹的路径
+        bool ok = false;
+        QString image_path;  // 图片移动后的路径
+        QString label_path;  // 标注文件移动或复制后的路径，没有标注文件时为空
+    };
+
+    explicit BatchOperation(QObject *parent = nullptr);
+    ~BatchOperation();
+
+    // target 为 MoveToFolder / CopyLabels 的目标文件夹，ConvertLabels 的目标格式标识
+    void start(Type type, const QString &folder, const QStringList &files, const QString &target = QString());
+    // ConvertLabels 在类别名称与序号之间转换时使用
+    void set_classes(const QStringList &classes);
+    // 包含转换时新出现的类别名称（已保存到 classes.txt）
+    QStringList classes() const;
+    // 取消后已处理的文件仍会在 finished 中报告
+    void cancel();
+    bool is_running() const;
+    Type type() const;
+
+    // path 是 folder 本身或位于 folder 之内（按解析符号链接后的路径比较）
+    static bool is_inside_folder(const QString &path, const QString &folder);
+
+signals:
+    void progress(int done, int total);
+    void finished(const QList<BatchOperation::Result> &results);
+
+private:
+    class Task;
+
+    static Result process(Type type, const QString &folder, const QString &target, const QString &file,
+                          ClassRegistry *registry);
+    void on_task_finished(const QList<Result> &results);
+
+    JobGroup m_jobs;
+    std::atomic<bool> m_cancelled;
+    Type m_type;
+    int m_pendingTasks;
+    int m_done;
+    int m_total;
+    QList<Result> m_results;
+    QStringList m_classes;
+    QSharedPointer<ClassRegistry> m_registry;
+};
+
+#endif // BATCHOPERATION_H
@@ -0,0 +1,67 @@
+// ImageScaler 与 QImage::scaled 的缩小速度比较
+// 用法: imagescaler_benchmark [图片路径]，不指定图片时使用 6000x4000 的随机图片
+#include "../imagescaler.h"
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace {
+const int kRuns = 7;
+
+// 多次运行取中位数（毫秒）
+double median_ms(const std::function<QImage()> &scale) {
+    std::vector<double> times;
+    for (int i = 0; i < kRuns; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        QImage result = scale();
+        times.push_back(timer.nsecsElapsed() / 1e6);
+        if (result.isNull()) {
+            return -1.0;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+QImage random_image(int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    QRandomGenerator generator(1);
+    for (int y = 0; y < height; ++y) {
+        quint32 *line = reinterpret_cast<quint32 *>(image.scanLine(y));
+        generator.fillRange(line, width);
+    }
+    return image;
+}
+}
+
+int main(int argc, char *argv[]) {
+    QTextStream out(stdout);
+    QImage image = argc > 1 ? QImage(QString::fromLocal8Bit(argv[1])) : random_image(6000, 4000);
+    if (image.isNull()) {
+        out << "cannot read image\n";
+        return 1;
+    }
+    image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                          : QImage::Format_RGB32);
+
+    out << "source " << image.width() << "x" << image.height() << ", simd " << ImageScaler::simd_level() << "\n";
+    out << "target\tImageScaler\tscaled(Smooth)\tscaled(Fast)  (ms, median of " << kRuns << ")\n";
+    for (int side: {2048, 1280, 640, 256}) {
+        const QSize size = image.size().scaled(side, side, Qt::KeepAspectRatio);
+        const double ours = median_ms([&]() { return ImageScaler::downscale(image, size); });
+        const double smooth = median_ms([&]() {
+            return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        });
+        const double fast = median_ms([&]() {
+            return image.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        });
+        out << size.width() << "x" << size.height() << "\t" << QString::number(ours, 'f', 1) << "\t\t"
+            << QString::number(smooth, 'f', 1) << "\t\t" << QString::number(fast, 'f', 1) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,319 @@
+#include "cocoexporter.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QDateTime>
+
+namespace {
+// 每个解析任务处理的图片数量
+const int kExportChunkSize = 512;
+// 拼接临时文件时每次复制的字节数
+const qint64 kCopyBlockSize = 1 << 20;
+}
+
+// 后台解析任务：读取一块图片的尺寸与标注文件（按文件夹选择的格式），转换为像素坐标
+class CocoExporter::ParseTask : public QRunnable {
+public:
+    ParseTask(CocoExporter *exporter, int generation, const QString &folder, int first,
+              const QStringList &files, const QList<QSize> &sizes, const QSharedPointer<ClassRegistry> &registry)
+        : m_exporter(exporter), m_generation(generation), m_folder(folder), m_first(first),
+          m_files(files), m_sizes(sizes), m_registry(registry), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        Chunk chunk;
+        chunk.first = m_first;
+        chunk.sizes.reserve(m_files.size());
+
+        for (int i = 0; i < m_files.size(); ++i) {
+            if (m_exporter->m_generation.load() != m_generation) {
+                return;
+            }
+
+            QSize size = m_sizes.at(i);
+            if (!size.isValid() || size.isEmpty()) {
+                size = ImageProbe::image_size(m_folder + "/" + m_files.at(i));
+            }
+            chunk.sizes.append(size);
+            if (size.isEmpty()) {
+                continue;
+            }
+
+            QList<LabelShape> shapes;
+            if (!m_registry->read(m_format, m_folder + "/" + m_files.at(i), size, nullptr, &shapes)) {
+                continue;
+            }
+            for (const LabelShape &shape: shapes) {
+                Annotation annotation;
+                annotation.image = i;
+                annotation.class_id = shape.class_id;
+                annotation.box = shape.box;
+                annotation.polygon = shape.points;
+                chunk.annotations.append(annotation);
+            }
+        }
+
+        CocoExporter *exporter = m_exporter;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(exporter, [exporter, generation, chunk]() {
+            exporter->on_chunk_parsed(generation, chunk);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    CocoExporter *m_exporter;
+    int m_generation;
+    QString m_folder;
+    int m_first;
+    QStringList m_files;
+    QList<QSize> m_sizes;
+    QSharedPointer<ClassRegistry> m_registry;
+    const LabelFormat *m_format;
+};
+
+CocoExporter::CocoExporter(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_generation(0)
+      , m_output(nullptr)
+      , m_annotations(nullptr)
+      , m_nextChunk(0)
+      , m_nextWrite(0)
+      , m_inFlight(0)
+      , m_done(0)
+      , m_annotationCount(0)
+      , m_maxClassId(-1) {
+}
+
+CocoExporter::~CocoExporter() {
+    cancel();
+}
+
+bool CocoExporter::start(const QString &folder, const QStringList &files, const QList<QSize> &sizes,
+                         const QStringList &classes, const QString &output) {
+    if (is_running()) {
+        return false;
+    }
+
+    m_folder = folder;
+    m_files = files;
+    m_sizes = sizes;
+    // 所有解析任务共用类别表，不同文件中的同一新类别得到相同的 ID
+    m_registry.reset(new ClassRegistry(folder, classes));
+    m_parsed.clear();
+    m_nextChunk = 0;
+    m_nextWrite = 0;
+    m_inFlight = 0;
+    m_done = 0;
+    m_annotationCount = 0;
+    m_maxClassId = classes.size() - 1;
+
+    m_output = new QSaveFile(output);
+    m_annotations = new QTemporaryFile();
+    if (!m_output->open(QIODevice::WriteOnly) || !m_annotations->open()) {
+        cleanup();
+        return false;
+    }
+
+    QByteArray header = "{\n\"info\": {\"description\": \"ImageLabeler export\", \"date_created\": ";
+    header += json_string(QDateTime::currentDateTime().toString(Qt::ISODate));
+    header += "},\n\"licenses\": [],\n\"images\": [";
+    m_output->write(header);
+
+    if (m_files.isEmpty()) {
+        finish();
+        return true;
+    }
+    schedule_chunks();
+    return true;
+}
+
+void CocoExporter::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    if (is_running()) {
+        m_output->cancelWriting();
+        cleanup();
+    }
+}
+
+bool CocoExporter::is_running() const {
+    return m_output != nullptr;
+}
+
+QStringList CocoExporter::classes() const {
+    return m_registry ? m_registry->classes() : QStringList();
+}
+
+void CocoExporter::schedule_chunks() {
+    // 限制同时处理的分块数量，写入较慢时不会无限积压解析结果
+    const int max_in_flight = qMax(2, m_jobs.max_running() * 2);
+    int chunk_count = (m_files.size() + kExportChunkSize - 1) / kExportChunkSize;
+    while (m_nextChunk < chunk_count && m_inFlight < max_in_flight) {
+        int first = m_nextChunk * kExportChunkSize;
+        m_jobs.start(new ParseTask(this, m_generation.load(), m_folder, first,
+                                   m_files.mid(first, kExportChunkSize), m_sizes.mid(first, kExportChunkSize),
+                                   m_registry));
+        ++m_nextChunk;
+        ++m_inFlight;
+    }
+}
+
+void CocoExporter::on_chunk_parsed(int generation, const Chunk &chunk) {
+    if (generation != m_generation.load() || !is_running()) {
+        return;
+    }
+
+    // 分块可能乱序完成，按原顺序写入
+    --m_inFlight;
+    m_parsed.insert(chunk.first / kExportChunkSize, chunk);
+    while (m_parsed.contains(m_nextWrite)) {
+        Chunk next = m_parsed.take(m_nextWrite);
+        if (!write_chunk(next)) {
+            fail(tr("写入文件失败: %1").arg(m_output->errorString()));
+            return;
+        }
+        ++m_nextWrite;
+        m_done += next.sizes.size();
+    }
+    emit progress(m_done, m_files.size());
+
+    if (m_done >= m_files.size()) {
+        finish();
+    } else {
+        schedule_chunks();
+    }
+}
+
+bool CocoExporter::write_chunk(const Chunk &chunk) {
+    QByteArray images;
+    for (int i = 0; i < chunk.sizes.size(); ++i) {
+        int image_id = chunk.first + i + 1;
+        images += image_id == 1 ? "\n" : ",\n";
+        images += "{\"id\": " + QByteArray::number(image_id);
+        images += ", \"file_name\": " + json_string(m_files.at(chunk.first + i));
+        images += ", \"width\": " + QByteArray::number(chunk.sizes.at(i).width());
+        images += ", \"height\": " + QByteArray::number(chunk.sizes.at(i).height()) + "}";
+    }
+
+    QByteArray annotations;
+    for (const Annotation &annotation: chunk.annotations) {
+        ++m_annotationCount;
+        m_maxClassId = qMax(m_maxClassId, annotation.class_id);
+
+        double area = annotation.box.width() * annotation.box.height();
+        QByteArray segmentation = "[]";
+        if (!annotation.polygon.isEmpty()) {
+            // 多边形面积（鞋带公式）
+            double twice_area = 0;
+            segmentation = "[[";
+            for (int k = 0; k < annotation.polygon.size(); ++k) {
+                const QPointF &p = annotation.polygon.at(k);
+                const QPointF &q = annotation.polygon.at((k + 1) % annotation.polygon.size());
+                twice_area += p.x() * q.y() - q.x() * p.y();
+                if (k > 0) {
+                    segmentation += ", ";
+                }
+                segmentation += json_number(p.x()) + ", " + json_number(p.y());
+            }
+            segmentation += "]]";
+            area = qAbs(twice_area) / 2;
+        }
+
+        annotations += m_annotationCount == 1 ? "\n" : ",\n";
+        annotations += "{\"id\": " + QByteArray::number(m_annotationCount);
+        annotations += ", \"image_id\": " + QByteArray::number(chunk.first + annotation.image + 1);
+        annotations += ", \"category_id\": " + QByteArray::number(annotation.class_id + 1);
+        annotations += ", \"bbox\": [" + json_number(annotation.box.x()) + ", " + json_number(annotation.box.y()) +
+                       ", " + json_number(annotation.box.width()) + ", " + json_number(annotation.box.height()) + "]";
+        annotations += ", \"area\": " + json_number(area);
+        annotations += ", \"segmentation\": " + segmentation;
+        annotations += ", \"iscrowd\": 0}";
+    }
+
+    return m_output->write(images) == images.size() && m_annotations->write(annotations) == annotations.size();
+}
+
+void CocoExporter::finish() {
+    // 拼接 annotations 临时文件
+    m_output->write("\n],\n\"annotations\": [");
+    m_annotations->seek(0);
+    while (!m_annotations->atEnd()) {
+        QByteArray block = m_annotations->read(kCopyBlockSize);
+        if (block.isEmpty() || m_output->write(block) != block.size()) {
+            fail(tr("写入文件失败: %1").arg(m_output->errorString()));
+            return;
+        }
+    }
+
+    // 类别 ID 从 1 开始，对应 classes.txt 中的第 id - 1 行
+    const QStringList classes = m_registry->classes();
+    QByteArray categories = "\n],\n\"categories\": [";
+    for (int id = 0; id <= m_maxClassId; ++id) {
+        QString name = id < classes.size() ? classes.at(id) : QString("class_%1").arg(id);
+        categories += id == 0 ? "\n" : ",\n";
+        categories += "{\"id\": " + QByteArray::number(id + 1) + ", \"name\": " + json_string(name) +
+                      ", \"supercategory\": \"\"}";
+    }
+    categories += "\n]\n}\n";
+    m_output->write(categories);
+
+    if (!m_output->commit()) {
+        fail(tr("写入文件失败: %1").arg(m_output->errorString()));
+        return;
+    }
+
+    QString message = tr("已导出 %1 张图片, %2 个标注").arg(m_files.size()).arg(m_annotationCount);
+    cleanup();
+    emit finished(true, message);
+}
+
+void CocoExporter::fail(const QString &message) {
+    ++m_generation;
+    m_jobs.clear();
+    m_output->cancelWriting();
+    cleanup();
+    emit finished(false, message);
+}
+
+void CocoExporter::cleanup() {
+    delete m_output;
+    m_output = nullptr;
+    delete m_annotations;
+    m_annotations = nullptr;
+    m_parsed.clear();
+    m_files.clear();
+    m_sizes.clear();
+    m_inFlight = 0;
+}
+
+QByteArray CocoExporter::json_string(const QString &text) {
+    QByteArray utf8 = text.toUtf8();
+    QByteArray escaped;
+    escaped.reserve(utf8.size() + 2);
+    escaped += '"';
+    for (char c: utf8) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped += QString("\\u%1").arg(static_cast<int>(c), 4, 16, QChar('0')).toLatin1();
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    escaped += '"';
+    return escaped;
+}
+
+QByteArray CocoExporter::json_number(double value) {
+    return QByteArray::number(value, 'f', 2);
+}
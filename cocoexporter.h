@@ -0,0 +1,88 @@
+#ifndef COCOEXPORTER_H
+#define COCOEXPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QPointF>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "jobscheduler.h"
+
+class ClassRegistry;
+class QSaveFile;
+class QTemporaryFile;
+
+// COCO 格式导出类
+// 标注文件在线程池中分块并行解析，结果按顺序直接写入磁盘：
+// images 写入输出文件，annotations 先写入临时文件，最后拼接并写入 categories。
+// 同时在处理中的分块数量有上限，内存占用与数据集大小无关。
+class CocoExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CocoExporter(QObject *parent = nullptr);
+    ~CocoExporter();
+
+    // files 为相对于 folder 的图片路径，sizes 为已知的图片尺寸（无效时读取文件头）
+    bool start(const QString &folder, const QStringList &files, const QList<QSize> &sizes,
+               const QStringList &classes, const QString &output);
+    void cancel();
+    bool is_running() const;
+    // 包含导出时新出现的类别名称（已保存到 classes.txt）
+    QStringList classes() const;
+
+signals:
+    void progress(int done, int total);
+    void finished(bool ok, const QString &message);
+
+private:
+    class ParseTask;
+
+    struct Annotation {
+        int image = 0;            // 分块内的图片序号
+        int class_id = 0;
+        QRectF box;               // 像素坐标
+        QVector<QPointF> polygon; // 像素坐标，矩形为空
+    };
+
+    struct Chunk {
+        int first = 0;            // 分块第一张图片在 files 中的位置
+        QVector<QSize> sizes;
+        QVector<Annotation> annotations;
+    };
+
+    void schedule_chunks();
+    void on_chunk_parsed(int generation, const Chunk &chunk);
+    bool write_chunk(const Chunk &chunk);
+    void finish();
+    void fail(const QString &message);
+    void cleanup();
+    static QByteArray json_string(const QString &text);
+    static QByteArray json_number(double value);
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+
+    QString m_folder;
+    QStringList m_files;
+    QList<QSize> m_sizes;
+    QSharedPointer<ClassRegistry> m_registry;
+
+    QSaveFile *m_output;
+    QTemporaryFile *m_annotations;
+    QMap<int, Chunk> m_parsed; // 已解析但还未轮到写入的分块
+    int m_nextChunk;
+    int m_nextWrite;
+    int m_inFlight;
+    int m_done;
+    qint64 m_annotationCount;
+    int m_maxClassId;
+};
+
+#endif // COCOEXPORTER_H
@@ -0,0 +1,452 @@
+#include "cocoimporter.h"
+#include "datasetindex.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPolygonF>
+
+namespace {
+// 缓存的标注行超过该大小时写入磁盘
+const qint64 kPendingLimit = 32 << 20;
+
+QByteArray format_number(double value) {
+    return QByteArray::number(value, 'f', 6);
+}
+}
+
+template<typename Function>
+bool CocoImporter::for_each_element(const char *data, qint64 begin, qint64 end, Function function) {
+    qint64 pos = skip_whitespace(data, end, begin + 1);
+    while (pos < end && data[pos] != ']') {
+        qint64 element_end = skip_value(data, end, pos);
+        if (element_end < 0) {
+            return false;
+        }
+
+        // 每个元素单独解析，解析完成后立即释放
+        QJsonDocument document = QJsonDocument::fromJson(
+            QByteArray::fromRawData(data + pos, static_cast<int>(element_end - pos)));
+        if (document.isObject() && !function(document.object(), element_end)) {
+            return false;
+        }
+
+        pos = skip_whitespace(data, end, element_end);
+        if (pos < end && data[pos] == ',') {
+            pos = skip_whitespace(data, end, pos + 1);
+        }
+    }
+    return true;
+}
+
+// 后台导入任务：依次解析 categories、images、annotations 三个数组
+class CocoImporter::ImportTask : public QRunnable {
+public:
+    ImportTask(CocoImporter *importer, const QString &input, const QString &folder, const QStringList &classes)
+        : m_importer(importer), m_input(input), m_folder(folder), m_classes(classes) {
+    }
+
+    void run() override {
+        QString message;
+        QStringList files;
+        State state;
+        state.folder = m_folder;
+        state.classes = m_classes;
+        state.format = LabelFormat::folder_format(m_folder);
+        bool ok = import(&state, &message);
+        if (!CocoImporter::flush(&state) && ok) {
+            ok = false;
+            message = QObject::tr("写入标注文件失败");
+        }
+
+        for (qint64 id: state.written) {
+            files.append(state.images.value(id).file);
+        }
+        if (ok) {
+            message = QObject::tr("已导入 %1 个标注, %2 张图片").arg(state.annotation_count).arg(files.size());
+            if (state.skipped_count > 0) {
+                message += QObject::tr(", 跳过 %1 个找不到图片或类别的标注").arg(state.skipped_count);
+            }
+        }
+
+        CocoImporter *importer = m_importer;
+        QStringList classes = state.classes;
+        QMetaObject::invokeMethod(importer, [importer, ok, message, files, classes]() {
+            importer->on_import_finished(ok, message, files, classes);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    bool import(State *state, QString *message) {
+        QFile file(m_input);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *message = QObject::tr("无法打开文件: %1").arg(file.errorString());
+            return false;
+        }
+
+        // 优先使用内存映射，文件内容不进入堆内存
+        qint64 size = file.size();
+        QByteArray buffer;
+        const char *data = reinterpret_cast<const char *>(file.map(0, size));
+        if (!data) {
+            buffer = file.readAll();
+            data = buffer.constData();
+        }
+
+        QHash<QByteArray, QPair<qint64, qint64>> arrays;
+        if (!CocoImporter::find_arrays(data, size, &arrays) ||
+            !arrays.contains("images") || !arrays.contains("annotations")) {
+            *message = QObject::tr("不是有效的 COCO 标注文件");
+            return false;
+        }
+
+        std::atomic<bool> &cancelled = m_importer->m_cancelled;
+        int last_percent = -1;
+        auto report = [this, &last_percent](qint64 done, qint64 total) {
+            int percent = total > 0 ? static_cast<int>(done * 100 / total) : 100;
+            if (percent != last_percent) {
+                last_percent = percent;
+                CocoImporter *importer = m_importer;
+                QMetaObject::invokeMethod(importer, [importer, percent]() {
+                    emit importer->progress(percent);
+                }, Qt::QueuedConnection);
+            }
+        };
+
+        if (arrays.contains("categories")) {
+            auto range = arrays.value("categories");
+            CocoImporter::for_each_element(data, range.first, range.second, [&](const QJsonObject &object, qint64) {
+                CocoImporter::add_category(state, object);
+                return !cancelled.load();
+            });
+        }
+
+        // 先读取全部图片信息，annotations 可能出现在 images 之前
+        auto images = arrays.value("images");
+        auto annotations = arrays.value("annotations");
+        qint64 total = (images.second - images.first) + (annotations.second - annotations.first);
+        bool parsed = CocoImporter::for_each_element(data, images.first, images.second,
+                                                     [&](const QJsonObject &object, qint64 pos) {
+            CocoImporter::add_image(state, object);
+            report(pos - images.first, total);
+            return !cancelled.load();
+        });
+        parsed = parsed && CocoImporter::for_each_element(data, annotations.first, annotations.second,
+                                                          [&](const QJsonObject &object, qint64 pos) {
+            CocoImporter::add_annotation(state, object);
+            if (state->pending_bytes > kPendingLimit && !CocoImporter::flush(state)) {
+                return false;
+            }
+            report(images.second - images.first + pos - annotations.first, total);
+            return !cancelled.load();
+        });
+
+        if (cancelled.load()) {
+            *message = QObject::tr("导入已取消");
+            return false;
+        }
+        if (!parsed) {
+            *message = QObject::tr("COCO 文件格式错误或写入标注文件失败");
+            return false;
+        }
+        return true;
+    }
+
+    CocoImporter *m_importer;
+    QString m_input;
+    QString m_folder;
+    QStringList m_classes;
+};
+
+CocoImporter::CocoImporter(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_cancelled(false)
+      , m_running(false) {
+    m_jobs.set_max_running(1);
+}
+
+CocoImporter::~CocoImporter() {
+    cancel();
+    m_jobs.wait();
+}
+
+void CocoImporter::start(const QString &input, const QString &folder, const QStringList &classes) {
+    if (m_running) {
+        return;
+    }
+
+    m_cancelled = false;
+    m_running = true;
+    m_jobs.start(new ImportTask(this, input, folder, classes));
+}
+
+void CocoImporter::cancel() {
+    m_cancelled = true;
+}
+
+bool CocoImporter::is_running() const {
+    return m_running;
+}
+
+void CocoImporter::on_import_finished(bool ok, const QString &message, const QStringList &files,
+                                      const QStringList &classes) {
+    m_running = false;
+    emit finished(ok, message, files, classes);
+}
+
+bool CocoImporter::find_arrays(const char *data, qint64 size, QHash<QByteArray, QPair<qint64, qint64>> *arrays) {
+    // 只遍历顶层对象的键，值整体跳过
+    qint64 pos = skip_whitespace(data, size, 0);
+    if (pos >= size || data[pos] != '{') {
+        return false;
+    }
+    pos = skip_whitespace(data, size, pos + 1);
+    while (pos < size && data[pos] != '}') {
+        if (data[pos] != '"') {
+            return false;
+        }
+        qint64 key_end = skip_value(data, size, pos);
+        if (key_end < 0) {
+            return false;
+        }
+        QByteArray key(data + pos + 1, static_cast<int>(key_end - pos - 2));
+
+        pos = skip_whitespace(data, size, key_end);
+        if (pos >= size || data[pos] != ':') {
+            return false;
+        }
+        pos = skip_whitespace(data, size, pos + 1);
+        qint64 value_end = skip_value(data, size, pos);
+        if (value_end < 0) {
+            return false;
+        }
+        if (data[pos] == '[') {
+            arrays->insert(key, qMakePair(pos, value_end));
+        }
+
+        pos = skip_whitespace(data, size, value_end);
+        if (pos < size && data[pos] == ',') {
+            pos = skip_whitespace(data, size, pos + 1);
+        }
+    }
+    return pos < size;
+}
+
+qint64 CocoImporter::skip_whitespace(const char *data, qint64 size, qint64 pos) {
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\n' || data[pos] == '\r' || data[pos] == '\t')) {
+        ++pos;
+    }
+    return pos;
+}
+
+qint64 CocoImporter::skip_value(const char *data, qint64 size, qint64 pos) {
+    if (pos >= size) {
+        return -1;
+    }
+
+    // 字符串与嵌套的对象、数组按括号深度跳过，字符串中的括号与转义字符不计入
+    int depth = 0;
+    bool in_string = false;
+    for (qint64 i = pos; i < size; ++i) {
+        char c = data[i];
+        if (in_string) {
+            if (c == '\\') {
+                ++i;
+            } else if (c == '"') {
+                in_string = false;
+                if (depth == 0) {
+                    return i + 1;
+                }
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+                in_string = true;
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (depth == 0) {
+                    return i;
+                }
+                if (--depth == 0) {
+                    return i + 1;
+                }
+                break;
+            case ',':
+            case ' ':
+            case '\n':
+            case '\r':
+            case '\t':
+                if (depth == 0) {
+                    return i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return depth == 0 && !in_string ? size : -1;
+}
+
+void CocoImporter::add_category(State *state, const QJsonObject &category) {
+    qint64 id = static_cast<qint64>(category.value("id").toDouble(-1));
+    QString name = category.value("name").toString().trimmed();
+    if (id < 0 || name.isEmpty()) {
+        return;
+    }
+
+    int class_id = state->classes.indexOf(name);
+    if (class_id < 0) {
+        class_id = state->classes.size();
+        state->classes.append(name);
+    }
+    state->category_classes.insert(id, class_id);
+}
+
+void CocoImporter::add_image(State *state, const QJsonObject &image) {
+    qint64 id = static_cast<qint64>(image.value("id").toDouble(-1));
+    QString file_name = QDir::fromNativeSeparators(image.value("file_name").toString());
+    if (id < 0 || file_name.isEmpty()) {
+        return;
+    }
+
+    // file_name 可能是相对路径、绝对路径或只有文件名
+    ImageInfo info;
+    QDir folder(state->folder);
+    QString relative = QFileInfo(file_name).isAbsolute() ? folder.relativeFilePath(file_name) : file_name;
+    if (!relative.startsWith("../") && QFile::exists(state->folder + "/" + relative)) {
+        info.file = relative;
+    } else if (QFile::exists(state->folder + "/" + QFileInfo(file_name).fileName())) {
+        info.file = QFileInfo(file_name).fileName();
+    }
+
+    info.width = image.value("width").toInt();
+    info.height = image.value("height").toInt();
+    if (!info.file.isEmpty() && (info.width <= 0 || info.height <= 0)) {
+        QSize size = ImageProbe::image_size(state->folder + "/" + info.file);
+        info.width = size.width();
+        info.height = size.height();
+    }
+    state->images.insert(id, info);
+}
+
+void CocoImporter::add_annotation(State *state, const QJsonObject &annotation) {
+    qint64 image_id = static_cast<qint64>(annotation.value("image_id").toDouble(-1));
+    qint64 category_id = static_cast<qint64>(annotation.value("category_id").toDouble(-1));
+    auto image = state->images.constFind(image_id);
+    auto category = state->category_classes.constFind(category_id);
+    if (image == state->images.constEnd() || image->file.isEmpty() || image->width <= 0 || image->height <= 0 ||
+        category == state->category_classes.constEnd()) {
+        ++state->skipped_count;
+        return;
+    }
+
+    const double width = image->width;
+    const double height = image->height;
+    QByteArray line = QByteArray::number(category.value());
+
+    // 多边形分割（RLE 格式只使用外接矩形），否则使用 bbox
+    QJsonValue segmentation = annotation.value("segmentation");
+    QJsonArray polygon = segmentation.isArray() && segmentation.toArray().size() > 0
+                         ? segmentation.toArray().at(0).toArray() : QJsonArray();
+    if (polygon.size() >= 6 && polygon.size() % 2 == 0) {
+        for (int i = 0; i < polygon.size(); i += 2) {
+            line += " " + format_number(polygon.at(i).toDouble() / width);
+            line += " " + format_number(polygon.at(i + 1).toDouble() / height);
+        }
+    } else {
+        QJsonArray bbox = annotation.value("bbox").toArray();
+        if (bbox.size() != 4) {
+            ++state->skipped_count;
+            return;
+        }
+        double x = bbox.at(0).toDouble();
+        double y = bbox.at(1).toDouble();
+        double w = bbox.at(2).toDouble();
+        double h = bbox.at(3).toDouble();
+        line += " " + format_number((x + w / 2) / width);
+        line += " " + format_number((y + h / 2) / height);
+        line += " " + format_number(w / width);
+        line += " " + format_number(h / height);
+    }
+    line += "\n";
+
+    state->pending[image_id] += line;
+    state->pending_bytes += line.size();
+    ++state->annotation_count;
+}
+
+bool CocoImporter::flush(State *state) {
+    bool ok = true;
+    const bool append_lines = state->format == LabelFormat::format("yolo");
+    for (auto it = state->pending.constBegin(); it != state->pending.constEnd(); ++it) {
+        if (!append_lines) {
+            if (!write_shapes(state, it.key(), it.value())) {
+                ok = false;
+                continue;
+            }
+            state->written.insert(it.key());
+            continue;
+        }
+
+        // 每张图片第一次写入时覆盖旧的标注文件，之后追加
+        QFile file(DatasetIndex::label_path(state->folder, state->images.value(it.key()).file));
+        QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Text;
+        mode |= state->written.contains(it.key()) ? QIODevice::Append : QIODevice::Truncate;
+        if (!file.open(mode) || file.write(it.value()) != it.value().size()) {
+            ok = false;
+            continue;
+        }
+        state->written.insert(it.key());
+    }
+    state->pending.clear();
+    state->pending_bytes = 0;
+    return ok;
+}
+
+bool CocoImporter::write_shapes(State *state, qint64 image_id, const QByteArray &lines) {
+    // 其他格式不能追加写入，与已写入的标注合并后整体重写
+    const ImageInfo image = state->images.value(image_id);
+    const QString image_path = state->folder + "/" + image.file;
+    const QSize size(image.width, image.height);
+    QList<LabelShape> shapes;
+    if (state->written.contains(image_id)) {
+        state->format->read(image_path, size, &state->classes, &shapes);
+    }
+
+    const QList<QByteArray> rows = lines.split('\n');
+    for (const QByteArray &row: rows) {
+        const QList<QByteArray> parts = row.split(' ');
+        if (parts.size() < 5) {
+            continue;
+        }
+
+        LabelShape shape;
+        shape.class_id = parts[0].toInt();
+        if (parts.size() == 5) {
+            double w = parts[3].toDouble() * size.width();
+            double h = parts[4].toDouble() * size.height();
+            shape.box = QRectF(parts[1].toDouble() * size.width() - w / 2,
+                               parts[2].toDouble() * size.height() - h / 2, w, h);
+        } else {
+            for (int i = 1; i + 1 < parts.size(); i += 2) {
+                shape.points.append(QPointF(parts[i].toDouble() * size.width(),
+                                            parts[i + 1].toDouble() * size.height()));
+            }
+            shape.box = QPolygonF(shape.points).boundingRect();
+        }
+        shapes.append(shape);
+    }
+    return state->format->write(image_path, size, state->classes, shapes);
+}
@@ -0,0 +1,79 @@
+#ifndef COCOIMPORTER_H
+#define COCOIMPORTER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <atomic>
+#include "jobscheduler.h"
+
+class QJsonObject;
+class LabelFormat;
+
+// COCO 格式导入类
+// 在后台线程中通过内存映射读取 JSON，只定位顶层的 images / annotations / categories 数组，
+// 数组元素逐个解析，不构建整个文档；转换后的 YOLO 标注按图片缓存，超过上限时追加写入标注文件。
+// 文件夹使用其他标注格式时，缓存的标注在写入时转换为该格式。
+class CocoImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CocoImporter(QObject *parent = nullptr);
+    ~CocoImporter();
+
+    // classes 为当前的类别列表，COCO 类别按名称对应，不存在的类别追加到末尾
+    void start(const QString &input, const QString &folder, const QStringList &classes);
+    void cancel();
+    bool is_running() const;
+
+signals:
+    void progress(int percent);
+    // files 为写入了标注的图片（相对路径），classes 为导入后的类别列表
+    void finished(bool ok, const QString &message, const QStringList &files, const QStringList &classes);
+
+private:
+    class ImportTask;
+
+    struct ImageInfo {
+        QString file;
+        int width = 0;
+        int height = 0;
+    };
+
+    // 在工作线程中执行的导入过程
+    struct State {
+        QString folder;
+        const LabelFormat *format = nullptr;
+        QStringList classes;
+        QHash<qint64, int> category_classes; // COCO 类别ID -> 类别序号
+        QHash<qint64, ImageInfo> images;     // COCO 图片ID -> 图片
+        QHash<qint64, QByteArray> pending;   // 尚未写入的标注行
+        qint64 pending_bytes = 0;
+        QSet<qint64> written;                // 已经写过（清空过旧内容）的图片
+        int annotation_count = 0;
+        int skipped_count = 0;
+    };
+
+    void on_import_finished(bool ok, const QString &message, const QStringList &files, const QStringList &classes);
+
+    static bool find_arrays(const char *data, qint64 size, QHash<QByteArray, QPair<qint64, qint64>> *arrays);
+    static qint64 skip_whitespace(const char *data, qint64 size, qint64 pos);
+    static qint64 skip_value(const char *data, qint64 size, qint64 pos);
+    template<typename Function>
+    static bool for_each_element(const char *data, qint64 begin, qint64 end, Function function);
+
+    static void add_category(State *state, const QJsonObject &category);
+    static void add_image(State *state, const QJsonObject &image);
+    static void add_annotation(State *state, const QJsonObject &annotation);
+    static bool flush(State *state);
+    static bool write_shapes(State *state, qint64 image_id, const QByteArray &lines);
+
+    JobGroup m_jobs;
+    std::atomic<bool> m_cancelled;
+    bool m_running;
+};
+
+#endif // COCOIMPORTER_H
@@ -0,0 +1,255 @@
+#include "cropexporter.h"
+#include "datasetsource.h"
+#include "imageprobe.h"
+#include "imagescaler.h"
+#include "labelformat.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QPolygonF>
+#include <QSet>
+#include <QtMath>
+
+namespace {
+// 每个裁剪任务处理的图片数量，解码较慢，块小一些以便线程间均衡
+const int kCropChunkSize = 32;
+// 输出 JPEG 的质量
+const int kJpegQuality = 95;
+}
+
+// 后台裁剪任务：依次解码一块图片并写出其中所有标注的裁剪
+class CropExporter::CropTask : public QRunnable {
+public:
+    CropTask(CropExporter *exporter, int generation, const QString &folder, const QStringList &files,
+             const QStringList &keys, const QSharedPointer<ClassRegistry> &registry, const QString &output,
+             double padding, int size)
+        : m_exporter(exporter), m_generation(generation), m_folder(folder), m_files(files), m_keys(keys),
+          m_registry(registry), m_output(output), m_padding(padding), m_size(size), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        int crops = 0;
+        int failed = 0;
+        QSet<QString> created_dirs;
+        for (int index = 0; index < m_files.size(); ++index) {
+            if (m_exporter->m_generation.load() != m_generation) {
+                return;
+            }
+
+            const QString &file = m_files.at(index);
+            QString image_path = m_folder + "/" + file;
+            QSize image_size = ImageProbe::image_size(image_path);
+            QStringList known_classes;
+            QList<LabelShape> shapes;
+            if (image_size.isEmpty() ||
+                !m_registry->read(m_format, image_path, image_size, &known_classes, &shapes) ||
+                shapes.isEmpty()) {
+                continue;
+            }
+
+            // 先计算所有裁剪区域（原图坐标），再决定解码尺寸
+            QRect bounds(QPoint(0, 0), image_size);
+            QList<QRect> rects;
+            int min_side = 0;
+            for (const LabelShape &shape: shapes) {
+                QRectF box = shape.is_polygon() ? QPolygonF(shape.points).boundingRect() : shape.box;
+                box.adjust(-box.width() * m_padding, -box.height() * m_padding,
+                           box.width() * m_padding, box.height() * m_padding);
+                QRect rect = box.toAlignedRect() & bounds;
+                rects.append(rect);
+                if (!rect.isEmpty()) {
+                    int side = qMax(rect.width(), rect.height());
+                    min_side = min_side == 0 ? side : qMin(min_side, side);
+                }
+            }
+            if (min_side == 0) {
+                continue;
+            }
+
+            // 所有裁剪都会被缩小时，JPEG 可直接按比例解码（libjpeg 的 DCT 缩放），减少解码量
+            SourceImageReader reader(image_path);
+            double scale = 1.0;
+            if (m_size > 0 && m_size < min_side && reader.format() == "jpeg") {
+                scale = static_cast<double>(m_size) / min_side;
+                reader.setScaledSize(QSize(qCeil(image_size.width() * scale), qCeil(image_size.height() * scale)));
+            }
+            QImage image = reader.read();
+            if (image.isNull()) {
+                qWarning() << "无法解码图片:" << image_path << reader.errorString();
+                failed += rects.size();
+                continue;
+            }
+            scale = static_cast<double>(image.width()) / image_size.width();
+
+            const QString &key = m_keys.at(index);
+            for (int i = 0; i < rects.size(); ++i) {
+                if (rects.at(i).isEmpty()) {
+                    continue;
+                }
+
+                QRectF scaled(rects.at(i).x() * scale, rects.at(i).y() * scale,
+                              rects.at(i).width() * scale, rects.at(i).height() * scale);
+                QImage crop = image.copy(scaled.toAlignedRect() & image.rect());
+                if (m_size > 0 && qMax(crop.width(), crop.height()) != m_size) {
+                    crop = ImageScaler::downscale(crop, crop.size().scaled(m_size, m_size, Qt::KeepAspectRatio));
+                }
+
+                QString dir = m_output + "/" + CropExporter::class_folder(known_classes, shapes.at(i).class_id);
+                if (!created_dirs.contains(dir)) {
+                    QDir().mkpath(dir);
+                    created_dirs.insert(dir);
+                }
+                QString path = QString("%1/%2_%3.jpg").arg(dir, key).arg(i);
+                if (crop.save(path, "JPG", kJpegQuality)) {
+                    ++crops;
+                } else {
+                    qWarning() << "无法保存裁剪图片:" << path;
+                    ++failed;
+                }
+            }
+        }
+
+        CropExporter *exporter = m_exporter;
+        int generation = m_generation;
+        int done = m_files.size();
+        QMetaObject::invokeMethod(exporter, [exporter, generation, done, crops, failed]() {
+            exporter->on_chunk_finished(generation, done, crops, failed);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    CropExporter *m_exporter;
+    int m_generation;
+    QString m_folder;
+    QStringList m_files;
+    QStringList m_keys;
+    QSharedPointer<ClassRegistry> m_registry;
+    QString m_output;
+    double m_padding;
+    int m_size;
+    const LabelFormat *m_format;
+};
+
+CropExporter::CropExporter(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_generation(0)
+      , m_total(0)
+      , m_pendingTasks(0)
+      , m_done(0)
+      , m_crops(0)
+      , m_failed(0)
+      , m_running(false) {
+}
+
+CropExporter::~CropExporter() {
+    cancel();
+}
+
+bool CropExporter::start(const QString &folder, const QStringList &files, const QStringList &classes,
+                         const QString &output, double padding, int size) {
+    if (is_running() || !QDir().mkpath(output)) {
+        return false;
+    }
+
+    m_output = output;
+    m_total = files.size();
+    m_pendingTasks = 0;
+    m_done = 0;
+    m_crops = 0;
+    m_failed = 0;
+    m_running = true;
+    m_timer.start();
+
+    // 不同图片可能得到相同的键（同名不同扩展名、路径分隔符与 '_'），重复的键加序号
+    QStringList keys;
+    keys.reserve(files.size());
+    QSet<QString> used;
+    used.reserve(files.size());
+    for (const QString &file: files) {
+        const QString base = crop_key(file);
+        QString key = base;
+        for (int n = 1; used.contains(key); ++n) {
+            key = base + "_" + QString::number(n);
+        }
+        used.insert(key);
+        keys.append(key);
+    }
+
+    // 所有任务共用类别表，新出现的类别名称保存到 classes.txt
+    m_registry.reset(new ClassRegistry(folder, classes));
+    for (int first = 0; first < files.size(); first += kCropChunkSize) {
+        m_jobs.start(new CropTask(this, m_generation.load(), folder, files.mid(first, kCropChunkSize),
+                                  keys.mid(first, kCropChunkSize), m_registry, output, qMax(0.0, padding),
+                                  qMax(0, size)));
+        ++m_pendingTasks;
+    }
+    if (m_pendingTasks == 0) {
+        finish();
+    }
+    return true;
+}
+
+void CropExporter::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_running = false;
+}
+
+bool CropExporter::is_running() const {
+    return m_running;
+}
+
+QStringList CropExporter::classes() const {
+    return m_registry ? m_registry->classes() : QStringList();
+}
+
+void CropExporter::on_chunk_finished(int generation, int done, int crops, int failed) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+
+    m_done += done;
+    m_crops += crops;
+    m_failed += failed;
+    emit progress(m_done, m_total);
+
+    if (--m_pendingTasks == 0) {
+        finish();
+    }
+}
+
+void CropExporter::finish() {
+    double seconds = qMax<qint64>(m_timer.elapsed(), 1) / 1000.0;
+    QString message = tr("已从 %1 张图片导出 %2 个裁剪到 %3, %4 个/秒")
+        .arg(m_total).arg(m_crops).arg(m_output)
+        .arg(m_crops / seconds, 0, 'f', 1);
+    if (m_failed > 0) {
+        message += tr(", %1 个失败").arg(m_failed);
+    }
+    m_running = false;
+    emit finished(m_failed == 0, message);
+}
+
+QString CropExporter::crop_key(const QString &file) {
+    // 子文件夹中的图片把路径分隔符替换为 '_'，避免不同文件夹的同名图片冲突
+    QFileInfo info(file);
+    QString key = info.completeBaseName();
+    int slash = file.lastIndexOf('/');
+    return slash < 0 ? key : QString(file.left(slash)).replace('/', '_') + "_" + key;
+}
+
+QString CropExporter::class_folder(const QStringList &classes, int class_id) {
+    QString name = class_id >= 0 && class_id < classes.size() ? classes.at(class_id) : QString::number(class_id);
+    // 类别名中不能作为文件夹名的字符替换为 '_'
+    for (QChar &ch: name) {
+        if (ch == '/' || ch == '\\' || ch == ':' || ch == '*' || ch == '?' || ch == '"' || ch == '<' || ch == '>' ||
+            ch == '|') {
+            ch = '_';
+        }
+    }
+    name = name.trimmed();
+    return name.isEmpty() || name == "." || name == ".." ? QString::number(class_id) : name;
+}
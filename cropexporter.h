@@ -0,0 +1,60 @@
+#ifndef CROPEXPORTER_H
+#define CROPEXPORTER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <atomic>
+#include "jobscheduler.h"
+
+class ClassRegistry;
+
+// 目标裁剪导出类
+// 把文件夹中每个矩形标注（多边形取外接矩形）按可选的边距与尺寸裁剪为单独的图片，
+// 保存到以类别名命名的子文件夹，用于训练二阶段分类器。
+// 每张图片只解码一次；指定输出尺寸且所有裁剪区域都比它大时，JPEG 以缩小的尺寸解码。
+class CropExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CropExporter(QObject *parent = nullptr);
+    ~CropExporter();
+
+    // padding 为每边相对框宽高的扩展比例，size 为输出的最长边（0 表示保持原尺寸）
+    bool start(const QString &folder, const QStringList &files, const QStringList &classes, const QString &output,
+               double padding, int size);
+    void cancel();
+    bool is_running() const;
+    // 包含导出时新出现的类别名称（已保存到 classes.txt）
+    QStringList classes() const;
+
+signals:
+    void progress(int done, int total);
+    void finished(bool ok, const QString &message);
+
+private:
+    class CropTask;
+
+    void on_chunk_finished(int generation, int done, int crops, int failed);
+    void finish();
+
+    static QString crop_key(const QString &file);
+    static QString class_folder(const QStringList &classes, int class_id);
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+
+    QString m_output;
+    QSharedPointer<ClassRegistry> m_registry;
+    int m_total;
+    int m_pendingTasks;
+    int m_done;
+    int m_crops;
+    int m_failed;
+    QElapsedTimer m_timer;
+    bool m_running;
+};
+
+#endif // CROPEXPORTER_H
@@ -0,0 +1,632 @@
+#include "datasetindex.h"
+#include "datasetsource.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+#include <QDebug>
+
+namespace {
+// 每个构建任务处理的文件数量
+const int kBuildChunkSize = 512;
+
+QString encode_class_counts(const QMap<int, int> &counts) {
+    QStringList parts;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        parts << QString("%1:%2").arg(it.key()).arg(it.value());
+    }
+    return parts.join(",");
+}
+
+QMap<int, int> decode_class_counts(const QString &text) {
+    QMap<int, int> counts;
+    const QStringList parts = text.split(",", Qt::SkipEmptyParts);
+    for (const QString &part: parts) {
+        int sep = part.indexOf(':');
+        if (sep > 0) {
+            counts.insert(part.left(sep).toInt(), part.mid(sep + 1).toInt());
+        }
+    }
+    return counts;
+}
+}
+
+// 后台构建任务：检查一批文件的时间戳，只对发生变化的文件读取图片头和标注文件
+class DatasetIndex::BuildTask : public QRunnable {
+public:
+    BuildTask(DatasetIndex *index, int generation, const QString &folder,
+              const QStringList &files, const QList<ImageRecord> &known, const QList<bool> &has_known,
+              const QStringList &classes)
+        : m_index(index), m_generation(generation), m_folder(folder),
+          m_files(files), m_known(known), m_hasKnown(has_known), m_classes(classes) {
+    }
+
+    void run() override {
+        QList<QPair<QString, ImageRecord>> results;
+        for (int i = 0; i < m_files.size(); ++i) {
+            // 文件夹已切换，放弃本次结果
+            if (m_index->m_generation.load() != m_generation) {
+                return;
+            }
+
+            const ImageRecord *known = m_hasKnown.at(i) ? &m_known.at(i) : nullptr;
+            ImageRecord record = DatasetIndex::scan_image(m_folder, m_files.at(i), known, m_classes);
+            if (!known || record.size != known->size || record.mtime != known->mtime ||
+                record.label_mtime != known->label_mtime) {
+                results.append(qMakePair(m_files.at(i), record));
+            }
+        }
+
+        DatasetIndex *index = m_index;
+        int generation = m_generation;
+        int processed = m_files.size();
+        QMetaObject::invokeMethod(index, [index, generation, results, processed]() {
+            index->apply_results(generation, results, processed);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    DatasetIndex *m_index;
+    int m_generation;
+    QString m_folder;
+    QStringList m_files;
+    QList<ImageRecord> m_known;
+    QList<bool> m_hasKnown;
+    QStringList m_classes;
+};
+
+DatasetIndex::DatasetIndex(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Indexing)
+      , m_generation(0)
+      , m_fullBuild(false)
+      , m_pendingTasks(0)
+      , m_done(0)
+      , m_total(0) {
+    m_connectionName = QString("dataset_index_%1").arg(reinterpret_cast<quintptr>(this));
+}
+
+DatasetIndex::~DatasetIndex() {
+    close();
+}
+
+bool DatasetIndex::open(const QString &folder) {
+    close();
+
+    m_folder = folder;
+    m_db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_db.setDatabaseName(folder + "/.imagelabeler.db");
+    if (!m_db.open()) {
+        qWarning() << "无法打开索引数据库:" << m_db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+    if (!query.exec("CREATE TABLE IF NOT EXISTS images ("
+                    "file TEXT PRIMARY KEY, "
+                    "size INTEGER, "
+                    "mtime INTEGER, "
+                    "label_mtime INTEGER, "
+                    "width INTEGER, "
+                    "height INTEGER, "
+                    "annotation_count INTEGER, "
+                    "class_counts TEXT, "
+                    "issue_count INTEGER DEFAULT 0, "
+                    "flagged INTEGER DEFAULT 0)")) {
+        qWarning() << "无法创建索引表:" << query.lastError().text();
+        return false;
+    }
+
+    // 旧版本创建的索引表补充新增的列，并让所有标注文件在下次构建时重新检查
+    if (add_column("issue_count INTEGER DEFAULT 0")) {
+        query.exec("UPDATE images SET label_mtime = -1");
+    }
+    add_column("flagged INTEGER DEFAULT 0");
+
+    load_records();
+    return true;
+}
+
+void DatasetIndex::close() {
+    // 使正在运行的构建任务失效并等待其退出
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_pendingTasks = 0;
+    m_fullBuild = false;
+    m_liveFiles.clear();
+    m_records.clear();
+
+    if (m_db.isValid()) {
+        m_db.close();
+        m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+    m_folder.clear();
+}
+
+bool DatasetIndex::is_open() const {
+    return m_db.isOpen();
+}
+
+bool DatasetIndex::add_column(const QString &definition) {
+    QString name = definition.section(' ', 0, 0);
+    QSqlQuery query(m_db);
+    if (query.exec("PRAGMA table_info(images)")) {
+        while (query.next()) {
+            if (query.value(1).toString() == name) {
+                return false;
+            }
+        }
+    }
+    if (!query.exec("ALTER TABLE images ADD COLUMN " + definition)) {
+        qWarning() << "无法更新索引表:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void DatasetIndex::load_records() {
+    m_records.clear();
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT file, size, mtime, label_mtime, width, height, annotation_count, class_counts, "
+                    "issue_count, flagged FROM images")) {
+        return;
+    }
+
+    while (query.next()) {
+        ImageRecord record;
+        record.size = query.value(1).toLongLong();
+        record.mtime = query.value(2).toLongLong();
+        record.label_mtime = query.value(3).toLongLong();
+        record.width = query.value(4).toInt();
+        record.height = query.value(5).toInt();
+        record.annotation_count = query.value(6).toInt();
+        record.class_counts = decode_class_counts(query.value(7).toString());
+        record.issue_count = query.value(8).toInt();
+        record.flagged = query.value(9).toBool();
+        m_records.insert(query.value(0).toString(), record);
+    }
+}
+
+void DatasetIndex::write_record(const QString &file, const ImageRecord &record) {
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO images "
+                  "(file, size, mtime, label_mtime, width, height, annotation_count, class_counts, "
+                  "issue_count, flagged) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(file);
+    query.addBindValue(record.size);
+    query.addBindValue(record.mtime);
+    query.addBindValue(record.label_mtime);
+    query.addBindValue(record.width);
+    query.addBindValue(record.height);
+    query.addBindValue(record.annotation_count);
+    query.addBindValue(encode_class_counts(record.class_counts));
+    query.addBindValue(record.issue_count);
+    query.addBindValue(record.flagged ? 1 : 0);
+    if (!query.exec()) {
+        qWarning() << "写入索引失败:" << query.lastError().text();
+    }
+}
+
+void DatasetIndex::build(const QStringList &files) {
+    if (!m_db.isOpen()) {
+        return;
+    }
+
+    ++m_generation;
+    m_jobs.clear();
+    m_liveFiles = QSet<QString>(files.begin(), files.end());
+    m_fullBuild = true;
+    m_pendingTasks = 0;
+    m_done = 0;
+    m_total = 0;
+
+    schedule_tasks(files);
+    if (m_pendingTasks == 0) {
+        finish_build();
+    }
+}
+
+void DatasetIndex::update_images(const QStringList &files) {
+    if (!m_db.isOpen() || files.isEmpty()) {
+        return;
+    }
+
+    // 完整构建进行中时，新文件也要计入存活集合，避免被当作过期记录清除
+    if (m_fullBuild) {
+        for (const QString &file: files) {
+            m_liveFiles.insert(file);
+        }
+    }
+    if (m_pendingTasks == 0) {
+        m_done = 0;
+        m_total = 0;
+    }
+    schedule_tasks(files);
+}
+
+void DatasetIndex::schedule_tasks(const QStringList &files) {
+    int generation = m_generation.load();
+    m_total += files.size();
+
+    for (int start = 0; start < files.size(); start += kBuildChunkSize) {
+        QStringList chunk = files.mid(start, kBuildChunkSize);
+        QList<ImageRecord> known;
+        QList<bool> has_known;
+        known.reserve(chunk.size());
+        has_known.reserve(chunk.size());
+        for (const QString &file: chunk) {
+            auto it = m_records.constFind(file);
+            has_known.append(it != m_records.constEnd());
+            known.append(it != m_records.constEnd() ? it.value() : ImageRecord());
+        }
+
+        m_jobs.start(new BuildTask(this, generation, m_folder, chunk, known, has_known, m_classes));
+        ++m_pendingTasks;
+    }
+}
+
+bool DatasetIndex::is_building() const {
+    return m_pendingTasks > 0;
+}
+
+void DatasetIndex::apply_results(int generation, const QList<QPair<QString, ImageRecord>> &results, int processed) {
+    if (generation != m_generation.load()) {
+        return;
+    }
+
+    if (!results.isEmpty()) {
+        m_db.transaction();
+        for (const auto &result: results) {
+            ImageRecord record = result.second;
+            auto it = m_records.constFind(result.first);
+            record.flagged = it != m_records.constEnd() && it->flagged;
+            m_records.insert(result.first, record);
+            write_record(result.first, record);
+        }
+        m_db.commit();
+    }
+
+    m_done += processed;
+    emit build_progress(m_done, m_total);
+
+    if (--m_pendingTasks == 0) {
+        finish_build();
+    }
+}
+
+void DatasetIndex::finish_build() {
+    // 完整构建时清除已不存在的文件记录
+    QStringList stale;
+    if (m_fullBuild) {
+        for (auto it = m_records.constBegin(); it != m_records.constEnd(); ++it) {
+            if (!m_liveFiles.contains(it.key())) {
+                stale.append(it.key());
+            }
+        }
+    }
+
+    if (!stale.isEmpty()) {
+        m_db.transaction();
+        QSqlQuery query(m_db);
+        query.prepare("DELETE FROM images WHERE file = ?");
+        for (const QString &file: stale) {
+            m_records.remove(file);
+            query.bindValue(0, file);
+            query.exec();
+        }
+        m_db.commit();
+    }
+
+    m_liveFiles.clear();
+    m_fullBuild = false;
+    emit build_finished();
+}
+
+bool DatasetIndex::contains(const QString &file) const {
+    return m_records.contains(file);
+}
+
+ImageRecord DatasetIndex::record(const QString &file) const {
+    return m_records.value(file);
+}
+
+QSize DatasetIndex::image_size(const QString &file) {
+    // 索引中的尺寸就是按文件大小与修改时间校验过的缓存
+    auto it = m_records.constFind(file);
+    if (it != m_records.constEnd() && it->width > 0 && it->height > 0) {
+        return QSize(it->width, it->height);
+    }
+    if (!m_db.isOpen()) {
+        return ImageProbe::image_size(m_folder + "/" + file);
+    }
+
+    ImageRecord record = scan_image(m_folder, file, it != m_records.constEnd() ? &it.value() : nullptr, m_classes);
+    if (it != m_records.constEnd()) {
+        record.flagged = it->flagged;
+    }
+    m_records.insert(file, record);
+    write_record(file, record);
+    return QSize(record.width, record.height);
+}
+
+void DatasetIndex::update_image(const QString &file, int width, int height, const QMap<int, int> &class_counts) {
+    if (!m_db.isOpen()) {
+        return;
+    }
+
+    ImageRecord record;
+    DatasetSource::file_stamp(m_folder + "/" + file, &record.size, &record.mtime);
+    record.label_mtime = LabelFormat::folder_format(m_folder)->label_stamp(m_folder + "/" + file);
+    record.width = width;
+    record.height = height;
+    record.class_counts = class_counts;
+    for (int count: class_counts) {
+        record.annotation_count += count;
+    }
+
+    auto it = m_records.constFind(file);
+    if (it != m_records.constEnd() && it->size == record.size && it->mtime == record.mtime &&
+        it->label_mtime == record.label_mtime && it->width == record.width && it->height == record.height &&
+        it->class_counts == record.class_counts) {
+        return;
+    }
+    record.flagged = it != m_records.constEnd() && it->flagged;
+
+    // 重新检查刚写入的标注文件
+    if (record.label_mtime != 0) {
+        ImageRecord checked;
+        scan_label(m_folder, file, QSize(width, height), m_classes, &checked);
+        record.issue_count = checked.issue_count;
+    }
+
+    m_records.insert(file, record);
+    write_record(file, record);
+    emit record_changed(file);
+}
+
+void DatasetIndex::remove_image(const QString &file) {
+    if (!m_db.isOpen() || !m_records.remove(file)) {
+        return;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM images WHERE file = ?");
+    query.addBindValue(file);
+    query.exec();
+    emit record_changed(file);
+}
+
+void DatasetIndex::remove_images(const QStringList &files) {
+    if (!m_db.isOpen()) {
+        return;
+    }
+
+    m_db.transaction();
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM images WHERE file = ?");
+    for (const QString &file: files) {
+        if (m_records.remove(file)) {
+            query.bindValue(0, file);
+            query.exec();
+        }
+    }
+    m_db.commit();
+}
+
+void DatasetIndex::restore_images(const QList<QPair<QString, ImageRecord>> &records) {
+    if (!m_db.isOpen()) {
+        return;
+    }
+
+    // 文件时间戳不变，恢复后无需重新扫描
+    m_db.transaction();
+    for (const auto &record: records) {
+        m_records.insert(record.first, record.second);
+        write_record(record.first, record.second);
+    }
+    m_db.commit();
+}
+
+void DatasetIndex::set_classes(const QStringList &classes) {
+    m_classes = classes;
+}
+
+void DatasetIndex::set_flagged(const QString &file, bool flagged) {
+    if (!m_db.isOpen()) {
+        return;
+    }
+
+    // 尚未建立索引的图片先同步扫描一次
+    auto it = m_records.find(file);
+    if (it == m_records.end()) {
+        it = m_records.insert(file, scan_image(m_folder, file, nullptr, m_classes));
+    }
+    if (it->flagged == flagged) {
+        return;
+    }
+
+    it->flagged = flagged;
+    write_record(file, it.value());
+    emit record_changed(file);
+}
+
+int DatasetIndex::image_count() const {
+    return m_records.size();
+}
+
+int DatasetIndex::labelled_count() const {
+    int count = 0;
+    for (const ImageRecord &record: m_records) {
+        if (record.is_labelled()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int DatasetIndex::annotation_total() const {
+    int total = 0;
+    for (const ImageRecord &record: m_records) {
+        total += record.annotation_count;
+    }
+    return total;
+}
+
+QMap<int, int> DatasetIndex::class_totals() const {
+    QMap<int, int> totals;
+    for (const ImageRecord &record: m_records) {
+        for (auto it = record.class_counts.constBegin(); it != record.class_counts.constEnd(); ++it) {
+            totals[it.key()] += it.value();
+        }
+    }
+    return totals;
+}
+
+ImageSummary DatasetIndex::summary(const QString &file) const {
+    ImageSummary summary;
+    auto it = m_records.constFind(file);
+    if (it == m_records.constEnd()) {
+        return summary;
+    }
+
+    summary.flags = ImageSummary::Indexed;
+    if (it->is_labelled()) {
+        summary.flags |= ImageSummary::Labelled;
+    }
+    if (it->flagged) {
+        summary.flags |= ImageSummary::Flagged;
+    }
+    if (it->issue_count > 0) {
+        summary.flags |= ImageSummary::HasIssues;
+    }
+    summary.annotation_count = static_cast<quint32>(it->annotation_count);
+    for (auto count = it->class_counts.constBegin(); count != it->class_counts.constEnd(); ++count) {
+        if (count.key() >= 0) {
+            summary.class_mask |= quint64(1) << qMin(count.key(), 63);
+        }
+    }
+    return summary;
+}
+
+QString DatasetIndex::label_path(const QString &folder, const QString &file) {
+    return LabelFormat::folder_format(folder)->label_path(folder + "/" + file);
+}
+
+ImageRecord DatasetIndex::scan_image(const QString &folder, const QString &file, const ImageRecord *known,
+                                     const QStringList &classes) {
+    ImageRecord record;
+    // 挂载的数据来源中的图片使用来源列出的大小与修改时间，不需要读取图片
+    const QString image_path = folder + "/" + file;
+    DatasetSource::file_stamp(image_path, &record.size, &record.mtime);
+
+    record.label_mtime = LabelFormat::folder_format(folder)->label_stamp(image_path);
+
+    // 图片未变化时沿用已知尺寸，否则只读取文件头获取尺寸
+    if (known && known->size == record.size && known->mtime == record.mtime && known->width > 0) {
+        record.width = known->width;
+        record.height = known->height;
+    } else {
+        QSize size = ImageProbe::image_size(image_path);
+        record.width = size.width();
+        record.height = size.height();
+    }
+
+    // 标注文件未变化时沿用已知统计
+    if (known && known->label_mtime == record.label_mtime) {
+        record.annotation_count = known->annotation_count;
+        record.class_counts = known->class_counts;
+        record.issue_count = known->issue_count;
+        return record;
+    }
+
+    if (record.label_mtime != 0) {
+        scan_label(folder, file, QSize(record.width, record.height), classes, &record);
+    }
+    return record;
+}
+
+void DatasetIndex::scan_label(const QString &folder, const QString &file, const QSize &size,
+                              const QStringList &classes, ImageRecord *record) {
+    const LabelFormat *format = LabelFormat::folder_format(folder);
+    if (format == LabelFormat::format("yolo")) {
+        scan_yolo_label(format->label_path(folder + "/" + file), classes.size(), record);
+        return;
+    }
+
+    // 其他格式先读取为像素坐标，再检查类别与坐标范围
+    QStringList known_classes = classes;
+    QList<LabelShape> shapes;
+    if (!format->read(folder + "/" + file, size, &known_classes, &shapes)) {
+        record->issue_count++;
+        return;
+    }
+
+    const QRectF bounds = QRectF(0, 0, size.width(), size.height()).adjusted(-0.5, -0.5, 0.5, 0.5);
+    for (const LabelShape &shape: shapes) {
+        bool valid = shape.class_id >= 0 && (classes.isEmpty() || shape.class_id < classes.size()) &&
+                     shape.box.width() > 0 && shape.box.height() > 0;
+        if (valid && !size.isEmpty() && !bounds.contains(shape.box)) {
+            valid = false;
+        }
+        // 无效的标注只计为问题，不计入类别统计
+        if (!valid) {
+            record->issue_count++;
+            continue;
+        }
+
+        record->class_counts[shape.class_id]++;
+        record->annotation_count++;
+    }
+}
+
+void DatasetIndex::scan_yolo_label(const QString &path, int class_count, ImageRecord *record) {
+    QFile label_file(path);
+    if (!label_file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+
+    QTextStream in(&label_file);
+    while (!in.atEnd()) {
+        QStringList parts = in.readLine().split(" ", Qt::SkipEmptyParts);
+        if (parts.isEmpty()) {
+            continue;
+        }
+        // 与 load_annotations 的解析规则保持一致：矩形 5 个字段，多边形为奇数个字段
+        if (parts.size() != 5 && (parts.size() < 7 || parts.size() % 2 == 0)) {
+            record->issue_count++;
+            continue;
+        }
+
+        bool ok = false;
+        int class_id = parts[0].toInt(&ok);
+        bool valid = ok && class_id >= 0 && (class_count == 0 || class_id < class_count);
+        QVector<double> values;
+        for (int i = 1; i < parts.size() && valid; ++i) {
+            double value = parts[i].toDouble(&ok);
+            valid = ok && value >= 0.0 && value <= 1.0;
+            values.append(value);
+        }
+        // 矩形宽高不能为 0
+        if (valid && parts.size() == 5 && (values[2] <= 0.0 || values[3] <= 0.0)) {
+            valid = false;
+        }
+        if (!valid) {
+            record->issue_count++;
+            continue;
+        }
+
+        record->class_counts[class_id]++;
+        record->annotation_count++;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef DATASETINDEX_H
+#define DATASETINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+#include <QSqlDatabase>
+#include <atomic>
+#include "imagefilelist.h"
+#include "jobscheduler.h"
+
+// 单张图片的索引记录
+struct ImageRecord {
+    qint64 size = 0;             // 图片文件大小
+    qint64 mtime = 0;            // 图片修改时间(毫秒)
+    qint64 label_mtime = 0;      // 标注校验值(见 LabelFormat::label_stamp)，0 表示没有标注
+    int width = 0;               // 图片宽度
+    int height = 0;              // 图片高度
+    int annotation_count = 0;    // 标注数量
+    QMap<int, int> class_counts; // 类别ID -> 标注数量
+    int issue_count = 0;         // 无法解析、坐标越界或面积为 0 的标注行数量
+    bool flagged = false;        // 用户标记，不随重新扫描改变
+
+    bool is_labelled() const { return annotation_count > 0; }
+};
+
+// 数据集索引类
+// 每个文件夹一个 SQLite 数据库(.imagelabeler.db)，记录图片大小、修改时间、尺寸与标注统计。
+// 首次打开时在线程池中并行构建，之后只重新扫描发生变化的文件，保存标注时增量更新。
+class DatasetIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DatasetIndex(QObject *parent = nullptr);
+    ~DatasetIndex();
+
+    bool open(const QString &folder);
+    void close();
+    bool is_open() const;
+
+    // 异步增量构建索引，完成后发出 build_finished 信号
+    void build(const QStringList &files);
+    // 只扫描指定文件（例如文件夹中新出现的图片），不清理其他记录
+    void update_images(const QStringList &files);
+    bool is_building() const;
+
+    bool contains(const QString &file) const;
+    ImageRecord record(const QString &file) const;
+    // 生成文件列表中使用的标注摘要
+    ImageSummary summary(const QString &file) const;
+    // 图片尺寸：优先使用索引中的记录，没有时只读取文件头并写入索引
+    QSize image_size(const QString &file);
+    void update_image(const QString &file, int width, int height, const QMap<int, int> &class_counts);
+    void remove_image(const QString &file);
+    // 批量删除与恢复记录（例如批量删除、撤销删除），不逐个发出 record_changed 信号
+    void remove_images(const QStringList &files);
+    void restore_images(const QList<QPair<QString, ImageRecord>> &records);
+    void set_flagged(const QString &file, bool flagged);
+
+    // 数据集统计，全部来自内存中的索引，不读取标注文件
+    int image_count() const;
+    int labelled_count() const;
+    int annotation_total() const;
+    QMap<int, int> class_totals() const;
+
+    // 非 YOLO 格式按类别名称保存，扫描时需要当前的类别列表
+    void set_classes(const QStringList &classes);
+
+    // 标注文件路径由文件夹选择的标注格式决定
+    static QString label_path(const QString &folder, const QString &file);
+    static ImageRecord scan_image(const QString &folder, const QString &file, const ImageRecord *known,
+                                  const QStringList &classes);
+    static void scan_label(const QString &folder, const QString &file, const QSize &size,
+                           const QStringList &classes, ImageRecord *record);
+
+signals:
+    void build_progress(int done, int total);
+    void build_finished();
+    void record_changed(const QString &file);
+
+private:
+    class BuildTask;
+
+    void load_records();
+    bool add_column(const QString &definition);
+    void schedule_tasks(const QStringList &files);
+    void write_record(const QString &file, const ImageRecord &record);
+    void apply_results(int generation, const QList<QPair<QString, ImageRecord>> &results, int processed);
+    void finish_build();
+    static void scan_yolo_label(const QString &path, int class_count, ImageRecord *record);
+
+    QString m_folder;
+    QString m_connectionName;
+    QSqlDatabase m_db;
+    QHash<QString, ImageRecord> m_records;
+    QStringList m_classes;
+
+    // 构建状态
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+    QSet<QString> m_liveFiles;
+    bool m_fullBuild;
+    int m_pendingTasks;
+    int m_done;
+    int m_total;
+};
+
+#endif // DATASETINDEX_H
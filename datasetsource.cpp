@@ -0,0 +1,117 @@
+#include "datasetsource.h"
+#include "folderscanner.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QReadWriteLock>
+#include <QSet>
+
+namespace {
+// 当前挂载的数据来源
+QReadWriteLock g_mountLock;
+QString g_mountFolder;
+QSharedPointer<DatasetSource> g_mounted;
+
+// path 为挂载的成员时返回来源与成员路径；只在查找期间持有挂载锁
+QSharedPointer<DatasetSource> mounted_member(const QString &path, QString *member) {
+    QReadLocker locker(&g_mountLock);
+    if (!g_mounted || path.size() <= g_mountFolder.size() || !path.startsWith(g_mountFolder) ||
+        path.at(g_mountFolder.size()) != QLatin1Char('/')) {
+        return QSharedPointer<DatasetSource>();
+    }
+    *member = path.mid(g_mountFolder.size() + 1);
+    if (!g_mounted->contains(*member)) {
+        return QSharedPointer<DatasetSource>();
+    }
+    return g_mounted;
+}
+}
+
+void DatasetSource::prepare_folder(const QString &folder) {
+    // 标注按图片路径保存，先创建所有子文件夹
+    QDir root(QDir::cleanPath(folder));
+    QSet<QString> dirs;
+    for (const QString &file: files()) {
+        const int slash = file.lastIndexOf('/');
+        if (slash > 0) {
+            dirs.insert(file.left(slash));
+        }
+    }
+    for (const QString &dir: dirs) {
+        root.mkpath(dir);
+    }
+    extract_missing(root.path());
+}
+
+void DatasetSource::mount(const QString &folder, const QSharedPointer<DatasetSource> &source) {
+    QWriteLocker locker(&g_mountLock);
+    g_mountFolder = QDir::cleanPath(folder);
+    g_mounted = source;
+}
+
+void DatasetSource::unmount() {
+    QSharedPointer<DatasetSource> source;
+    {
+        QWriteLocker locker(&g_mountLock);
+        g_mountFolder.clear();
+        source.swap(g_mounted);
+    }
+    // 在锁外释放引用；有线程正在读取时由最后一个读取者删除来源
+}
+
+QStringList DatasetSource::mounted_images(const QString &folder) {
+    QReadLocker locker(&g_mountLock);
+    QStringList images;
+    if (!g_mounted || QDir::cleanPath(folder) != g_mountFolder) {
+        return images;
+    }
+    for (const QString &file: g_mounted->files()) {
+        if (FolderScanner::is_image_file(file)) {
+            images.append(file);
+        }
+    }
+    return images;
+}
+
+bool DatasetSource::read_mounted(const QString &path, QByteArray *data, qint64 limit) {
+    QString member;
+    QSharedPointer<DatasetSource> source = mounted_member(path, &member);
+    if (!source || QFile::exists(path)) {
+        return false;
+    }
+    *data = source->read(member, limit);
+    return !data->isEmpty();
+}
+
+void DatasetSource::file_stamp(const QString &path, qint64 *size, qint64 *mtime) {
+    QString member;
+    QSharedPointer<DatasetSource> source = mounted_member(path, &member);
+    if (source && !QFile::exists(path) && source->stat(member, size, mtime)) {
+        return;
+    }
+    QFileInfo info(path);
+    *size = info.size();
+    *mtime = info.lastModified().toMSecsSinceEpoch();
+}
+
+bool DatasetSource::is_local(const QString &path) {
+    QString member;
+    QSharedPointer<DatasetSource> source = mounted_member(path, &member);
+    return !source || QFile::exists(path) || source->is_cached(member);
+}
+
+SourceImageReader::SourceImageReader(const QString &path) {
+    QByteArray data;
+    if (DatasetSource::read_mounted(path, &data)) {
+        m_buffer.setData(data);
+        m_buffer.open(QIODevice::ReadOnly);
+        setDevice(&m_buffer);
+    } else {
+        setFileName(path);
+    }
+}
+
+SourceImageReader::~SourceImageReader() {
+    setDevice(nullptr);
+}
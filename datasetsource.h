@@ -0,0 +1,63 @@
+#ifndef DATASETSOURCE_H
+#define DATASETSOURCE_H
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QImageReader>
+#include <QSharedPointer>
+#include <QStringList>
+
+// 数据集来源
+// 图片不在本地文件夹中的数据集（压缩包、对象存储）挂载到一个本地文件夹，
+// 文件夹中保存标注、索引与缩略图缓存；该文件夹下磁盘上不存在的图片从数据来源读取，
+// 因此 image_folder / image_files、列表、导航与缩略图与普通文件夹相同。
+// read 可在多个线程中同时调用。
+class DatasetSource {
+public:
+    virtual ~DatasetSource() {}
+
+    // 成员路径（相对路径，使用 '/' 分隔）
+    virtual QStringList files() const = 0;
+    virtual bool contains(const QString &member) const = 0;
+    // limit >= 0 时只读取开头 limit 字节，用于读取文件头
+    virtual QByteArray read(const QString &member, qint64 limit = -1) const = 0;
+    // 成员的大小与修改时间（毫秒），用作索引与缓存的校验值
+    virtual bool stat(const QString &member, qint64 *size, qint64 *mtime) const = 0;
+    // 读取该成员不需要等待网络
+    virtual bool is_cached(const QString &member) const { Q_UNUSED(member) return true; }
+    // 预读即将显示的成员，按访问顺序排列
+    virtual void prefetch(const QStringList &members) { Q_UNUSED(members) }
+
+    // 准备挂载文件夹：创建成员所在的子文件夹，并取出 folder 中还没有的标注等小文件。
+    // 可能较慢（对象存储需要下载），在后台线程中调用
+    void prepare_folder(const QString &folder);
+
+    // 挂载到 folder，同一时间只挂载一个来源。
+    // 读取时持有来源的引用而不持有挂载锁，取消挂载后正在进行的读取仍可完成
+    static void mount(const QString &folder, const QSharedPointer<DatasetSource> &source);
+    static void unmount();
+    // folder 为挂载文件夹时返回来源中的图片成员，否则返回空列表
+    static QStringList mounted_images(const QString &folder);
+    // path 位于挂载文件夹下、磁盘上不存在且是来源的成员时读取该成员
+    static bool read_mounted(const QString &path, QByteArray *data, qint64 limit = -1);
+    // 文件大小与修改时间：挂载的成员取自来源，其他文件取自磁盘
+    static void file_stamp(const QString &path, qint64 *size, qint64 *mtime);
+    // path 不是挂载的成员，或成员已在本地缓存中
+    static bool is_local(const QString &path);
+
+protected:
+    // 挂载时调用，把标注、classes.txt 等非图片小文件保存到 folder（已存在的不覆盖）
+    virtual void extract_missing(const QString &folder) { Q_UNUSED(folder) }
+};
+
+// 图片读取器：挂载的数据来源中的图片先读到内存再解码，其他路径与 QImageReader 相同
+class SourceImageReader : public QImageReader {
+public:
+    explicit SourceImageReader(const QString &path);
+    ~SourceImageReader();
+
+private:
+    QBuffer m_buffer;
+};
+
+#endif // DATASETSOURCE_H
@@ -0,0 +1,309 @@
+#include "displayadjuster.h"
+#include <QSysInfo>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISPLAYADJUSTER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+// CLAHE 分块数（每个方向）与直方图限幅倍数
+const int kTiles = 8;
+const double kClipLimit = 3.0;
+// 统计 CLAHE 直方图时最多采样的像素数，大图隔点采样
+const int kStatisticsPixels = 4 * 1024 * 1024;
+
+// 32 位图片中透明通道的字节位置
+int alpha_byte(QImage::Format format) {
+    if (format == QImage::Format_RGBX8888 || format == QImage::Format_RGBA8888 ||
+        format == QImage::Format_RGBA8888_Premultiplied) {
+        return 3;
+    }
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian ? 3 : 0;
+}
+
+void lut_row_scalar(uchar *data, int count, const uchar *lut, int alpha) {
+    if (alpha < 0) {
+        for (int i = 0; i < count; ++i) {
+            data[i] = lut[data[i]];
+        }
+        return;
+    }
+    for (int i = 0; i < count; i += 4) {
+        for (int c = 0; c < 4; ++c) {
+            if (c != alpha) {
+                data[i + c] = lut[data[i + c]];
+            }
+        }
+    }
+}
+
+#ifdef DISPLAYADJUSTER_X86
+// 256 项查找表拆成 16 张 16 项小表：低 4 位用 pshufb 在每张小表中查找，高 4 位选择小表。
+// x86 为小端，32 位像素的透明通道固定在第 3 个字节，最后按掩码还原
+__attribute__((target("avx2")))
+int lut_row_avx2(uchar *data, int count, const uchar *lut, bool keep_alpha) {
+    __m256i tables[16];
+    for (int k = 0; k < 16; ++k) {
+        tables[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + 16 * k)));
+    }
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    const __m256i alpha_mask = keep_alpha ? _mm256_set1_epi32(static_cast<int>(0xFF000000)) : _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i low = _mm256_and_si256(values, low_mask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(values, 4), low_mask);
+        __m256i result = _mm256_setzero_si256();
+        for (int k = 0; k < 16; ++k) {
+            __m256i hit = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(static_cast<char>(k)));
+            result = _mm256_or_si256(result, _mm256_and_si256(hit, _mm256_shuffle_epi8(tables[k], low)));
+        }
+        result = _mm256_blendv_epi8(result, values, alpha_mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), result);
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+int lut_row_sse41(uchar *data, int count, const uchar *lut, bool keep_alpha) {
+    __m128i tables[16];
+    for (int k = 0; k < 16; ++k) {
+        tables[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + 16 * k));
+    }
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    const __m128i alpha_mask = keep_alpha ? _mm_set1_epi32(static_cast<int>(0xFF000000)) : _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i low = _mm_and_si128(values, low_mask);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(values, 4), low_mask);
+        __m128i result = _mm_setzero_si128();
+        for (int k = 0; k < 16; ++k) {
+            __m128i hit = _mm_cmpeq_epi8(high, _mm_set1_epi8(static_cast<char>(k)));
+            result = _mm_or_si128(result, _mm_and_si128(hit, _mm_shuffle_epi8(tables[k], low)));
+        }
+        result = _mm_blendv_epi8(result, values, alpha_mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), result);
+    }
+    return i;
+}
+#endif
+
+void lut_row(uchar *data, int count, const uchar *lut, int alpha) {
+    int done = 0;
+#ifdef DISPLAYADJUSTER_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    static const bool sse41 = __builtin_cpu_supports("sse4.1");
+    if (alpha < 0 || alpha == 3) {
+        if (avx2) {
+            done = lut_row_avx2(data, count, lut, alpha == 3);
+        } else if (sse41) {
+            done = lut_row_sse41(data, count, lut, alpha == 3);
+        }
+    }
+#endif
+    lut_row_scalar(data + done, count - done, lut, alpha);
+}
+
+// 输出坐标在分块中心之间的插值位置：相邻两块与第二块的权重（0-256）
+struct TileWeight {
+    int first;
+    int second;
+    int weight;
+};
+
+QVector<TileWeight> tile_weights(int origin, int count, int step, int tile_size) {
+    QVector<TileWeight> weights(count);
+    for (int i = 0; i < count; ++i) {
+        const double position = (origin + i * step + 0.5) / tile_size - 0.5;
+        int first = static_cast<int>(std::floor(position));
+        double fraction = position - first;
+        if (first < 0) {
+            first = 0;
+            fraction = 0.0;
+        } else if (first >= kTiles - 1) {
+            first = kTiles - 1;
+            fraction = 0.0;
+        }
+        weights[i] = {first, qMin(first + 1, kTiles - 1), static_cast<int>(fraction * 256.0 + 0.5)};
+    }
+    return weights;
+}
+}
+
+DisplayAdjuster::DisplayAdjuster()
+    : m_brightness(0), m_contrast(0), m_gamma(1.0), m_clahe(false) {
+    update_lut();
+}
+
+void DisplayAdjuster::set_levels(int brightness, int contrast, double gamma) {
+    m_brightness = qBound(-100, brightness, 100);
+    m_contrast = qBound(-100, contrast, 100);
+    m_gamma = qBound(0.1, gamma, 5.0);
+    update_lut();
+}
+
+void DisplayAdjuster::set_clahe(bool enabled) {
+    m_clahe = enabled;
+}
+
+int DisplayAdjuster::brightness() const {
+    return m_brightness;
+}
+
+int DisplayAdjuster::contrast() const {
+    return m_contrast;
+}
+
+double DisplayAdjuster::gamma() const {
+    return m_gamma;
+}
+
+bool DisplayAdjuster::clahe() const {
+    return m_clahe;
+}
+
+bool DisplayAdjuster::is_identity() const {
+    return !m_clahe && m_brightness == 0 && m_contrast == 0 && qFuzzyCompare(m_gamma, 1.0);
+}
+
+void DisplayAdjuster::update_lut() {
+    // 先按对比度绕中间灰度拉伸、加亮度，再做 gamma
+    const double factor = m_contrast >= 0 ? 1.0 + m_contrast / 25.0 : 1.0 + m_contrast / 100.0;
+    const double offset = m_brightness / 200.0;
+    for (int v = 0; v < 256; ++v) {
+        double x = (v / 255.0 - 0.5) * factor + 0.5 + offset;
+        x = std::pow(qBound(0.0, x, 1.0), 1.0 / m_gamma);
+        m_lut[v] = static_cast<uchar>(x * 255.0 + 0.5);
+    }
+}
+
+void DisplayAdjuster::set_statistics(const QImage &image) {
+    clear_statistics();
+    if (image.isNull()) {
+        return;
+    }
+
+    const QImage gray = image.format() == QImage::Format_Grayscale8 ? image
+                                                                    : image.convertToFormat(QImage::Format_Grayscale8);
+    const int width = gray.width();
+    const int height = gray.height();
+    const int tile_width = (width + kTiles - 1) / kTiles;
+    const int tile_height = (height + kTiles - 1) / kTiles;
+    const int sample = qMax(1, static_cast<int>(std::sqrt(static_cast<double>(width) * height / kStatisticsPixels)));
+
+    QVector<int> column_tile(width);
+    for (int x = 0; x < width; ++x) {
+        column_tile[x] = x / tile_width;
+    }
+    QVector<quint32> histograms(kTiles * kTiles * 256, 0);
+    for (int y = 0; y < height; y += sample) {
+        const uchar *line = gray.constScanLine(y);
+        quint32 *row = histograms.data() + (y / tile_height) * kTiles * 256;
+        for (int x = 0; x < width; x += sample) {
+            row[column_tile.at(x) * 256 + line[x]]++;
+        }
+    }
+
+    // 每块：直方图限幅，超出部分平均分给所有灰度，再按累积分布生成查找表
+    m_tileLuts.resize(kTiles * kTiles * 256);
+    for (int tile = 0; tile < kTiles * kTiles; ++tile) {
+        quint32 *histogram = histograms.data() + tile * 256;
+        uchar *lut = m_tileLuts.data() + tile * 256;
+        quint64 total = 0;
+        for (int v = 0; v < 256; ++v) {
+            total += histogram[v];
+        }
+        if (total == 0) {
+            for (int v = 0; v < 256; ++v) {
+                lut[v] = static_cast<uchar>(v);
+            }
+            continue;
+        }
+
+        const quint32 clip = qMax<quint32>(1, static_cast<quint32>(kClipLimit * total / 256));
+        quint64 excess = 0;
+        for (int v = 0; v < 256; ++v) {
+            if (histogram[v] > clip) {
+                excess += histogram[v] - clip;
+                histogram[v] = clip;
+            }
+        }
+        const quint32 bonus = static_cast<quint32>(excess / 256);
+        const int remainder = static_cast<int>(excess % 256);
+        quint64 sum = 0;
+        for (int v = 0; v < 256; ++v) {
+            sum += histogram[v] + bonus + (v < remainder ? 1 : 0);
+            lut[v] = static_cast<uchar>((sum * 255 + total / 2) / total);
+        }
+    }
+    m_imageSize = image.size();
+}
+
+void DisplayAdjuster::clear_statistics() {
+    m_imageSize = QSize();
+    m_tileLuts.clear();
+}
+
+bool DisplayAdjuster::has_statistics() const {
+    return !m_tileLuts.isEmpty();
+}
+
+void DisplayAdjuster::apply(QImage &image, const QPoint &origin, int step) const {
+    if (image.isNull() || is_identity()) {
+        return;
+    }
+    if (image.format() != QImage::Format_Grayscale8 && image.depth() != 32) {
+        image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+
+    if (m_clahe && has_statistics()) {
+        apply_clahe(image, origin, qMax(1, step));
+    }
+    if (m_brightness != 0 || m_contrast != 0 || !qFuzzyCompare(m_gamma, 1.0)) {
+        const bool gray = image.format() == QImage::Format_Grayscale8;
+        const int alpha = gray ? -1 : alpha_byte(image.format());
+        const int count = image.width() * (gray ? 1 : 4);
+        for (int y = 0; y < image.height(); ++y) {
+            lut_row(image.scanLine(y), count, m_lut, alpha);
+        }
+    }
+}
+
+void DisplayAdjuster::apply_clahe(QImage &image, const QPoint &origin, int step) const {
+    const int tile_width = (m_imageSize.width() + kTiles - 1) / kTiles;
+    const int tile_height = (m_imageSize.height() + kTiles - 1) / kTiles;
+    const QVector<TileWeight> columns = tile_weights(origin.x(), image.width(), step, tile_width);
+    const QVector<TileWeight> rows = tile_weights(origin.y(), image.height(), step, tile_height);
+
+    // 彩色图片各颜色通道使用同一组亮度查找表，色调基本不变
+    const bool gray = image.format() == QImage::Format_Grayscale8;
+    const int channels = gray ? 1 : 4;
+    const int alpha = gray ? -1 : alpha_byte(image.format());
+    const uchar *luts = m_tileLuts.constData();
+    for (int y = 0; y < image.height(); ++y) {
+        const TileWeight &row = rows.at(y);
+        const uchar *top = luts + row.first * kTiles * 256;
+        const uchar *bottom = luts + row.second * kTiles * 256;
+        uchar *line = image.scanLine(y);
+        for (int x = 0; x < image.width(); ++x) {
+            const TileWeight &column = columns.at(x);
+            const uchar *top_left = top + column.first * 256;
+            const uchar *top_right = top + column.second * 256;
+            const uchar *bottom_left = bottom + column.first * 256;
+            const uchar *bottom_right = bottom + column.second * 256;
+            uchar *pixel = line + x * channels;
+            for (int c = 0; c < channels; ++c) {
+                if (c == alpha) {
+                    continue;
+                }
+                const int v = pixel[c];
+                const int upper = top_left[v] * (256 - column.weight) + top_right[v] * column.weight;
+                const int lower = bottom_left[v] * (256 - column.weight) + bottom_right[v] * column.weight;
+                pixel[c] = static_cast<uchar>((upper * (256 - row.weight) + lower * row.weight + (1 << 15)) >> 16);
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef DISPLAYADJUSTER_H
+#define DISPLAYADJUSTER_H
+
+#include <QImage>
+#include <QPoint>
+#include <QVector>
+
+// 显示调整类（只用于显示，不修改图片文件）
+// 亮度、对比度、gamma 合成一张 256 项查找表，只在参数改变时重新计算；
+// CLAHE 把图片分成 8x8 块，每块按限幅后的亮度直方图生成查找表，像素在相邻 4 块之间双线性插值。
+// 查找表应用于 Grayscale8 或 32 位图片，可以只处理图片的一部分（可见区域），
+// x86 上按 CPU 选择 AVX2 / SSE4.1 实现。
+class DisplayAdjuster {
+public:
+    DisplayAdjuster();
+
+    // brightness、contrast 为 -100 到 100，gamma 为 0.1 到 5.0
+    void set_levels(int brightness, int contrast, double gamma);
+    void set_clahe(bool enabled);
+    int brightness() const;
+    int contrast() const;
+    double gamma() const;
+    bool clahe() const;
+    bool is_identity() const;
+
+    // 由整张 8 位图片统计 CLAHE 分块查找表
+    void set_statistics(const QImage &image);
+    void clear_statistics();
+    bool has_statistics() const;
+
+    // 原地调整 Grayscale8 或 32 位图片（透明通道不变）；
+    // origin、step 为该图片在原图中的位置与采样步长，用于定位 CLAHE 分块
+    void apply(QImage &image, const QPoint &origin = QPoint(), int step = 1) const;
+
+private:
+    void update_lut();
+    void apply_clahe(QImage &image, const QPoint &origin, int step) const;
+
+    int m_brightness;
+    int m_contrast;
+    double m_gamma;
+    bool m_clahe;
+    uchar m_lut[256];
+
+    QSize m_imageSize;
+    QVector<uchar> m_tileLuts;   // kTiles * kTiles 张查找表
+};
+
+#endif // DISPLAYADJUSTER_H
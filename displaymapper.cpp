@@ -0,0 +1,213 @@
+#include "displaymapper.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISPLAYMAPPER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+const int kLevels = 65536;
+
+inline uchar map_value(quint16 value, float low, float scale) {
+    return static_cast<uchar>(qBound(0.0f, (value - low) * scale + 0.5f, 255.0f));
+}
+
+void map_row_scalar(const quint16 *src, uchar *dst, int count, float low, float scale) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = map_value(src[i], low, scale);
+    }
+}
+
+#ifdef DISPLAYMAPPER_X86
+// 每次 8 个值：扩展为 32 位浮点、线性映射、四舍五入后饱和打包为 8 位
+__attribute__((target("avx2")))
+int map_row_avx2(const quint16 *src, uchar *dst, int count, float low, float scale) {
+    const __m256 low_v = _mm256_set1_ps(low);
+    const __m256 scale_v = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m256 mapped = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(values)), low_v),
+                                      scale_v);
+        __m256i rounded = _mm256_cvtps_epi32(mapped);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+int map_row_sse41(const quint16 *src, uchar *dst, int count, float low, float scale) {
+    const __m128 low_v = _mm_set1_ps(low);
+    const __m128 scale_v = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(values));
+        __m128 hi = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(values, 8)));
+        __m128i lo_i = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(lo, low_v), scale_v));
+        __m128i hi_i = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(hi, low_v), scale_v));
+        __m128i words = _mm_packs_epi32(lo_i, hi_i);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+#endif
+
+void map_row(const quint16 *src, uchar *dst, int count, float low, float scale) {
+    int done = 0;
+#ifdef DISPLAYMAPPER_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    static const bool sse41 = __builtin_cpu_supports("sse4.1");
+    if (avx2) {
+        done = map_row_avx2(src, dst, count, low, scale);
+    } else if (sse41) {
+        done = map_row_sse41(src, dst, count, low, scale);
+    }
+#endif
+    map_row_scalar(src + done, dst + done, count - done, low, scale);
+}
+}
+
+DisplayMapper::DisplayMapper()
+    : m_gray(true), m_histogramTotal(0), m_low(0), m_high(kLevels - 1) {
+}
+
+bool DisplayMapper::is_high_bit_depth(QImage::Format format) {
+    return format == QImage::Format_Grayscale16 || format == QImage::Format_RGBX64 ||
+           format == QImage::Format_RGBA64 || format == QImage::Format_RGBA64_Premultiplied;
+}
+
+bool DisplayMapper::set_image(const QImage &image) {
+    clear();
+    if (image.isNull() || !is_high_bit_depth(image.format())) {
+        return false;
+    }
+
+    m_gray = image.format() == QImage::Format_Grayscale16;
+    m_image = m_gray ? image : image.convertToFormat(QImage::Format_RGBA64);
+
+    // 四个子直方图交替累加，避免相邻相同值的读写依赖，最后合并
+    const int channels = m_gray ? 1 : 4;
+    const int values = m_gray ? 1 : 3;  // 彩色图片统计 R、G、B，不统计透明通道
+    QVector<quint32> partial(4 * kLevels, 0);
+    quint32 *h = partial.data();
+    for (int y = 0; y < m_image.height(); ++y) {
+        const quint16 *line = reinterpret_cast<const quint16 *>(m_image.constScanLine(y));
+        const int count = m_image.width() * channels;
+        int i = 0;
+        if (m_gray) {
+            for (; i + 4 <= count; i += 4) {
+                h[line[i]]++;
+                h[kLevels + line[i + 1]]++;
+                h[2 * kLevels + line[i + 2]]++;
+                h[3 * kLevels + line[i + 3]]++;
+            }
+        }
+        for (; i < count; i += channels) {
+            for (int c = 0; c < values; ++c) {
+                h[c * kLevels + line[i + c]]++;
+            }
+        }
+    }
+    m_histogram = QVector<quint32>(kLevels, 0);
+    for (int v = 0; v < kLevels; ++v) {
+        m_histogram[v] = h[v] + h[kLevels + v] + h[2 * kLevels + v] + h[3 * kLevels + v];
+    }
+    m_histogramTotal = static_cast<quint64>(m_image.width()) * m_image.height() * values;
+
+    set_percentile_window(0.5, 99.5);
+    return true;
+}
+
+void DisplayMapper::clear() {
+    m_image = QImage();
+    m_histogram.clear();
+    m_histogramTotal = 0;
+    m_low = 0;
+    m_high = kLevels - 1;
+}
+
+bool DisplayMapper::is_null() const {
+    return m_image.isNull();
+}
+
+QSize DisplayMapper::size() const {
+    return m_image.size();
+}
+
+void DisplayMapper::set_window(int low, int high) {
+    m_low = qBound(0, low, kLevels - 2);
+    m_high = qBound(m_low + 1, high, kLevels - 1);
+}
+
+int DisplayMapper::window_low() const {
+    return m_low;
+}
+
+int DisplayMapper::window_high() const {
+    return m_high;
+}
+
+void DisplayMapper::set_percentile_window(double low_percent, double high_percent) {
+    if (m_histogramTotal == 0) {
+        return;
+    }
+
+    const quint64 low_count = static_cast<quint64>(m_histogramTotal * qBound(0.0, low_percent, 100.0) / 100.0);
+    const quint64 high_count = static_cast<quint64>(m_histogramTotal * qBound(0.0, high_percent, 100.0) / 100.0);
+    int low = 0;
+    int high = kLevels - 1;
+    quint64 sum = 0;
+    bool low_found = false;
+    for (int v = 0; v < kLevels; ++v) {
+        sum += m_histogram.at(v);
+        if (!low_found && sum > low_count) {
+            low = v;
+            low_found = true;
+        }
+        if (sum >= high_count) {
+            high = v;
+            break;
+        }
+    }
+    set_window(low, high);
+}
+
+QImage DisplayMapper::render(const QRect &rect, int step) const {
+    const QRect area = rect & QRect(QPoint(0, 0), m_image.size());
+    if (area.isEmpty()) {
+        return QImage();
+    }
+
+    step = qMax(1, step);
+    const int width = (area.width() + step - 1) / step;
+    const int height = (area.height() + step - 1) / step;
+    const int channels = m_gray ? 1 : 4;
+    const float low = static_cast<float>(m_low);
+    const float scale = 255.0f / (m_high - m_low);
+
+    QImage result(width, height, m_gray ? QImage::Format_Grayscale8 : QImage::Format_RGBX8888);
+    for (int y = 0; y < height; ++y) {
+        const quint16 *src = reinterpret_cast<const quint16 *>(m_image.constScanLine(area.y() + y * step)) +
+                             area.x() * channels;
+        uchar *dst = result.scanLine(y);
+        if (step == 1) {
+            // 连续像素：各通道（RGBA64 内存顺序为 R、G、B、A）逐个映射
+            map_row(src, dst, width * channels, low, scale);
+        } else {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    dst[x * channels + c] = map_value(src[x * step * channels + c], low, scale);
+                }
+            }
+        }
+        if (!m_gray) {
+            for (int x = 0; x < width; ++x) {
+                dst[x * 4 + 3] = 255;
+            }
+        }
+    }
+    return result;
+}
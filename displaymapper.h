@@ -0,0 +1,43 @@
+#ifndef DISPLAYMAPPER_H
+#define DISPLAYMAPPER_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// 高位深图片显示映射类
+// 保存 16 位灰度 / RGB 原始数据，按窗口 [low, high] 线性映射为 8 位用于显示；
+// 加载时统计一次 16 位直方图，用于按百分位自动设置窗口。
+// 映射只对请求的区域计算，可按步长隔点采样（缩小显示时只算屏幕上的像素数），
+// x86 上按 CPU 选择 AVX2 / SSE4.1 实现。
+class DisplayMapper {
+public:
+    DisplayMapper();
+
+    static bool is_high_bit_depth(QImage::Format format);
+
+    bool set_image(const QImage &image);
+    void clear();
+    bool is_null() const;
+    QSize size() const;
+
+    // 窗口为原始 16 位数值
+    void set_window(int low, int high);
+    int window_low() const;
+    int window_high() const;
+    // 按直方图百分位（0-100）设置窗口
+    void set_percentile_window(double low_percent, double high_percent);
+
+    // 把 rect 区域映射为 8 位图片（灰度为 Grayscale8，彩色为 RGBX8888），每 step 个像素取一个
+    QImage render(const QRect &rect, int step = 1) const;
+
+private:
+    QImage m_image;
+    bool m_gray;
+    QVector<quint32> m_histogram;
+    quint64 m_histogramTotal;
+    int m_low;
+    int m_high;
+};
+
+#endif // DISPLAYMAPPER_H
@@ -0,0 +1,282 @@
+#include "folderscanner.h"
+#include "datasetsource.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+namespace {
+// 单个目录中每找到多少张图片就发送一批结果
+const int kScanBatchSize = 4096;
+
+// 扫描时跳过的子文件夹（删除备份目录）
+const char *const kSkippedDirs[] = {"bak"};
+}
+
+// 后台扫描任务：枚举单个目录，图片分批发送，子目录交回主线程继续调度
+class FolderScanner::ScanTask : public QRunnable {
+public:
+    ScanTask(FolderScanner *scanner, int generation, const QString &root,
+             const QString &relative_dir, bool recursive)
+        : m_scanner(scanner), m_generation(generation), m_root(root),
+          m_relativeDir(relative_dir), m_recursive(recursive) {
+    }
+
+    void run() override {
+        QString prefix = m_relativeDir.isEmpty() ? QString() : m_relativeDir + "/";
+        QString dir_path = m_relativeDir.isEmpty() ? m_root : m_root + "/" + m_relativeDir;
+
+        QDir::Filters filters = QDir::Files | QDir::NoDotAndDotDot;
+        if (m_recursive) {
+            filters |= QDir::Dirs;
+        }
+
+        QStringList files;
+        QList<QByteArray> keys;
+        QStringList subdirs;
+        QDirIterator it(dir_path, filters);
+        while (it.hasNext()) {
+            it.next();
+            if (m_scanner->m_generation.load() != m_generation) {
+                return;
+            }
+
+            QString name = it.fileName();
+            // 目录项类型来自 readdir，不需要额外的 stat
+            if (m_recursive && it.fileInfo().isDir()) {
+                if (FolderScanner::is_scanned_dir(it.fileInfo())) {
+                    subdirs.append(prefix + name);
+                }
+                continue;
+            }
+
+            if (FolderScanner::is_image_file(name)) {
+                files.append(prefix + name);
+                keys.append(FolderScanner::natural_sort_key(prefix + name));
+                if (files.size() >= kScanBatchSize) {
+                    post_batch(files, keys);
+                    files.clear();
+                    keys.clear();
+                }
+            }
+        }
+
+        if (!files.isEmpty()) {
+            post_batch(files, keys);
+        }
+
+        FolderScanner *scanner = m_scanner;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(scanner, [scanner, generation, subdirs]() {
+            scanner->on_directory_scanned(generation, subdirs);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    void post_batch(const QStringList &files, const QList<QByteArray> &keys) {
+        FolderScanner *scanner = m_scanner;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(scanner, [scanner, generation, files, keys]() {
+            scanner->on_batch_scanned(generation, files, keys);
+        }, Qt::QueuedConnection);
+    }
+
+    FolderScanner *m_scanner;
+    int m_generation;
+    QString m_root;
+    QString m_relativeDir;
+    bool m_recursive;
+};
+
+// 数据来源列表任务：成员列表已在内存中，只需过滤、计算排序键并分批发送
+class FolderScanner::SourceTask : public QRunnable {
+public:
+    SourceTask(FolderScanner *scanner, int generation, const QStringList &images, bool recursive)
+        : m_scanner(scanner), m_generation(generation), m_images(images), m_recursive(recursive) {
+    }
+
+    void run() override {
+        QStringList files;
+        QList<QByteArray> keys;
+        for (const QString &image: m_images) {
+            if (m_scanner->m_generation.load() != m_generation) {
+                return;
+            }
+            if (!m_recursive && image.contains('/')) {
+                continue;
+            }
+            files.append(image);
+            keys.append(FolderScanner::natural_sort_key(image));
+            if (files.size() >= kScanBatchSize) {
+                post_batch(files, keys);
+                files.clear();
+                keys.clear();
+            }
+        }
+        if (!files.isEmpty()) {
+            post_batch(files, keys);
+        }
+
+        FolderScanner *scanner = m_scanner;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(scanner, [scanner, generation]() {
+            scanner->on_directory_scanned(generation, QStringList());
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    void post_batch(const QStringList &files, const QList<QByteArray> &keys) {
+        FolderScanner *scanner = m_scanner;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(scanner, [scanner, generation, files, keys]() {
+            scanner->on_batch_scanned(generation, files, keys);
+        }, Qt::QueuedConnection);
+    }
+
+    FolderScanner *m_scanner;
+    int m_generation;
+    QStringList m_images;
+    bool m_recursive;
+};
+
+FolderScanner::FolderScanner(QObject *parent)
+    : QObject(parent)
+      , m_recursive(false)
+      , m_jobs(JobScheduler::Indexing)
+      , m_generation(0)
+      , m_pendingDirs(0)
+      , m_total(0) {
+}
+
+FolderScanner::~FolderScanner() {
+    cancel();
+}
+
+void FolderScanner::start(const QString &folder, bool recursive) {
+    cancel();
+
+    m_root = folder;
+    m_recursive = recursive;
+    m_total = 0;
+
+    QStringList mounted = DatasetSource::mounted_images(folder);
+    if (!mounted.isEmpty()) {
+        ++m_pendingDirs;
+        m_jobs.start(new SourceTask(this, m_generation.load(), mounted, recursive));
+        return;
+    }
+    schedule_directory(QString());
+}
+
+void FolderScanner::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_pendingDirs = 0;
+}
+
+bool FolderScanner::is_running() const {
+    return m_pendingDirs > 0;
+}
+
+void FolderScanner::schedule_directory(const QString &relative_dir) {
+    ++m_pendingDirs;
+    m_jobs.start(new ScanTask(this, m_generation.load(), m_root, relative_dir, m_recursive));
+}
+
+void FolderScanner::on_batch_scanned(int generation, const QStringList &files, const QList<QByteArray> &keys) {
+    if (generation != m_generation.load()) {
+        return;
+    }
+
+    m_total += files.size();
+    emit files_found(files, keys);
+}
+
+void FolderScanner::on_directory_scanned(int generation, const QStringList &subdirs) {
+    if (generation != m_generation.load()) {
+        return;
+    }
+
+    for (const QString &subdir: subdirs) {
+        schedule_directory(subdir);
+    }
+
+    if (--m_pendingDirs == 0) {
+        emit finished(m_total);
+    }
+}
+
+bool FolderScanner::is_scanned_dir(const QFileInfo &info) {
+    // 跳过隐藏目录与备份目录；不进入符号链接目录，避免链接成环时无限递归
+    const QString name = info.fileName();
+    if (name.startsWith('.')) {
+        return false;
+    }
+    for (const char *skipped: kSkippedDirs) {
+        if (name == QLatin1String(skipped)) {
+            return false;
+        }
+    }
+    return !info.isSymLink();
+}
+
+bool FolderScanner::is_image_file(const QString &name) {
+    int dot = name.lastIndexOf('.');
+    if (dot < 0) {
+        return false;
+    }
+
+    // Supported image formats
+    static const QStringList image_extensions = {"png", "jpg", "jpeg", "bmp", "tiff"};
+    QStringRef suffix = name.midRef(dot + 1);
+    for (const QString &extension: image_extensions) {
+        if (suffix.compare(extension, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QByteArray FolderScanner::natural_sort_key(const QString &name) {
+    // 文本部分转为小写 UTF-8；数字串编码为 '0' + 有效位数 + 去掉前导零的数字，
+    // 这样按字节比较时数字串按数值大小排序
+    QByteArray key;
+    key.reserve(name.size() + 8);
+
+    QString text;
+    int i = 0;
+    while (i < name.size()) {
+        QChar c = name.at(i);
+        if (c >= QLatin1Char('0') && c <= QLatin1Char('9')) {
+            if (!text.isEmpty()) {
+                key.append(text.toLower().toUtf8());
+                text.clear();
+            }
+
+            int start = i;
+            while (i < name.size() && name.at(i) >= QLatin1Char('0') && name.at(i) <= QLatin1Char('9')) {
+                ++i;
+            }
+
+            int significant = start;
+            while (significant < i - 1 && name.at(significant) == QLatin1Char('0')) {
+                ++significant;
+            }
+
+            int digits = qMin(i - significant, 255);
+            key.append('0');
+            key.append(static_cast<char>(digits));
+            for (int d = significant; d < significant + digits; ++d) {
+                key.append(static_cast<char>(name.at(d).unicode()));
+            }
+        } else {
+            text.append(c);
+            ++i;
+        }
+    }
+
+    if (!text.isEmpty()) {
+        key.append(text.toLower().toUtf8());
+    }
+    return key;
+}
@@ -0,0 +1,56 @@
+#ifndef FOLDERSCANNER_H
+#define FOLDERSCANNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QList>
+#include <QByteArray>
+#include <atomic>
+#include "jobscheduler.h"
+
+class QFileInfo;
+
+// 文件夹扫描类
+// 在线程池中枚举目录（可选递归子文件夹），不排序、不逐个构造 QFileInfo，
+// 找到的图片分批通过 files_found 信号发送，同时附带预先计算好的自然排序键。
+// 文件夹挂载了数据来源（压缩包、对象存储）时改为列出来源中的图片（见 DatasetSource）。
+class FolderScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FolderScanner(QObject *parent = nullptr);
+    ~FolderScanner();
+
+    void start(const QString &folder, bool recursive);
+    void cancel();
+    bool is_running() const;
+
+    // 仅根据扩展名判断是否为支持的图片文件
+    static bool is_image_file(const QString &name);
+    // 递归扫描时是否进入该子文件夹
+    static bool is_scanned_dir(const QFileInfo &info);
+    // 自然排序键：数字按数值比较、字母不区分大小写，可直接按字节比较
+    static QByteArray natural_sort_key(const QString &name);
+
+signals:
+    void files_found(const QStringList &files, const QList<QByteArray> &keys);
+    void finished(int total);
+
+private:
+    class ScanTask;
+    class SourceTask;
+
+    void schedule_directory(const QString &relative_dir);
+    void on_batch_scanned(int generation, const QStringList &files, const QList<QByteArray> &keys);
+    void on_directory_scanned(int generation, const QStringList &subdirs);
+
+    QString m_root;
+    bool m_recursive;
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+    int m_pendingDirs;
+    int m_total;
+};
+
+#endif // FOLDERSCANNER_H
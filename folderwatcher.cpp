@@ -0,0 +1,322 @@
+#include "folderwatcher.h"
+#include "folderscanner.h"
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <algorithm>
+
+namespace {
+// 变化事件的合并间隔(毫秒)
+const int kRescanDelay = 300;
+
+QString parent_dir(const QString &file) {
+    int slash = file.lastIndexOf('/');
+    return slash < 0 ? QString() : file.left(slash);
+}
+
+// 列出一个目录中的图片（已排序）与递归扫描时要进入的子目录
+void list_directory(const QString &root, const QString &dir, bool recursive, QStringList *images,
+                    QStringList *subdirs) {
+    const QString prefix = dir.isEmpty() ? QString() : dir + "/";
+    QDir::Filters filters = QDir::Files | QDir::NoDotAndDotDot;
+    if (recursive) {
+        filters |= QDir::Dirs;
+    }
+    QDirIterator it(dir.isEmpty() ? root : root + "/" + dir, filters);
+    while (it.hasNext()) {
+        it.next();
+        QString name = it.fileName();
+        if (recursive && it.fileInfo().isDir()) {
+            if (FolderScanner::is_scanned_dir(it.fileInfo())) {
+                subdirs->append(prefix + name);
+            }
+        } else if (FolderScanner::is_image_file(name)) {
+            images->append(prefix + name);
+        }
+    }
+    std::sort(images->begin(), images->end());
+}
+}
+
+// 后台重新列出目录，并与上次的列表按顺序归并比较
+class FolderWatcher::RescanTask : public QRunnable {
+public:
+    RescanTask(FolderWatcher *watcher, int generation, const QString &root, bool recursive,
+               const QHash<QString, QStringList> &old_listings, const QHash<QString, QStringList> &known_listings)
+        : m_watcher(watcher), m_generation(generation), m_root(root), m_recursive(recursive),
+          m_oldListings(old_listings), m_knownListings(known_listings) {
+    }
+
+    void run() override {
+        QHash<QString, QStringList> listings;
+        QStringList added;
+        QStringList removed;
+        QStringList removed_dirs;
+
+        for (auto it = m_oldListings.constBegin(); it != m_oldListings.constEnd(); ++it) {
+            const QString &dir = it.key();
+            QStringList current;
+            QStringList subdirs;
+            list_directory(m_root, dir, m_recursive, &current, &subdirs);
+            if (m_recursive && !dir.isEmpty() && !QFileInfo::exists(m_root + "/" + dir)) {
+                // 目录本身已删除，其下的目录一起删除
+                append_nested(dir, &removed_dirs);
+            } else if (m_recursive) {
+                update_subdirs(dir, subdirs, &listings, &added, &removed_dirs);
+            }
+
+            // 两个有序列表归并得到新增与删除的文件
+            const QStringList &old = it.value();
+            int i = 0;
+            int j = 0;
+            while (i < old.size() || j < current.size()) {
+                if (j >= current.size() || (i < old.size() && old.at(i) < current.at(j))) {
+                    removed.append(old.at(i++));
+                } else if (i >= old.size() || current.at(j) < old.at(i)) {
+                    added.append(current.at(j++));
+                } else {
+                    ++i;
+                    ++j;
+                }
+            }
+
+            listings.insert(dir, current);
+        }
+
+        // 已删除的目录中原有的图片全部删除；重新列出过的目录已经在归并时计入
+        removed_dirs.removeDuplicates();
+        for (const QString &dir: removed_dirs) {
+            if (!m_oldListings.contains(dir)) {
+                removed += m_knownListings.value(dir);
+            }
+            listings.remove(dir);
+        }
+
+        FolderWatcher *watcher = m_watcher;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(watcher, [watcher, generation, listings, added, removed, removed_dirs]() {
+            watcher->on_rescan_finished(generation, listings, added, removed, removed_dirs);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    // 比较 dir 的子目录：新出现的目录整个列出，其中的图片都是新增的；消失的目录连同其下的目录一起删除
+    void update_subdirs(const QString &dir, const QStringList &subdirs, QHash<QString, QStringList> *listings,
+                        QStringList *added, QStringList *removed_dirs) {
+        const QSet<QString> current(subdirs.begin(), subdirs.end());
+        const QString prefix = dir.isEmpty() ? QString() : dir + "/";
+        for (auto it = m_knownListings.constBegin(); it != m_knownListings.constEnd(); ++it) {
+            const QString &known = it.key();
+            if (!known.isEmpty() && known.startsWith(prefix) && known.indexOf('/', prefix.size()) < 0 &&
+                !current.contains(known)) {
+                append_nested(known, removed_dirs);
+            }
+        }
+
+        QStringList pending;
+        for (const QString &subdir: subdirs) {
+            if (!m_knownListings.contains(subdir)) {
+                pending.append(subdir);
+            }
+        }
+        while (!pending.isEmpty()) {
+            const QString next = pending.takeLast();
+            QStringList images;
+            QStringList nested;
+            list_directory(m_root, next, true, &images, &nested);
+            listings->insert(next, images);
+            *added += images;
+            for (const QString &child: nested) {
+                if (!m_knownListings.contains(child)) {
+                    pending.append(child);
+                }
+            }
+        }
+    }
+
+    void append_nested(const QString &dir, QStringList *dirs) const {
+        for (auto it = m_knownListings.constBegin(); it != m_knownListings.constEnd(); ++it) {
+            if (it.key() == dir || it.key().startsWith(dir + "/")) {
+                dirs->append(it.key());
+            }
+        }
+    }
+
+    FolderWatcher *m_watcher;
+    int m_generation;
+    QString m_root;
+    bool m_recursive;
+    QHash<QString, QStringList> m_oldListings;
+    QHash<QString, QStringList> m_knownListings;
+};
+
+FolderWatcher::FolderWatcher(QObject *parent)
+    : QObject(parent)
+      , m_watcher(new QFileSystemWatcher(this))
+      , m_timer(new QTimer(this))
+      , m_jobs(JobScheduler::Indexing)
+      , m_generation(0)
+      , m_rescanning(false)
+      , m_recursive(false) {
+    m_jobs.set_max_running(1);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(kRescanDelay);
+    connect(m_timer, &QTimer::timeout, this, &FolderWatcher::rescan_dirty_directories);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::on_directory_changed);
+}
+
+FolderWatcher::~FolderWatcher() {
+    stop();
+}
+
+void FolderWatcher::watch(const QString &folder, const QStringList &files, bool recursive) {
+    stop();
+
+    m_root = folder;
+    m_recursive = recursive;
+    m_listings.insert(QString(), QStringList());
+    for (const QString &file: files) {
+        m_listings[parent_dir(file)].append(file);
+    }
+
+    QStringList paths;
+    for (auto it = m_listings.begin(); it != m_listings.end(); ++it) {
+        std::sort(it.value().begin(), it.value().end());
+        paths.append(it.key().isEmpty() ? m_root : m_root + "/" + it.key());
+    }
+    m_watcher->addPaths(paths);
+
+    // 递归时还要监视还没有图片的子目录，其中出现新图片或新目录时才能发现
+    if (recursive) {
+        const QString root = m_root;
+        const int generation = m_generation;
+        m_jobs.start([this, root, generation]() {
+            QStringList dirs;
+            QStringList pending{QString()};
+            while (!pending.isEmpty()) {
+                const QString dir = pending.takeLast();
+                const QString prefix = dir.isEmpty() ? QString() : dir + "/";
+                QDirIterator it(dir.isEmpty() ? root : root + "/" + dir, QDir::Dirs | QDir::NoDotAndDotDot);
+                while (it.hasNext()) {
+                    it.next();
+                    if (FolderScanner::is_scanned_dir(it.fileInfo())) {
+                        dirs.append(prefix + it.fileName());
+                        pending.append(prefix + it.fileName());
+                    }
+                }
+            }
+            QMetaObject::invokeMethod(this, [this, generation, dirs]() {
+                if (generation != m_generation) {
+                    return;
+                }
+                add_directories(dirs);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void FolderWatcher::add_directories(const QStringList &dirs) {
+    QStringList paths;
+    for (const QString &dir: dirs) {
+        if (!m_listings.contains(dir)) {
+            m_listings.insert(dir, QStringList());
+            paths.append(m_root + "/" + dir);
+        }
+    }
+    if (!paths.isEmpty()) {
+        m_watcher->addPaths(paths);
+    }
+}
+
+void FolderWatcher::stop() {
+    ++m_generation;
+    m_timer->stop();
+    m_jobs.clear();
+    m_jobs.wait();
+    m_rescanning = false;
+
+    QStringList directories = m_watcher->directories();
+    if (!directories.isEmpty()) {
+        m_watcher->removePaths(directories);
+    }
+    m_listings.clear();
+    m_dirtyDirs.clear();
+    m_root.clear();
+    m_recursive = false;
+}
+
+void FolderWatcher::on_directory_changed(const QString &path) {
+    QString dir = QDir(m_root).relativeFilePath(path);
+    if (dir == ".") {
+        dir.clear();
+    }
+    if (!m_listings.contains(dir)) {
+        return;
+    }
+
+    m_dirtyDirs.insert(dir);
+    // 不重新计时，持续的变化也能按固定间隔得到处理
+    if (!m_timer->isActive() && !m_rescanning) {
+        m_timer->start();
+    }
+}
+
+void FolderWatcher::rescan_dirty_directories() {
+    if (m_dirtyDirs.isEmpty() || m_rescanning) {
+        return;
+    }
+
+    QHash<QString, QStringList> old_listings;
+    for (const QString &dir: m_dirtyDirs) {
+        old_listings.insert(dir, m_listings.value(dir));
+    }
+    m_dirtyDirs.clear();
+
+    m_rescanning = true;
+    m_jobs.start(new RescanTask(this, m_generation, m_root, m_recursive, old_listings, m_listings));
+}
+
+void FolderWatcher::on_rescan_finished(int generation, const QHash<QString, QStringList> &listings,
+                                       const QStringList &added, const QStringList &removed,
+                                       const QStringList &removed_dirs) {
+    if (generation != m_generation) {
+        return;
+    }
+
+    m_rescanning = false;
+    // 新出现的子目录开始监视，已删除的目录停止监视
+    QStringList new_paths;
+    for (auto it = listings.constBegin(); it != listings.constEnd(); ++it) {
+        if (!m_listings.contains(it.key())) {
+            new_paths.append(m_root + "/" + it.key());
+        }
+        m_listings.insert(it.key(), it.value());
+    }
+    if (!new_paths.isEmpty()) {
+        m_watcher->addPaths(new_paths);
+    }
+    QStringList old_paths;
+    for (const QString &dir: removed_dirs) {
+        m_listings.remove(dir);
+        m_dirtyDirs.remove(dir);
+        old_paths.append(m_root + "/" + dir);
+    }
+    const QStringList watched = m_watcher->directories();
+    old_paths.erase(std::remove_if(old_paths.begin(), old_paths.end(), [&watched](const QString &path) {
+        return !watched.contains(path);
+    }), old_paths.end());
+    if (!old_paths.isEmpty()) {
+        m_watcher->removePaths(old_paths);
+    }
+
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        emit files_changed(added, removed);
+    }
+
+    // 重新扫描期间又有新的变化
+    if (!m_dirtyDirs.isEmpty()) {
+        m_timer->start();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include "jobscheduler.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+// 文件夹监视类
+// 通过 QFileSystemWatcher（Linux 下基于 inotify）监视已加载的文件夹，
+// 变化事件先合并一段时间，再在后台线程中重新列出发生变化的目录并与上次结果比较，
+// 每个批次只发出一次 files_changed 信号，突发的大量新文件不会引起大量界面更新。
+// 递归模式下新建的子目录在重新列出父目录时加入监视，其中的图片作为新增；删除的子目录移出监视。
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FolderWatcher(QObject *parent = nullptr);
+    ~FolderWatcher();
+
+    // files 为相对于 folder 的图片路径，用作比较的初始状态；
+    // recursive 时同时监视子目录，新建的子目录加入监视，删除的子目录移出
+    void watch(const QString &folder, const QStringList &files, bool recursive);
+    void stop();
+
+signals:
+    void files_changed(const QStringList &added, const QStringList &removed);
+
+private slots:
+    void on_directory_changed(const QString &path);
+    void rescan_dirty_directories();
+
+private:
+    class RescanTask;
+
+    void on_rescan_finished(int generation, const QHash<QString, QStringList> &listings,
+                            const QStringList &added, const QStringList &removed,
+                            const QStringList &removed_dirs);
+    void add_directories(const QStringList &dirs);
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_timer;
+    JobGroup m_jobs;
+    int m_generation;
+    bool m_rescanning;
+    bool m_recursive;
+
+    QString m_root;
+    QHash<QString, QStringList> m_listings; // 相对目录 -> 已排序的图片相对路径
+    QSet<QString> m_dirtyDirs;
+};
+
+#endif // FOLDERWATCHER_H
@@ -0,0 +1,224 @@
+#include "framecache.h"
+#include "datasetsource.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'I', 'F', 'R', 'C'};
+const quint32 kVersion = 1;
+const char kSuffix[] = ".frame";
+// 默认上限 4 GB；超过上限时删除到上限的 90%
+const qint64 kDefaultLimit = qint64(4096) << 20;
+const double kEvictRatio = 0.9;
+}
+
+class FrameCache::WriteTask : public QRunnable {
+public:
+    WriteTask(FrameCache *cache, const QString &entry, qint64 source_size, qint64 source_mtime, const QImage &image)
+        : m_cache(cache), m_entry(entry), m_sourceSize(source_size), m_sourceMtime(source_mtime), m_image(image) {
+    }
+
+    void run() override {
+        Header header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.width = m_image.width();
+        header.height = m_image.height();
+        header.format = m_image.format();
+        header.bytes_per_line = m_image.bytesPerLine();
+        header.source_size = m_sourceSize;
+        header.source_mtime = m_sourceMtime;
+
+        // 覆盖已有的缓存文件时，总大小减去原文件的大小
+        const QFileInfo old_info(m_entry);
+        const qint64 old_size = old_info.exists() ? old_info.size() : 0;
+        QSaveFile file(m_entry);
+        qint64 size = -1;
+        if (file.open(QIODevice::WriteOnly) &&
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)) {
+            const qint64 data_size = static_cast<qint64>(header.bytes_per_line) * header.height;
+            if (file.write(reinterpret_cast<const char *>(m_image.constBits()), data_size) == data_size &&
+                file.commit()) {
+                size = sizeof(header) + data_size;
+            }
+        }
+        if (size < 0) {
+            qWarning() << "无法写入解码缓存:" << m_entry;
+        }
+        m_cache->on_written(m_entry, old_size, size);
+    }
+
+private:
+    FrameCache *m_cache;
+    QString m_entry;
+    qint64 m_sourceSize;
+    qint64 m_sourceMtime;
+    QImage m_image;
+};
+
+FrameCache::FrameCache(QObject *parent)
+    : QObject(parent), m_jobs(JobScheduler::Background), m_limit(kDefaultLimit), m_total(-1) {
+    m_folder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/frames";
+    QDir().mkpath(m_folder);
+    // 写入受磁盘速度限制，一个线程即可
+    m_jobs.set_max_running(1);
+}
+
+FrameCache::~FrameCache() {
+    m_jobs.wait();
+}
+
+void FrameCache::set_limit(qint64 bytes) {
+    QMutexLocker locker(&m_mutex);
+    m_limit = qMax<qint64>(0, bytes);
+    // 统计与淘汰需要遍历缓存目录，在写入线程中进行
+    m_jobs.start([this]() {
+        QMutexLocker locker(&m_mutex);
+        evict();
+    });
+}
+
+qint64 FrameCache::limit() const {
+    QMutexLocker locker(&m_mutex);
+    return m_limit;
+}
+
+QString FrameCache::entry_path(const QString &path) const {
+    QByteArray key = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(),
+                                              QCryptographicHash::Sha1).toHex();
+    return m_folder + "/" + QString::fromLatin1(key) + kSuffix;
+}
+
+QImage FrameCache::load(const QString &path) {
+    // 压缩包与对象存储中的图片使用来源中的大小与修改时间校验
+    qint64 source_size = 0;
+    qint64 source_mtime = 0;
+    DatasetSource::file_stamp(path, &source_size, &source_mtime);
+    const QString entry = entry_path(path);
+    QImage image = find(entry, source_size, source_mtime);
+    if (!image.isNull()) {
+        return image;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    image = SourceImageReader(path).read();
+    // 解码快的图片和带调色板的图片不缓存
+    if (image.isNull() || timer.elapsed() < kMinDecodeMs || image.colorCount() > 0) {
+        return image;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_limit == 0 || m_writing.contains(entry)) {
+            return image;
+        }
+        m_writing.insert(entry);
+    }
+    m_jobs.start(new WriteTask(this, entry, source_size, source_mtime, image));
+    return image;
+}
+
+QImage FrameCache::find(const QString &entry, qint64 source_size, qint64 source_mtime) const {
+    QFile file(entry);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    Header header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        return QImage();
+    }
+    // 原图已修改
+    if (header.source_size != source_size || header.source_mtime != source_mtime) {
+        return QImage();
+    }
+    if (header.width <= 0 || header.height <= 0 || header.format <= QImage::Format_Invalid ||
+        header.format >= QImage::NImageFormats ||
+        file.size() != static_cast<qint64>(sizeof(header)) + static_cast<qint64>(header.bytes_per_line) * header.height) {
+        return QImage();
+    }
+
+    QImage image(header.width, header.height, static_cast<QImage::Format>(header.format));
+    if (image.isNull() || image.bytesPerLine() > header.bytes_per_line) {
+        return QImage();
+    }
+    if (image.bytesPerLine() == header.bytes_per_line) {
+        const qint64 data_size = static_cast<qint64>(header.bytes_per_line) * header.height;
+        if (file.read(reinterpret_cast<char *>(image.bits()), data_size) != data_size) {
+            return QImage();
+        }
+    } else {
+        for (int y = 0; y < header.height; ++y) {
+            if (file.read(reinterpret_cast<char *>(image.scanLine(y)), image.bytesPerLine()) != image.bytesPerLine() ||
+                !file.seek(file.pos() + header.bytes_per_line - image.bytesPerLine())) {
+                return QImage();
+            }
+        }
+    }
+    file.close();
+
+    // 更新修改时间，淘汰时按最久未使用删除
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return image;
+}
+
+void FrameCache::on_written(const QString &entry, qint64 old_size, qint64 size) {
+    QMutexLocker locker(&m_mutex);
+    m_writing.remove(entry);
+    if (size > 0 && m_total >= 0) {
+        m_total += size - old_size;
+    }
+    evict();
+}
+
+void FrameCache::evict() {
+    // 调用时已持有 m_mutex
+    QDir dir(m_folder);
+    const QStringList filters{QString("*") + kSuffix};
+    if (m_total < 0) {
+        m_total = 0;
+        for (const QFileInfo &info: dir.entryInfoList(filters, QDir::Files)) {
+            m_total += info.size();
+        }
+    }
+    if (m_total <= m_limit) {
+        return;
+    }
+
+    const qint64 target = static_cast<qint64>(m_limit * kEvictRatio);
+    for (const QFileInfo &info: dir.entryInfoList(filters, QDir::Files, QDir::Time | QDir::Reversed)) {
+        if (m_total <= target) {
+            break;
+        }
+        if (m_writing.contains(info.absoluteFilePath())) {
+            continue;
+        }
+        if (QFile::remove(info.absoluteFilePath())) {
+            m_total -= info.size();
+        }
+    }
+}
+
+void FrameCache::clear() {
+    m_jobs.wait();
+
+    QMutexLocker locker(&m_mutex);
+    QDir dir(m_folder);
+    for (const QString &name: dir.entryList({QString("*") + kSuffix}, QDir::Files)) {
+        dir.remove(name);
+    }
+    m_total = 0;
+}
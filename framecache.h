@@ -0,0 +1,61 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include "jobscheduler.h"
+
+// 解码结果磁盘缓存
+// 大 PNG、LZW 压缩的 TIFF 等解码很慢的图片，把解码后的像素按原始格式（小文件头 + 扫描行）
+// 保存在用户缓存目录中，再次打开时直接读入，只受磁盘速度限制。
+// 以图片绝对路径为键，图片大小或修改时间改变后缓存失效；写入在后台线程完成，
+// 总大小超过上限时删除最久未使用的缓存（命中时更新缓存文件的修改时间）。
+class FrameCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 解码时间达到该值（毫秒）的图片才写入缓存
+    static const int kMinDecodeMs = 100;
+
+    explicit FrameCache(QObject *parent = nullptr);
+    ~FrameCache();
+
+    void set_limit(qint64 bytes);
+    qint64 limit() const;
+
+    // 先查缓存，没有时解码
+    QImage load(const QString &path);
+    void clear();
+
+private:
+    class WriteTask;
+
+    // 缓存文件头，后接 height 行、每行 bytes_per_line 字节
+    struct Header {
+        char magic[4];
+        quint32 version;
+        qint32 width;
+        qint32 height;
+        qint32 format;
+        qint32 bytes_per_line;
+        qint64 source_size;
+        qint64 source_mtime;
+    };
+
+    QString entry_path(const QString &path) const;
+    QImage find(const QString &entry, qint64 source_size, qint64 source_mtime) const;
+    void on_written(const QString &entry, qint64 old_size, qint64 size);
+    void evict();
+
+    QString m_folder;
+    JobGroup m_jobs;
+    mutable QMutex m_mutex;
+    qint64 m_limit;
+    qint64 m_total;         // 缓存总大小，-1 表示尚未统计
+    QSet<QString> m_writing;
+};
+
+#endif // FRAMECACHE_H
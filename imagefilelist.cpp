@@ -0,0 +1,340 @@
+#include "imagefilelist.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+namespace {
+// 已删除的字节超过该值且超过总量一半时整理存储
+const qint64 kCompactThreshold = 1 << 20;
+
+void split_path(const QString &file, QString *dir, QString *name) {
+    int slash = file.lastIndexOf('/');
+    *dir = slash < 0 ? QString() : file.left(slash);
+    *name = slash < 0 ? file : file.mid(slash + 1);
+}
+}
+
+QString FileNameView::file_name() const {
+    return QString::fromUtf8(m_name);
+}
+
+QString FileNameView::path() const {
+    if (m_dir->isEmpty()) {
+        return QString::fromUtf8(m_name);
+    }
+    return *m_dir + "/" + QString::fromUtf8(m_name);
+}
+
+ImageFileList::ImageFileList()
+    : m_garbage(0), m_bitmaps(StatusBitCount) {
+}
+
+QString ImageFileList::at(int i) const {
+    return view(i).path();
+}
+
+FileNameView ImageFileList::view(int i) const {
+    const Entry &entry = m_entries.at(i);
+    return FileNameView(&m_dirs.at(entry.dir), m_bytes.constData() + entry.offset);
+}
+
+void ImageFileList::set_summary(int i, const ImageSummary &summary) {
+    m_summaries[i] = summary;
+
+    // 已生成的位图原地更新
+    const quint64 mask = quint64(1) << (i & 63);
+    for (int bit = 0; bit < StatusBitCount; ++bit) {
+        QVector<quint64> &bitmap = m_bitmaps[bit];
+        if (bitmap.isEmpty()) {
+            continue;
+        }
+        if (status_bit(summary, bit)) {
+            bitmap[i >> 6] |= mask;
+        } else {
+            bitmap[i >> 6] &= ~mask;
+        }
+    }
+}
+
+int ImageFileList::find_next(int row, int step, int bit, bool value) const {
+    const int count = m_entries.size();
+    if (count == 0 || bit < 0 || bit >= StatusBitCount) {
+        return -1;
+    }
+
+    // 查找 0 时对每个字取反，统一成查找 1；一次跳过 64 行
+    const QVector<quint64> &bitmap = status_bitmap(bit);
+    const quint64 flip = value ? 0 : ~quint64(0);
+    const int words = bitmap.size();
+
+    if (step > 0) {
+        int start = qMax(row + 1, 0);
+        if (start >= count) {
+            return -1;
+        }
+        int w = start >> 6;
+        quint64 word = (bitmap.at(w) ^ flip) & (~quint64(0) << (start & 63));
+        while (true) {
+            if (word) {
+                int found = (w << 6) + static_cast<int>(qCountTrailingZeroBits(word));
+                return found < count ? found : -1;
+            }
+            if (++w >= words) {
+                return -1;
+            }
+            word = bitmap.at(w) ^ flip;
+        }
+    }
+
+    int start = qMin(row - 1, count - 1);
+    if (start < 0) {
+        return -1;
+    }
+    int w = start >> 6;
+    int shift = 63 - (start & 63);
+    quint64 word = (bitmap.at(w) ^ flip) & (~quint64(0) >> shift);
+    while (true) {
+        if (word) {
+            return (w << 6) + 63 - static_cast<int>(qCountLeadingZeroBits(word));
+        }
+        if (--w < 0) {
+            return -1;
+        }
+        word = bitmap.at(w) ^ flip;
+    }
+}
+
+int ImageFileList::indexOf(const QString &file) const {
+    QString dir;
+    QString name;
+    split_path(file, &dir, &name);
+
+    auto dir_it = m_dirIds.constFind(dir);
+    if (dir_it == m_dirIds.constEnd()) {
+        return -1;
+    }
+
+    // 在连续内存上直接比较 UTF-8 字节
+    QByteArray utf8 = name.toUtf8();
+    const char *bytes = m_bytes.constData();
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &entry = m_entries.at(i);
+        if (entry.dir == dir_it.value() && std::strcmp(bytes + entry.offset, utf8.constData()) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QVector<int> ImageFileList::index_of_all(const QStringList &files) const {
+    QVector<int> rows(files.size(), -1);
+
+    // 目录编号 -> (UTF-8 文件名 -> files 中的位置)
+    QHash<quint32, QHash<QByteArray, int>> wanted;
+    for (int k = 0; k < files.size(); ++k) {
+        QString dir;
+        QString name;
+        split_path(files.at(k), &dir, &name);
+        auto dir_it = m_dirIds.constFind(dir);
+        if (dir_it != m_dirIds.constEnd()) {
+            wanted[dir_it.value()].insert(name.toUtf8(), k);
+        }
+    }
+    if (wanted.isEmpty()) {
+        return rows;
+    }
+
+    const char *bytes = m_bytes.constData();
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &entry = m_entries.at(i);
+        auto dir_it = wanted.constFind(entry.dir);
+        if (dir_it == wanted.constEnd()) {
+            continue;
+        }
+        const char *name = bytes + entry.offset;
+        auto name_it = dir_it->constFind(QByteArray::fromRawData(name, static_cast<int>(std::strlen(name))));
+        if (name_it != dir_it->constEnd()) {
+            rows[name_it.value()] = i;
+        }
+    }
+    return rows;
+}
+
+void ImageFileList::clear() {
+    invalidate_bitmaps();
+    m_bytes.clear();
+    m_entries.clear();
+    m_summaries.clear();
+    m_dirs.clear();
+    m_dirIds.clear();
+    m_garbage = 0;
+}
+
+void ImageFileList::append(const QString &file) {
+    invalidate_bitmaps();
+    m_entries.append(make_entry(file));
+    m_summaries.append(ImageSummary());
+}
+
+void ImageFileList::append(const QStringList &files) {
+    invalidate_bitmaps();
+    m_entries.reserve(m_entries.size() + files.size());
+    for (const QString &file: files) {
+        m_entries.append(make_entry(file));
+    }
+    m_summaries.resize(m_entries.size());
+}
+
+void ImageFileList::insert(int i, const QString &file) {
+    invalidate_bitmaps();
+    m_entries.insert(i, make_entry(file));
+    m_summaries.insert(i, ImageSummary());
+}
+
+void ImageFileList::removeAt(int i) {
+    invalidate_bitmaps();
+    m_garbage += std::strlen(m_bytes.constData() + m_entries.at(i).offset) + 1;
+    m_entries.removeAt(i);
+    m_summaries.removeAt(i);
+    compact();
+}
+
+QString ImageFileList::takeAt(int i) {
+    QString file = at(i);
+    removeAt(i);
+    return file;
+}
+
+void ImageFileList::remove_rows(const QVector<int> &rows) {
+    if (rows.isEmpty()) {
+        return;
+    }
+    invalidate_bitmaps();
+
+    // 一次遍历完成删除
+    int next = 0;
+    int write = 0;
+    for (int read = 0; read < m_entries.size(); ++read) {
+        if (next < rows.size() && rows.at(next) == read) {
+            m_garbage += std::strlen(m_bytes.constData() + m_entries.at(read).offset) + 1;
+            ++next;
+            continue;
+        }
+        m_summaries[write] = m_summaries.at(read);
+        m_entries[write++] = m_entries.at(read);
+    }
+    m_entries.resize(write);
+    m_summaries.resize(write);
+    compact();
+}
+
+void ImageFileList::reorder(const QVector<int> &order) {
+    invalidate_bitmaps();
+    QVector<Entry> entries;
+    QVector<ImageSummary> summaries;
+    entries.reserve(order.size());
+    summaries.reserve(order.size());
+    for (int i: order) {
+        entries.append(m_entries.at(i));
+        summaries.append(m_summaries.at(i));
+    }
+    m_entries = entries;
+    m_summaries = summaries;
+}
+
+QStringList ImageFileList::to_string_list() const {
+    QStringList files;
+    files.reserve(m_entries.size());
+    for (int i = 0; i < m_entries.size(); ++i) {
+        files.append(at(i));
+    }
+    return files;
+}
+
+qint64 ImageFileList::memory_usage() const {
+    qint64 usage = m_bytes.capacity() + static_cast<qint64>(m_entries.capacity()) * sizeof(Entry) +
+                   static_cast<qint64>(m_summaries.capacity()) * sizeof(ImageSummary);
+    for (const QString &dir: m_dirs) {
+        usage += dir.capacity() * sizeof(QChar);
+    }
+    for (const QVector<quint64> &bitmap: m_bitmaps) {
+        usage += static_cast<qint64>(bitmap.capacity()) * sizeof(quint64);
+    }
+    return usage;
+}
+
+ImageFileList::Entry ImageFileList::make_entry(const QString &file) {
+    QString dir;
+    QString name;
+    split_path(file, &dir, &name);
+
+    Entry entry;
+    entry.offset = static_cast<quint32>(m_bytes.size());
+    entry.dir = dir_id(dir);
+    m_bytes.append(name.toUtf8());
+    m_bytes.append('\0');
+    return entry;
+}
+
+quint32 ImageFileList::dir_id(const QString &dir) {
+    auto it = m_dirIds.constFind(dir);
+    if (it != m_dirIds.constEnd()) {
+        return it.value();
+    }
+
+    quint32 id = static_cast<quint32>(m_dirs.size());
+    m_dirs.append(dir);
+    m_dirIds.insert(dir, id);
+    return id;
+}
+
+void ImageFileList::compact() {
+    if (m_garbage < kCompactThreshold || m_garbage * 2 < m_bytes.size()) {
+        return;
+    }
+
+    // 只保留仍被引用的文件名
+    QByteArray bytes;
+    bytes.reserve(static_cast<int>(m_bytes.size() - m_garbage));
+    for (Entry &entry: m_entries) {
+        const char *name = m_bytes.constData() + entry.offset;
+        int length = static_cast<int>(std::strlen(name)) + 1;
+        entry.offset = static_cast<quint32>(bytes.size());
+        bytes.append(name, length);
+    }
+    m_bytes = bytes;
+    m_garbage = 0;
+}
+
+bool ImageFileList::status_bit(const ImageSummary &summary, int bit) {
+    switch (bit) {
+        case StatusIndexed:
+            return summary.flags & ImageSummary::Indexed;
+        case StatusLabelled:
+            return summary.flags & ImageSummary::Labelled;
+        case StatusFlagged:
+            return summary.flags & ImageSummary::Flagged;
+        case StatusIssues:
+            return summary.flags & ImageSummary::HasIssues;
+        default:
+            return summary.class_mask & (quint64(1) << (bit - StatusClassBase));
+    }
+}
+
+const QVector<quint64> &ImageFileList::status_bitmap(int bit) const {
+    QVector<quint64> &bitmap = m_bitmaps[bit];
+    if (bitmap.isEmpty() && !m_summaries.isEmpty()) {
+        bitmap.fill(0, (m_summaries.size() + 63) / 64);
+        for (int i = 0; i < m_summaries.size(); ++i) {
+            if (status_bit(m_summaries.at(i), bit)) {
+                bitmap[i >> 6] |= quint64(1) << (i & 63);
+            }
+        }
+    }
+    return bitmap;
+}
+
+void ImageFileList::invalidate_bitmaps() {
+    for (QVector<quint64> &bitmap: m_bitmaps) {
+        bitmap.clear();
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef IMAGEFILELIST_H
+#define IMAGEFILELIST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 每张图片的标注摘要，来自数据集索引，按行与文件列表对齐，用于快速筛选
+struct ImageSummary {
+    enum Flag {
+        Indexed = 0x1,   // 已有索引记录
+        Labelled = 0x2,  // 至少有一个标注
+        Flagged = 0x4,   // 用户标记
+        HasIssues = 0x8  // 标注文件存在问题
+    };
+
+    quint32 flags = 0;
+    quint32 annotation_count = 0;
+    quint64 class_mask = 0; // 第 i 位表示包含类别 i，类别ID >= 63 统一记在第 63 位
+};
+
+// 文件名视图：直接指向 ImageFileList 内部存储，不复制字符串
+class FileNameView {
+public:
+    FileNameView(const QString *dir, const char *name) : m_dir(dir), m_name(name) {}
+
+    const QString &dir() const { return *m_dir; } // 相对目录，根目录为空
+    const char *name() const { return m_name; }   // UTF-8 文件名，以 '\0' 结尾
+    QString file_name() const;
+    QString path() const;                          // 相对于图片文件夹的路径
+
+private:
+    const QString *m_dir;
+    const char *m_name;
+};
+
+// 图片文件列表
+// 文件名以 UTF-8 连续存放在一块内存中，每项只保存偏移量与目录编号，
+// 相同的目录前缀只保存一次。排序、删除只移动 8 字节的表项，不移动字符串。
+// 摘要中的每个状态位另外按需生成一份位图，用于快速查找下一个满足条件的行。
+class ImageFileList {
+public:
+    // 状态位图编号：前几个对应摘要标志，之后每个类别一个
+    enum StatusBit {
+        StatusIndexed = 0,
+        StatusLabelled,
+        StatusFlagged,
+        StatusIssues,
+        StatusClassBase, // StatusClassBase + 类别ID，类别ID >= 63 共用最后一个
+        StatusBitCount = StatusClassBase + 64
+    };
+
+    ImageFileList();
+
+    int size() const { return m_entries.size(); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+    QString at(int i) const;
+    FileNameView view(int i) const;
+
+    const ImageSummary &summary(int i) const { return m_summaries.at(i); }
+    void set_summary(int i, const ImageSummary &summary);
+    // 从 row 开始按 step 方向查找下一个状态位等于 value 的行，没有则返回 -1
+    int find_next(int row, int step, int bit, bool value) const;
+
+    int indexOf(const QString &file) const;
+    // 一次遍历查找多个文件，返回与 files 一一对应的行号，不存在为 -1
+    QVector<int> index_of_all(const QStringList &files) const;
+
+    void clear();
+    void append(const QString &file);
+    void append(const QStringList &files);
+    void insert(int i, const QString &file);
+    void removeAt(int i);
+    QString takeAt(int i);
+    // 删除多行，rows 需要按升序排列
+    void remove_rows(const QVector<int> &rows);
+    // 按 order 重新排列，order[i] 为新位置 i 上的旧行号
+    void reorder(const QVector<int> &order);
+
+    QStringList to_string_list() const;
+    qint64 memory_usage() const;
+
+private:
+    struct Entry {
+        quint32 offset; // 文件名在 m_bytes 中的偏移
+        quint32 dir;    // 目录在 m_dirs 中的编号
+    };
+
+    Entry make_entry(const QString &file);
+    quint32 dir_id(const QString &dir);
+    void compact();
+    static bool status_bit(const ImageSummary &summary, int bit);
+    const QVector<quint64> &status_bitmap(int bit) const;
+    void invalidate_bitmaps();
+
+    QByteArray m_bytes;
+    QVector<Entry> m_entries;
+    QVector<ImageSummary> m_summaries; // 与 m_entries 一一对应
+    QStringList m_dirs;
+    QHash<QString, quint32> m_dirIds;
+    qint64 m_garbage; // 已删除文件名占用的字节数
+    // 状态位图，每 64 行一个字，首次查询时生成，行结构变化后失效
+    mutable QVector<QVector<quint64>> m_bitmaps;
+};
+
+#endif // IMAGEFILELIST_H
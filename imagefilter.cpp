@@ -0,0 +1,164 @@
+#include "imagefilter.h"
+#include "imagefilelist.h"
+#include "datasetindex.h"
+#include <QRegularExpression>
+
+namespace {
+inline char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool is_ascii(const char *text) {
+    for (const char *p = text; *p; ++p) {
+        if (static_cast<unsigned char>(*p) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 在以 '\0' 结尾的 ASCII 字符串中查找小写 ASCII 子串，不区分大小写
+bool contains_ascii_ci(const char *haystack, const QByteArray &needle) {
+    const int n = needle.size();
+    if (n == 0) {
+        return true;
+    }
+
+    const char first = needle.at(0);
+    for (const char *p = haystack; *p; ++p) {
+        if (ascii_lower(*p) != first) {
+            continue;
+        }
+        int k = 1;
+        while (k < n && p[k] && ascii_lower(p[k]) == needle.at(k)) {
+            ++k;
+        }
+        if (k == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool compare(int lhs, int op, int rhs) {
+    switch (op) {
+        case 0: return lhs < rhs;
+        case 1: return lhs <= rhs;
+        case 2: return lhs == rhs;
+        case 3: return lhs >= rhs;
+        default: return lhs > rhs;
+    }
+}
+}
+
+ImageFilter ImageFilter::parse(const QString &text, const QStringList &classes) {
+    ImageFilter filter;
+    static const QRegularExpression count_pattern("^(?:boxes|count|标注)(<=|>=|<|>|=)(\\d+)$");
+
+    const QStringList tokens = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    for (QString token: tokens) {
+        Term term;
+        if (token.size() > 1 && token.startsWith('!')) {
+            term.negate = true;
+            token = token.mid(1);
+        }
+
+        QString lower = token.toLower();
+        QRegularExpressionMatch count_match = count_pattern.match(lower);
+        if (lower.startsWith("class:")) {
+            QString name = token.mid(6);
+            term.kind = Term::Class;
+            bool is_number = false;
+            int id = name.toInt(&is_number);
+            if (is_number) {
+                term.class_id = id;
+            } else {
+                for (int i = 0; i < classes.size(); ++i) {
+                    if (classes.at(i).compare(name, Qt::CaseInsensitive) == 0) {
+                        term.class_id = i;
+                        break;
+                    }
+                }
+            }
+        } else if (lower == "labelled" || lower == "labeled" || lower == "已标注") {
+            term.kind = Term::Labelled;
+        } else if (lower == "unlabelled" || lower == "unlabeled" || lower == "未标注") {
+            term.kind = Term::Unlabelled;
+        } else if (lower == "flagged" || lower == "已标记") {
+            term.kind = Term::Flagged;
+        } else if (lower == "issues" || lower == "问题") {
+            term.kind = Term::Issues;
+        } else if (count_match.hasMatch()) {
+            term.kind = Term::Count;
+            QString op = count_match.captured(1);
+            term.op = op == "<" ? Less : op == "<=" ? LessEqual : op == "=" ? Equal : op == ">=" ? GreaterEqual : Greater;
+            term.value = count_match.captured(2).toInt();
+        } else {
+            term.kind = Term::Name;
+            term.pattern = lower;
+            term.text = lower.toUtf8();
+            term.ascii = is_ascii(term.text.constData());
+        }
+        filter.m_terms.append(term);
+    }
+    return filter;
+}
+
+bool ImageFilter::is_empty() const {
+    return m_terms.isEmpty();
+}
+
+QVector<int> ImageFilter::evaluate(const ImageFileList &files, const DatasetIndex *index) const {
+    QVector<int> rows;
+    for (int row = 0; row < files.size(); ++row) {
+        bool accepted = true;
+        for (const Term &term: m_terms) {
+            if (matches(term, files, row, index) == term.negate) {
+                accepted = false;
+                break;
+            }
+        }
+        if (accepted) {
+            rows.append(row);
+        }
+    }
+    return rows;
+}
+
+bool ImageFilter::matches(const Term &term, const ImageFileList &files, int row, const DatasetIndex *index) const {
+    const ImageSummary &summary = files.summary(row);
+    switch (term.kind) {
+        case Term::Name: {
+            // 文件名与搜索词都是 ASCII 时直接按字节比较，否则按 Unicode 规则不区分大小写
+            FileNameView view = files.view(row);
+            const char *name = view.name();
+            if (term.ascii && is_ascii(name) ? contains_ascii_ci(name, term.text)
+                                             : QString::fromUtf8(name).contains(term.pattern, Qt::CaseInsensitive)) {
+                return true;
+            }
+            // 子文件夹名也参与匹配
+            return !view.dir().isEmpty() && view.dir().contains(term.pattern, Qt::CaseInsensitive);
+        }
+        case Term::Class:
+            if (term.class_id < 0) {
+                return false;
+            }
+            if (term.class_id < 63) {
+                return summary.class_mask & (quint64(1) << term.class_id);
+            }
+            // 类别ID较大时摘要中只记录了是否存在，需要查询索引确认
+            return (summary.class_mask & (quint64(1) << 63)) &&
+                   index->record(files.at(row)).class_counts.contains(term.class_id);
+        case Term::Labelled:
+            return summary.flags & ImageSummary::Labelled;
+        case Term::Unlabelled:
+            return !(summary.flags & ImageSummary::Labelled);
+        case Term::Flagged:
+            return summary.flags & ImageSummary::Flagged;
+        case Term::Issues:
+            return summary.flags & ImageSummary::HasIssues;
+        case Term::Count:
+            return compare(static_cast<int>(summary.annotation_count), term.op, term.value);
+    }
+    return false;
+}
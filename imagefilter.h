@@ -0,0 +1,63 @@
+#ifndef IMAGEFILTER_H
+#define IMAGEFILTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+class ImageFileList;
+class DatasetIndex;
+
+// 图片筛选条件
+// 支持的写法（空格分隔，多个条件同时满足，前缀 ! 表示取反）：
+//   class:truck / class:3   包含指定类别
+//   labelled / unlabelled   已标注 / 未标注（也可写作 已标注 / 未标注）
+//   flagged / issues        已标记 / 标注有问题（也可写作 已标记 / 问题）
+//   boxes>50 boxes<=3 ...   按标注数量比较
+//   其他文本                文件名包含该文本（ASCII 不区分大小写）
+// 求值只读取文件列表中的 UTF-8 文件名与按行对齐的标注摘要，不访问磁盘。
+class ImageFilter {
+public:
+    static ImageFilter parse(const QString &text, const QStringList &classes);
+
+    bool is_empty() const;
+    // 返回满足条件的行号（升序）
+    QVector<int> evaluate(const ImageFileList &files, const DatasetIndex *index) const;
+
+private:
+    enum CompareOp {
+        Less,
+        LessEqual,
+        Equal,
+        GreaterEqual,
+        Greater
+    };
+
+    struct Term {
+        enum Kind {
+            Name,
+            Class,
+            Labelled,
+            Unlabelled,
+            Flagged,
+            Issues,
+            Count
+        };
+
+        Kind kind = Name;
+        bool negate = false;
+        QString pattern;   // Name: 小写文本
+        QByteArray text;   // Name: 小写 UTF-8
+        bool ascii = true; // Name: text 只含 ASCII 字符
+        int class_id = -1; // Class
+        CompareOp op = Equal;
+        int value = 0;     // Count
+    };
+
+    bool matches(const Term &term, const ImageFileList &files, int row, const DatasetIndex *index) const;
+
+    QList<Term> m_terms;
+};
+
+#endif // IMAGEFILTER_H
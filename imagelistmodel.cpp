@@ -0,0 +1,196 @@
+#include "imagelistmodel.h"
+#include "datasetindex.h"
+#include "thumbnailprovider.h"
+#include <QBrush>
+#include <QColor>
+#include <QFont>
+#include <algorithm>
+
+ImageListModel::ImageListModel(const ImageFileList *files, DatasetIndex *index, QObject *parent)
+    : QAbstractListModel(parent), m_files(files), m_index(index), m_thumbnails(nullptr), m_filtered(false) {
+}
+
+int ImageListModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_filtered ? m_rows.size() : m_files->size();
+}
+
+QVariant ImageListModel::data(const QModelIndex &index, int role) const {
+    int row = index.isValid() ? source_row(index.row()) : -1;
+    if (row < 0 || row >= m_files->size()) {
+        return QVariant();
+    }
+
+    switch (role) {
+        case Qt::DisplayRole:
+            return m_files->at(row);
+        case Qt::DecorationRole: {
+            // 只有可见行会请求，缩略图未生成时先返回空，生成后通过 refresh_row 更新
+            if (!m_thumbnails) {
+                return QVariant();
+            }
+            QPixmap pixmap = m_thumbnails->thumbnail(m_files->at(row), row);
+            return pixmap.isNull() ? QVariant() : QVariant(pixmap);
+        }
+        case Qt::ForegroundRole: {
+            // 根据索引摘要标记有问题的图片与已标注图片
+            quint32 flags = m_files->summary(row).flags;
+            if (flags & ImageSummary::HasIssues) {
+                return QBrush(QColor(192, 0, 0));
+            }
+            if (flags & ImageSummary::Labelled) {
+                return QBrush(QColor(0, 128, 0));
+            }
+            return QVariant();
+        }
+        case Qt::FontRole:
+            // 用户标记的图片加粗显示
+            if (m_files->summary(row).flags & ImageSummary::Flagged) {
+                QFont font;
+                font.setBold(true);
+                return font;
+            }
+            return QVariant();
+        case Qt::ToolTipRole: {
+            QString file = m_files->at(row);
+            if (!m_index->contains(file)) {
+                return file;
+            }
+            ImageRecord record = m_index->record(file);
+            QString tooltip = QString(tr("%1\n尺寸: %2x%3 标注数量: %4"))
+                .arg(file).arg(record.width).arg(record.height).arg(record.annotation_count);
+            if (record.issue_count > 0) {
+                tooltip += QString(tr("\n问题标注: %1")).arg(record.issue_count);
+            }
+            return tooltip;
+        }
+        default:
+            return QVariant();
+    }
+}
+
+void ImageListModel::begin_reset() {
+    beginResetModel();
+}
+
+void ImageListModel::end_reset() {
+    update_filter_rows();
+    endResetModel();
+}
+
+// 筛选状态下行号映射会整体变化，结构修改都按重置处理
+void ImageListModel::begin_append(int count) {
+    if (m_filtered) {
+        beginResetModel();
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_files->size(), m_files->size() + count - 1);
+}
+
+void ImageListModel::end_append() {
+    if (m_filtered) {
+        end_reset();
+        return;
+    }
+    endInsertRows();
+}
+
+void ImageListModel::begin_insert(int row) {
+    if (m_filtered) {
+        beginResetModel();
+        return;
+    }
+    beginInsertRows(QModelIndex(), row, row);
+}
+
+void ImageListModel::end_insert() {
+    if (m_filtered) {
+        end_reset();
+        return;
+    }
+    endInsertRows();
+}
+
+void ImageListModel::begin_remove(int row) {
+    if (m_filtered) {
+        beginResetModel();
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+}
+
+void ImageListModel::end_remove() {
+    if (m_filtered) {
+        end_reset();
+        return;
+    }
+    endRemoveRows();
+}
+
+void ImageListModel::refresh_row(int row) {
+    int row_in_view = view_row(row);
+    if (row_in_view >= 0) {
+        emit dataChanged(index(row_in_view), index(row_in_view),
+                         {Qt::DecorationRole, Qt::ForegroundRole, Qt::FontRole, Qt::ToolTipRole});
+    }
+}
+
+void ImageListModel::refresh_all() {
+    if (rowCount() > 0) {
+        emit dataChanged(index(0), index(rowCount() - 1),
+                         {Qt::DecorationRole, Qt::ForegroundRole, Qt::FontRole, Qt::ToolTipRole});
+    }
+}
+
+void ImageListModel::set_thumbnails(ThumbnailProvider *thumbnails) {
+    m_thumbnails = thumbnails;
+    refresh_all();
+}
+
+void ImageListModel::set_filter(const ImageFilter &filter) {
+    beginResetModel();
+    m_filter = filter;
+    m_filtered = !filter.is_empty();
+    update_filter_rows();
+    endResetModel();
+}
+
+bool ImageListModel::is_filtered() const {
+    return m_filtered;
+}
+
+int ImageListModel::source_row(int view_row) const {
+    if (!m_filtered) {
+        return view_row;
+    }
+    return view_row >= 0 && view_row < m_rows.size() ? m_rows.at(view_row) : -1;
+}
+
+int ImageListModel::view_row(int source_row) const {
+    if (!m_filtered) {
+        return source_row >= 0 && source_row < m_files->size() ? source_row : -1;
+    }
+    auto it = std::lower_bound(m_rows.constBegin(), m_rows.constEnd(), source_row);
+    return it != m_rows.constEnd() && *it == source_row ? static_cast<int>(it - m_rows.constBegin()) : -1;
+}
+
+int ImageListModel::next_row(int source_row, int step) const {
+    if (!m_filtered) {
+        int row = source_row + step;
+        return row >= 0 && row < m_files->size() ? row : -1;
+    }
+
+    // 当前行不在筛选结果中时，也能跳到前后最近的可见行
+    if (step > 0) {
+        auto it = std::upper_bound(m_rows.constBegin(), m_rows.constEnd(), source_row);
+        return it != m_rows.constEnd() ? *it : -1;
+    }
+    auto it = std::lower_bound(m_rows.constBegin(), m_rows.constEnd(), source_row);
+    return it != m_rows.constBegin() ? *(it - 1) : -1;
+}
+
+void ImageListModel::update_filter_rows() {
+    m_rows = m_filtered ? m_filter.evaluate(*m_files, m_index) : QVector<int>();
+}
@@ -0,0 +1,60 @@
+#ifndef IMAGELISTMODEL_H
+#define IMAGELISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "imagefilelist.h"
+#include "imagefilter.h"
+
+class DatasetIndex;
+class ThumbnailProvider;
+
+// 图片列表模型
+// 直接引用主窗口中的图片文件列表，不复制文件名；视图只为可见行请求数据。
+// 修改文件列表前后需要调用对应的 begin_/end_ 函数通知视图。
+// 设置筛选条件后只显示满足条件的行，行号需要通过 source_row / view_row 转换。
+class ImageListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    ImageListModel(const ImageFileList *files, DatasetIndex *index, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void begin_reset();
+    void end_reset();
+    void begin_append(int count);
+    void end_append();
+    void begin_insert(int row);
+    void end_insert();
+    void begin_remove(int row);
+    void end_remove();
+    void refresh_row(int row);
+    void refresh_all();
+
+    // 网格模式：设置后为每行提供缩略图，nullptr 为列表模式
+    void set_thumbnails(ThumbnailProvider *thumbnails);
+
+    // 筛选
+    void set_filter(const ImageFilter &filter);
+    bool is_filtered() const;
+    int source_row(int view_row) const;
+    int view_row(int source_row) const;
+    // 从 source_row 开始按 step 方向查找下一个可见行，没有则返回 -1
+    int next_row(int source_row, int step) const;
+
+private:
+    void update_filter_rows();
+
+    const ImageFileList *m_files;
+    DatasetIndex *m_index;
+    ThumbnailProvider *m_thumbnails;
+
+    ImageFilter m_filter;
+    bool m_filtered;
+    QVector<int> m_rows; // 筛选后可见的行号（升序）
+};
+
+#endif // IMAGELISTMODEL_H
@@ -0,0 +1,181 @@
+#include "imageprobe.h"
+#include "datasetsource.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+
+namespace {
+// 数据来源（压缩包、对象存储）中的图片只读取开头这么多字节用于解析文件头
+const qint64 kSourceHeaderSize = 256 * 1024;
+}
+
+QSize ImageProbe::image_size(const QString &path) {
+    QFile file(path);
+    QBuffer buffer;
+    QIODevice *device = &file;
+    QByteArray data;
+    if (DatasetSource::read_mounted(path, &data, kSourceHeaderSize)) {
+        buffer.setData(data);
+        device = &buffer;
+    }
+    if (!device->open(QIODevice::ReadOnly)) {
+        return QSize();
+    }
+
+    // 按文件开头的标识判断格式，不依赖扩展名
+    QByteArray magic = device->peek(8);
+    QSize size;
+    if (magic.startsWith("\x89PNG\r\n\x1a\n")) {
+        size = png_size(device);
+    } else if (magic.startsWith("\xff\xd8")) {
+        size = jpeg_size(device);
+    } else if (magic.startsWith(QByteArray("II*\0", 4))) {
+        size = tiff_size(device, true);
+    } else if (magic.startsWith(QByteArray("MM\0*", 4))) {
+        size = tiff_size(device, false);
+    } else if (magic.startsWith("BM")) {
+        size = bmp_size(device);
+    }
+
+    if (size.isValid() && !size.isEmpty()) {
+        return size;
+    }
+    device->close();
+    return SourceImageReader(path).size();
+}
+
+QSize ImageProbe::png_size(QIODevice *device) {
+    // 签名(8) + IHDR 长度(4) + "IHDR"(4) + 宽(4) + 高(4)
+    QByteArray header = device->read(24);
+    if (header.size() < 24 || header.mid(12, 4) != "IHDR") {
+        return QSize();
+    }
+
+    QDataStream in(header.mid(16));
+    in.setByteOrder(QDataStream::BigEndian);
+    quint32 width = 0;
+    quint32 height = 0;
+    in >> width >> height;
+    return QSize(static_cast<int>(width), static_cast<int>(height));
+}
+
+QSize ImageProbe::jpeg_size(QIODevice *device) {
+    QDataStream in(device);
+    in.setByteOrder(QDataStream::BigEndian);
+    device->seek(2);
+
+    // 依次跳过各个段，直到遇到帧头(SOFn)
+    while (!in.atEnd()) {
+        quint8 byte = 0;
+        in >> byte;
+        if (byte != 0xFF) {
+            continue;
+        }
+        quint8 marker = 0xFF;
+        while (marker == 0xFF && !in.atEnd()) {
+            in >> marker;
+        }
+
+        // 没有长度字段的标记
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            continue;
+        }
+        // 图像结束或扫描数据开始，说明没有找到帧头
+        if (marker == 0xD9 || marker == 0xDA) {
+            break;
+        }
+
+        quint16 length = 0;
+        in >> length;
+        if (length < 2) {
+            break;
+        }
+
+        // SOF0 - SOF15，除去 DHT(C4)、JPG(C8)、DAC(CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            quint8 precision = 0;
+            quint16 height = 0;
+            quint16 width = 0;
+            in >> precision >> height >> width;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            return QSize(width, height);
+        }
+
+        if (!device->seek(device->pos() + length - 2)) {
+            break;
+        }
+    }
+    return QSize();
+}
+
+QSize ImageProbe::tiff_size(QIODevice *device, bool little_endian) {
+    QDataStream in(device);
+    in.setByteOrder(little_endian ? QDataStream::LittleEndian : QDataStream::BigEndian);
+    device->seek(4);
+
+    // 只读取第一个 IFD 中的 ImageWidth(256) 与 ImageLength(257)
+    quint32 ifd_offset = 0;
+    in >> ifd_offset;
+    if (!device->seek(ifd_offset)) {
+        return QSize();
+    }
+
+    quint16 entry_count = 0;
+    in >> entry_count;
+    int width = 0;
+    int height = 0;
+    for (int i = 0; i < entry_count && in.status() == QDataStream::Ok; ++i) {
+        quint16 tag = 0;
+        quint16 type = 0;
+        quint32 count = 0;
+        in >> tag >> type >> count;
+
+        // 值字段固定 4 字节，SHORT 类型位于前 2 字节
+        quint32 value = 0;
+        if (type == 3) {
+            quint16 short_value = 0;
+            quint16 padding = 0;
+            in >> short_value >> padding;
+            value = short_value;
+        } else {
+            in >> value;
+        }
+
+        if (tag == 256) {
+            width = static_cast<int>(value);
+        } else if (tag == 257) {
+            height = static_cast<int>(value);
+        }
+        if (width > 0 && height > 0) {
+            return QSize(width, height);
+        }
+    }
+    return QSize();
+}
+
+QSize ImageProbe::bmp_size(QIODevice *device) {
+    QByteArray header = device->read(26);
+    if (header.size() < 26) {
+        return QSize();
+    }
+
+    QDataStream in(header.mid(14));
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 header_size = 0;
+    in >> header_size;
+
+    // OS/2 BITMAPCOREHEADER 使用 16 位宽高，其余版本为 32 位，高度为负表示自上而下存储
+    if (header_size == 12) {
+        quint16 width = 0;
+        quint16 height = 0;
+        in >> width >> height;
+        return QSize(width, height);
+    }
+
+    qint32 width = 0;
+    qint32 height = 0;
+    in >> width >> height;
+    return QSize(width, qAbs(height));
+}
@@ -0,0 +1,23 @@
+#ifndef IMAGEPROBE_H
+#define IMAGEPROBE_H
+
+#include <QSize>
+#include <QString>
+
+class QIODevice;
+
+// 图片尺寸探测类
+// 只读取文件头获取图片宽高，不解码像素：PNG/JPEG/TIFF/BMP 按文件格式直接解析，
+// 其他格式或解析失败时退回 QImageReader::size()。可在工作线程中调用。
+class ImageProbe {
+public:
+    static QSize image_size(const QString &path);
+
+private:
+    static QSize png_size(QIODevice *device);
+    static QSize jpeg_size(QIODevice *device);
+    static QSize tiff_size(QIODevice *device, bool little_endian);
+    static QSize bmp_size(QIODevice *device);
+};
+
+#endif // IMAGEPROBE_H
@@ -0,0 +1,249 @@
+#include "imageresizer.h"
+#include "displaymapper.h"
+#include "imageprobe.h"
+#include "imagescaler.h"
+#include "labelformat.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+
+namespace {
+// 每个缩放任务处理的图片数量
+const int kResizeChunkSize = 16;
+}
+
+// 后台缩放任务：依次缩小一块图片，并同步重写像素坐标的标注
+class ImageResizer::ResizeTask : public QRunnable {
+public:
+    ResizeTask(ImageResizer *resizer, int generation, const QString &folder, const QStringList &files,
+               const QStringList &classes, int max_side, int quality)
+        : m_resizer(resizer), m_generation(generation), m_folder(folder), m_files(files), m_classes(classes),
+          m_maxSide(max_side), m_quality(quality), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        QStringList resized;
+        int failed = 0;
+        qint64 bytes_before = 0;
+        qint64 bytes_after = 0;
+        for (const QString &file: m_files) {
+            if (m_resizer->m_generation.load() != m_generation) {
+                return;
+            }
+
+            QString image_path = m_folder + "/" + file;
+            QSize size = ImageProbe::image_size(image_path);
+            if (size.isEmpty()) {
+                ++failed;
+                continue;
+            }
+            if (qMax(size.width(), size.height()) <= m_maxSide) {
+                continue;
+            }
+
+            double scale = static_cast<double>(m_maxSide) / qMax(size.width(), size.height());
+            QSize target(qMax(1, qRound(size.width() * scale)), qMax(1, qRound(size.height() * scale)));
+
+            // 在替换图片之前读出像素坐标的标注
+            QStringList known_classes = m_classes;
+            QList<LabelShape> shapes;
+            bool rewrite_labels = !m_format->normalized_coordinates() &&
+                                  m_format->read(image_path, size, &known_classes, &shapes) && !shapes.isEmpty();
+
+            // 缩小后的图片先写入临时文件，标注写入成功后才替换原图
+            qint64 before = QFileInfo(image_path).size();
+            QSaveFile output(image_path);
+            if (!encode_image(image_path, target, &output)) {
+                ++failed;
+                continue;
+            }
+
+            const QString label_path = m_format->label_path(image_path);
+            QByteArray label_backup;
+            if (rewrite_labels) {
+                double sx = static_cast<double>(target.width()) / size.width();
+                double sy = static_cast<double>(target.height()) / size.height();
+                for (LabelShape &shape: shapes) {
+                    shape.box = QRectF(shape.box.x() * sx, shape.box.y() * sy,
+                                       shape.box.width() * sx, shape.box.height() * sy);
+                    for (QPointF &point: shape.points) {
+                        point = QPointF(point.x() * sx, point.y() * sy);
+                    }
+                }
+                QFile label_file(label_path);
+                if (label_file.open(QIODevice::ReadOnly)) {
+                    label_backup = label_file.readAll();
+                    label_file.close();
+                }
+                if (!m_format->write(image_path, target, known_classes, shapes)) {
+                    qWarning() << "无法重写标注文件:" << label_path;
+                    output.cancelWriting();
+                    ++failed;
+                    continue;
+                }
+            }
+
+            if (!output.commit()) {
+                qWarning() << "无法替换图片:" << image_path;
+                // 图片未替换，恢复原标注
+                if (rewrite_labels && !restore_labels(label_path, label_backup)) {
+                    qWarning() << "无法恢复标注文件:" << label_path;
+                }
+                ++failed;
+                continue;
+            }
+
+            resized.append(file);
+            bytes_before += before;
+            bytes_after += QFileInfo(image_path).size();
+        }
+
+        ImageResizer *resizer = m_resizer;
+        int generation = m_generation;
+        int done = m_files.size();
+        QMetaObject::invokeMethod(resizer, [resizer, generation, done, resized, failed, bytes_before, bytes_after]() {
+            resizer->on_chunk_finished(generation, done, resized, failed, bytes_before, bytes_after);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    // 解码、缩小并以原格式写入 output，由调用者提交；EXIF 等元数据不保留
+    bool encode_image(const QString &path, const QSize &target, QSaveFile *output) const {
+        QImageReader reader(path);
+        QByteArray format = reader.format();
+        QImage image = reader.read();
+        if (image.isNull()) {
+            qWarning() << "无法解码图片:" << path << reader.errorString();
+            return false;
+        }
+        // ImageScaler 按 8 位通道计算，16 位图片用 QImage 缩放并保持原格式，避免原图被降为 8 位
+        QImage scaled;
+        if (DisplayMapper::is_high_bit_depth(image.format())) {
+            scaled = image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                         .convertToFormat(image.format());
+        } else {
+            scaled = ImageScaler::downscale(image, target);
+        }
+
+        // 以原格式写回；质量只用于有损格式，PNG 等的 quality 表示压缩级别
+        if (!output->open(QIODevice::WriteOnly)) {
+            qWarning() << "无法写入图片:" << path;
+            return false;
+        }
+        QImageWriter writer(output, format);
+        if (format == "jpeg" || format == "jpg" || format == "webp") {
+            writer.setQuality(m_quality);
+        }
+        if (!writer.write(scaled)) {
+            qWarning() << "无法编码图片:" << path << writer.errorString();
+            output->cancelWriting();
+            return false;
+        }
+        return true;
+    }
+
+    static bool restore_labels(const QString &path, const QByteArray &data) {
+        QSaveFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit();
+    }
+
+    ImageResizer *m_resizer;
+    int m_generation;
+    QString m_folder;
+    QStringList m_files;
+    QStringList m_classes;
+    int m_maxSide;
+    int m_quality;
+    const LabelFormat *m_format;
+};
+
+ImageResizer::ImageResizer(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_generation(0)
+      , m_total(0)
+      , m_pendingTasks(0)
+      , m_done(0)
+      , m_failed(0)
+      , m_bytesBefore(0)
+      , m_bytesAfter(0)
+      , m_running(false) {
+}
+
+ImageResizer::~ImageResizer() {
+    cancel();
+}
+
+bool ImageResizer::start(const QString &folder, const QStringList &files, const QStringList &classes, int max_side,
+                         int quality) {
+    if (is_running() || max_side <= 0) {
+        return false;
+    }
+
+    m_total = files.size();
+    m_pendingTasks = 0;
+    m_done = 0;
+    m_failed = 0;
+    m_bytesBefore = 0;
+    m_bytesAfter = 0;
+    m_resized.clear();
+    m_running = true;
+    m_timer.start();
+
+    for (int first = 0; first < files.size(); first += kResizeChunkSize) {
+        m_jobs.start(new ResizeTask(this, m_generation.load(), folder, files.mid(first, kResizeChunkSize), classes,
+                                    max_side, quality));
+        ++m_pendingTasks;
+    }
+    if (m_pendingTasks == 0) {
+        finish();
+    }
+    return true;
+}
+
+void ImageResizer::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_running = false;
+}
+
+bool ImageResizer::is_running() const {
+    return m_running;
+}
+
+void ImageResizer::on_chunk_finished(int generation, int done, const QStringList &resized, int failed,
+                                     qint64 bytes_before, qint64 bytes_after) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+
+    m_done += done;
+    m_resized += resized;
+    m_failed += failed;
+    m_bytesBefore += bytes_before;
+    m_bytesAfter += bytes_after;
+    emit progress(m_done, m_total);
+
+    if (--m_pendingTasks == 0) {
+        finish();
+    }
+}
+
+void ImageResizer::finish() {
+    double seconds = qMax<qint64>(m_timer.elapsed(), 1) / 1000.0;
+    QString message = tr("已缩小 %1 / %2 张图片, 节省 %3 MB, %4 张/秒")
+        .arg(m_resized.size()).arg(m_total)
+        .arg((m_bytesBefore - m_bytesAfter) / 1048576.0, 0, 'f', 1)
+        .arg(m_resized.size() / seconds, 0, 'f', 1);
+    if (m_failed > 0) {
+        message += tr(", %1 个失败").arg(m_failed);
+    }
+    QStringList resized = m_resized;
+    m_resized.clear();
+    m_running = false;
+    emit finished(m_failed == 0, message, resized);
+}
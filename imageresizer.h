@@ -0,0 +1,55 @@
+#ifndef IMAGERESIZER_H
+#define IMAGERESIZER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <atomic>
+#include "jobscheduler.h"
+
+// 数据集缩小类
+// 把文件夹中最长边超过设定值的图片按比例缩小并以原格式重新编码（原地替换），
+// 缩放使用面积平均滤波，各图片在线程池中并行处理。
+// 归一化坐标的标注（YOLO）缩放后仍然有效，不做修改；
+// 像素坐标的标注（VOC、LabelMe）按同样的比例重写。
+class ImageResizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageResizer(QObject *parent = nullptr);
+    ~ImageResizer();
+
+    // max_side 为缩小后的最长边，quality 为 JPEG 等有损格式的编码质量
+    bool start(const QString &folder, const QStringList &files, const QStringList &classes, int max_side,
+               int quality);
+    void cancel();
+    bool is_running() const;
+
+signals:
+    void progress(int done, int total);
+    // resized 为实际被缩小的图片
+    void finished(bool ok, const QString &message, const QStringList &resized);
+
+private:
+    class ResizeTask;
+
+    void on_chunk_finished(int generation, int done, const QStringList &resized, int failed, qint64 bytes_before,
+                           qint64 bytes_after);
+    void finish();
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+
+    int m_total;
+    int m_pendingTasks;
+    int m_done;
+    int m_failed;
+    qint64 m_bytesBefore;
+    qint64 m_bytesAfter;
+    QStringList m_resized;
+    QElapsedTimer m_timer;
+    bool m_running;
+};
+
+#endif // IMAGERESIZER_H
@@ -0,0 +1,409 @@
+#include "imagescaler.h"
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGESCALER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+enum SimdLevel {
+    Scalar = 0,
+    Sse41,
+    Avx2
+};
+
+SimdLevel detect_simd_level() {
+#ifdef IMAGESCALER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return Sse41;
+    }
+#endif
+    return Scalar;
+}
+
+SimdLevel simd() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+// 一个输出像素在一个方向上覆盖的源像素 [first, first + count)，权重从 weights[weight_offset] 开始
+struct Span {
+    int first;
+    int count;
+    int weight_offset;
+};
+
+QVector<Span> make_spans(int source, int target, QVector<float> *weights) {
+    // 输出像素 t 覆盖源区间 [t * scale, (t + 1) * scale)，权重为重叠长度 / scale，和为 1
+    const double scale = static_cast<double>(source) / target;
+    QVector<Span> spans;
+    spans.reserve(target);
+    weights->clear();
+    weights->reserve(target * (static_cast<int>(std::ceil(scale)) + 1));
+    for (int t = 0; t < target; ++t) {
+        const double begin = t * scale;
+        const double end = qMin(static_cast<double>(source), (t + 1) * scale);
+        const int first = static_cast<int>(std::floor(begin));
+        const int last = qMin(source, static_cast<int>(std::ceil(end)));
+        spans.append({first, last - first, weights->size()});
+        for (int j = first; j < last; ++j) {
+            const double overlap = qMin(end, j + 1.0) - qMax(begin, static_cast<double>(j));
+            weights->append(static_cast<float>(overlap / scale));
+        }
+    }
+    return spans;
+}
+
+// 转换为可直接按字节平均的格式：灰度 1 通道、RGB888 3 通道、32 位 4 通道（透明通道预乘）
+QImage channel_image(const QImage &image, int *channels) {
+    switch (image.format()) {
+        case QImage::Format_Grayscale8:
+            *channels = 1;
+            return image;
+        case QImage::Format_RGB888:
+            *channels = 3;
+            return image;
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+            *channels = 4;
+            return image;
+        case QImage::Format_RGBA8888:
+            *channels = 4;
+            return image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+        default:
+            *channels = 4;
+            return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                 : QImage::Format_RGB32);
+    }
+}
+
+// 垂直累加：acc[i] += weight * line[i]
+void accumulate_scalar(float *acc, const uchar *line, float weight, int count) {
+    for (int i = 0; i < count; ++i) {
+        acc[i] += weight * line[i];
+    }
+}
+
+// 水平累加并转换为 8 位
+void horizontal_scalar(const float *acc, uchar *out, const Span *spans, const float *weights, int width,
+                       int channels) {
+    for (int x = 0; x < width; ++x) {
+        const Span &span = spans[x];
+        const float *in = acc + span.first * channels;
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int k = 0; k < span.count; ++k) {
+            const float weight = weights[span.weight_offset + k];
+            for (int c = 0; c < channels; ++c) {
+                sum[c] += weight * in[k * channels + c];
+            }
+        }
+        for (int c = 0; c < channels; ++c) {
+            out[x * channels + c] = static_cast<uchar>(qBound(0.0f, sum[c] + 0.5f, 255.0f));
+        }
+    }
+}
+
+// 2x2 平均，返回处理的输出像素数
+int half_scalar(const uchar *row0, const uchar *row1, uchar *out, int first, int width, int channels) {
+    for (int x = first; x < width; ++x) {
+        const int i = 2 * x * channels;
+        for (int c = 0; c < channels; ++c) {
+            out[x * channels + c] = static_cast<uchar>(
+                (row0[i + c] + row0[i + channels + c] + row1[i + c] + row1[i + channels + c] + 2) >> 2);
+        }
+    }
+    return width;
+}
+
+#ifdef IMAGESCALER_X86
+__attribute__((target("avx2")))
+void accumulate_avx2(float *acc, const uchar *line, float weight, int count) {
+    const __m256 w = _mm256_set1_ps(weight);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(line + i));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(values, w)));
+    }
+    accumulate_scalar(acc + i, line + i, weight, count - i);
+}
+
+__attribute__((target("sse4.1")))
+void accumulate_sse41(float *acc, const uchar *line, float weight, int count) {
+    const __m128 w = _mm_set1_ps(weight);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int packed;
+        std::memcpy(&packed, line + i, sizeof(packed));
+        __m128 values = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(values, w)));
+    }
+    accumulate_scalar(acc + i, line + i, weight, count - i);
+}
+
+// 4 通道时一个像素正好是一个 __m128
+__attribute__((target("sse4.1")))
+void horizontal4_sse41(const float *acc, uchar *out, const Span *spans, const float *weights, int width) {
+    for (int x = 0; x < width; ++x) {
+        const Span &span = spans[x];
+        const float *in = acc + span.first * 4;
+        const float *w = weights + span.weight_offset;
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < span.count; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + k * 4), _mm_set1_ps(w[k])));
+        }
+        // 四舍五入后饱和转换为 8 位
+        __m128i value = _mm_cvtps_epi32(sum);
+        value = _mm_packs_epi32(value, value);
+        value = _mm_packus_epi16(value, value);
+        int pixel = _mm_cvtsi128_si32(value);
+        std::memcpy(out + x * 4, &pixel, sizeof(pixel));
+    }
+}
+
+// 4 通道的 2x2 平均：每次读取两行各 8 个像素，输出 4 个像素
+__attribute__((target("sse4.1")))
+int half4_sse41(const uchar *row0, const uchar *row1, uchar *out, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i result[2];
+        for (int half = 0; half < 2; ++half) {
+            const int offset = x * 8 + half * 16;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + offset));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + offset));
+            // 扩展为 16 位后两行相加：lo = 像素 0、1，hi = 像素 2、3
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            // 相邻像素相加：[0 + 1, 2 + 3]
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            result[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(result[0], result[1]));
+    }
+    return x;
+}
+
+// 每次计算两个输出像素，分别放在 __m256 的低、高 128 位；两个像素覆盖的列数可能不同
+__attribute__((target("avx2")))
+void horizontal4_avx2(const float *acc, uchar *out, const Span *spans, const float *weights, int width) {
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        const Span &span0 = spans[x];
+        const Span &span1 = spans[x + 1];
+        const float *in0 = acc + span0.first * 4;
+        const float *in1 = acc + span1.first * 4;
+        const float *w0 = weights + span0.weight_offset;
+        const float *w1 = weights + span1.weight_offset;
+        const int common = qMin(span0.count, span1.count);
+        __m256 sum = _mm256_setzero_ps();
+        int k = 0;
+        for (; k < common; ++k) {
+            const __m256 values = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in0 + k * 4)),
+                                                       _mm_loadu_ps(in1 + k * 4), 1);
+            const __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[k])), _mm_set1_ps(w1[k]), 1);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(values, w));
+        }
+        __m128 sum0 = _mm256_castps256_ps128(sum);
+        __m128 sum1 = _mm256_extractf128_ps(sum, 1);
+        for (int j = k; j < span0.count; ++j) {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(in0 + j * 4), _mm_set1_ps(w0[j])));
+        }
+        for (int j = k; j < span1.count; ++j) {
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(in1 + j * 4), _mm_set1_ps(w1[j])));
+        }
+        // 四舍五入后饱和转换为 8 位，两个像素一起写出
+        __m128i value = _mm_packs_epi32(_mm_cvtps_epi32(sum0), _mm_cvtps_epi32(sum1));
+        value = _mm_packus_epi16(value, value);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x * 4), value);
+    }
+    if (x < width) {
+        horizontal4_sse41(acc, out + x * 4, spans + x, weights, width - x);
+    }
+}
+
+// 4 通道的 2x2 平均：每次读取两行各 16 个像素，输出 8 个像素
+__attribute__((target("avx2")))
+int half4_avx2(const uchar *row0, const uchar *row1, uchar *out, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i result[2];
+        for (int half = 0; half < 2; ++half) {
+            const int offset = x * 8 + half * 32;
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + offset));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + offset));
+            // 与 SSE4.1 版本相同，按 128 位分别计算：每半边得到 2 个输出像素
+            __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+            __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+            __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+            result[half] = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+        }
+        // 按 128 位打包后顺序为像素 0 1 4 5 | 2 3 6 7，再按 64 位重排
+        __m256i packed = _mm256_packus_epi16(result[0], result[1]);
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x * 4), packed);
+    }
+    return x + half4_sse41(row0 + x * 8, row1 + x * 8, out + x * 4, width - x);
+}
+#endif
+
+// 源区域 [x0, x0 + nx) x [y0, y0 + ny) 的平均值写入 out
+void average_block(const QImage &source, int x0, int y0, int nx, int ny, int channels, uchar *out) {
+    const int count = nx * ny;
+    for (int c = 0; c < channels; ++c) {
+        int sum = 0;
+        for (int y = y0; y < y0 + ny; ++y) {
+            const uchar *line = source.constScanLine(y);
+            for (int x = x0; x < x0 + nx; ++x) {
+                sum += line[x * channels + c];
+            }
+        }
+        out[c] = static_cast<uchar>((sum + count / 2) / count);
+    }
+}
+
+void accumulate(float *acc, const uchar *line, float weight, int count) {
+#ifdef IMAGESCALER_X86
+    if (simd() == Avx2) {
+        accumulate_avx2(acc, line, weight, count);
+        return;
+    }
+    if (simd() == Sse41) {
+        accumulate_sse41(acc, line, weight, count);
+        return;
+    }
+#endif
+    accumulate_scalar(acc, line, weight, count);
+}
+
+void horizontal(const float *acc, uchar *out, const Span *spans, const float *weights, int width, int channels) {
+#ifdef IMAGESCALER_X86
+    if (channels == 4 && simd() == Avx2) {
+        horizontal4_avx2(acc, out, spans, weights, width);
+        return;
+    }
+    if (channels == 4 && simd() == Sse41) {
+        horizontal4_sse41(acc, out, spans, weights, width);
+        return;
+    }
+#endif
+    horizontal_scalar(acc, out, spans, weights, width, channels);
+}
+
+void half_row(const uchar *row0, const uchar *row1, uchar *out, int width, int channels) {
+    int first = 0;
+#ifdef IMAGESCALER_X86
+    if (channels == 4 && simd() == Avx2) {
+        first = half4_avx2(row0, row1, out, width);
+    } else if (channels == 4 && simd() == Sse41) {
+        first = half4_sse41(row0, row1, out, width);
+    }
+#endif
+    half_scalar(row0, row1, out, first, width, channels);
+}
+}
+
+QImage ImageScaler::downscale(const QImage &image, const QSize &size) {
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+
+    // 减半到目标尺寸的两倍以内，剩下的比例由面积平均完成
+    QImage current = image;
+    while (current.width() / 2 >= size.width() * 2 && current.height() / 2 >= size.height() * 2) {
+        current = half(current);
+    }
+    return area_downscale(current, size);
+}
+
+QImage ImageScaler::area_downscale(const QImage &image, const QSize &size) {
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    if (size == image.size()) {
+        return image;
+    }
+    if (size.width() > image.width() || size.height() > image.height()) {
+        return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    int channels = 0;
+    const QImage source = channel_image(image, &channels);
+
+    QVector<float> x_weights;
+    QVector<float> y_weights;
+    const QVector<Span> x_spans = make_spans(source.width(), size.width(), &x_weights);
+    const QVector<Span> y_spans = make_spans(source.height(), size.height(), &y_weights);
+
+    QImage result(size, source.format());
+    const int row_values = source.width() * channels;
+    QVector<float> row(row_values);
+    for (int y = 0; y < size.height(); ++y) {
+        // 垂直方向：把覆盖的源行加权累加到一行
+        const Span &y_span = y_spans.at(y);
+        std::fill(row.begin(), row.end(), 0.0f);
+        for (int k = 0; k < y_span.count; ++k) {
+            accumulate(row.data(), source.constScanLine(y_span.first + k), y_weights.at(y_span.weight_offset + k),
+                       row_values);
+        }
+
+        // 水平方向：每个输出像素累加其覆盖的列
+        horizontal(row.constData(), result.scanLine(y), x_spans.constData(), x_weights.constData(), size.width(),
+                   channels);
+    }
+    return result;
+}
+
+QImage ImageScaler::half(const QImage &image) {
+    if (image.width() < 2 || image.height() < 2) {
+        return area_downscale(image, QSize(qMax(1, image.width() / 2), qMax(1, image.height() / 2)));
+    }
+
+    int channels = 0;
+    const QImage source = channel_image(image, &channels);
+    QImage result(source.width() / 2, source.height() / 2, source.format());
+    const int width = result.width();
+    const int height = result.height();
+    // 宽或高为奇数时，多出的一列/一行并入最后一个输出像素（3 个源像素平均）
+    const bool odd_x = source.width() % 2 != 0;
+    const bool odd_y = source.height() % 2 != 0;
+    for (int y = 0; y < height; ++y) {
+        uchar *line = result.scanLine(y);
+        if (odd_y && y == height - 1) {
+            for (int x = 0; x < width; ++x) {
+                average_block(source, 2 * x, 2 * y, odd_x && x == width - 1 ? 3 : 2, 3, channels,
+                              line + x * channels);
+            }
+            continue;
+        }
+        half_row(source.constScanLine(2 * y), source.constScanLine(2 * y + 1), line, width, channels);
+        if (odd_x) {
+            average_block(source, 2 * (width - 1), 2 * y, 3, 2, channels, line + (width - 1) * channels);
+        }
+    }
+    return result;
+}
+
+const char *ImageScaler::simd_level() {
+    switch (simd()) {
+        case Avx2:
+            return "AVX2";
+        case Sse41:
+            return "SSE4.1";
+        default:
+            return "scalar";
+    }
+}
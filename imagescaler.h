@@ -0,0 +1,25 @@
+#ifndef IMAGESCALER_H
+#define IMAGESCALER_H
+
+#include <QImage>
+#include <QSize>
+
+// 图片缩小类
+// 所有需要缩小图片的地方（缩略图、预览、导出）共用的接口，支持 8 位灰度、RGB 与 RGBA。
+// 面积平均（box）滤波：每个输出像素是其覆盖的源像素区域按覆盖面积加权的平均值，
+// 大比例缩小时没有 QImage::scaled 双线性采样的混叠。先按行做垂直累加再做水平累加，
+// x86 上按 CPU 在运行时选择 AVX2 / SSE4.1 实现，其他平台使用标量实现。可在工作线程中调用。
+class ImageScaler {
+public:
+    // 缩小到 size，大比例缩小时先用 half 逐级减半再做面积平均；size 大于原图时退回 QImage::scaled
+    static QImage downscale(const QImage &image, const QSize &size);
+    // 精确的面积平均缩小
+    static QImage area_downscale(const QImage &image, const QSize &size);
+    // 2x2 平均缩小一半；奇数时最后一行/列并入最后一个输出像素
+    static QImage half(const QImage &image);
+
+    // 当前使用的指令集，例如 "AVX2"
+    static const char *simd_level();
+};
+
+#endif // IMAGESCALER_H
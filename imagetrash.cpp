@@ -0,0 +1,119 @@
+#include "imagetrash.h"
+#include "labelformat.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+void ImageTrash::set_folder(const QString &folder) {
+    m_folder = folder;
+    m_batches.clear();
+}
+
+QString ImageTrash::trash_folder(const QString &folder) {
+    return folder + "/bak";
+}
+
+bool ImageTrash::move_files(const QString &folder, Entry *entry) {
+    QString image_path = folder + "/" + entry->file;
+    QString label_path = DatasetIndex::label_path(folder, entry->file);
+
+    // 递归扫描时图片可能位于子文件夹中，回收站中保留相对路径；重名时追加序号
+    entry->image_path = unique_path(trash_folder(folder) + "/" + entry->file);
+    QDir().mkpath(QFileInfo(entry->image_path).absolutePath());
+    if (!move_file(image_path, entry->image_path)) {
+        qWarning() << "无法移动图片到回收站:" << image_path;
+        return false;
+    }
+
+    // 共用容器中的标注保留在原处，撤销后图片仍能找到
+    entry->label_path.clear();
+    if (LabelFormat::folder_format(folder)->per_image_files() && QFile::exists(label_path)) {
+        QFileInfo info(entry->image_path);
+        entry->label_path = info.absolutePath() + "/" + info.completeBaseName() + "." + QFileInfo(label_path).suffix();
+        if (!move_file(label_path, entry->label_path)) {
+            qWarning() << "无法移动标注文件到回收站:" << label_path;
+            entry->label_path.clear();
+        }
+    }
+    return true;
+}
+
+bool ImageTrash::move_to_trash(const Entry &entry) {
+    Entry moved = entry;
+    if (!move_files(m_folder, &moved)) {
+        return false;
+    }
+    push(QList<Entry>() << moved);
+    return true;
+}
+
+void ImageTrash::push(const QList<Entry> &entries) {
+    if (!entries.isEmpty()) {
+        m_batches.append(entries);
+    }
+}
+
+bool ImageTrash::can_undo() const {
+    return !m_batches.isEmpty();
+}
+
+bool ImageTrash::undo(QList<Entry> *entries) {
+    if (m_batches.isEmpty()) {
+        return false;
+    }
+
+    QList<Entry> batch = m_batches.takeLast();
+    entries->clear();
+    for (const Entry &entry: batch) {
+        QString image_path = m_folder + "/" + entry.file;
+        if (QFile::exists(image_path)) {
+            qWarning() << "原位置已存在同名文件，无法恢复:" << image_path;
+            continue;
+        }
+        QDir().mkpath(QFileInfo(image_path).absolutePath());
+        if (!move_file(entry.image_path, image_path)) {
+            qWarning() << "无法从回收站恢复图片:" << entry.image_path;
+            continue;
+        }
+        if (!entry.label_path.isEmpty()) {
+            QString label_path = DatasetIndex::label_path(m_folder, entry.file);
+            if (!QFile::exists(label_path) && !move_file(entry.label_path, label_path)) {
+                qWarning() << "无法从回收站恢复标注文件:" << entry.label_path;
+            }
+        }
+        entries->append(entry);
+    }
+
+    // 按原行号升序插入即可还原删除前的顺序
+    std::sort(entries->begin(), entries->end(), [](const Entry &a, const Entry &b) {
+        return a.row < b.row;
+    });
+    return !entries->isEmpty();
+}
+
+void ImageTrash::clear() {
+    m_batches.clear();
+}
+
+bool ImageTrash::move_file(const QString &from, const QString &to) {
+    // QFile::rename 在同一文件系统内只重命名目录项，跨设备时才退回到复制后删除
+    return QFile::rename(from, to);
+}
+
+QString ImageTrash::unique_path(const QString &path) {
+    if (!QFile::exists(path)) {
+        return path;
+    }
+
+    QFileInfo info(path);
+    QString base = info.absolutePath() + "/" + info.completeBaseName();
+    QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    for (int n = 1;; ++n) {
+        QString candidate = QString("%1_%2%3").arg(base).arg(n).arg(suffix);
+        if (!QFile::exists(candidate)) {
+            return candidate;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef IMAGETRASH_H
+#define IMAGETRASH_H
+
+#include <QList>
+#include <QString>
+#include "datasetindex.h"
+
+// 图片回收站
+// 删除时把图片与标注文件重命名到图片文件夹下的 bak 目录（保留相对路径），
+// 同一文件系统内只修改目录项，不复制文件内容；按删除批次记录以便撤销。
+class ImageTrash {
+public:
+    // 一张被删除的图片
+    struct Entry {
+        QString file;         // 相对于图片文件夹的路径
+        int row = -1;         // 删除前在列表中的位置
+        QString image_path;   // 回收站中的图片路径
+        QString label_path;   // 回收站中的标注文件路径，没有标注文件时为空
+        ImageRecord record;   // 删除前的索引记录
+        bool has_record = false;
+    };
+
+    void set_folder(const QString &folder);
+    static QString trash_folder(const QString &folder);
+
+    // 只移动文件并填写 entry 中的回收站路径，不修改撤销记录，可在工作线程中调用
+    static bool move_files(const QString &folder, Entry *entry);
+
+    // 将一张图片移入回收站并记录为一个批次
+    bool move_to_trash(const Entry &entry);
+    // 记录一批已经移入回收站的图片，撤销时一起恢复
+    void push(const QList<Entry> &entries);
+
+    // 恢复最近一批删除的图片，entries 按删除前的行号升序排列
+    bool can_undo() const;
+    bool undo(QList<Entry> *entries);
+    void clear();
+
+private:
+    static bool move_file(const QString &from, const QString &to);
+    static QString unique_path(const QString &path);
+
+    QString m_folder;
+    QList<QList<Entry>> m_batches;
+};
+
+#endif // IMAGETRASH_H
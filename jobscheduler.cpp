@@ -0,0 +1,311 @@
+#include "jobscheduler.h"
+#include <QObject>
+#include <QThread>
+#include <algorithm>
+#include <limits>
+
+namespace {
+class FunctionJob : public QRunnable {
+public:
+    explicit FunctionJob(std::function<void()> function) : m_function(std::move(function)) {
+    }
+
+    void run() override {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+}
+
+class JobScheduler::Worker : public QRunnable {
+public:
+    explicit Worker(JobScheduler *scheduler) : m_scheduler(scheduler) {
+    }
+
+    void run() override {
+        m_scheduler->run_worker();
+    }
+
+private:
+    JobScheduler *m_scheduler;
+};
+
+JobScheduler *JobScheduler::instance() {
+    static JobScheduler scheduler;
+    return &scheduler;
+}
+
+QString JobScheduler::priority_name(Priority priority) {
+    switch (priority) {
+        case CurrentImage:
+            return QObject::tr("当前图片");
+        case Neighbour:
+            return QObject::tr("相邻图片");
+        case Thumbnail:
+            return QObject::tr("缩略图");
+        case Indexing:
+            return QObject::tr("扫描与索引");
+        case Background:
+            return QObject::tr("导出与批量操作");
+        default:
+            return QString();
+    }
+}
+
+JobScheduler::JobScheduler()
+    : m_threads(qMax(1, QThread::idealThreadCount()))
+      , m_workers(0)
+      , m_running(0) {
+    m_pool.setMaxThreadCount(m_threads);
+    // 预读与缩略图各最多占一半线程，其他类别最多占用除保留线程外的全部线程
+    const int half = qMax(1, m_threads / 2);
+    const int rest = qMax(1, m_threads - 1);
+    m_limits[CurrentImage] = m_threads;
+    m_limits[Neighbour] = half;
+    m_limits[Thumbnail] = half;
+    m_limits[Indexing] = rest;
+    m_limits[Background] = rest;
+    for (int i = 0; i < PriorityCount; ++i) {
+        m_classRunning[i] = 0;
+    }
+    reset_stats();
+}
+
+JobScheduler::~JobScheduler() {
+    m_pool.waitForDone();
+}
+
+int JobScheduler::thread_count() const {
+    return m_threads;
+}
+
+void JobScheduler::set_limit(Priority priority, int limit) {
+    QMutexLocker locker(&m_mutex);
+    m_limits[priority] = qBound(1, limit, m_threads);
+    dispatch();
+}
+
+int JobScheduler::limit(Priority priority) const {
+    QMutexLocker locker(&m_mutex);
+    return m_limits[priority];
+}
+
+QVector<JobScheduler::Stats> JobScheduler::stats() const {
+    QMutexLocker locker(&m_mutex);
+    QVector<Stats> result;
+    for (int i = 0; i < PriorityCount; ++i) {
+        const Counters &counters = m_counters[i];
+        Stats stats;
+        stats.queued = static_cast<int>(m_queues[i].size());
+        stats.running = m_classRunning[i];
+        stats.limit = m_limits[i];
+        stats.finished = counters.finished;
+        stats.wait_ms = counters.finished > 0 ? counters.wait_ms / counters.finished : 0.0;
+        stats.run_ms = counters.finished > 0 ? counters.run_ms / counters.finished : 0.0;
+        stats.max_wait_ms = counters.max_wait_ms;
+        result.append(stats);
+    }
+    return result;
+}
+
+void JobScheduler::reset_stats() {
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < PriorityCount; ++i) {
+        m_counters[i] = Counters{0, 0.0, 0.0, 0.0};
+    }
+}
+
+void JobScheduler::submit(const QSharedPointer<GroupState> &group, QRunnable *task, int order) {
+    QMutexLocker locker(&m_mutex);
+    Job job{task, order, group, QElapsedTimer()};
+    job.queued.start();
+    ++group->pending;
+
+    // order 大的在前，order 相同时先提交的在前
+    std::deque<Job> &queue = m_queues[group->priority];
+    auto it = std::upper_bound(queue.begin(), queue.end(), order, [](int value, const Job &job) {
+        return value > job.order;
+    });
+    queue.insert(it, job);
+
+    if (m_workers < m_threads) {
+        ++m_workers;
+        m_pool.start(new Worker(this));
+    }
+}
+
+void JobScheduler::cancel(const QSharedPointer<GroupState> &group) {
+    QMutexLocker locker(&m_mutex);
+    std::deque<Job> &queue = m_queues[group->priority];
+    for (auto it = queue.begin(); it != queue.end();) {
+        if (it->group != group) {
+            ++it;
+            continue;
+        }
+        if (it->task->autoDelete()) {
+            delete it->task;
+        }
+        --group->pending;
+        it = queue.erase(it);
+    }
+    m_finished.wakeAll();
+}
+
+void JobScheduler::wait(const QSharedPointer<GroupState> &group) {
+    QMutexLocker locker(&m_mutex);
+    while (group->pending > 0) {
+        m_finished.wait(&m_mutex);
+    }
+}
+
+void JobScheduler::run_pending(const QSharedPointer<GroupState> &group) {
+    // 调用线程不属于线程池，不计入类别的运行数
+    QMutexLocker locker(&m_mutex);
+    std::deque<Job> &queue = m_queues[group->priority];
+    for (;;) {
+        auto it = std::find_if(queue.begin(), queue.end(), [&group](const Job &job) {
+            return job.group == group;
+        });
+        if (it == queue.end()) {
+            return;
+        }
+        Job job = *it;
+        queue.erase(it);
+        ++group->running;
+        const double wait_ms = job.queued.nsecsElapsed() / 1e6;
+        locker.unlock();
+
+        QElapsedTimer timer;
+        timer.start();
+        job.task->run();
+        const double run_ms = timer.nsecsElapsed() / 1e6;
+        if (job.task->autoDelete()) {
+            delete job.task;
+        }
+
+        locker.relock();
+        finish(job, wait_ms, run_ms);
+    }
+}
+
+void JobScheduler::finish(const Job &job, double wait_ms, double run_ms) {
+    // 调用时已持有 m_mutex
+    --job.group->running;
+    --job.group->pending;
+    Counters &counters = m_counters[job.group->priority];
+    ++counters.finished;
+    counters.wait_ms += wait_ms;
+    counters.run_ms += run_ms;
+    counters.max_wait_ms = qMax(counters.max_wait_ms, wait_ms);
+    m_finished.wakeAll();
+}
+
+int JobScheduler::max_running(const QSharedPointer<GroupState> &group) const {
+    QMutexLocker locker(&m_mutex);
+    return qMin(group->max_running, m_limits[group->priority]);
+}
+
+void JobScheduler::dispatch() {
+    // 调用时已持有 m_mutex；没有可运行任务的工作线程会直接退出
+    while (m_workers < m_threads) {
+        ++m_workers;
+        m_pool.start(new Worker(this));
+    }
+}
+
+bool JobScheduler::take(Job *job) {
+    // 调用时已持有 m_mutex
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        if (m_classRunning[priority] >= m_limits[priority]) {
+            continue;
+        }
+        // 保留一个线程给当前图片与相邻图片
+        if (priority > Neighbour && m_threads > 1 && m_running >= m_threads - 1) {
+            continue;
+        }
+        std::deque<Job> &queue = m_queues[priority];
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->group->running >= it->group->max_running) {
+                continue;
+            }
+            *job = *it;
+            queue.erase(it);
+            ++m_running;
+            ++m_classRunning[priority];
+            ++job->group->running;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobScheduler::run_worker() {
+    QMutexLocker locker(&m_mutex);
+    Job job;
+    while (take(&job)) {
+        const Priority priority = job.group->priority;
+        const double wait_ms = job.queued.nsecsElapsed() / 1e6;
+        locker.unlock();
+
+        QElapsedTimer timer;
+        timer.start();
+        job.task->run();
+        const double run_ms = timer.nsecsElapsed() / 1e6;
+        if (job.task->autoDelete()) {
+            delete job.task;
+        }
+
+        locker.relock();
+        --m_running;
+        --m_classRunning[priority];
+        finish(job, wait_ms, run_ms);
+        job.group.reset();
+    }
+    --m_workers;
+}
+
+JobGroup::JobGroup(JobScheduler::Priority priority)
+    : m_state(new JobScheduler::GroupState{priority, std::numeric_limits<int>::max(), 0, 0}) {
+}
+
+JobGroup::~JobGroup() {
+    clear();
+    wait();
+}
+
+JobScheduler::Priority JobGroup::priority() const {
+    return m_state->priority;
+}
+
+void JobGroup::set_max_running(int count) {
+    JobScheduler *scheduler = JobScheduler::instance();
+    QMutexLocker locker(&scheduler->m_mutex);
+    m_state->max_running = qMax(1, count);
+    scheduler->dispatch();
+}
+
+int JobGroup::max_running() const {
+    return JobScheduler::instance()->max_running(m_state);
+}
+
+void JobGroup::start(QRunnable *task, int order) {
+    JobScheduler::instance()->submit(m_state, task, order);
+}
+
+void JobGroup::start(std::function<void()> function, int order) {
+    start(new FunctionJob(std::move(function)), order);
+}
+
+void JobGroup::clear() {
+    JobScheduler::instance()->cancel(m_state);
+}
+
+void JobGroup::wait() {
+    JobScheduler::instance()->wait(m_state);
+}
+
+void JobGroup::run_pending() {
+    JobScheduler::instance()->run_pending(m_state);
+}
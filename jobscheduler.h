@@ -0,0 +1,127 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+
+// 后台任务调度器
+// 所有后台任务共用一组线程（数量为 CPU 核数），按优先级类别取任务：
+// 当前图片 > 相邻图片 > 可见缩略图 > 扫描与索引 > 导出等其他任务。
+// 每个类别有同时运行的任务数上限；线程多于一个时保留一个线程给当前图片与相邻图片，
+// 低优先级的长任务不会让当前图片等待。任务不可抢占，已开始的任务会运行完。
+// 任务通过 JobGroup 提交，JobGroup 取消排队中的任务并等待正在运行的任务。
+class JobScheduler {
+public:
+    enum Priority {
+        CurrentImage,
+        Neighbour,
+        Thumbnail,
+        Indexing,
+        Background,
+        PriorityCount
+    };
+
+    struct Stats {
+        int queued;
+        int running;
+        int limit;
+        qint64 finished;
+        double wait_ms;    // 平均排队时间
+        double run_ms;     // 平均运行时间
+        double max_wait_ms;
+    };
+
+    static JobScheduler *instance();
+    static QString priority_name(Priority priority);
+
+    int thread_count() const;
+    void set_limit(Priority priority, int limit);
+    int limit(Priority priority) const;
+
+    QVector<Stats> stats() const;
+    void reset_stats();
+
+private:
+    friend class JobGroup;
+    class Worker;
+
+    struct GroupState {
+        Priority priority;
+        int max_running;
+        int pending;       // 排队与正在运行的任务
+        int running;
+    };
+
+    struct Job {
+        QRunnable *task;
+        int order;
+        QSharedPointer<GroupState> group;
+        QElapsedTimer queued;
+    };
+
+    struct Counters {
+        qint64 finished;
+        double wait_ms;
+        double run_ms;
+        double max_wait_ms;
+    };
+
+    JobScheduler();
+    ~JobScheduler();
+
+    void submit(const QSharedPointer<GroupState> &group, QRunnable *task, int order);
+    void cancel(const QSharedPointer<GroupState> &group);
+    void wait(const QSharedPointer<GroupState> &group);
+    void run_pending(const QSharedPointer<GroupState> &group);
+    int max_running(const QSharedPointer<GroupState> &group) const;
+
+    void run_worker();
+    bool take(Job *job);
+    void finish(const Job &job, double wait_ms, double run_ms);
+    void dispatch();
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_finished;
+    QThreadPool m_pool;
+    int m_threads;
+    int m_workers;             // 正在取任务的工作线程
+    int m_running;
+    std::deque<Job> m_queues[PriorityCount];
+    int m_classRunning[PriorityCount];
+    int m_limits[PriorityCount];
+    Counters m_counters[PriorityCount];
+};
+
+// 一组后台任务，通常属于同一个对象
+// 接口与 QThreadPool 相同：start 提交任务，order 大的先运行；clear 取消排队中的任务，
+// 正在运行的任务用各自的 generation 丢弃过期结果；析构时取消并等待所有任务结束。
+class JobGroup {
+public:
+    explicit JobGroup(JobScheduler::Priority priority);
+    ~JobGroup();
+
+    JobScheduler::Priority priority() const;
+    // 本组同时运行的任务数上限，默认只受类别上限限制
+    void set_max_running(int count);
+    int max_running() const;
+
+    void start(QRunnable *task, int order = 0);
+    void start(std::function<void()> function, int order = 0);
+    void clear();
+    void wait();
+    // 在调用线程中运行本组还在排队的任务，等待前调用可避免排队任务让调用线程空等
+    void run_pending();
+
+private:
+    Q_DISABLE_COPY(JobGroup)
+    QSharedPointer<JobScheduler::GroupState> m_state;
+};
+
+#endif // JOBSCHEDULER_H
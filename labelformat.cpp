@@ -0,0 +1,530 @@
+#include "labelformat.h"
+#include "labelstore.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QPolygonF>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+namespace {
+// YOLO 格式：每张图片一个 txt 文件，坐标按图片尺寸归一化
+// 矩形: class_id x_center y_center width height
+// 多边形: class_id x1 y1 x2 y2 ... xn yn
+class YoloFormat : public LabelFormat {
+public:
+    QString id() const override { return "yolo"; }
+    QString name() const override { return "YOLO (txt)"; }
+    QString label_path(const QString &image_path) const override { return base_path(image_path) + ".txt"; }
+    bool normalized_coordinates() const override { return true; }
+
+    bool read(const QString &image_path, const QSize &image_size,
+              QStringList *classes, QList<LabelShape> *shapes) const override {
+        Q_UNUSED(classes)
+        QFile file(label_path(image_path));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return false;
+        }
+
+        const double img_w = image_size.width();
+        const double img_h = image_size.height();
+        QTextStream in(&file);
+        while (!in.atEnd()) {
+            QStringList parts = in.readLine().split(" ", Qt::SkipEmptyParts);
+            if (parts.size() < 5) {
+                continue;
+            }
+
+            LabelShape shape;
+            shape.class_id = parts[0].toInt();
+            if (parts.size() == 5) {
+                double width = parts[3].toDouble() * img_w;
+                double height = parts[4].toDouble() * img_h;
+                double x = parts[1].toDouble() * img_w - width / 2;
+                double y = parts[2].toDouble() * img_h - height / 2;
+                shape.box = QRectF(x, y, width, height);
+            } else if (parts.size() % 2 == 1) {
+                for (int i = 1; i < parts.size(); i += 2) {
+                    shape.points.append(QPointF(parts[i].toDouble() * img_w, parts[i + 1].toDouble() * img_h));
+                }
+                if (shape.points.size() < 3) {
+                    continue;
+                }
+                shape.box = QPolygonF(shape.points).boundingRect();
+            } else {
+                continue;
+            }
+            shapes->append(shape);
+        }
+        return true;
+    }
+
+    bool write(const QString &image_path, const QSize &image_size,
+               const QStringList &classes, const QList<LabelShape> &shapes) const override {
+        Q_UNUSED(classes)
+        QString path = label_path(image_path);
+        if (shapes.isEmpty()) {
+            QFile::remove(path);
+            return true;
+        }
+
+        // 先写入临时文件再替换，写入失败时保留原标注
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            return false;
+        }
+
+        const int img_w = image_size.width();
+        const int img_h = image_size.height();
+        QTextStream out(&file);
+        for (const LabelShape &shape: shapes) {
+            out << shape.class_id;
+            if (shape.is_polygon()) {
+                for (const QPointF &point: shape.points) {
+                    out << " " << QString::number(point.x() / img_w, 'f', 6)
+                        << " " << QString::number(point.y() / img_h, 'f', 6);
+                }
+            } else {
+                out << " " << QString::number((shape.box.x() + shape.box.width() / 2.0) / img_w, 'f', 6)
+                    << " " << QString::number((shape.box.y() + shape.box.height() / 2.0) / img_h, 'f', 6)
+                    << " " << QString::number(shape.box.width() / img_w, 'f', 6)
+                    << " " << QString::number(shape.box.height() / img_h, 'f', 6);
+            }
+            out << "\n";
+        }
+        out.flush();
+        return out.status() == QTextStream::Ok && file.commit();
+    }
+};
+
+// Pascal VOC 格式：每张图片一个 xml 文件，像素坐标
+// 多边形额外写入 <polygon><x1/><y1/>...</polygon>，同时保留外接矩形 <bndbox>
+class VocFormat : public LabelFormat {
+public:
+    QString id() const override { return "voc"; }
+    QString name() const override { return "Pascal VOC (xml)"; }
+    QString label_path(const QString &image_path) const override { return base_path(image_path) + ".xml"; }
+
+    bool read(const QString &image_path, const QSize &image_size,
+              QStringList *classes, QList<LabelShape> *shapes) const override {
+        Q_UNUSED(image_size)
+        QFile file(label_path(image_path));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QXmlStreamReader xml(&file);
+        while (xml.readNextStartElement()) {
+            if (xml.name() != QLatin1String("annotation")) {
+                xml.skipCurrentElement();
+                continue;
+            }
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("object")) {
+                    read_object(&xml, classes, shapes);
+                } else {
+                    xml.skipCurrentElement();
+                }
+            }
+        }
+        return !xml.hasError();
+    }
+
+    bool write(const QString &image_path, const QSize &image_size,
+               const QStringList &classes, const QList<LabelShape> &shapes) const override {
+        QString path = label_path(image_path);
+        if (shapes.isEmpty()) {
+            QFile::remove(path);
+            return true;
+        }
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        QFileInfo info(image_path);
+        QXmlStreamWriter xml(&file);
+        xml.setAutoFormatting(true);
+        xml.writeStartDocument();
+        xml.writeStartElement("annotation");
+        xml.writeTextElement("folder", info.dir().dirName());
+        xml.writeTextElement("filename", info.fileName());
+        xml.writeStartElement("size");
+        xml.writeTextElement("width", QString::number(image_size.width()));
+        xml.writeTextElement("height", QString::number(image_size.height()));
+        xml.writeTextElement("depth", "3");
+        xml.writeEndElement();
+        xml.writeTextElement("segmented", "0");
+
+        for (const LabelShape &shape: shapes) {
+            xml.writeStartElement("object");
+            xml.writeTextElement("name", class_name(classes, shape.class_id));
+            xml.writeTextElement("pose", "Unspecified");
+            xml.writeTextElement("truncated", "0");
+            xml.writeTextElement("difficult", "0");
+            xml.writeStartElement("bndbox");
+            xml.writeTextElement("xmin", QString::number(shape.box.left()));
+            xml.writeTextElement("ymin", QString::number(shape.box.top()));
+            xml.writeTextElement("xmax", QString::number(shape.box.left() + shape.box.width()));
+            xml.writeTextElement("ymax", QString::number(shape.box.top() + shape.box.height()));
+            xml.writeEndElement();
+            if (shape.is_polygon()) {
+                xml.writeStartElement("polygon");
+                for (int i = 0; i < shape.points.size(); ++i) {
+                    xml.writeTextElement(QString("x%1").arg(i + 1), QString::number(shape.points.at(i).x()));
+                    xml.writeTextElement(QString("y%1").arg(i + 1), QString::number(shape.points.at(i).y()));
+                }
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+        }
+
+        xml.writeEndElement();
+        xml.writeEndDocument();
+        return !xml.hasError() && file.commit();
+    }
+
+private:
+    static void read_object(QXmlStreamReader *xml, QStringList *classes, QList<LabelShape> *shapes) {
+        LabelShape shape;
+        QString name;
+        double xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+        bool has_box = false;
+        QMap<int, QPointF> points;
+
+        while (xml->readNextStartElement()) {
+            if (xml->name() == QLatin1String("name")) {
+                name = xml->readElementText().trimmed();
+            } else if (xml->name() == QLatin1String("bndbox")) {
+                while (xml->readNextStartElement()) {
+                    double value = xml->readElementText().toDouble();
+                    if (xml->name() == QLatin1String("xmin")) {
+                        xmin = value;
+                    } else if (xml->name() == QLatin1String("ymin")) {
+                        ymin = value;
+                    } else if (xml->name() == QLatin1String("xmax")) {
+                        xmax = value;
+                    } else if (xml->name() == QLatin1String("ymax")) {
+                        ymax = value;
+                    }
+                }
+                has_box = true;
+            } else if (xml->name() == QLatin1String("polygon")) {
+                // x1 y1 x2 y2 ... 按序号组成顶点
+                while (xml->readNextStartElement()) {
+                    QString tag = xml->name().toString();
+                    double value = xml->readElementText().toDouble();
+                    int index = tag.mid(1).toInt();
+                    if (index <= 0) {
+                        continue;
+                    }
+                    if (tag.startsWith('x')) {
+                        points[index].setX(value);
+                    } else if (tag.startsWith('y')) {
+                        points[index].setY(value);
+                    }
+                }
+            } else {
+                xml->skipCurrentElement();
+            }
+        }
+
+        if (name.isEmpty()) {
+            return;
+        }
+        shape.class_id = class_id(classes, name);
+        if (points.size() >= 3) {
+            shape.points = points.values().toVector();
+            shape.box = QPolygonF(shape.points).boundingRect();
+        } else if (has_box) {
+            shape.box = QRectF(xmin, ymin, xmax - xmin, ymax - ymin);
+        } else {
+            return;
+        }
+        shapes->append(shape);
+    }
+};
+
+// LabelMe 格式：每张图片一个 json 文件，像素坐标
+class LabelMeFormat : public LabelFormat {
+public:
+    QString id() const override { return "labelme"; }
+    QString name() const override { return "LabelMe (json)"; }
+    QString label_path(const QString &image_path) const override { return base_path(image_path) + ".json"; }
+
+    bool read(const QString &image_path, const QSize &image_size,
+              QStringList *classes, QList<LabelShape> *shapes) const override {
+        Q_UNUSED(image_size)
+        QFile file(label_path(image_path));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+        if (!document.isObject()) {
+            return false;
+        }
+
+        const QJsonArray items = document.object().value("shapes").toArray();
+        for (const QJsonValue &item: items) {
+            QJsonObject object = item.toObject();
+            QString type = object.value("shape_type").toString("polygon");
+            const QJsonArray point_array = object.value("points").toArray();
+            QVector<QPointF> points;
+            for (const QJsonValue &point: point_array) {
+                QJsonArray xy = point.toArray();
+                points.append(QPointF(xy.at(0).toDouble(), xy.at(1).toDouble()));
+            }
+
+            LabelShape shape;
+            if (type == "rectangle" && points.size() == 2) {
+                shape.box = QRectF(points.at(0), points.at(1)).normalized();
+            } else if (type == "polygon" && points.size() >= 3) {
+                shape.points = points;
+                shape.box = QPolygonF(points).boundingRect();
+            } else {
+                continue;
+            }
+            shape.class_id = class_id(classes, object.value("label").toString().trimmed());
+            shapes->append(shape);
+        }
+        return true;
+    }
+
+    bool write(const QString &image_path, const QSize &image_size,
+               const QStringList &classes, const QList<LabelShape> &shapes) const override {
+        QString path = label_path(image_path);
+        if (shapes.isEmpty()) {
+            QFile::remove(path);
+            return true;
+        }
+
+        QJsonArray items;
+        for (const LabelShape &shape: shapes) {
+            QJsonArray points;
+            if (shape.is_polygon()) {
+                for (const QPointF &point: shape.points) {
+                    points.append(QJsonArray{point.x(), point.y()});
+                }
+            } else {
+                points.append(QJsonArray{shape.box.left(), shape.box.top()});
+                points.append(QJsonArray{shape.box.right(), shape.box.bottom()});
+            }
+
+            QJsonObject object;
+            object["label"] = class_name(classes, shape.class_id);
+            object["points"] = points;
+            object["group_id"] = QJsonValue::Null;
+            object["shape_type"] = shape.is_polygon() ? "polygon" : "rectangle";
+            object["flags"] = QJsonObject();
+            items.append(object);
+        }
+
+        QJsonObject root;
+        root["version"] = "5.0.1";
+        root["flags"] = QJsonObject();
+        root["shapes"] = items;
+        root["imagePath"] = QFileInfo(image_path).fileName();
+        root["imageData"] = QJsonValue::Null;
+        root["imageHeight"] = image_size.height();
+        root["imageWidth"] = image_size.width();
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Indented);
+        return file.write(data) == data.size() && file.commit();
+    }
+};
+
+// 二进制容器：每个文件夹一个 labels.bin，通过内存映射读取，见 LabelStore
+class BinaryFormat : public LabelFormat {
+public:
+    QString id() const override { return "yolo-bin"; }
+    QString name() const override { return "YOLO 二进制 (labels.bin)"; }
+    QString label_path(const QString &image_path) const override {
+        return LabelStore::container_path(QFileInfo(image_path).absolutePath());
+    }
+    bool per_image_files() const override { return false; }
+    bool normalized_coordinates() const override { return true; }
+    // 容器文件由所有图片共用，按图片记录的内容计算校验值
+    qint64 label_stamp(const QString &image_path) const override {
+        QFileInfo info(image_path);
+        return LabelStore::open(info.absolutePath())->stamp(info.fileName());
+    }
+
+    bool read(const QString &image_path, const QSize &image_size,
+              QStringList *classes, QList<LabelShape> *shapes) const override {
+        Q_UNUSED(classes)
+        QFileInfo info(image_path);
+        return LabelStore::open(info.absolutePath())->read(info.fileName(), image_size, shapes);
+    }
+
+    bool write(const QString &image_path, const QSize &image_size,
+               const QStringList &classes, const QList<LabelShape> &shapes) const override {
+        Q_UNUSED(classes)
+        QFileInfo info(image_path);
+        return LabelStore::open(info.absolutePath())->write(info.fileName(), image_size, shapes);
+    }
+};
+
+// 按文件夹保存的格式选择缓存，工作线程也会读取
+QReadWriteLock folder_formats_lock;
+QHash<QString, QString> folder_formats;
+}
+
+QList<const LabelFormat *> LabelFormat::formats() {
+    static const YoloFormat yolo;
+    static const VocFormat voc;
+    static const LabelMeFormat labelme;
+    static const BinaryFormat binary;
+    static const QList<const LabelFormat *> registry = {&yolo, &voc, &labelme, &binary};
+    return registry;
+}
+
+const LabelFormat *LabelFormat::format(const QString &id) {
+    for (const LabelFormat *format: formats()) {
+        if (format->id() == id) {
+            return format;
+        }
+    }
+    return nullptr;
+}
+
+const LabelFormat *LabelFormat::default_format() {
+    return formats().first();
+}
+
+const LabelFormat *LabelFormat::folder_format(const QString &folder) {
+    {
+        QReadLocker locker(&folder_formats_lock);
+        auto it = folder_formats.constFind(folder);
+        if (it != folder_formats.constEnd()) {
+            const LabelFormat *cached = format(it.value());
+            return cached ? cached : default_format();
+        }
+    }
+
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    QString id = settings.value("label_formats").toMap().value(folder).toString();
+    {
+        QWriteLocker locker(&folder_formats_lock);
+        folder_formats.insert(folder, id);
+    }
+    const LabelFormat *selected = format(id);
+    return selected ? selected : default_format();
+}
+
+void LabelFormat::set_folder_format(const QString &folder, const QString &id) {
+    {
+        QWriteLocker locker(&folder_formats_lock);
+        folder_formats.insert(folder, id);
+    }
+
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    QVariantMap folder_ids = settings.value("label_formats").toMap();
+    folder_ids.insert(folder, id);
+    settings.setValue("label_formats", folder_ids);
+}
+
+bool LabelFormat::save_classes(const QString &folder, const QStringList &classes) {
+    QSaveFile file(folder + "/classes.txt");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    for (const QString &class_name: classes) {
+        out << class_name << "\n";
+    }
+    out.flush();
+    return file.commit();
+}
+
+qint64 LabelFormat::label_stamp(const QString &image_path) const {
+    QFileInfo info(label_path(image_path));
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+QString LabelFormat::base_path(const QString &image_path) {
+    QFileInfo info(image_path);
+    return info.absolutePath() + "/" + info.completeBaseName();
+}
+
+QString LabelFormat::class_name(const QStringList &classes, int class_id) {
+    return class_id >= 0 && class_id < classes.size() ? classes.at(class_id) : QString::number(class_id);
+}
+
+int LabelFormat::class_id(QStringList *classes, const QString &name) {
+    int id = classes->indexOf(name);
+    if (id >= 0) {
+        return id;
+    }
+
+    // 写入时未知类别使用序号作为名称
+    bool is_number = false;
+    int number = name.toInt(&is_number);
+    if (is_number && number >= 0) {
+        return number;
+    }
+    classes->append(name);
+    return classes->size() - 1;
+}
+
+ClassRegistry::ClassRegistry(const QString &folder, const QStringList &classes)
+    : m_folder(folder), m_classes(classes) {
+}
+
+bool ClassRegistry::read(const LabelFormat *format, const QString &image_path, const QSize &image_size,
+                         QStringList *classes, QList<LabelShape> *shapes) {
+    QStringList known = this->classes();
+    const int base = known.size();
+    if (!format->read(image_path, image_size, &known, shapes)) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (known.size() > base) {
+        // 本文件追加的名称可能已由其他文件加入，按名称换成共用类别表中的序号
+        QVector<int> ids(known.size() - base);
+        bool added = false;
+        for (int i = base; i < known.size(); ++i) {
+            int id = m_classes.indexOf(known.at(i));
+            if (id < 0) {
+                m_classes.append(known.at(i));
+                id = m_classes.size() - 1;
+                added = true;
+            }
+            ids[i - base] = id;
+        }
+        for (LabelShape &shape: *shapes) {
+            if (shape.class_id >= base && shape.class_id < known.size()) {
+                shape.class_id = ids.at(shape.class_id - base);
+            }
+        }
+        if (added && !LabelFormat::save_classes(m_folder, m_classes)) {
+            qWarning() << "无法保存类别文件:" << m_folder + "/classes.txt";
+        }
+    }
+    if (classes) {
+        *classes = m_classes;
+    }
+    return true;
+}
+
+QStringList ClassRegistry::classes() const {
+    QMutexLocker locker(&m_mutex);
+    return m_classes;
+}
@@ -0,0 +1,81 @@
+#ifndef LABELFORMAT_H
+#define LABELFORMAT_H
+
+#include <QList>
+#include <QMutex>
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 一个标注对象，坐标为图片像素坐标
+struct LabelShape {
+    int class_id = 0;
+    QRectF box;               // 矩形；多边形时为外接矩形
+    QVector<QPointF> points;  // 多边形顶点，矩形为空
+
+    bool is_polygon() const { return !points.isEmpty(); }
+};
+
+// 标注文件格式
+// 每种格式负责标注文件路径与读写，注册后可按文件夹选择。
+// 读写函数不依赖界面，可在工作线程中调用。
+class LabelFormat {
+public:
+    virtual ~LabelFormat() = default;
+
+    virtual QString id() const = 0;    // 保存到设置中的标识，例如 "yolo"
+    virtual QString name() const = 0;  // 显示名称
+    virtual QString label_path(const QString &image_path) const = 0;
+    // 为 false 时 label_path 是文件夹内所有图片共用的文件，不能按图片移动或删除
+    virtual bool per_image_files() const { return true; }
+    // 为 true 时坐标按图片尺寸归一化保存，图片缩放后标注不需要修改
+    virtual bool normalized_coordinates() const { return false; }
+    // 图片标注的校验值，标注改变后随之改变，没有标注时为 0；默认为标注文件的修改时间
+    virtual qint64 label_stamp(const QString &image_path) const;
+
+    // classes 用于类别名称与序号的转换，读取时遇到未知的类别名称会追加到末尾
+    virtual bool read(const QString &image_path, const QSize &image_size,
+                      QStringList *classes, QList<LabelShape> *shapes) const = 0;
+    // 没有标注时删除标注文件
+    virtual bool write(const QString &image_path, const QSize &image_size,
+                       const QStringList &classes, const QList<LabelShape> &shapes) const = 0;
+
+    // 格式注册表
+    static QList<const LabelFormat *> formats();
+    static const LabelFormat *format(const QString &id);
+    static const LabelFormat *default_format();
+
+    // 按文件夹保存的格式选择，未设置时为 YOLO
+    static const LabelFormat *folder_format(const QString &folder);
+    static void set_folder_format(const QString &folder, const QString &id);
+    // 文件夹的 classes.txt，每行一个类别名称
+    static bool save_classes(const QString &folder, const QStringList &classes);
+
+protected:
+    static QString base_path(const QString &image_path);
+    static QString class_name(const QStringList &classes, int class_id);
+    static int class_id(QStringList *classes, const QString &name);
+};
+
+// 多个工作线程共用的类别表
+// 按名称保存的格式（VOC、LabelMe）中出现 classes.txt 没有的名称时，所有文件统一分配序号，
+// 并在返回读取结果（之后才会写出使用该序号的标注）之前追加保存到 classes.txt。
+class ClassRegistry {
+public:
+    ClassRegistry(const QString &folder, const QStringList &classes);
+
+    // 与 LabelFormat::read 相同，shapes 中的新类别按共用类别表编号，classes 返回当前的完整类别表
+    bool read(const LabelFormat *format, const QString &image_path, const QSize &image_size,
+              QStringList *classes, QList<LabelShape> *shapes);
+    QStringList classes() const;
+
+private:
+    mutable QMutex m_mutex;
+    QString m_folder;
+    QStringList m_classes;
+};
+
+#endif // LABELFORMAT_H
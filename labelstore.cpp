@@ -0,0 +1,470 @@
+#include "labelstore.h"
+#include <QDir>
+#include <QMutex>
+#include <QPolygonF>
+#include <QSaveFile>
+#include <QVector>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'I', 'L', 'B', 'L'};
+const quint32 kVersion = 1;
+// 日志超过该大小且超过容器大小时自动合并，保证重写的总量与数据量成正比
+const qint64 kJournalLimit = 16 << 20;
+
+// 已打开的容器，每个文件夹一个，映射保持到程序退出
+QMutex stores_mutex;
+QHash<QString, QSharedPointer<LabelStore>> stores;
+
+// 每个标注：qint32 类别ID, quint32 顶点数, 之后为 float32 坐标
+// 顶点数为 0 表示矩形 (x_center, y_center, width, height)，否则为多边形 (x1, y1, ..., xn, yn)
+void append_u32(QByteArray *data, quint32 value) {
+    data->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void append_float(QByteArray *data, double value) {
+    float f = static_cast<float>(value);
+    data->append(reinterpret_cast<const char *>(&f), sizeof(f));
+}
+
+quint32 read_u32(const uchar *p) {
+    quint32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+float read_float(const uchar *p) {
+    float value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+int compare_names(const char *lhs, int lhs_size, const char *rhs, int rhs_size) {
+    int result = std::memcmp(lhs, rhs, static_cast<size_t>(qMin(lhs_size, rhs_size)));
+    return result != 0 ? result : lhs_size - rhs_size;
+}
+}
+
+LabelStore::LabelStore(const QString &dir)
+    : m_dir(dir), m_base(nullptr), m_size(0), m_header(nullptr), m_journalSize(0) {
+}
+
+LabelStore::~LabelStore() {
+    unmap_container();
+}
+
+QSharedPointer<LabelStore> LabelStore::open(const QString &dir) {
+    QString key = QDir::cleanPath(dir);
+    QMutexLocker locker(&stores_mutex);
+    QSharedPointer<LabelStore> store = stores.value(key);
+    if (store) {
+        return store;
+    }
+
+    store = QSharedPointer<LabelStore>(new LabelStore(key));
+    store->map_container();
+    store->replay_journal();
+    stores.insert(key, store);
+    return store;
+}
+
+QString LabelStore::container_path(const QString &dir) {
+    return dir + "/labels.bin";
+}
+
+void LabelStore::flush_all() {
+    QList<QSharedPointer<LabelStore>> opened;
+    {
+        QMutexLocker locker(&stores_mutex);
+        opened = stores.values();
+    }
+    for (const QSharedPointer<LabelStore> &store: opened) {
+        store->compact();
+    }
+}
+
+bool LabelStore::contains(const QString &name) const {
+    QReadLocker locker(&m_lock);
+    const uchar *data = nullptr;
+    quint32 size = 0;
+    quint32 shape_count = 0;
+    return lookup(name.toUtf8(), &data, &size, &shape_count) && shape_count > 0;
+}
+
+qint64 LabelStore::stamp(const QString &name) const {
+    QReadLocker locker(&m_lock);
+    const uchar *data = nullptr;
+    quint32 size = 0;
+    quint32 shape_count = 0;
+    if (!lookup(name.toUtf8(), &data, &size, &shape_count) || shape_count == 0) {
+        return 0;
+    }
+    const uint hash = qHashBits(data, size, shape_count);
+    return (static_cast<qint64>(size) << 32 | hash) | 1;
+}
+
+bool LabelStore::read(const QString &name, const QSize &image_size, QList<LabelShape> *shapes) const {
+    QReadLocker locker(&m_lock);
+    const uchar *data = nullptr;
+    quint32 size = 0;
+    quint32 shape_count = 0;
+    if (!lookup(name.toUtf8(), &data, &size, &shape_count)) {
+        return true;
+    }
+    return decode(data, size, shape_count, image_size, shapes);
+}
+
+bool LabelStore::write(const QString &name, const QSize &image_size, const QList<LabelShape> &shapes) {
+    if (!shapes.isEmpty() && image_size.isEmpty()) {
+        return false;
+    }
+
+    QByteArray key = name.toUtf8();
+    Pending pending;
+    pending.shape_count = static_cast<quint32>(shapes.size());
+    pending.data = encode(image_size, shapes);
+
+    QWriteLocker locker(&m_lock);
+    // 没有变化时不写日志
+    const uchar *data = nullptr;
+    quint32 size = 0;
+    quint32 shape_count = 0;
+    bool found = lookup(key, &data, &size, &shape_count);
+    if ((!found && shapes.isEmpty()) ||
+        (found && shape_count == pending.shape_count && size == static_cast<quint32>(pending.data.size()) &&
+         std::memcmp(data, pending.data.constData(), size) == 0)) {
+        return true;
+    }
+
+    if (!m_journal.isOpen()) {
+        m_journal.setFileName(container_path(m_dir) + ".journal");
+        if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "无法写入标注日志:" << m_journal.fileName();
+            return false;
+        }
+    }
+
+    // 日志记录：quint32 文件名长度, 文件名, quint32 标注数量, quint32 数据长度, 数据
+    QByteArray record;
+    append_u32(&record, static_cast<quint32>(key.size()));
+    record.append(key);
+    append_u32(&record, pending.shape_count);
+    append_u32(&record, static_cast<quint32>(pending.data.size()));
+    record.append(pending.data);
+    if (m_journal.write(record) != record.size() || !m_journal.flush()) {
+        qWarning() << "无法写入标注日志:" << m_journal.fileName();
+        return false;
+    }
+    m_journalSize += record.size();
+
+    m_pending.insert(key, pending);
+    if (m_journalSize > kJournalLimit && m_journalSize > m_size) {
+        return compact_locked();
+    }
+    return true;
+}
+
+bool LabelStore::compact() {
+    QWriteLocker locker(&m_lock);
+    return compact_locked();
+}
+
+bool LabelStore::compact_locked() {
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+
+    // 合并容器中未修改的记录与日志中的记录，按文件名排序
+    struct Item {
+        QByteArray name;
+        const uchar *data;
+        quint32 size;
+        quint32 shape_count;
+    };
+    QVector<Item> items;
+    const quint32 count = m_header ? m_header->count : 0;
+    items.reserve(static_cast<int>(count) + m_pending.size());
+    if (m_header) {
+        const Entry *entries = reinterpret_cast<const Entry *>(m_base + sizeof(Header));
+        for (quint32 i = 0; i < count; ++i) {
+            const Entry &entry = entries[i];
+            const char *name_data = nullptr;
+            int name_size = 0;
+            // 损坏的记录丢弃
+            if (!entry_name(entry, &name_data, &name_size) ||
+                entry.data_offset > static_cast<quint64>(m_size) - m_header->data_offset ||
+                entry.data_size > static_cast<quint64>(m_size) - m_header->data_offset - entry.data_offset) {
+                continue;
+            }
+            QByteArray name = QByteArray::fromRawData(name_data, name_size);
+            if (m_pending.contains(name)) {
+                continue;
+            }
+            items.append({name, m_base + m_header->data_offset + entry.data_offset, entry.data_size,
+                          entry.shape_count});
+        }
+    }
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        if (it->shape_count > 0) {
+            items.append({it.key(), reinterpret_cast<const uchar *>(it->data.constData()),
+                          static_cast<quint32>(it->data.size()), it->shape_count});
+        }
+    }
+    std::sort(items.begin(), items.end(), [](const Item &lhs, const Item &rhs) {
+        return compare_names(lhs.name.constData(), lhs.name.size(), rhs.name.constData(), rhs.name.size()) < 0;
+    });
+
+    QVector<Entry> entries(items.size());
+    QByteArray names;
+    quint64 data_size = 0;
+    for (int i = 0; i < items.size(); ++i) {
+        entries[i].name_offset = static_cast<quint32>(names.size());
+        entries[i].name_size = static_cast<quint32>(items.at(i).name.size());
+        entries[i].data_offset = data_size;
+        entries[i].data_size = items.at(i).size;
+        entries[i].shape_count = items.at(i).shape_count;
+        names.append(items.at(i).name);
+        data_size += items.at(i).size;
+    }
+    // 数据区按 8 字节对齐
+    while (names.size() % 8 != 0) {
+        names.append('\0');
+    }
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = static_cast<quint32>(items.size());
+    header.reserved = 0;
+    header.names_offset = sizeof(Header) + static_cast<quint64>(entries.size()) * sizeof(Entry);
+    header.data_offset = header.names_offset + static_cast<quint64>(names.size());
+
+    QSaveFile output(container_path(m_dir));
+    if (!output.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法写入标注容器:" << output.fileName();
+        return false;
+    }
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(entries.constData()),
+                 static_cast<qint64>(entries.size()) * sizeof(Entry));
+    output.write(names);
+    for (const Item &item: items) {
+        output.write(reinterpret_cast<const char *>(item.data), item.size);
+    }
+
+    // 写完后才能释放旧的映射，items 中的数据指向它
+    items.clear();
+    unmap_container();
+    if (!output.commit()) {
+        qWarning() << "无法写入标注容器:" << output.fileName();
+        map_container();
+        return false;
+    }
+
+    m_journal.close();
+    QFile::remove(container_path(m_dir) + ".journal");
+    m_journalSize = 0;
+    m_pending.clear();
+    return map_container();
+}
+
+bool LabelStore::map_container() {
+    m_file.setFileName(container_path(m_dir));
+    if (!m_file.exists()) {
+        return true;
+    }
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法打开标注容器:" << m_file.fileName();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_base = m_size >= static_cast<qint64>(sizeof(Header)) ? m_file.map(0, m_size) : nullptr;
+    const Header *header = reinterpret_cast<const Header *>(m_base);
+    if (!m_base || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion ||
+        header->names_offset != sizeof(Header) + static_cast<quint64>(header->count) * sizeof(Entry) ||
+        header->data_offset < header->names_offset || header->data_offset > static_cast<quint64>(m_size)) {
+        qWarning() << "标注容器格式错误:" << m_file.fileName();
+        unmap_container();
+        return false;
+    }
+    m_header = header;
+    return true;
+}
+
+void LabelStore::unmap_container() {
+    if (m_base) {
+        m_file.unmap(const_cast<uchar *>(m_base));
+    }
+    m_file.close();
+    m_base = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+bool LabelStore::replay_journal() {
+    QFile journal(container_path(m_dir) + ".journal");
+    if (!journal.exists()) {
+        return true;
+    }
+    if (!journal.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // 日志按写入顺序重放，同一图片以最后一条为准；末尾不完整的记录丢弃
+    QByteArray data = journal.readAll();
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+    int pos = 0;
+    while (pos + 4 <= size) {
+        quint32 name_size = read_u32(p + pos);
+        if (pos + 12 + static_cast<qint64>(name_size) > size) {
+            break;
+        }
+        QByteArray name(data.constData() + pos + 4, static_cast<int>(name_size));
+        Pending pending;
+        pending.shape_count = read_u32(p + pos + 4 + name_size);
+        quint32 data_size = read_u32(p + pos + 8 + name_size);
+        int data_pos = pos + 12 + static_cast<int>(name_size);
+        if (data_pos + static_cast<qint64>(data_size) > size) {
+            break;
+        }
+        pending.data = data.mid(data_pos, static_cast<int>(data_size));
+        m_pending.insert(name, pending);
+        pos = data_pos + static_cast<int>(data_size);
+    }
+    m_journalSize = pos;
+    return true;
+}
+
+bool LabelStore::entry_name(const Entry &entry, const char **name, int *size) const {
+    // 文件名必须位于文件名区内
+    const quint64 names_size = m_header->data_offset - m_header->names_offset;
+    if (entry.name_offset > names_size || entry.name_size > names_size - entry.name_offset) {
+        return false;
+    }
+    *name = reinterpret_cast<const char *>(m_base + m_header->names_offset + entry.name_offset);
+    *size = static_cast<int>(entry.name_size);
+    return true;
+}
+
+int LabelStore::find_entry(const QByteArray &name) const {
+    if (!m_header) {
+        return -1;
+    }
+
+    const Entry *entries = reinterpret_cast<const Entry *>(m_base + sizeof(Header));
+    int low = 0;
+    int high = static_cast<int>(m_header->count) - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        const char *entry_data = nullptr;
+        int entry_size = 0;
+        if (!entry_name(entries[mid], &entry_data, &entry_size)) {
+            qWarning() << "标注容器格式错误:" << m_file.fileName();
+            return -1;
+        }
+        int result = compare_names(entry_data, entry_size, name.constData(), name.size());
+        if (result == 0) {
+            return mid;
+        }
+        if (result < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+bool LabelStore::lookup(const QByteArray &name, const uchar **data, quint32 *size, quint32 *shape_count) const {
+    auto it = m_pending.constFind(name);
+    if (it != m_pending.constEnd()) {
+        *data = reinterpret_cast<const uchar *>(it->data.constData());
+        *size = static_cast<quint32>(it->data.size());
+        *shape_count = it->shape_count;
+        return true;
+    }
+
+    int index = find_entry(name);
+    if (index < 0) {
+        return false;
+    }
+    const Entry &entry = reinterpret_cast<const Entry *>(m_base + sizeof(Header))[index];
+    // 数据必须位于数据区内，分开比较避免偏移量相加溢出
+    const quint64 data_size = static_cast<quint64>(m_size) - m_header->data_offset;
+    if (entry.data_offset > data_size || entry.data_size > data_size - entry.data_offset) {
+        return false;
+    }
+    *data = m_base + m_header->data_offset + entry.data_offset;
+    *size = entry.data_size;
+    *shape_count = entry.shape_count;
+    return true;
+}
+
+QByteArray LabelStore::encode(const QSize &image_size, const QList<LabelShape> &shapes) {
+    // 与 YOLO 写出时的归一化计算保持一致
+    const int img_w = image_size.width();
+    const int img_h = image_size.height();
+    QByteArray data;
+    for (const LabelShape &shape: shapes) {
+        append_u32(&data, static_cast<quint32>(shape.class_id));
+        if (shape.is_polygon()) {
+            append_u32(&data, static_cast<quint32>(shape.points.size()));
+            for (const QPointF &point: shape.points) {
+                append_float(&data, point.x() / img_w);
+                append_float(&data, point.y() / img_h);
+            }
+        } else {
+            append_u32(&data, 0);
+            append_float(&data, (shape.box.x() + shape.box.width() / 2.0) / img_w);
+            append_float(&data, (shape.box.y() + shape.box.height() / 2.0) / img_h);
+            append_float(&data, shape.box.width() / img_w);
+            append_float(&data, shape.box.height() / img_h);
+        }
+    }
+    return data;
+}
+
+bool LabelStore::decode(const uchar *data, quint32 size, quint32 shape_count, const QSize &image_size,
+                        QList<LabelShape> *shapes) {
+    const double img_w = image_size.width();
+    const double img_h = image_size.height();
+    quint32 pos = 0;
+    for (quint32 i = 0; i < shape_count; ++i) {
+        if (pos + 8 > size) {
+            return false;
+        }
+        LabelShape shape;
+        shape.class_id = static_cast<qint32>(read_u32(data + pos));
+        quint32 point_count = read_u32(data + pos + 4);
+        pos += 8;
+
+        quint32 value_count = point_count == 0 ? 4 : point_count * 2;
+        if (point_count > (size - pos) / 8 || pos + value_count * 4 > size) {
+            return false;
+        }
+        const uchar *values = data + pos;
+        pos += value_count * 4;
+
+        // 与 YOLO 读取时的像素坐标换算保持一致
+        if (point_count == 0) {
+            double width = read_float(values + 8) * img_w;
+            double height = read_float(values + 12) * img_h;
+            double x = read_float(values) * img_w - width / 2;
+            double y = read_float(values + 4) * img_h - height / 2;
+            shape.box = QRectF(x, y, width, height);
+        } else {
+            shape.points.reserve(static_cast<int>(point_count));
+            for (quint32 k = 0; k < point_count; ++k) {
+                shape.points.append(QPointF(read_float(values + k * 8) * img_w,
+                                            read_float(values + k * 8 + 4) * img_h));
+            }
+            shape.box = QPolygonF(shape.points).boundingRect();
+        }
+        shapes->append(shape);
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef LABELSTORE_H
+#define LABELSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include "labelformat.h"
+
+// 二进制标注容器
+// 每个文件夹一个 labels.bin：文件头、按文件名排序的偏移表、文件名区、float32 坐标数据。
+// 读取时通过内存映射二分查找，不解析文本；修改先追加到 labels.bin.journal，
+// 合并时整体重写容器。坐标与 YOLO 一样按图片尺寸归一化保存，
+// 与 save_annotations 写出的 6 位小数 YOLO 文本相互转换无损。
+// 同一文件夹的容器全局共享一个实例，可在工作线程中读写。
+class LabelStore {
+public:
+    ~LabelStore();
+
+    static QSharedPointer<LabelStore> open(const QString &dir);
+    static QString container_path(const QString &dir);
+    // 把所有已打开容器中日志里的修改合并进容器文件（切换文件夹、退出、批量转换结束时调用）
+    static void flush_all();
+
+    bool contains(const QString &name) const;
+    // 图片记录的校验值（数据长度与内容哈希），没有标注时为 0；合并容器后不变
+    qint64 stamp(const QString &name) const;
+    // name 为文件夹内的图片文件名，shapes 为像素坐标
+    bool read(const QString &name, const QSize &image_size, QList<LabelShape> *shapes) const;
+    bool write(const QString &name, const QSize &image_size, const QList<LabelShape> &shapes);
+    bool compact();
+
+private:
+    // 文件头与偏移表按本机字节序（小端）保存，偏移表按文件名字节序排列
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint32 count;
+        quint32 reserved;
+        quint64 names_offset;
+        quint64 data_offset;
+    };
+
+    struct Entry {
+        quint32 name_offset;  // 相对文件名区
+        quint32 name_size;
+        quint64 data_offset;  // 相对数据区
+        quint32 data_size;
+        quint32 shape_count;
+    };
+
+    // 尚未合并的修改，shape_count 为 0 表示没有标注
+    struct Pending {
+        quint32 shape_count = 0;
+        QByteArray data;
+    };
+
+    explicit LabelStore(const QString &dir);
+
+    bool map_container();
+    void unmap_container();
+    bool replay_journal();
+    bool entry_name(const Entry &entry, const char **name, int *size) const;
+    int find_entry(const QByteArray &name) const;
+    bool lookup(const QByteArray &name, const uchar **data, quint32 *size, quint32 *shape_count) const;
+    bool compact_locked();
+
+    static QByteArray encode(const QSize &image_size, const QList<LabelShape> &shapes);
+    static bool decode(const uchar *data, quint32 size, quint32 shape_count, const QSize &image_size,
+                       QList<LabelShape> *shapes);
+
+    QString m_dir;
+    mutable QReadWriteLock m_lock;
+    QFile m_file;
+    const uchar *m_base;
+    qint64 m_size;
+    const Header *m_header;
+    QFile m_journal;
+    qint64 m_journalSize;
+    QHash<QByteArray, Pending> m_pending;
+};
+
+#endif // LABELSTORE_H
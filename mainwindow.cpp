@@ -1,14 +1,34 @@
 #include "mainwindow.h"
 #include "annotationgraphicsview.h"
 #include "classmanagerdialog.h"
+#include "datasetindex.h"
+#include "folderscanner.h"
+#include "folderwatcher.h"
+#include "imagelistmodel.h"
+#include "cocoexporter.h"
+#include "cocoimporter.h"
+#include "labelformat.h"
+#include "labelstore.h"
+#include "shardexporter.h"
+#include "splitgenerator.h"
+#include "cropexporter.h"
+#include "imageresizer.h"
+#include "thumbnailprovider.h"
+#include "framecache.h"
+#include "archivesource.h"
+#include "remotesource.h"
+#include "minimapwidget.h"
+#include "jobscheduler.h"
 #include <QApplication>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QScrollArea>
 #include <QShortcut>
 #include <QComboBox>
 #include <QDialog>
-#include <QListWidget>
+#include <QDockWidget>
+#include <QListView>
 #include <QFormLayout>
 #include <QLineEdit>
 #include <QDialogButtonBox>
@@ -23,8 +43,14 @@
 #include <QCloseEvent>
 #include <QPushButton>
 #include <QTextStream>
+#include <QRegularExpression>
 #include <QScreen>
+#include <QSignalBlocker>
+#include <QSlider>
+#include <QTableWidget>
+#include <QHeaderView>
 #include <QButtonGroup>
+#include <QCheckBox>
 #include <QTranslator>
 #include <QMenuBar>
 #include <QMenu>
@@ -32,10 +58,33 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QSettings>
+#include <QProgressDialog>
+#include <QItemSelectionModel>
+#include <QSet>
+#include <QTimer>
+#include <algorithm>
+#include <numeric>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
       , current_index(0)
+      , dataset_index(new DatasetIndex(this))
+      , folder_scanner(new FolderScanner(this))
+      , folder_watcher(new FolderWatcher(this))
+      , batch_operation(new BatchOperation(this))
+      , batch_progress(nullptr)
+      , label_format_group(nullptr)
+      , coco_exporter(new CocoExporter(this))
+      , coco_importer(new CocoImporter(this))
+      , shard_exporter(new ShardExporter(this))
+      , split_generator(new SplitGenerator(this))
+      , crop_exporter(new CropExporter(this))
+      , image_resizer(new ImageResizer(this))
+      , thumbnail_provider(new ThumbnailProvider(this))
+      , frame_cache(new FrameCache(this))
+      , source_jobs(JobScheduler::Indexing)
+      , source_generation(0)
+      , prefetch_index(-1)
       , current_language("zh") {
     // 从设置中读取当前语言
     QSettings settings("ImageLabeler", "ImageLabeler");
@@ -43,12 +92,18 @@ MainWindow::MainWindow(QWidget *parent)
 
     init_ui();
     setup_shortcuts();
+    create_dataset_menu();
+    create_navigate_menu();
     create_language_menu();
     create_about_menu();
     update_language_menu();
 }
 
 MainWindow::~MainWindow() {
+    // 预解码任务使用解码缓存与数据来源，先停止
+    annotation_widget->preload(QStringList());
+    annotation_widget->set_frame_cache(nullptr);
+    close_source();
 }
 
 void MainWindow::init_ui() {
@@ -118,11 +173,44 @@ void MainWindow::init_ui() {
     connect(reset_view_btn, &QPushButton::clicked, this, &MainWindow::reset_view);
     left_layout->addWidget(reset_view_btn);
 
+    // 图片排序方式
+    sort_combo = new QComboBox(this);
+    sort_combo->addItem(tr("按文件名排序"), SortByName);
+    sort_combo->addItem(tr("未标注优先"), SortUnlabelledFirst);
+    sort_combo->addItem(tr("按标注数量排序"), SortByAnnotationCount);
+    sort_combo->addItem(tr("按修改时间排序"), SortByModifiedTime);
+    connect(sort_combo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::sort_images);
+    left_layout->addWidget(sort_combo);
+
+    // 图片筛选，输入停止后再筛选，避免每次按键都遍历整个列表
+    filter_edit = new QLineEdit(this);
+    filter_edit->setPlaceholderText(tr("筛选: 文件名 class:名称 未标注 boxes>5"));
+    filter_edit->setClearButtonEnabled(true);
+    filter_edit->setToolTip(tr("多个条件用空格分隔，前缀 ! 表示取反\n"
+                               "class:名称或ID  包含指定类别\n"
+                               "labelled / unlabelled  已标注 / 未标注\n"
+                               "flagged / issues  已标记 / 标注有问题\n"
+                               "boxes>N boxes<=N ...  按标注数量筛选\n"
+                               "其他文本  文件名包含该文本"));
+    filter_timer = new QTimer(this);
+    filter_timer->setSingleShot(true);
+    filter_timer->setInterval(150);
+    connect(filter_edit, &QLineEdit::textChanged, filter_timer, QOverload<>::of(&QTimer::start));
+    connect(filter_timer, &QTimer::timeout, this, &MainWindow::apply_filter);
+    left_layout->addWidget(filter_edit);
+
     // 创建图片列表
-    image_list = new QListWidget(this);
+    image_model = new ImageListModel(&image_files, dataset_index, this);
+    image_list = new QListView(this);
     image_list->setFixedHeight(300);
-    image_list->setSelectionMode(QAbstractItemView::SingleSelection);
-    connect(image_list, &QListWidget::itemClicked, this, &MainWindow::on_image_list_item_clicked);
+    image_list->setSelectionMode(QAbstractItemView::ExtendedSelection); // Ctrl/Shift 多选后批量操作
+    image_list->setContextMenuPolicy(Qt::CustomContextMenu);
+    image_list->setUniformItemSizes(true); // 百万级列表也只布局可见行
+    image_list->setTextElideMode(Qt::ElideMiddle); // 文件名过长时在中间显示省略号
+    image_list->setModel(image_model);
+    connect(image_list, &QListView::clicked, this, &MainWindow::on_image_list_item_clicked);
+    connect(image_list, &QListView::customContextMenuRequested, this, &MainWindow::on_image_list_context_menu);
     left_layout->addWidget(image_list);
 
     // Add stretch to push class selection to bottom
@@ -171,6 +259,117 @@ void MainWindow::init_ui() {
     scroll_area->setWidgetResizable(true);
     right_layout->addWidget(scroll_area);
 
+    // 16 位图片的显示窗口，只在加载 16 位图片时显示
+    window_widget = new QWidget(this);
+    QHBoxLayout *window_layout = new QHBoxLayout(window_widget);
+    window_layout->setContentsMargins(0, 0, 0, 0);
+    window_low_slider = new QSlider(Qt::Horizontal, window_widget);
+    window_high_slider = new QSlider(Qt::Horizontal, window_widget);
+    window_low_slider->setRange(0, 65535);
+    window_high_slider->setRange(0, 65535);
+    window_low_slider->setToolTip(tr("窗口下限"));
+    window_high_slider->setToolTip(tr("窗口上限"));
+    QPushButton *auto_window_btn = new QPushButton(tr("自动"), window_widget);
+    auto_window_btn->setToolTip(tr("按直方图 0.5%-99.5% 自动设置窗口"));
+    window_layout->addWidget(new QLabel(tr("窗口:"), window_widget));
+    window_layout->addWidget(window_low_slider);
+    window_layout->addWidget(window_high_slider);
+    window_layout->addWidget(auto_window_btn);
+    window_widget->hide();
+    right_layout->addWidget(window_widget);
+    connect(window_low_slider, &QSlider::valueChanged, this, &MainWindow::on_window_slider_changed);
+    connect(window_high_slider, &QSlider::valueChanged, this, &MainWindow::on_window_slider_changed);
+    connect(auto_window_btn, &QPushButton::clicked, this, [this]() {
+        annotation_widget->auto_window();
+        update_window_controls();
+    });
+    connect(annotation_widget, &AnnotationGraphicsView::image_changed, this, &MainWindow::update_window_controls);
+
+    // 导航图停靠窗口，放大后显示当前可见区域，点击或拖动平移
+    minimap = new MinimapWidget(annotation_widget, this);
+    minimap_dock = new QDockWidget(tr("导航"), this);
+    minimap_dock->setObjectName("minimap_dock");
+    minimap_dock->setWidget(minimap);
+    addDockWidget(Qt::RightDockWidgetArea, minimap_dock);
+
+    // 显示调整停靠窗口，只改变显示，不修改图片文件
+    QWidget *adjust_widget = new QWidget(this);
+    QFormLayout *adjust_layout = new QFormLayout(adjust_widget);
+    brightness_slider = new QSlider(Qt::Horizontal, adjust_widget);
+    brightness_slider->setRange(-100, 100);
+    contrast_slider = new QSlider(Qt::Horizontal, adjust_widget);
+    contrast_slider->setRange(-100, 100);
+    gamma_slider = new QSlider(Qt::Horizontal, adjust_widget);
+    gamma_slider->setRange(10, 300);
+    gamma_slider->setValue(100);
+    clahe_check = new QCheckBox(tr("局部对比度增强 (CLAHE)"), adjust_widget);
+    adjust_label = new QLabel(adjust_widget);
+    QPushButton *reset_adjust_btn = new QPushButton(tr("重置"), adjust_widget);
+    adjust_layout->addRow(tr("亮度:"), brightness_slider);
+    adjust_layout->addRow(tr("对比度:"), contrast_slider);
+    adjust_layout->addRow(tr("Gamma:"), gamma_slider);
+    adjust_layout->addRow(clahe_check);
+    adjust_layout->addRow(adjust_label, reset_adjust_btn);
+    adjust_dock = new QDockWidget(tr("显示调整"), this);
+    adjust_dock->setObjectName("adjust_dock");
+    adjust_dock->setWidget(adjust_widget);
+    addDockWidget(Qt::RightDockWidgetArea, adjust_dock);
+    connect(brightness_slider, &QSlider::valueChanged, this, &MainWindow::on_adjustment_changed);
+    connect(contrast_slider, &QSlider::valueChanged, this, &MainWindow::on_adjustment_changed);
+    connect(gamma_slider, &QSlider::valueChanged, this, &MainWindow::on_adjustment_changed);
+    connect(clahe_check, &QCheckBox::toggled, this, &MainWindow::on_adjustment_changed);
+    connect(reset_adjust_btn, &QPushButton::clicked, this, [this]() {
+        {
+            QSignalBlocker brightness_blocker(brightness_slider);
+            QSignalBlocker contrast_blocker(contrast_slider);
+            QSignalBlocker gamma_blocker(gamma_slider);
+            QSignalBlocker clahe_blocker(clahe_check);
+            brightness_slider->setValue(0);
+            contrast_slider->setValue(0);
+            gamma_slider->setValue(100);
+            clahe_check->setChecked(false);
+        }
+        on_adjustment_changed();
+    });
+
+    // 后台任务停靠窗口（调试用），显示各优先级的队列长度、运行数与排队 / 运行时间，默认隐藏
+    QWidget *jobs_widget = new QWidget(this);
+    QVBoxLayout *jobs_layout = new QVBoxLayout(jobs_widget);
+    jobs_table = new QTableWidget(JobScheduler::PriorityCount, 7, jobs_widget);
+    jobs_table->setHorizontalHeaderLabels({tr("排队"), tr("运行"), tr("上限"), tr("完成"),
+                                           tr("平均等待 (ms)"), tr("平均运行 (ms)"), tr("最长等待 (ms)")});
+    for (int i = 0; i < JobScheduler::PriorityCount; ++i) {
+        jobs_table->setVerticalHeaderItem(i, new QTableWidgetItem(
+            JobScheduler::priority_name(static_cast<JobScheduler::Priority>(i))));
+    }
+    jobs_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    jobs_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    QPushButton *reset_jobs_btn = new QPushButton(tr("重置统计"), jobs_widget);
+    jobs_layout->addWidget(new QLabel(tr("线程数: %1").arg(JobScheduler::instance()->thread_count()), jobs_widget));
+    jobs_layout->addWidget(jobs_table);
+    jobs_layout->addWidget(reset_jobs_btn);
+    jobs_dock = new QDockWidget(tr("后台任务"), this);
+    jobs_dock->setObjectName("jobs_dock");
+    jobs_dock->setWidget(jobs_widget);
+    addDockWidget(Qt::BottomDockWidgetArea, jobs_dock);
+    jobs_dock->hide();
+    // 只在面板显示时刷新
+    jobs_timer = new QTimer(this);
+    jobs_timer->setInterval(500);
+    connect(jobs_timer, &QTimer::timeout, this, &MainWindow::update_jobs_table);
+    connect(jobs_dock, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+        if (visible) {
+            update_jobs_table();
+            jobs_timer->start();
+        } else {
+            jobs_timer->stop();
+        }
+    });
+    connect(reset_jobs_btn, &QPushButton::clicked, this, [this]() {
+        JobScheduler::instance()->reset_stats();
+        update_jobs_table();
+    });
+
     // Status bar showing mouse position and zoom info
     status_label = new QLabel(tr("就绪"));
     right_layout->addWidget(status_label);
@@ -181,6 +380,9 @@ void MainWindow::init_ui() {
 
     // 连接缩放变化信号
     connect(annotation_widget, &AnnotationGraphicsView::scale_changed, this, &MainWindow::update_status);
+    connect(annotation_widget, &AnnotationGraphicsView::classes_discovered, this, &MainWindow::on_classes_discovered);
+    connect(annotation_widget, &AnnotationGraphicsView::annotations_unreadable, this,
+            &MainWindow::on_annotations_unreadable);
 
     // Set focus policy to receive keyboard events
     annotation_widget->setFocusPolicy(Qt::StrongFocus);
@@ -193,6 +395,39 @@ void MainWindow::init_ui() {
     QButtonGroup *mode_group = new QButtonGroup(this);
     mode_group->addButton(rectangle_mode_btn);
     mode_group->addButton(polygon_mode_btn);
+
+    // 数据集索引
+    connect(dataset_index, &DatasetIndex::build_progress, this, &MainWindow::on_index_build_progress);
+    connect(dataset_index, &DatasetIndex::build_finished, this, &MainWindow::on_index_build_finished);
+    connect(dataset_index, &DatasetIndex::record_changed, this, &MainWindow::on_index_record_changed);
+    connect(thumbnail_provider, &ThumbnailProvider::thumbnail_ready, this, &MainWindow::on_thumbnail_ready);
+
+    // 文件夹扫描
+    connect(folder_scanner, &FolderScanner::files_found, this, &MainWindow::on_scan_files_found);
+    connect(folder_scanner, &FolderScanner::finished, this, &MainWindow::on_scan_finished);
+
+    // 文件夹监视
+    connect(folder_watcher, &FolderWatcher::files_changed, this, &MainWindow::on_folder_files_changed);
+
+    // 批量操作
+    connect(batch_operation, &BatchOperation::progress, this, &MainWindow::on_batch_progress);
+    connect(batch_operation, &BatchOperation::finished, this, &MainWindow::on_batch_finished);
+
+    // 导入导出
+    connect(coco_exporter, &CocoExporter::progress, this, &MainWindow::on_batch_progress);
+    connect(coco_exporter, &CocoExporter::finished, this, &MainWindow::on_export_finished);
+    connect(coco_importer, &CocoImporter::progress, this, [this](int percent) {
+        on_batch_progress(percent, 100);
+    });
+    connect(coco_importer, &CocoImporter::finished, this, &MainWindow::on_coco_import_finished);
+    connect(shard_exporter, &ShardExporter::progress, this, &MainWindow::on_batch_progress);
+    connect(shard_exporter, &ShardExporter::finished, this, &MainWindow::on_export_finished);
+    connect(split_generator, &SplitGenerator::progress, this, &MainWindow::on_batch_progress);
+    connect(split_generator, &SplitGenerator::finished, this, &MainWindow::on_export_finished);
+    connect(crop_exporter, &CropExporter::progress, this, &MainWindow::on_batch_progress);
+    connect(crop_exporter, &CropExporter::finished, this, &MainWindow::on_export_finished);
+    connect(image_resizer, &ImageResizer::progress, this, &MainWindow::on_batch_progress);
+    connect(image_resizer, &ImageResizer::finished, this, &MainWindow::on_resize_finished);
 }
 
 void MainWindow::set_rectangle_mode() {
@@ -254,6 +489,13 @@ void MainWindow::setup_shortcuts() {
     zoom_out_shortcut = new QShortcut(QKeySequence("-"), this);
     connect(zoom_out_shortcut, &QShortcut::activated, this, &MainWindow::zoom_out);
 
+    // Ctrl+F - 定位到筛选输入框
+    filter_shortcut = new QShortcut(QKeySequence::Find, this);
+    connect(filter_shortcut, &QShortcut::activated, this, [this]() {
+        filter_edit->setFocus();
+        filter_edit->selectAll();
+    });
+
     // 添加多边形相关快捷键
     // 1 key - Rectangle mode
     rectangle_mode_shortcut = new QShortcut(QKeySequence("1"), this);
@@ -275,12 +517,148 @@ void MainWindow::setup_shortcuts() {
 void MainWindow::load_folder() {
     QString folder = QFileDialog::getExistingDirectory(this, tr("选择图片文件夹"));
     if (!folder.isEmpty()) {
+        close_source();
         image_folder = folder;
         load_classes();
         load_images_from_folder();
     }
 }
 
+void MainWindow::load_archive() {
+    QString path = QFileDialog::getOpenFileName(this, tr("选择压缩包"), QString(),
+                                                tr("压缩包 (*.zip *.tar);;所有文件 (*)"));
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QSharedPointer<ArchiveSource> archive(new ArchiveSource());
+    if (!ArchiveSource::is_archive_file(path) || !archive->open(path)) {
+        QMessageBox::warning(this, tr("警告"), tr("无法读取压缩包: %1").arg(path));
+        return;
+    }
+
+    // 标注、索引与缩略图缓存保存在压缩包旁边的同名文件夹中，图片按需从压缩包读取
+    QFileInfo info(path);
+    QString folder = info.absolutePath() + "/" + info.completeBaseName();
+    if (!QDir().mkpath(folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("无法创建标注文件夹: %1").arg(folder));
+        return;
+    }
+
+    prepare_source(archive, [archive, folder](QString *) {
+        archive->prepare_folder(folder);
+        return folder;
+    });
+}
+
+void MainWindow::load_remote() {
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    bool ok = false;
+    QString text = QInputDialog::getText(this, tr("打开对象存储"),
+                                         tr("地址 (http(s)://主机/桶/前缀):"), QLineEdit::Normal,
+                                         settings.value("remote_url").toString(), &ok).trimmed();
+    if (!ok || text.isEmpty()) {
+        return;
+    }
+
+    settings.setValue("remote_url", text);
+
+    // 来源在最后一个引用释放后删除，可能在工作线程中，因此交给主线程删除
+    RemoteSource *remote = new RemoteSource();
+    remote->set_cache_limit(settings.value("remote_cache_limit_mb", 2048).toLongLong() << 20);
+    QSharedPointer<DatasetSource> source(remote, &QObject::deleteLater);
+    const QUrl url = QUrl::fromUserInput(text);
+    const QString list_error = tr("无法列出对象存储中的文件: %1").arg(text);
+    const QString folder_error = tr("无法创建标注文件夹: %1");
+
+    // 列出对象与下载标注在后台完成；标注、索引与缩略图缓存保存在本地文件夹中，图片按需下载
+    prepare_source(source, [remote, url, list_error, folder_error](QString *error) {
+        if (!remote->open(url)) {
+            *error = list_error;
+            return QString();
+        }
+        const QString folder = remote->local_folder();
+        if (!QDir().mkpath(folder)) {
+            *error = folder_error.arg(folder);
+            return QString();
+        }
+        remote->prepare_folder(folder);
+        return folder;
+    });
+}
+
+// 在后台准备数据来源，完成后替换当前数据集并加载图片列表；准备期间仍显示原来的数据集
+void MainWindow::prepare_source(const QSharedPointer<DatasetSource> &source,
+                                const std::function<QString(QString *error)> &prepare) {
+    source_jobs.clear();
+    const int generation = ++source_generation;
+    status_label->setText(tr("正在准备数据集..."));
+    source_jobs.start([this, source, prepare, generation]() {
+        QString error;
+        const QString folder = prepare(&error);
+        QMetaObject::invokeMethod(this, [this, source, folder, error, generation]() {
+            if (generation != source_generation) {
+                return;
+            }
+            if (folder.isEmpty()) {
+                status_label->setText(tr("就绪"));
+                QMessageBox::warning(this, tr("警告"), error);
+                return;
+            }
+            close_source();
+            dataset_source = source;
+            DatasetSource::mount(folder, dataset_source);
+            image_folder = folder;
+            load_classes();
+            load_images_from_folder();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::close_source() {
+    // 放弃还在后台准备的数据来源
+    ++source_generation;
+    source_jobs.clear();
+    if (!dataset_source) {
+        return;
+    }
+    folder_scanner->cancel();
+    // 正在进行的读取持有来源的引用，读取完成后才删除来源
+    DatasetSource::unmount();
+    dataset_source.reset();
+    prefetch_index = -1;
+}
+
+// 按导航方向在后台预先解码后面的两张图片；对象存储另外预读更多图片到本地缓存
+void MainWindow::prefetch_images() {
+    if (current_index < 0 || current_index >= image_files.size()) {
+        return;
+    }
+    const int prefetch_count = dataset_source ? 8 : 2;
+    const int decode_count = 2;
+    const int step = current_index < prefetch_index ? -1 : 1;
+    prefetch_index = current_index;
+
+    QStringList members;
+    int row = current_index;
+    for (int i = 0; i < prefetch_count; ++i) {
+        row = image_model->next_row(row, step);
+        if (row < 0) {
+            break;
+        }
+        members.append(image_files.at(row));
+    }
+
+    QStringList paths;
+    for (int i = 0; i < qMin(decode_count, members.size()); ++i) {
+        paths.append(image_folder + "/" + members.at(i));
+    }
+    annotation_widget->preload(paths);
+    if (dataset_source) {
+        dataset_source->prefetch(members);
+    }
+}
+
 void MainWindow::load_classes() {
     if (image_folder.isEmpty()) {
         return;
@@ -309,6 +687,9 @@ void MainWindow::load_classes() {
 
     // Update annotation widget with classes
     annotation_widget->set_classes(classes);
+    dataset_index->set_classes(classes);
+    thumbnail_provider->set_classes(classes);
+    batch_operation->set_classes(classes);
 
     if (!classes.isEmpty()) {
         annotation_widget->set_current_class(0);
@@ -321,15 +702,7 @@ void MainWindow::save_classes() {
         return;
     }
 
-    QString classes_file = image_folder + "/classes.txt";
-    QFile file(classes_file);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        for (const QString &className: classes) {
-            out << className << "\n";
-        }
-        file.close();
-    }
+    LabelFormat::save_classes(image_folder, classes);
 }
 
 void MainWindow::manage_classes() {
@@ -346,32 +719,303 @@ void MainWindow::load_images_from_folder() {
         return;
     }
 
-    // Supported image formats
-    QStringList image_extensions;
-    image_extensions << "png" << "jpg" << "jpeg" << "bmp" << "tiff";
+    folder_watcher->stop();
+    LabelStore::flush_all();
+    image_trash.set_folder(image_folder);
+    undo_delete_action->setEnabled(false);
+    annotation_widget->set_label_format(LabelFormat::folder_format(image_folder));
+    update_label_format_menu();
+
+    image_model->begin_reset();
     image_files.clear();
+    scan_keys.clear();
+    current_index = 0;
+    image_model->end_reset();
+
+    annotation_widget->clear();
+    info_label->setText(tr("未加载图片"));
+    prev_btn->setEnabled(false);
+    next_btn->setEnabled(false);
 
-    QDir dir(image_folder);
-    QStringList files = dir.entryList(QDir::Files, QDir::Name);
+    // 打开数据集索引，已有记录可以立即用于显示标注状态
+    dataset_index->open(image_folder);
+    thumbnail_provider->open(image_folder);
 
-    for (const QString &file: files) {
-        QFileInfo file_info(file);
-        if (image_extensions.contains(file_info.suffix().toLower())) {
-            image_files.append(file);
+    // 在后台线程中扫描文件夹，结果分批加入列表
+    folder_scanner->start(image_folder, recursive_action->isChecked());
+    status_label->setText(tr("正在扫描文件夹..."));
+}
+
+void MainWindow::on_scan_files_found(const QStringList &files, const QList<QByteArray> &keys) {
+    bool first_batch = image_files.isEmpty();
+
+    image_model->begin_append(files.size());
+    image_files.append(files);
+    sync_image_summaries(image_files.size() - files.size(), image_files.size() - 1);
+    image_model->end_append();
+    for (const QByteArray &key: keys) {
+        scan_keys.append(key);
+    }
+
+    // 第一批结果到达后立即显示第一张图片，扫描完成前即可开始标注
+    if (first_batch) {
+        current_index = 0;
+        load_current_image();
+        prev_btn->setEnabled(true);
+        next_btn->setEnabled(true);
+    }
+
+    status_label->setText(QString(tr("正在扫描文件夹: 已找到 %1 张图片")).arg(image_files.size()));
+}
+
+void MainWindow::on_scan_finished(int total) {
+    if (total == 0) {
+        status_label->setText(tr("就绪"));
+        QMessageBox::warning(this, tr("警告"), tr("文件夹中没有找到图片文件"));
+        return;
+    }
+
+    // 使用扫描时预先计算的排序键排序，当前图片保持不变
+    sort_images(sort_combo->currentIndex());
+    scan_keys.clear();
+    scan_keys.squeeze();
+
+    // 在后台增量更新数据集索引，并开始监视文件夹中新增、删除的图片
+    QStringList files = image_files.to_string_list();
+    dataset_index->build(files);
+    thumbnail_provider->prune(files);
+    // 压缩包中的图片不在磁盘上，不需要监视
+    if (!dataset_source) {
+        folder_watcher->watch(image_folder, files, recursive_action->isChecked());
+    }
+}
+
+void MainWindow::on_folder_files_changed(const QStringList &added, const QStringList &removed) {
+    // 过滤掉程序自身已经处理过的变化（例如删除、恢复图片）
+    QVector<int> removed_rows;
+    QSet<QString> removed_set;
+    QVector<int> removed_lookup = image_files.index_of_all(removed);
+    for (int k = 0; k < removed.size(); ++k) {
+        if (removed_lookup.at(k) >= 0) {
+            removed_rows.append(removed_lookup.at(k));
+            removed_set.insert(removed.at(k));
         }
     }
+    std::sort(removed_rows.begin(), removed_rows.end());
 
-    if (!image_files.isEmpty()) {
+    QStringList added_files;
+    QVector<int> added_lookup = image_files.index_of_all(added);
+    for (int k = 0; k < added.size(); ++k) {
+        if (added_lookup.at(k) < 0) {
+            added_files.append(added.at(k));
+        }
+    }
+    if (added_files.isEmpty() && removed_rows.isEmpty()) {
+        return;
+    }
+
+    QString current_file = image_files.isEmpty() ? QString() : image_files.at(current_index);
+    bool current_removed = removed_set.contains(current_file);
+    int old_index = current_index;
+
+    // 少量变化逐行通知视图，大量变化合并为一次重置
+    const int incremental_limit = 256;
+    bool batch_update = added_files.size() + removed_rows.size() > incremental_limit;
+    if (batch_update) {
+        image_model->begin_reset();
+    }
+
+    // 删除
+    if (!removed_rows.isEmpty()) {
+        if (batch_update) {
+            image_files.remove_rows(removed_rows);
+        } else {
+            for (int i = removed_rows.size() - 1; i >= 0; --i) {
+                image_model->begin_remove(removed_rows.at(i));
+                image_files.removeAt(removed_rows.at(i));
+                image_model->end_remove();
+            }
+        }
+        dataset_index->remove_images(removed_set.values());
+    }
+
+    // 新增：按文件名排序时插入到自然排序的位置，否则追加到末尾
+    if (!added_files.isEmpty()) {
+        if (batch_update || sort_combo->currentIndex() != SortByName) {
+            if (!batch_update) {
+                image_model->begin_append(added_files.size());
+            }
+            image_files.append(added_files);
+            if (!batch_update) {
+                image_model->end_append();
+            }
+        } else {
+            for (const QString &file: added_files) {
+                // 二分查找插入位置
+                QByteArray key = FolderScanner::natural_sort_key(file);
+                int low = 0;
+                int high = image_files.size();
+                while (low < high) {
+                    int mid = (low + high) / 2;
+                    if (FolderScanner::natural_sort_key(image_files.at(mid)) < key) {
+                        low = mid + 1;
+                    } else {
+                        high = mid;
+                    }
+                }
+                int row = low;
+                image_model->begin_insert(row);
+                image_files.insert(row, file);
+                image_model->end_insert();
+            }
+        }
+        dataset_index->update_images(added_files);
+    }
+
+    if (batch_update) {
+        if (!added_files.isEmpty() && sort_combo->currentIndex() == SortByName) {
+            // 大批量新增时整体重新排序一次
+            image_model->end_reset();
+            current_index = current_removed || current_file.isEmpty()
+                    ? qBound(0, old_index, image_files.size() - 1)
+                    : qMax(0, image_files.indexOf(current_file));
+            sort_images(SortByName);
+        } else {
+            image_model->end_reset();
+        }
+    }
+
+    // 保持当前图片；当前图片被删除时，如果同一批次只新增了一个文件则视为重命名
+    if (image_files.isEmpty()) {
+        current_index = 0;
+        annotation_widget->clear();
+        info_label->setText(tr("未加载图片"));
+        prev_btn->setEnabled(false);
+        next_btn->setEnabled(false);
+    } else if (current_removed) {
+        if (removed_set.size() == 1 && added_files.size() == 1) {
+            current_index = qMax(0, image_files.indexOf(added_files.first()));
+        } else {
+            current_index = qBound(0, old_index, image_files.size() - 1);
+        }
+        load_current_image();
+    } else if (current_file.isEmpty()) {
         current_index = 0;
         load_current_image();
         prev_btn->setEnabled(true);
         next_btn->setEnabled(true);
+    } else {
+        current_index = qMax(0, image_files.indexOf(current_file));
         update_image_list();
+        update_status();
+    }
+
+    status_label->setText(QString(tr("文件夹已更新: 新增 %1, 删除 %2"))
+        .arg(added_files.size()).arg(removed_rows.size()));
+}
+
+void MainWindow::set_recursive_scan(bool recursive) {
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    settings.setValue("recursive_scan", recursive);
+}
+
+void MainWindow::set_thumbnail_grid(bool enabled) {
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    settings.setValue("thumbnail_grid", enabled);
+
+    if (enabled) {
+        int size = ThumbnailProvider::kThumbnailSize;
+        image_list->setViewMode(QListView::IconMode);
+        image_list->setMovement(QListView::Static);
+        image_list->setResizeMode(QListView::Adjust);
+        image_list->setIconSize(QSize(size, size));
+        image_list->setGridSize(QSize(size + 16, size + 2 * fontMetrics().height()));
     } else {
-        QMessageBox::warning(this, tr("警告"), tr("文件夹中没有找到图片文件"));
+        image_list->setViewMode(QListView::ListMode);
+        image_list->setIconSize(QSize());
+        image_list->setGridSize(QSize());
+    }
+    image_model->set_thumbnails(enabled ? thumbnail_provider : nullptr);
+    update_image_list();
+}
+
+void MainWindow::set_frame_cache(bool enabled) {
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    settings.setValue("frame_cache", enabled);
+    annotation_widget->set_frame_cache(enabled ? frame_cache : nullptr);
+}
+
+void MainWindow::set_frame_cache_limit() {
+    bool ok = false;
+    int limit = QInputDialog::getInt(this, tr("解码缓存"), tr("缓存大小上限 (MB):"),
+                                     static_cast<int>(frame_cache->limit() >> 20), 256, 1024 * 1024, 256, &ok);
+    if (!ok) {
+        return;
+    }
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    settings.setValue("frame_cache_limit_mb", limit);
+    frame_cache->set_limit(static_cast<qint64>(limit) << 20);
+}
+
+void MainWindow::on_thumbnail_ready(const QString &file, int row) {
+    // row 是请求时的行号；文件列表变化后该行不再是这张图片，行重新显示时会再次请求
+    if (row >= 0 && row < image_files.size() && image_files.at(row) == file) {
+        image_model->refresh_row(row);
+    }
+}
+
+void MainWindow::update_window_controls() {
+    bool visible = annotation_widget->is_high_bit_depth();
+    window_widget->setVisible(visible);
+    if (!visible) {
+        return;
+    }
+    QSignalBlocker low_blocker(window_low_slider);
+    QSignalBlocker high_blocker(window_high_slider);
+    window_low_slider->setValue(annotation_widget->window_low());
+    window_high_slider->setValue(annotation_widget->window_high());
+}
+
+void MainWindow::on_window_slider_changed() {
+    annotation_widget->set_window(window_low_slider->value(), window_high_slider->value());
+    status_label->setText(tr("窗口: %1 - %2").arg(annotation_widget->window_low()).arg(annotation_widget->window_high()));
+}
+
+void MainWindow::update_jobs_table() {
+    const QVector<JobScheduler::Stats> stats = JobScheduler::instance()->stats();
+    for (int row = 0; row < stats.size(); ++row) {
+        const JobScheduler::Stats &item = stats.at(row);
+        const QStringList values = {
+            QString::number(item.queued),
+            QString::number(item.running),
+            QString::number(item.limit),
+            QString::number(item.finished),
+            QString::number(item.wait_ms, 'f', 1),
+            QString::number(item.run_ms, 'f', 1),
+            QString::number(item.max_wait_ms, 'f', 1)
+        };
+        for (int column = 0; column < values.size(); ++column) {
+            QTableWidgetItem *cell = jobs_table->item(row, column);
+            if (!cell) {
+                cell = new QTableWidgetItem();
+                cell->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                jobs_table->setItem(row, column, cell);
+            }
+            cell->setText(values.at(column));
+        }
     }
 }
 
+void MainWindow::on_adjustment_changed() {
+    double gamma = gamma_slider->value() / 100.0;
+    annotation_widget->set_adjustment(brightness_slider->value(), contrast_slider->value(), gamma,
+                                      clahe_check->isChecked());
+    adjust_label->setText(tr("亮度 %1 对比度 %2 Gamma %3")
+                              .arg(brightness_slider->value())
+                              .arg(contrast_slider->value())
+                              .arg(gamma, 0, 'f', 2));
+}
+
 void MainWindow::load_current_image() {
     if (current_index >= 0 && current_index < image_files.size()) {
         QString image_path = image_folder + "/" + image_files.at(current_index);
@@ -389,39 +1033,46 @@ void MainWindow::load_current_image() {
             .arg(rect_count));
         update_status();
         update_image_list();
+        prefetch_images();
     } else {
         info_label->setText(tr("未加载图片"));
     }
 }
 
+// 设置了筛选条件时只在筛选结果中切换
 void MainWindow::prev_image() {
-    if (current_index > 0) {
+    int row = image_model->next_row(current_index, -1);
+    if (row >= 0) {
         save_current_annotations();
-        current_index--;
+        current_index = row;
         load_current_image();
-        // 自动选中当前图片
-        if (current_index < image_list->count()) {
-            image_list->setCurrentRow(current_index);
-        }
     }
 }
 
 void MainWindow::next_image() {
-    if (current_index < image_files.size() - 1) {
+    int row = image_model->next_row(current_index, 1);
+    if (row >= 0) {
         save_current_annotations();
-        current_index++;
+        current_index = row;
         load_current_image();
-        // 自动选中当前图片
-        if (current_index < image_list->count()) {
-            image_list->setCurrentRow(current_index);
-        }
     }
 }
 
 void MainWindow::save_current_annotations() {
+    // 标注文件无法解析的图片不保存，原文件保持不变
+    if (annotation_widget->is_read_only()) {
+        return;
+    }
     if (current_index >= 0 && current_index < image_files.size()) {
         QString image_path = image_folder + "/" + image_files.at(current_index);
         annotation_widget->save_annotations(image_path);
+
+        // 增量更新数据集索引
+        QSize image_size = annotation_widget->get_image_size();
+        if (image_size.isValid()) {
+            dataset_index->update_image(image_files.at(current_index), image_size.width(), image_size.height(),
+                                        annotation_widget->get_class_counts());
+        }
         status_label->setText(tr("标注已保存"));
     }
 }
@@ -435,209 +1086,910 @@ void MainWindow::delete_current_image() {
 
         if (reply == QMessageBox::Yes) {
             QString image_path = image_folder + "/" + image_files.at(current_index);
-            QString txt_path = QFileInfo(image_path).absolutePath() + "/" +
-                               QFileInfo(image_path).completeBaseName() + ".txt";
+            QString txt_path = DatasetIndex::label_path(image_folder, image_files.at(current_index));
+            const LabelFormat *format = LabelFormat::folder_format(image_folder);
 
             // Delete image file
             if (QFile::exists(image_path)) {
                 QFile::remove(image_path);
             }
 
-            // Delete annotation file
-            if (QFile::exists(txt_path)) {
+            // Delete annotation file（共用容器中只清除这张图片的标注）
+            if (!format->per_image_files()) {
+                format->write(image_path, QSize(), classes, QList<LabelShape>());
+            } else if (QFile::exists(txt_path)) {
                 QFile::remove(txt_path);
             }
 
-            // Remove from list
-            QString deleted_file = image_files.takeAt(current_index);
-
-            // Update index
-            if (current_index >= image_files.size() && !image_files.isEmpty()) {
-                current_index = image_files.size() - 1;
-            }
-
-            // Load new image or clear
-            if (!image_files.isEmpty()) {
-                load_current_image();
-            } else {
-                annotation_widget->clear();
-                info_label->setText(tr("未加载图片"));
-                prev_btn->setEnabled(false);
-                next_btn->setEnabled(false);
-            }
-
+            QString deleted_file = remove_current_from_list();
             status_label->setText(QString(tr("已删除: %1")).arg(deleted_file));
-            update_image_list();
         }
     }
 }
 
 void MainWindow::delete_current_image_with_backup() {
     if (current_index >= 0 && current_index < image_files.size()) {
-        QString image_path = image_folder + "/" + image_files.at(current_index);
-        QString txt_path = QFileInfo(image_path).absolutePath() + "/" +
-                           QFileInfo(image_path).completeBaseName() + ".txt";
-
-        // Create bak folder
-        QString bak_folder = image_folder + "/bak";
-        QDir dir;
-        if (!dir.exists(bak_folder)) {
-            dir.mkpath(bak_folder);
+        // 图片与标注文件重命名到 bak 目录，不复制文件内容，可以撤销
+        ImageTrash::Entry entry;
+        entry.file = image_files.at(current_index);
+        entry.row = current_index;
+        entry.has_record = dataset_index->contains(entry.file);
+        entry.record = dataset_index->record(entry.file);
+        if (!image_trash.move_to_trash(entry)) {
+            QMessageBox::warning(this, tr("警告"), QString(tr("无法删除图片 %1")).arg(entry.file));
+            return;
         }
 
-        // Backup image file
-        if (QFile::exists(image_path)) {
-            QString image_bak_path = bak_folder + "/" + image_files.at(current_index);
-            QFile::copy(image_path, image_bak_path);
-        }
+        QString deleted_file = remove_current_from_list();
+        undo_delete_action->setEnabled(true);
+        status_label->setText(QString(tr("已删除并备份: %1 (Shift+E 撤销)")).arg(deleted_file));
+    }
+}
 
-        // Backup annotation file
-        if (QFile::exists(txt_path)) {
-            QString txt_filename = QFileInfo(image_files.at(current_index)).completeBaseName() + ".txt";
-            QString txt_bak_path = bak_folder + "/" + txt_filename;
-            QFile::copy(txt_path, txt_bak_path);
-        }
+void MainWindow::undo_delete_image() {
+    if (!image_trash.can_undo()) {
+        return;
+    }
 
-        // Delete original files
-        if (QFile::exists(image_path)) {
-            QFile::remove(image_path);
-        }
+    QList<ImageTrash::Entry> entries;
+    bool restored = image_trash.undo(&entries);
+    undo_delete_action->setEnabled(image_trash.can_undo());
+    if (!restored) {
+        QMessageBox::warning(this, tr("警告"), tr("无法恢复删除的图片"));
+        return;
+    }
 
-        if (QFile::exists(txt_path)) {
-            QFile::remove(txt_path);
+    // 按原行号升序放回原来的位置，多张图片时只通知视图一次
+    save_current_annotations();
+    bool batch_update = entries.size() > 1;
+    if (batch_update) {
+        image_model->begin_reset();
+    }
+    QVector<int> rows;
+    for (const ImageTrash::Entry &entry: entries) {
+        int row = qBound(0, entry.row, image_files.size());
+        if (!batch_update) {
+            image_model->begin_insert(row);
         }
-
-        // Remove from list
-        QString deleted_file = image_files.takeAt(current_index);
-
-        // Update index
-        if (current_index >= image_files.size() && !image_files.isEmpty()) {
-            current_index = image_files.size() - 1;
+        image_files.insert(row, entry.file);
+        if (!batch_update) {
+            image_model->end_insert();
         }
+        rows.append(row);
+    }
 
-        // Load new image or clear
-        if (!image_files.isEmpty()) {
-            load_current_image();
+    QList<QPair<QString, ImageRecord>> records;
+    QStringList unindexed;
+    for (const ImageTrash::Entry &entry: entries) {
+        if (entry.has_record) {
+            records.append(qMakePair(entry.file, entry.record));
         } else {
-            annotation_widget->clear();
-            info_label->setText(tr("未加载图片"));
-            prev_btn->setEnabled(false);
-            next_btn->setEnabled(false);
+            unindexed.append(entry.file);
         }
-
-        status_label->setText(QString(tr("已删除并备份: %1")).arg(deleted_file));
     }
-}
-
-void MainWindow::zoom_in() {
-    annotation_widget->zoom_in();
-    update_status();
-}
+    dataset_index->restore_images(records);
+    dataset_index->update_images(unindexed);
+    for (int row: rows) {
+        sync_image_summaries(row, row);
+    }
+    if (batch_update) {
+        image_model->end_reset();
+    } else {
+        image_model->refresh_row(rows.first());
+    }
 
-void MainWindow::zoom_out() {
-    annotation_widget->zoom_out();
-    update_status();
+    current_index = rows.first();
+    load_current_image();
+    prev_btn->setEnabled(true);
+    next_btn->setEnabled(true);
+    status_label->setText(QString(tr("已恢复 %1 张图片")).arg(entries.size()));
 }
 
-void MainWindow::reset_view() {
-    annotation_widget->reset_view();
-    update_status();
+void MainWindow::on_image_list_context_menu(const QPoint &pos) {
+    if (!image_list->selectionModel()->hasSelection()) {
+        return;
+    }
+    batch_menu->exec(image_list->viewport()->mapToGlobal(pos));
 }
 
-void MainWindow::on_rectangle_drawn(QRect rect) {
-    status_label->setText(QString(tr("已添加标注框: 位置(%1, %2) 大小(%3x%4)"))
-        .arg(rect.x()).arg(rect.y()).arg(rect.width()).arg(rect.height()));
+void MainWindow::batch_delete_images() {
+    QVector<int> rows = selected_rows();
+    if (rows.isEmpty()) {
+        return;
+    }
 
-    // 更新信息标签中的标注数量
-    if (current_index >= 0 && current_index < image_files.size()) {
-        int rect_count = annotation_widget->get_rectangle_count();
-        info_label->setText(QString("图片: %1 (%2/%3) 标注数量: %4")
-            .arg(image_files.at(current_index))
-            .arg(current_index + 1)
-            .arg(image_files.size())
-            .arg(rect_count));
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, tr("确认删除"),
+        QString(tr("确定要将所选的 %1 张图片及其标注文件移入 bak 文件夹吗？")).arg(rows.size()),
+        QMessageBox::Yes | QMessageBox::No);
+    if (reply == QMessageBox::Yes) {
+        start_batch_operation(BatchOperation::MoveToTrash, rows);
     }
 }
 
-void MainWindow::on_mouse_moved(QPoint pos) {
-    update_status();
-}
+void MainWindow::batch_move_images() {
+    if (selected_rows().isEmpty()) {
+        return;
+    }
 
-void MainWindow::on_rectangle_selected(int index) {
-    // 可以在这里添加处理矩形选择的代码
-    // 例如更新状态栏或其他UI元素
-    Q_UNUSED(index);
+    QString target = QFileDialog::getExistingDirectory(this, tr("选择目标文件夹"));
+    if (target.isEmpty()) {
+        return;
+    }
+    if (BatchOperation::is_inside_folder(target, image_folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("目标文件夹不能是当前图片文件夹或其中的子文件夹"));
+        return;
+    }
+    start_batch_operation(BatchOperation::MoveToFolder, selected_rows(), target);
 }
 
-void MainWindow::on_rectangle_class_changed(int index, int classId) {
-    // 更新状态栏信息
-    status_label->setText(QString(tr("已更改标注框 %1 的类别为 %2")).arg(index).arg(classId));
+void MainWindow::batch_copy_labels() {
+    if (selected_rows().isEmpty()) {
+        return;
+    }
 
-    // 更新信息标签中的标注数量
-    if (current_index >= 0 && current_index < image_files.size()) {
-        int rect_count = annotation_widget->get_rectangle_count();
-        info_label->setText(QString("图片: %1 (%2/%3) 标注数量: %4")
-            .arg(image_files.at(current_index))
-            .arg(current_index + 1)
-            .arg(image_files.size())
-            .arg(rect_count));
+    QString target = QFileDialog::getExistingDirectory(this, tr("选择目标文件夹"));
+    if (target.isEmpty()) {
+        return;
+    }
+    if (BatchOperation::is_inside_folder(target, image_folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("目标文件夹不能是当前图片文件夹或其中的子文件夹"));
+        return;
     }
+    start_batch_operation(BatchOperation::CopyLabels, selected_rows(), target);
 }
 
-void MainWindow::on_class_changed(int index) {
-    annotation_widget->set_current_class(index);
-}
+void MainWindow::batch_clear_labels() {
+    QVector<int> rows = selected_rows();
+    if (rows.isEmpty()) {
+        return;
+    }
 
-void MainWindow::delete_selected_rectangle() {
-    annotation_widget->delete_selected_rectangle();
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, tr("确认清除"),
+        QString(tr("确定要删除所选的 %1 张图片的标注文件吗？")).arg(rows.size()),
+        QMessageBox::Yes | QMessageBox::No);
+    if (reply == QMessageBox::Yes) {
+        start_batch_operation(BatchOperation::ClearLabels, rows);
+    }
 }
 
-void MainWindow::update_status() {
-    // Update status bar info
-    QString status_text = QString(tr("缩放: %1x")).arg(annotation_widget->get_scale_factor(), 0, 'f', 2);
-    if (!image_files.isEmpty()) {
-        status_text += QString(tr(" | 图片: %1/%2")).arg(current_index + 1).arg(image_files.size());
+QVector<int> MainWindow::selected_rows() const {
+    // 按选择范围转换为文件列表中的行号，不逐个构造 QModelIndex
+    QVector<int> rows;
+    const QItemSelection ranges = image_list->selectionModel()->selection();
+    for (const QItemSelectionRange &range: ranges) {
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            int source = image_model->source_row(row);
+            if (source >= 0) {
+                rows.append(source);
+            }
+        }
     }
-    status_label->setText(status_text);
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
 }
 
-void MainWindow::keyPressEvent(QKeyEvent *event) {
-    // Pass unhandled key events to annotation widget
-    // QApplication::sendEvent(annotation_widget, event);
-}
+void MainWindow::start_batch_operation(BatchOperation::Type type, const QVector<int> &rows, const QString &target) {
+    if (batch_operation->is_running()) {
+        return;
+    }
+    if (rows.isEmpty()) {
+        return;
+    }
 
-void MainWindow::closeEvent(QCloseEvent *event) {
+    // 先保存当前图片，避免之后把旧的标注写回
     save_current_annotations();
-    event->accept();
-}
 
-void MainWindow::update_image_list() {
-    image_list->clear();
-    for (int i = 0; i < image_files.size(); ++i) {
-        QString text = image_files.at(i);
-        QListWidgetItem *item = new QListWidgetItem();
+    // 记录开始时的行号与索引记录，处理期间列表可能被文件夹监视更新
+    QStringList files;
+    batch_items.clear();
+    for (int row: rows) {
+        ImageTrash::Entry item;
+        item.file = image_files.at(row);
+        item.row = row;
+        if (type == BatchOperation::MoveToTrash) {
+            item.has_record = dataset_index->contains(item.file);
+            item.record = dataset_index->record(item.file);
+        }
+        batch_items.append(item);
+        files.append(item.file);
+    }
+
+    show_progress_dialog(QString(tr("正在处理 %1 张图片...")).arg(files.size()), files.size());
+    connect(batch_progress, &QProgressDialog::canceled, batch_operation, &BatchOperation::cancel);
+
+    batch_timer.start();
+    batch_operation->start(type, image_folder, files, target);
+}
+
+void MainWindow::on_batch_progress(int done, int total) {
+    if (batch_progress) {
+        batch_progress->setMaximum(total);
+        batch_progress->setValue(done);
+    }
+}
+
+void MainWindow::on_batch_finished(const QList<BatchOperation::Result> &results) {
+    close_progress_dialog();
+
+    QStringList succeeded;
+    QHash<QString, int> succeeded_results;
+    for (int i = 0; i < results.size(); ++i) {
+        if (results.at(i).ok) {
+            succeeded.append(results.at(i).file);
+            succeeded_results.insert(results.at(i).file, i);
+        }
+    }
+
+    switch (batch_operation->type()) {
+        case BatchOperation::MoveToTrash: {
+            // 整批记录为一次删除，撤销时一起恢复
+            QList<ImageTrash::Entry> entries;
+            for (ImageTrash::Entry item: batch_items) {
+                auto it = succeeded_results.constFind(item.file);
+                if (it != succeeded_results.constEnd()) {
+                    item.image_path = results.at(it.value()).image_path;
+                    item.label_path = results.at(it.value()).label_path;
+                    entries.append(item);
+                }
+            }
+            image_trash.push(entries);
+            undo_delete_action->setEnabled(image_trash.can_undo());
+            remove_files_from_list(succeeded);
+            break;
+        }
+        case BatchOperation::MoveToFolder:
+            remove_files_from_list(succeeded);
+            break;
+        case BatchOperation::ClearLabels:
+            // 重新扫描标注状态，当前图片重新加载以免保存时写回旧标注
+            dataset_index->update_images(succeeded);
+            if (current_index >= 0 && current_index < image_files.size() &&
+                succeeded_results.contains(image_files.at(current_index))) {
+                load_current_image();
+            }
+            break;
+        case BatchOperation::CopyLabels:
+            break;
+        case BatchOperation::ConvertLabels:
+            // 转换时出现的新类别名称已追加到 classes.txt，同步到类别列表
+            if (batch_operation->classes().size() > classes.size()) {
+                on_classes_discovered(batch_operation->classes());
+            }
+            break;
+    }
+    batch_items.clear();
+
+    status_label->setText(QString(tr("批量操作完成: 成功 %1, 失败 %2"))
+        .arg(succeeded.size()).arg(results.size() - succeeded.size()));
+
+    if (batch_operation->type() == BatchOperation::ConvertLabels && !results.isEmpty()) {
+        LabelStore::flush_all();
+        // 报告转换速度（文件/秒），并询问是否切换到转换后的格式
+        double seconds = qMax<qint64>(batch_timer.elapsed(), 1) / 1000.0;
+        status_label->setText(QString(tr("标注转换完成: 成功 %1, 失败 %2, %3 个文件/秒"))
+            .arg(succeeded.size()).arg(results.size() - succeeded.size())
+            .arg(results.size() / seconds, 0, 'f', 0));
+
+        const LabelFormat *target = LabelFormat::format(convert_target);
+        if (target && target != LabelFormat::folder_format(image_folder)) {
+            QMessageBox::StandardButton reply = QMessageBox::question(
+                this, tr("标注格式"),
+                QString(tr("是否将当前文件夹的标注格式切换为 %1？")).arg(target->name()),
+                QMessageBox::Yes | QMessageBox::No);
+            if (reply == QMessageBox::Yes) {
+                set_label_format(target->id());
+            }
+        }
+    }
+}
+
+void MainWindow::set_label_format(const QString &id) {
+    const LabelFormat *format = LabelFormat::format(id);
+    if (!format || image_folder.isEmpty()) {
+        update_label_format_menu();
+        return;
+    }
+    if (format == LabelFormat::folder_format(image_folder)) {
+        return;
+    }
+
+    // 先按原格式保存当前图片，再切换格式重新加载并更新索引
+    save_current_annotations();
+    LabelFormat::set_folder_format(image_folder, format->id());
+    annotation_widget->set_label_format(format);
+    update_label_format_menu();
+    load_current_image();
+    if (!image_files.isEmpty()) {
+        dataset_index->build(image_files.to_string_list());
+    }
+    status_label->setText(QString(tr("标注格式: %1")).arg(format->name()));
+}
+
+void MainWindow::update_label_format_menu() {
+    QString id = image_folder.isEmpty() ? LabelFormat::default_format()->id()
+                                        : LabelFormat::folder_format(image_folder)->id();
+    for (QAction *action: label_format_group->actions()) {
+        action->setChecked(action->data().toString() == id);
+    }
+}
+
+void MainWindow::convert_labels(const QString &id) {
+    if (image_files.isEmpty()) {
+        QMessageBox::information(this, tr("转换标注"), tr("未加载图片文件夹"));
+        return;
+    }
+
+    // 转换整个文件夹，原格式的标注文件保留
+    QVector<int> rows(image_files.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    convert_target = id;
+    start_batch_operation(BatchOperation::ConvertLabels, rows, id);
+}
+
+void MainWindow::on_classes_discovered(const QStringList &discovered) {
+    // 标注文件中出现了新的类别名称，追加到类别列表并保持当前选择
+    int current = class_combo->currentIndex();
+    classes = discovered;
+    save_classes();
+    load_classes();
+    if (current >= 0 && current < classes.size()) {
+        class_combo->setCurrentIndex(current);
+        annotation_widget->set_current_class(current);
+    }
+}
+
+void MainWindow::on_annotations_unreadable(const QString &label_path) {
+    // 在图片加载完成后再提示，加载过程中不弹出模态对话框
+    QMetaObject::invokeMethod(this, [this, label_path]() {
+        QMessageBox::warning(this, tr("警告"),
+                             QString(tr("无法解析标注文件 %1\n该图片以只读方式显示，修改不会保存，原文件保持不变。"))
+                                 .arg(label_path));
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::show_progress_dialog(const QString &text, int maximum) {
+    // 模态进度对话框，处理期间不能切换或修改图片
+    close_progress_dialog();
+    batch_progress = new QProgressDialog(text, tr("取消"), 0, maximum, this);
+    batch_progress->setWindowModality(Qt::WindowModal);
+    batch_progress->setMinimumDuration(0);
+    batch_progress->setAutoClose(false);
+    batch_progress->setAutoReset(false);
+    batch_progress->setValue(0);
+}
+
+void MainWindow::close_progress_dialog() {
+    if (batch_progress) {
+        // 关闭对话框也会发出 canceled 信号，先断开连接
+        QProgressDialog *dialog = batch_progress;
+        batch_progress = nullptr;
+        dialog->disconnect();
+        dialog->close();
+        dialog->deleteLater();
+    }
+}
+
+void MainWindow::export_coco() {
+    if (image_files.isEmpty() || coco_exporter->is_running()) {
+        return;
+    }
+
+    QString output = QFileDialog::getSaveFileName(this, tr("导出 COCO 标注"), image_folder + "/annotations.json",
+                                                  tr("COCO 标注文件 (*.json)"));
+    if (output.isEmpty()) {
+        return;
+    }
+
+    // 索引中已有的尺寸直接使用，其余由导出线程读取文件头
+    save_current_annotations();
+    QStringList files = image_files.to_string_list();
+    QList<QSize> sizes;
+    sizes.reserve(files.size());
+    for (const QString &file: files) {
+        ImageRecord record = dataset_index->record(file);
+        sizes.append(QSize(record.width, record.height));
+    }
+
+    if (!coco_exporter->start(image_folder, files, sizes, classes, output)) {
+        QMessageBox::warning(this, tr("警告"), QString(tr("无法创建文件 %1")).arg(output));
+        return;
+    }
+    if (coco_exporter->is_running()) {
+        show_progress_dialog(QString(tr("正在导出 %1 张图片...")).arg(files.size()), files.size());
+        connect(batch_progress, &QProgressDialog::canceled, this, [this]() {
+            coco_exporter->cancel();
+            close_progress_dialog();
+            status_label->setText(tr("导出已取消"));
+        });
+    }
+}
+
+void MainWindow::on_export_finished(bool ok, const QString &message) {
+    close_progress_dialog();
+
+    // 导出时出现的新类别名称已追加到 classes.txt，同步到类别列表
+    QStringList exported;
+    if (sender() == coco_exporter) {
+        exported = coco_exporter->classes();
+    } else if (sender() == shard_exporter) {
+        exported = shard_exporter->classes();
+    } else if (sender() == split_generator) {
+        exported = split_generator->classes();
+    } else if (sender() == crop_exporter) {
+        exported = crop_exporter->classes();
+    }
+    if (exported.size() > classes.size()) {
+        on_classes_discovered(exported);
+    }
+    if (ok) {
+        status_label->setText(message);
+    } else {
+        QMessageBox::warning(this, tr("导出失败"), message);
+    }
+}
+
+void MainWindow::export_shards() {
+    if (image_files.isEmpty() || shard_exporter->is_running()) {
+        return;
+    }
+
+    QString output = QFileDialog::getExistingDirectory(this, tr("选择分片输出文件夹"));
+    if (output.isEmpty()) {
+        return;
+    }
+    // 输出在图片文件夹内时分片会被当作数据集的一部分
+    if (BatchOperation::is_inside_folder(output, image_folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("目标文件夹不能是当前图片文件夹或其中的子文件夹"));
+        return;
+    }
+
+    bool ok = false;
+    int shard_mb = QInputDialog::getInt(this, tr("导出 WebDataset 分片"), tr("每个分片的大小 (MB):"),
+                                        1024, 16, 65536, 64, &ok);
+    if (!ok) {
+        return;
+    }
+
+    // 索引中已有的文件大小直接用于划分分片
+    save_current_annotations();
+    LabelStore::flush_all();
+    QStringList files = image_files.to_string_list();
+    QList<qint64> sizes;
+    sizes.reserve(files.size());
+    for (const QString &file: files) {
+        sizes.append(dataset_index->record(file).size);
+    }
+
+    if (!shard_exporter->start(image_folder, files, sizes, classes, output, qint64(shard_mb) << 20)) {
+        QMessageBox::warning(this, tr("警告"), QString(tr("无法创建文件夹 %1")).arg(output));
+        return;
+    }
+    if (shard_exporter->is_running()) {
+        show_progress_dialog(QString(tr("正在导出 %1 张图片...")).arg(files.size()), files.size());
+        connect(batch_progress, &QProgressDialog::canceled, this, [this]() {
+            shard_exporter->cancel();
+            close_progress_dialog();
+            status_label->setText(tr("导出已取消"));
+        });
+    }
+}
+
+void MainWindow::generate_splits() {
+    if (image_files.isEmpty() || split_generator->is_running()) {
+        return;
+    }
+    // 按类别分层需要完整的索引
+    if (dataset_index->is_building()) {
+        QMessageBox::information(this, tr("生成数据集划分"), tr("索引仍在建立中，请等待索引完成后再生成划分"));
+        return;
+    }
 
-        // 设置省略号模式，当文件名过长时在中间显示省略号
-        QFontMetrics metrics(image_list->font());
-        QString elidedText = metrics.elidedText(text, Qt::ElideMiddle, image_list->width() - 20);
-        item->setText(elidedText);
+    QString output = QFileDialog::getExistingDirectory(this, tr("选择划分输出文件夹"));
+    if (output.isEmpty()) {
+        return;
+    }
+    if (BatchOperation::is_inside_folder(output, image_folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("目标文件夹不能是当前图片文件夹或其中的子文件夹"));
+        return;
+    }
 
-        if (i == current_index) {
-            item->setSelected(true);
-            image_list->setCurrentItem(item);
+    bool ok = false;
+    QString text = QInputDialog::getText(this, tr("生成数据集划分"), tr("train / val / test 比例:"),
+                                         QLineEdit::Normal, "0.8, 0.1, 0.1", &ok);
+    if (!ok) {
+        return;
+    }
+    QVector<double> ratios;
+    for (const QString &part: text.split(QRegularExpression("[,\\s/]+"), Qt::SkipEmptyParts)) {
+        double ratio = part.toDouble(&ok);
+        if (!ok || ratio < 0) {
+            break;
         }
-        image_list->addItem(item);
+        ratios.append(ratio);
+    }
+    while (ok && ratios.size() < SplitGenerator::SplitCount) {
+        ratios.append(0);
+    }
+    if (!ok || ratios.size() != SplitGenerator::SplitCount || ratios.at(SplitGenerator::Train) <= 0) {
+        QMessageBox::warning(this, tr("警告"), tr("比例格式错误，例如: 0.8, 0.1, 0.1"));
+        return;
+    }
+
+    // 各图片的类别数量来自数据集索引（由标注文件统计）
+    save_current_annotations();
+    LabelStore::flush_all();
+    QStringList files = image_files.to_string_list();
+    QList<QMap<int, int>> class_counts;
+    class_counts.reserve(files.size());
+    for (const QString &file: files) {
+        class_counts.append(dataset_index->record(file).class_counts);
+    }
+
+    if (!split_generator->start(image_folder, files, class_counts, classes, ratios, output, 0)) {
+        QMessageBox::warning(this, tr("警告"), QString(tr("无法创建文件夹 %1")).arg(output));
+        return;
+    }
+    show_progress_dialog(QString(tr("正在划分 %1 张图片...")).arg(files.size()), files.size());
+    connect(batch_progress, &QProgressDialog::canceled, this, [this]() {
+        split_generator->cancel();
+        close_progress_dialog();
+        status_label->setText(tr("划分已取消"));
+    });
+}
+
+void MainWindow::export_crops() {
+    if (image_files.isEmpty() || crop_exporter->is_running()) {
+        return;
+    }
+
+    QString output = QFileDialog::getExistingDirectory(this, tr("选择裁剪输出文件夹"));
+    if (output.isEmpty()) {
+        return;
+    }
+    if (BatchOperation::is_inside_folder(output, image_folder)) {
+        QMessageBox::warning(this, tr("警告"), tr("目标文件夹不能是当前图片文件夹或其中的子文件夹"));
+        return;
+    }
+
+    bool ok = false;
+    int padding = QInputDialog::getInt(this, tr("导出目标裁剪"), tr("每边扩展 (%):"), 0, 0, 100, 5, &ok);
+    if (!ok) {
+        return;
+    }
+    int size = QInputDialog::getInt(this, tr("导出目标裁剪"), tr("输出最长边 (像素, 0 为原尺寸):"),
+                                    224, 0, 8192, 32, &ok);
+    if (!ok) {
+        return;
+    }
+
+    save_current_annotations();
+    LabelStore::flush_all();
+    QStringList files = image_files.to_string_list();
+    if (!crop_exporter->start(image_folder, files, classes, output, padding / 100.0, size)) {
+        QMessageBox::warning(this, tr("警告"), QString(tr("无法创建文件夹 %1")).arg(output));
+        return;
+    }
+    if (crop_exporter->is_running()) {
+        show_progress_dialog(QString(tr("正在裁剪 %1 张图片...")).arg(files.size()), files.size());
+        connect(batch_progress, &QProgressDialog::canceled, this, [this]() {
+            crop_exporter->cancel();
+            close_progress_dialog();
+            status_label->setText(tr("导出已取消"));
+        });
+    }
+}
+
+void MainWindow::resize_images() {
+    if (image_files.isEmpty() || image_resizer->is_running()) {
+        return;
+    }
+
+    bool ok = false;
+    int max_side = QInputDialog::getInt(this, tr("缩小全部图片"), tr("最长边 (像素):"), 1280, 16, 65536, 64, &ok);
+    if (!ok) {
+        return;
+    }
+    int quality = QInputDialog::getInt(this, tr("缩小全部图片"), tr("JPEG 质量:"), 90, 1, 100, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    // 原地替换图片文件，先确认
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, tr("缩小全部图片"),
+        QString(tr("将把最长边超过 %1 像素的图片缩小并覆盖原文件，标注同步调整。图片的 EXIF 等元数据不会保留，此操作无法撤销，是否继续？"))
+            .arg(max_side),
+        QMessageBox::Yes | QMessageBox::No);
+    if (reply != QMessageBox::Yes) {
+        return;
+    }
+
+    save_current_annotations();
+    LabelStore::flush_all();
+    QStringList files = image_files.to_string_list();
+    image_resizer->start(image_folder, files, classes, max_side, quality);
+    if (image_resizer->is_running()) {
+        show_progress_dialog(QString(tr("正在缩小 %1 张图片...")).arg(files.size()), files.size());
+        connect(batch_progress, &QProgressDialog::canceled, this, [this]() {
+            image_resizer->cancel();
+            close_progress_dialog();
+            status_label->setText(tr("缩小已取消"));
+        });
+    }
+}
+
+void MainWindow::on_resize_finished(bool ok, const QString &message, const QStringList &resized) {
+    close_progress_dialog();
+
+    // 图片尺寸与像素坐标的标注已改变，重新扫描并重新加载当前图片
+    dataset_index->update_images(resized);
+    if (current_index >= 0 && current_index < image_files.size() && resized.contains(image_files.at(current_index))) {
+        load_current_image();
+    }
+
+    if (ok) {
+        status_label->setText(message);
+    } else {
+        QMessageBox::warning(this, tr("缩小失败"), message);
+    }
+}
+
+void MainWindow::import_coco() {
+    if (image_folder.isEmpty() || coco_importer->is_running()) {
+        return;
+    }
+
+    QString input = QFileDialog::getOpenFileName(this, tr("导入 COCO 标注"), image_folder,
+                                                 tr("COCO 标注文件 (*.json)"));
+    if (input.isEmpty()) {
+        return;
+    }
+
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, tr("确认导入"), tr("导入会覆盖 COCO 文件中包含标注的图片的现有标注文件，是否继续？"),
+        QMessageBox::Yes | QMessageBox::No);
+    if (reply != QMessageBox::Yes) {
+        return;
+    }
+
+    save_current_annotations();
+    coco_importer->start(input, image_folder, classes);
+    show_progress_dialog(tr("正在导入 COCO 标注..."), 100);
+    connect(batch_progress, &QProgressDialog::canceled, coco_importer, &CocoImporter::cancel);
+}
+
+void MainWindow::on_coco_import_finished(bool ok, const QString &message, const QStringList &files,
+                                         const QStringList &imported_classes) {
+    close_progress_dialog();
+
+    // COCO 中新出现的类别追加到 classes.txt
+    if (imported_classes != classes) {
+        int current_class = class_combo->currentIndex();
+        classes = imported_classes;
+        save_classes();
+        load_classes();
+        class_combo->setCurrentIndex(qMax(0, current_class));
+    }
+
+    // 重新扫描写入了标注的图片，当前图片重新加载
+    dataset_index->update_images(files);
+    load_current_image();
+
+    if (ok) {
+        status_label->setText(message);
+    } else {
+        QMessageBox::warning(this, tr("导入失败"), message);
+    }
+}
+
+void MainWindow::remove_files_from_list(const QStringList &files) {
+    QVector<int> rows;
+    const QVector<int> lookup = image_files.index_of_all(files);
+    for (int row: lookup) {
+        if (row >= 0) {
+            rows.append(row);
+        }
+    }
+    if (rows.isEmpty()) {
+        return;
+    }
+    std::sort(rows.begin(), rows.end());
+
+    // 当前行之前被删除的行数，用来换算当前图片的新行号
+    int removed_before = static_cast<int>(std::lower_bound(rows.begin(), rows.end(), current_index) - rows.begin());
+    bool current_removed = removed_before < rows.size() && rows.at(removed_before) == current_index;
+
+    // 一次删除全部行，只重置一次列表
+    image_model->begin_reset();
+    image_files.remove_rows(rows);
+    image_model->end_reset();
+    dataset_index->remove_images(files);
+
+    if (image_files.isEmpty()) {
+        current_index = 0;
+        annotation_widget->clear();
+        info_label->setText(tr("未加载图片"));
+        prev_btn->setEnabled(false);
+        next_btn->setEnabled(false);
+        return;
+    }
+
+    current_index = qBound(0, current_index - removed_before, image_files.size() - 1);
+    if (current_removed) {
+        load_current_image();
+    } else {
+        update_image_list();
+        update_status();
+    }
+}
+
+QString MainWindow::remove_current_from_list() {
+    // Remove from list
+    image_model->begin_remove(current_index);
+    QString deleted_file = image_files.takeAt(current_index);
+    image_model->end_remove();
+    dataset_index->remove_image(deleted_file);
+
+    // Update index
+    if (current_index >= image_files.size() && !image_files.isEmpty()) {
+        current_index = image_files.size() - 1;
+    }
+
+    // Load new image or clear
+    if (!image_files.isEmpty()) {
+        load_current_image();
+    } else {
+        annotation_widget->clear();
+        info_label->setText(tr("未加载图片"));
+        prev_btn->setEnabled(false);
+        next_btn->setEnabled(false);
+    }
+    return deleted_file;
+}
+
+void MainWindow::zoom_in() {
+    annotation_widget->zoom_in();
+    update_status();
+}
+
+void MainWindow::zoom_out() {
+    annotation_widget->zoom_out();
+    update_status();
+}
+
+void MainWindow::reset_view() {
+    annotation_widget->reset_view();
+    update_status();
+}
+
+void MainWindow::on_rectangle_drawn(QRect rect) {
+    status_label->setText(QString(tr("已添加标注框: 位置(%1, %2) 大小(%3x%4)"))
+        .arg(rect.x()).arg(rect.y()).arg(rect.width()).arg(rect.height()));
+
+    // 更新信息标签中的标注数量
+    if (current_index >= 0 && current_index < image_files.size()) {
+        int rect_count = annotation_widget->get_rectangle_count();
+        info_label->setText(QString("图片: %1 (%2/%3) 标注数量: %4")
+            .arg(image_files.at(current_index))
+            .arg(current_index + 1)
+            .arg(image_files.size())
+            .arg(rect_count));
+    }
+}
+
+void MainWindow::on_mouse_moved(QPoint pos) {
+    update_status();
+}
+
+void MainWindow::on_rectangle_selected(int index) {
+    // 可以在这里添加处理矩形选择的代码
+    // 例如更新状态栏或其他UI元素
+    Q_UNUSED(index);
+}
+
+void MainWindow::on_rectangle_class_changed(int index, int classId) {
+    // 更新状态栏信息
+    status_label->setText(QString(tr("已更改标注框 %1 的类别为 %2")).arg(index).arg(classId));
+
+    // 更新信息标签中的标注数量
+    if (current_index >= 0 && current_index < image_files.size()) {
+        int rect_count = annotation_widget->get_rectangle_count();
+        info_label->setText(QString("图片: %1 (%2/%3) 标注数量: %4")
+            .arg(image_files.at(current_index))
+            .arg(current_index + 1)
+            .arg(image_files.size())
+            .arg(rect_count));
+    }
+}
+
+void MainWindow::on_class_changed(int index) {
+    annotation_widget->set_current_class(index);
+}
+
+void MainWindow::delete_selected_rectangle() {
+    annotation_widget->delete_selected_rectangle();
+}
+
+void MainWindow::update_status() {
+    // Update status bar info
+    QString status_text = QString(tr("缩放: %1x")).arg(annotation_widget->get_scale_factor(), 0, 'f', 2);
+    if (!image_files.isEmpty()) {
+        status_text += QString(tr(" | 图片: %1/%2")).arg(current_index + 1).arg(image_files.size());
+    }
+    status_label->setText(status_text);
+}
+
+void MainWindow::keyPressEvent(QKeyEvent *event) {
+    // Pass unhandled key events to annotation widget
+    // QApplication::sendEvent(annotation_widget, event);
+}
+
+void MainWindow::closeEvent(QCloseEvent *event) {
+    save_current_annotations();
+    LabelStore::flush_all();
+    event->accept();
+}
+
+void MainWindow::update_image_list() {
+    // 同步列表中的选中项为当前图片，当前图片被筛选掉时不选中任何行
+    int row = image_model->view_row(current_index);
+    if (row >= 0) {
+        // 多选时只移动当前项，不清除已选中的图片
+        QModelIndex index = image_model->index(row);
+        QItemSelectionModel *selection = image_list->selectionModel();
+        const QItemSelection ranges = selection->selection();
+        bool multiple = ranges.size() > 1 || (ranges.size() == 1 && ranges.first().height() > 1);
+        selection->setCurrentIndex(index, multiple && selection->isSelected(index)
+                                          ? QItemSelectionModel::NoUpdate
+                                          : QItemSelectionModel::ClearAndSelect);
+        image_list->scrollTo(index);
+    } else {
+        image_list->clearSelection();
     }
 }
 
-void MainWindow::on_image_list_item_clicked(QListWidgetItem *item) {
-    int row = image_list->row(item);
+void MainWindow::reload_image_list() {
+    image_model->begin_reset();
+    image_model->end_reset();
+    update_image_list();
+}
+
+void MainWindow::on_image_list_item_clicked(const QModelIndex &index) {
+    int row = image_model->source_row(index.row());
     if (row >= 0 && row < image_files.size() && row != current_index) {
         save_current_annotations();
         current_index = row;
         load_current_image();
+    }
+}
+
+void MainWindow::apply_filter() {
+    image_model->set_filter(ImageFilter::parse(filter_edit->text(), classes));
+
+    // 当前图片不在筛选结果中时跳到第一张匹配的图片
+    if (image_model->view_row(current_index) < 0 && image_model->rowCount() > 0) {
+        save_current_annotations();
+        current_index = image_model->source_row(0);
+        load_current_image();
+    } else {
         update_image_list();
     }
+
+    if (image_model->is_filtered()) {
+        status_label->setText(QString(tr("筛选结果: %1/%2")).arg(image_model->rowCount()).arg(image_files.size()));
+    } else {
+        update_status();
+    }
+}
+
+void MainWindow::sync_image_summaries(int first, int last) {
+    // 将索引中的标注统计复制到文件列表的摘要中，供筛选使用
+    for (int i = qMax(0, first); i <= last && i < image_files.size(); ++i) {
+        image_files.set_summary(i, dataset_index->summary(image_files.at(i)));
+    }
 }
 
 void MainWindow::create_language_menu() {
@@ -710,3 +2062,388 @@ void MainWindow::show_about() {
 
     QMessageBox::about(this, tr("关于 ImageLabeler"), about_text);
 }
+
+
+void MainWindow::create_dataset_menu() {
+    QMenu *dataset_menu = menuBar()->addMenu(tr("数据集"));
+
+    QAction *archive_action = new QAction(tr("打开压缩包..."), this);
+    connect(archive_action, &QAction::triggered, this, &MainWindow::load_archive);
+    dataset_menu->addAction(archive_action);
+
+    QAction *remote_action = new QAction(tr("打开对象存储..."), this);
+    connect(remote_action, &QAction::triggered, this, &MainWindow::load_remote);
+    dataset_menu->addAction(remote_action);
+    dataset_menu->addSeparator();
+
+    QAction *statistics_action = new QAction(tr("数据集统计"), this);
+    connect(statistics_action, &QAction::triggered, this, &MainWindow::show_dataset_statistics);
+    dataset_menu->addAction(statistics_action);
+
+    // 列表中选中图片的批量操作，同时用作列表的右键菜单
+    batch_menu = dataset_menu->addMenu(tr("所选图片"));
+    QAction *batch_delete_action = batch_menu->addAction(tr("删除并备份"));
+    connect(batch_delete_action, &QAction::triggered, this, &MainWindow::batch_delete_images);
+    QAction *batch_move_action = batch_menu->addAction(tr("移动到文件夹..."));
+    connect(batch_move_action, &QAction::triggered, this, &MainWindow::batch_move_images);
+    QAction *batch_copy_action = batch_menu->addAction(tr("复制标注到文件夹..."));
+    connect(batch_copy_action, &QAction::triggered, this, &MainWindow::batch_copy_labels);
+    QAction *batch_clear_action = batch_menu->addAction(tr("清除标注"));
+    connect(batch_clear_action, &QAction::triggered, this, &MainWindow::batch_clear_labels);
+
+    dataset_menu->addSeparator();
+
+    QAction *export_coco_action = new QAction(tr("导出 COCO 标注..."), this);
+    connect(export_coco_action, &QAction::triggered, this, &MainWindow::export_coco);
+    dataset_menu->addAction(export_coco_action);
+
+    QAction *import_coco_action = new QAction(tr("导入 COCO 标注..."), this);
+    connect(import_coco_action, &QAction::triggered, this, &MainWindow::import_coco);
+    dataset_menu->addAction(import_coco_action);
+
+    QAction *export_shards_action = new QAction(tr("导出 WebDataset 分片..."), this);
+    connect(export_shards_action, &QAction::triggered, this, &MainWindow::export_shards);
+    dataset_menu->addAction(export_shards_action);
+
+    QAction *generate_splits_action = new QAction(tr("生成数据集划分..."), this);
+    connect(generate_splits_action, &QAction::triggered, this, &MainWindow::generate_splits);
+    dataset_menu->addAction(generate_splits_action);
+
+    QAction *export_crops_action = new QAction(tr("导出目标裁剪..."), this);
+    connect(export_crops_action, &QAction::triggered, this, &MainWindow::export_crops);
+    dataset_menu->addAction(export_crops_action);
+
+    QAction *resize_images_action = new QAction(tr("缩小全部图片..."), this);
+    connect(resize_images_action, &QAction::triggered, this, &MainWindow::resize_images);
+    dataset_menu->addAction(resize_images_action);
+
+    dataset_menu->addSeparator();
+
+    // 标注文件格式，按文件夹保存
+    QMenu *format_menu = dataset_menu->addMenu(tr("标注格式"));
+    QMenu *convert_menu = dataset_menu->addMenu(tr("转换全部标注为"));
+    label_format_group = new QActionGroup(this);
+    label_format_group->setExclusive(true);
+    for (const LabelFormat *format: LabelFormat::formats()) {
+        QString id = format->id();
+        QAction *format_action = format_menu->addAction(format->name());
+        format_action->setCheckable(true);
+        format_action->setData(id);
+        label_format_group->addAction(format_action);
+        connect(format_action, &QAction::triggered, this, [this, id]() {
+            set_label_format(id);
+        });
+
+        QAction *convert_action = convert_menu->addAction(format->name());
+        connect(convert_action, &QAction::triggered, this, [this, id]() {
+            convert_labels(id);
+        });
+    }
+    update_label_format_menu();
+
+    dataset_menu->addSeparator();
+
+    undo_delete_action = new QAction(tr("撤销删除图片"), this);
+    undo_delete_action->setShortcut(QKeySequence("Shift+E"));
+    undo_delete_action->setEnabled(false);
+    connect(undo_delete_action, &QAction::triggered, this, &MainWindow::undo_delete_image);
+    dataset_menu->addAction(undo_delete_action);
+
+    dataset_menu->addSeparator();
+
+    // 加载文件夹时是否包含子文件夹
+    QSettings settings("ImageLabeler", "ImageLabeler");
+    recursive_action = new QAction(tr("包含子文件夹"), this);
+    recursive_action->setCheckable(true);
+    recursive_action->setChecked(settings.value("recursive_scan", false).toBool());
+    connect(recursive_action, &QAction::toggled, this, &MainWindow::set_recursive_scan);
+    dataset_menu->addAction(recursive_action);
+
+    // 图片列表显示为缩略图网格
+    thumbnail_grid_action = new QAction(tr("缩略图网格"), this);
+    thumbnail_grid_action->setCheckable(true);
+    thumbnail_grid_action->setChecked(settings.value("thumbnail_grid", false).toBool());
+    connect(thumbnail_grid_action, &QAction::toggled, this, &MainWindow::set_thumbnail_grid);
+    dataset_menu->addAction(thumbnail_grid_action);
+    set_thumbnail_grid(thumbnail_grid_action->isChecked());
+
+    // 解码慢的图片（大 PNG、TIFF 等）缓存解码结果
+    QMenu *frame_cache_menu = dataset_menu->addMenu(tr("解码缓存"));
+    frame_cache_action = new QAction(tr("缓存解码结果"), this);
+    frame_cache_action->setCheckable(true);
+    frame_cache_action->setChecked(settings.value("frame_cache", false).toBool());
+    connect(frame_cache_action, &QAction::toggled, this, &MainWindow::set_frame_cache);
+    frame_cache_menu->addAction(frame_cache_action);
+
+    QAction *frame_cache_limit_action = new QAction(tr("缓存大小上限..."), this);
+    connect(frame_cache_limit_action, &QAction::triggered, this, &MainWindow::set_frame_cache_limit);
+    frame_cache_menu->addAction(frame_cache_limit_action);
+
+    QAction *clear_frame_cache_action = new QAction(tr("清空解码缓存"), this);
+    connect(clear_frame_cache_action, &QAction::triggered, this, [this]() {
+        frame_cache->clear();
+        status_label->setText(tr("解码缓存已清空"));
+    });
+    frame_cache_menu->addAction(clear_frame_cache_action);
+
+    frame_cache->set_limit(settings.value("frame_cache_limit_mb", 4096).toLongLong() << 20);
+    set_frame_cache(frame_cache_action->isChecked());
+}
+
+void MainWindow::create_navigate_menu() {
+    QMenu *navigate_menu = menuBar()->addMenu(tr("跳转"));
+
+    QAction *minimap_action = minimap_dock->toggleViewAction();
+    minimap_action->setText(tr("显示导航图"));
+    navigate_menu->addAction(minimap_action);
+    QAction *adjust_action = adjust_dock->toggleViewAction();
+    adjust_action->setText(tr("显示调整面板"));
+    navigate_menu->addAction(adjust_action);
+    QAction *jobs_action = jobs_dock->toggleViewAction();
+    jobs_action->setText(tr("后台任务面板"));
+    navigate_menu->addAction(jobs_action);
+    navigate_menu->addSeparator();
+
+    QAction *flag_action = new QAction(tr("标记/取消标记当前图片"), this);
+    flag_action->setShortcut(QKeySequence("F"));
+    connect(flag_action, &QAction::triggered, this, &MainWindow::toggle_current_flag);
+    navigate_menu->addAction(flag_action);
+
+    navigate_menu->addSeparator();
+
+    // 每项包含向后、向前两个方向，Shift 表示向前
+    struct JumpItem {
+        QString text;
+        QString key;
+        int bit;
+        bool value;
+    };
+    const QList<JumpItem> items = {
+        {tr("未标注"), "U", ImageFileList::StatusLabelled, false},
+        {tr("已标记"), "G", ImageFileList::StatusFlagged, true},
+        {tr("有问题"), "I", ImageFileList::StatusIssues, true},
+    };
+    for (const JumpItem &item: items) {
+        QAction *next_action = new QAction(QString(tr("下一张%1图片")).arg(item.text), this);
+        next_action->setShortcut(QKeySequence(item.key));
+        int bit = item.bit;
+        bool value = item.value;
+        connect(next_action, &QAction::triggered, this, [this, bit, value]() {
+            jump_to_status(bit, value, 1);
+        });
+        navigate_menu->addAction(next_action);
+
+        QAction *prev_action = new QAction(QString(tr("上一张%1图片")).arg(item.text), this);
+        prev_action->setShortcut(QKeySequence("Shift+" + item.key));
+        connect(prev_action, &QAction::triggered, this, [this, bit, value]() {
+            jump_to_status(bit, value, -1);
+        });
+        navigate_menu->addAction(prev_action);
+    }
+
+    // 按当前选中的标签跳转
+    QAction *next_class_action = new QAction(tr("下一张包含当前标签的图片"), this);
+    next_class_action->setShortcut(QKeySequence("C"));
+    connect(next_class_action, &QAction::triggered, this, [this]() {
+        int class_id = class_combo->currentIndex();
+        jump_to_status(ImageFileList::StatusClassBase + qMin(class_id, 63), true, 1, class_id);
+    });
+    navigate_menu->addAction(next_class_action);
+
+    QAction *prev_class_action = new QAction(tr("上一张包含当前标签的图片"), this);
+    prev_class_action->setShortcut(QKeySequence("Shift+C"));
+    connect(prev_class_action, &QAction::triggered, this, [this]() {
+        int class_id = class_combo->currentIndex();
+        jump_to_status(ImageFileList::StatusClassBase + qMin(class_id, 63), true, -1, class_id);
+    });
+    navigate_menu->addAction(prev_class_action);
+}
+
+int MainWindow::find_status_row(int bit, bool value, int step, int class_id) const {
+    // 从当前图片开始在状态位图中查找，到达一端后从另一端继续，不读取任何文件
+    int row = current_index;
+    for (int pass = 0; pass < 2; ++pass) {
+        while ((row = image_files.find_next(row, step, bit, value)) >= 0) {
+            if (pass == 1 && (step > 0 ? row >= current_index : row <= current_index)) {
+                return -1;
+            }
+            // 跳过被筛选掉的图片
+            if (image_model->view_row(row) < 0) {
+                continue;
+            }
+            // 类别ID >= 63 共用一个状态位，需要查询索引确认
+            if (class_id >= 63 && !dataset_index->record(image_files.at(row)).class_counts.contains(class_id)) {
+                continue;
+            }
+            return row;
+        }
+        row = step > 0 ? -1 : image_files.size();
+    }
+    return -1;
+}
+
+void MainWindow::jump_to_status(int bit, bool value, int step, int class_id) {
+    if (image_files.isEmpty() || (bit >= ImageFileList::StatusClassBase && class_id < 0)) {
+        return;
+    }
+
+    // 先保存当前图片，使其状态参与查找
+    save_current_annotations();
+    int row = find_status_row(bit, value, step, class_id);
+    if (row < 0) {
+        status_label->setText(tr("没有找到符合条件的图片"));
+        return;
+    }
+
+    current_index = row;
+    load_current_image();
+}
+
+void MainWindow::toggle_current_flag() {
+    if (current_index < 0 || current_index >= image_files.size()) {
+        return;
+    }
+
+    bool flagged = !(image_files.summary(current_index).flags & ImageSummary::Flagged);
+    dataset_index->set_flagged(image_files.at(current_index), flagged);
+    status_label->setText(flagged ? tr("已标记当前图片") : tr("已取消标记当前图片"));
+}
+
+void MainWindow::on_index_build_progress(int done, int total) {
+    status_label->setText(QString(tr("正在建立索引: %1/%2")).arg(done).arg(total));
+}
+
+void MainWindow::on_index_build_finished() {
+    status_label->setText(QString(tr("索引已更新: 已标注 %1/%2"))
+        .arg(dataset_index->labelled_count()).arg(dataset_index->image_count()));
+
+    // 索引数据就绪后更新摘要，重新应用排序与筛选并刷新列表状态
+    sync_image_summaries(0, image_files.size() - 1);
+    if (sort_combo->currentIndex() != SortByName) {
+        sort_images(sort_combo->currentIndex());
+    } else if (image_model->is_filtered()) {
+        reload_image_list();
+    } else {
+        image_model->refresh_all();
+    }
+}
+
+void MainWindow::on_index_record_changed(const QString &file) {
+    // 通常是当前图片，先检查当前行避免线性查找
+    int row = current_index;
+    if (row < 0 || row >= image_files.size() || image_files.at(row) != file) {
+        row = image_files.indexOf(file);
+    }
+    if (row < 0) {
+        return;
+    }
+
+    // 只更新摘要，不重新筛选，避免正在标注的图片从列表中消失
+    image_files.set_summary(row, dataset_index->summary(file));
+    thumbnail_provider->invalidate(file);
+    image_model->refresh_row(row);
+}
+
+void MainWindow::sort_images(int mode) {
+    if (image_files.isEmpty()) {
+        return;
+    }
+
+    QString current_file = image_files.at(current_index);
+
+    // 自然排序键：扫描刚结束时直接使用扫描线程预先计算好的键
+    QVector<QByteArray> name_keys;
+    if (scan_keys.size() == image_files.size()) {
+        name_keys = scan_keys;
+    } else {
+        name_keys.reserve(image_files.size());
+        for (int i = 0; i < image_files.size(); ++i) {
+            name_keys.append(FolderScanner::natural_sort_key(image_files.at(i)));
+        }
+    }
+
+    // 预先从索引中取出排序键，排序过程中不访问磁盘
+    QVector<qint64> keys(image_files.size(), 0);
+    if (mode != SortByName) {
+        for (int i = 0; i < image_files.size(); ++i) {
+            ImageRecord record = dataset_index->record(image_files.at(i));
+            switch (mode) {
+                case SortUnlabelledFirst:
+                    keys[i] = record.is_labelled() ? 1 : 0;
+                    break;
+                case SortByAnnotationCount:
+                    keys[i] = -record.annotation_count;
+                    break;
+                case SortByModifiedTime:
+                    keys[i] = record.mtime;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    QVector<int> order(image_files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (keys[a] != keys[b]) {
+            return keys[a] < keys[b];
+        }
+        if (name_keys[a] != name_keys[b]) {
+            return name_keys[a] < name_keys[b];
+        }
+        return a < b;
+    });
+
+    // 只重排列表项，文件名本身不移动
+    image_files.reorder(order);
+
+    // 扫描仍在进行时保持排序键与文件列表一一对应
+    if (scan_keys.size() == order.size()) {
+        QVector<QByteArray> sorted_keys;
+        sorted_keys.reserve(order.size());
+        for (int i: order) {
+            sorted_keys.append(name_keys.at(i));
+        }
+        scan_keys = sorted_keys;
+    }
+
+    // 保持当前图片不变
+    current_index = qMax(0, image_files.indexOf(current_file));
+    reload_image_list();
+    update_status();
+}
+
+void MainWindow::show_dataset_statistics() {
+    if (!dataset_index->is_open()) {
+        QMessageBox::information(this, tr("数据集统计"), tr("未加载图片文件夹"));
+        return;
+    }
+
+    int image_count = dataset_index->image_count();
+    int labelled_count = dataset_index->labelled_count();
+
+    QString text = QString("<p>%1: %2</p><p>%3: %4</p><p>%5: %6</p><p>%7: %8</p>")
+            .arg(tr("图片总数")).arg(image_count)
+            .arg(tr("已标注")).arg(labelled_count)
+            .arg(tr("未标注")).arg(image_count - labelled_count)
+            .arg(tr("标注总数")).arg(dataset_index->annotation_total());
+
+    QMap<int, int> totals = dataset_index->class_totals();
+    if (!totals.isEmpty()) {
+        text += "<table>";
+        for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+            QString name = it.key() >= 0 && it.key() < classes.size() ? classes.at(it.key()) : tr("未知");
+            text += QString("<tr><td>%1 (%2)</td><td>&nbsp;%3</td></tr>").arg(name).arg(it.key()).arg(it.value());
+        }
+        text += "</table>";
+    }
+
+    text += QString("<p>%1: %2 KB</p>").arg(tr("文件列表内存占用")).arg(image_files.memory_usage() / 1024);
+
+    if (dataset_index->is_building()) {
+        text += QString("<p>%1</p>").arg(tr("索引仍在建立中，统计可能不完整"));
+    }
+
+    QMessageBox::information(this, tr("数据集统计"), text);
+}
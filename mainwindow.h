@@ -1,9 +1,17 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include <Qlistwidget>
 #include <QMainWindow>
+#include <QModelIndex>
 #include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <functional>
+#include "imagefilelist.h"
+#include "imagetrash.h"
+#include "batchoperation.h"
+#include "jobscheduler.h"
 
 class QAction;
 class QLabel;
@@ -12,11 +20,34 @@ class QComboBox;
 class QScrollArea;
 class QShortcut;
 class QButtonGroup;
-class QListWidget;
+class QListView;
+class QMenu;
+class QProgressDialog;
+class QLineEdit;
+class QTimer;
+class QActionGroup;
 class QTranslator;
 class QSettings;
 
 class AnnotationGraphicsView;
+class DatasetIndex;
+class FolderScanner;
+class FolderWatcher;
+class ImageListModel;
+class CocoExporter;
+class CocoImporter;
+class ShardExporter;
+class SplitGenerator;
+class CropExporter;
+class ImageResizer;
+class ThumbnailProvider;
+class FrameCache;
+class DatasetSource;
+class MinimapWidget;
+class QDockWidget;
+class QSlider;
+class QCheckBox;
+class QTableWidget;
 
 // 主窗口类
 class MainWindow : public QMainWindow
@@ -33,6 +64,8 @@ protected:
 
 private slots:
     void load_folder();
+    void load_archive();
+    void load_remote();
     void prev_image();
     void next_image();
     void save_current_annotations();
@@ -45,6 +78,34 @@ private slots:
     void on_class_changed(int index);
     void delete_selected_rectangle();
     void delete_current_image_with_backup();
+    void undo_delete_image();
+
+    // 批量操作槽函数
+    void on_image_list_context_menu(const QPoint &pos);
+    void batch_delete_images();
+    void batch_move_images();
+    void batch_copy_labels();
+    void batch_clear_labels();
+    void on_batch_progress(int done, int total);
+    void on_batch_finished(const QList<BatchOperation::Result> &results);
+
+    // 标注格式槽函数
+    void set_label_format(const QString &id);
+    void convert_labels(const QString &id);
+    void on_classes_discovered(const QStringList &discovered);
+    void on_annotations_unreadable(const QString &label_path);
+
+    // 导入导出槽函数
+    void export_coco();
+    void import_coco();
+    void export_shards();
+    void generate_splits();
+    void export_crops();
+    void resize_images();
+    void on_resize_finished(bool ok, const QString &message, const QStringList &resized);
+    void on_export_finished(bool ok, const QString &message);
+    void on_coco_import_finished(bool ok, const QString &message, const QStringList &files,
+                                 const QStringList &imported_classes);
     void manage_classes();
     void on_rectangle_selected(int index);
     void on_rectangle_class_changed(int index, int classId);
@@ -55,7 +116,11 @@ private slots:
     void finish_polygon_drawing();
 
     // 图片列表相关槽函数
-    void on_image_list_item_clicked(QListWidgetItem *item);
+    void on_image_list_item_clicked(const QModelIndex &index);
+    void apply_filter();
+
+    // 按状态跳转
+    void toggle_current_flag();
 
     // 语言切换槽函数
     void switch_to_chinese();
@@ -64,24 +129,106 @@ private slots:
     // 关于菜单槽函数
     void show_about();
 
+    // 数据集索引相关槽函数
+    void on_index_build_progress(int done, int total);
+    void on_index_build_finished();
+    void on_index_record_changed(const QString &file);
+    void sort_images(int mode);
+    void show_dataset_statistics();
+
+    // 文件夹扫描相关槽函数
+    void on_scan_files_found(const QStringList &files, const QList<QByteArray> &keys);
+    void on_scan_finished(int total);
+    void set_recursive_scan(bool recursive);
+    void set_thumbnail_grid(bool enabled);
+    void set_frame_cache(bool enabled);
+    void set_frame_cache_limit();
+    void on_thumbnail_ready(const QString &file, int row);
+    void update_window_controls();
+    void on_window_slider_changed();
+    void on_adjustment_changed();
+    void update_jobs_table();
+
+    // 文件夹监视槽函数
+    void on_folder_files_changed(const QStringList &added, const QStringList &removed);
+
 private:
     void init_ui();
     void setup_shortcuts();
     void load_classes();
     void save_classes();
     void load_images_from_folder();
+    void prepare_source(const QSharedPointer<DatasetSource> &source,
+                        const std::function<QString(QString *error)> &prepare);
+    void close_source();
+    void prefetch_images();
     void load_current_image();
     void update_status();
     void update_image_list();
     void create_language_menu();
     void create_about_menu();
+    void create_dataset_menu();
+    void create_navigate_menu();
+    int find_status_row(int bit, bool value, int step, int class_id) const;
+    void jump_to_status(int bit, bool value, int step, int class_id = -1);
+    void reload_image_list();
+    QString remove_current_from_list();
+    QVector<int> selected_rows() const;
+    void start_batch_operation(BatchOperation::Type type, const QVector<int> &rows,
+                               const QString &target = QString());
+    void update_label_format_menu();
+    void remove_files_from_list(const QStringList &files);
+    void show_progress_dialog(const QString &text, int maximum);
+    void close_progress_dialog();
+    void sync_image_summaries(int first, int last);
     void update_language_menu();
 
     // 数据相关
     QString image_folder;
-    QStringList image_files;
+    ImageFileList image_files;
     int current_index;
 
+    // 数据集索引
+    DatasetIndex *dataset_index;
+
+    // 回收站（bak 目录），用于撤销删除
+    ImageTrash image_trash;
+    QAction *undo_delete_action;
+
+    // 批量操作
+    BatchOperation *batch_operation;
+    QProgressDialog *batch_progress;
+    QMenu *batch_menu;
+    QList<ImageTrash::Entry> batch_items; // 开始时选中的图片及其行号、索引记录
+    QElapsedTimer batch_timer;
+    QString convert_target;                // 正在转换的目标标注格式
+
+    // 标注格式
+    QActionGroup *label_format_group;
+
+    // 导入导出
+    CocoExporter *coco_exporter;
+    CocoImporter *coco_importer;
+    ShardExporter *shard_exporter;
+    SplitGenerator *split_generator;
+    CropExporter *crop_exporter;
+    ImageResizer *image_resizer;
+
+    // 文件夹扫描
+    FolderScanner *folder_scanner;
+    QVector<QByteArray> scan_keys; // 扫描期间与 image_files 一一对应的自然排序键
+
+    // 文件夹监视
+    FolderWatcher *folder_watcher;
+
+    // 图片排序方式
+    enum ImageSortMode {
+        SortByName = 0,         // 按文件名
+        SortUnlabelledFirst,    // 未标注优先
+        SortByAnnotationCount,  // 按标注数量
+        SortByModifiedTime      // 按修改时间
+    };
+
     // 类别相关
     QStringList classes;
 
@@ -104,11 +251,38 @@ private:
     QComboBox *class_combo;
     QScrollArea *scroll_area;
     AnnotationGraphicsView *annotation_widget;
+    QDockWidget *minimap_dock;             // 导航图
+    MinimapWidget *minimap;
+    QWidget *window_widget;                // 16 位图片的显示窗口调节
+    QSlider *window_low_slider;
+    QSlider *window_high_slider;
+    QDockWidget *adjust_dock;              // 显示调整（亮度 / 对比度 / gamma / CLAHE）
+    QSlider *brightness_slider;
+    QSlider *contrast_slider;
+    QSlider *gamma_slider;                 // gamma * 100
+    QCheckBox *clahe_check;
+    QLabel *adjust_label;
+    QDockWidget *jobs_dock;                // 后台任务（调试用：各优先级的队列长度与延迟）
+    QTableWidget *jobs_table;
+    QTimer *jobs_timer;
     QLabel *status_label;
     QLabel *info_label;
 
     // 图片列表
-    QListWidget *image_list;
+    QListView *image_list;
+    ImageListModel *image_model;
+    QComboBox *sort_combo;
+    QAction *recursive_action;
+    QAction *thumbnail_grid_action;
+    ThumbnailProvider *thumbnail_provider;
+    QAction *frame_cache_action;
+    FrameCache *frame_cache;                // 解码结果磁盘缓存
+    QSharedPointer<DatasetSource> dataset_source; // 当前打开的压缩包或对象存储，普通文件夹时为空
+    JobGroup source_jobs;                   // 在后台打开、准备数据来源
+    int source_generation;
+    int prefetch_index;                     // 上次预读时的图片，用于判断导航方向
+    QLineEdit *filter_edit;
+    QTimer *filter_timer;
 
     // 语言切换动作
     QAction *chinese_action;
@@ -124,6 +298,7 @@ private:
     QShortcut *reset_view_shortcut;
     QShortcut *zoom_in_shortcut;
     QShortcut *zoom_out_shortcut;
+    QShortcut *filter_shortcut;
 
     // 添加多边形相关快捷键
     QShortcut *rectangle_mode_shortcut;
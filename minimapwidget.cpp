@@ -0,0 +1,146 @@
+#include "minimapwidget.h"
+#include "annotationgraphicsview.h"
+#include "imagescaler.h"
+#include "labelformat.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPolygonF>
+
+namespace {
+// 低分辨率副本的最长边
+const int kMinimapSize = 256;
+}
+
+MinimapWidget::MinimapWidget(AnnotationGraphicsView *view, QWidget *parent)
+    : QWidget(parent), m_view(view), m_dragging(false) {
+    setMinimumSize(120, 90);
+    setCursor(Qt::PointingHandCursor);
+
+    connect(m_view, &AnnotationGraphicsView::image_changed, this, &MinimapWidget::on_image_changed);
+    connect(m_view, &AnnotationGraphicsView::annotations_changed, this, &MinimapWidget::on_annotations_changed);
+    connect(m_view, &AnnotationGraphicsView::viewport_changed, this, &MinimapWidget::on_viewport_changed);
+}
+
+QSize MinimapWidget::sizeHint() const {
+    return QSize(kMinimapSize, kMinimapSize * 3 / 4);
+}
+
+void MinimapWidget::on_image_changed() {
+    QPixmap pixmap = m_view->get_pixmap();
+    m_imageSize = pixmap.size();
+    if (pixmap.isNull()) {
+        m_base = QPixmap();
+    } else {
+        // 用面积平均缩小，只在切换图片时做一次
+        QSize size = m_imageSize;
+        if (size.width() > kMinimapSize || size.height() > kMinimapSize) {
+            size = size.scaled(kMinimapSize, kMinimapSize, Qt::KeepAspectRatio);
+        }
+        m_base = QPixmap::fromImage(ImageScaler::downscale(pixmap.toImage(), size));
+    }
+    m_viewport = m_view->get_visible_rect();
+    render_overlay();
+    update();
+}
+
+void MinimapWidget::on_annotations_changed() {
+    render_overlay();
+    update();
+}
+
+void MinimapWidget::on_viewport_changed(const QRectF &rect) {
+    m_viewport = rect;
+    update();
+}
+
+QRectF MinimapWidget::image_rect() const {
+    if (m_imageSize.isEmpty()) {
+        return QRectF();
+    }
+    QSizeF size = QSizeF(m_imageSize).scaled(QSizeF(width(), height()), Qt::KeepAspectRatio);
+    return QRectF(QPointF((width() - size.width()) / 2.0, (height() - size.height()) / 2.0), size);
+}
+
+void MinimapWidget::render_overlay() {
+    QRectF target = image_rect();
+    if (target.isEmpty()) {
+        m_overlay = QPixmap();
+        return;
+    }
+
+    m_overlay = QPixmap(target.size().toSize());
+    m_overlay.fill(Qt::transparent);
+    double scale = target.width() / m_imageSize.width();
+    QPainter painter(&m_overlay);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QColor colors[] = {Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::gray};
+    for (const LabelShape &shape: m_view->get_shapes()) {
+        painter.setPen(QPen(colors[qAbs(shape.class_id) % 7], 1));
+        if (shape.is_polygon()) {
+            QPolygonF polygon;
+            for (const QPointF &point: shape.points) {
+                polygon.append(point * scale);
+            }
+            painter.drawPolygon(polygon);
+        } else {
+            painter.drawRect(QRectF(shape.box.topLeft() * scale, shape.box.size() * scale));
+        }
+    }
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(48, 48, 48));
+    QRectF target = image_rect();
+    if (m_base.isNull() || target.isEmpty()) {
+        return;
+    }
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawPixmap(target, m_base, QRectF(m_base.rect()));
+    painter.drawPixmap(target.topLeft(), m_overlay);
+
+    // 可见区域覆盖整张图片时不显示
+    double scale = target.width() / m_imageSize.width();
+    QRectF visible(target.topLeft() + m_viewport.topLeft() * scale, m_viewport.size() * scale);
+    visible = visible.intersected(target);
+    if (!visible.isEmpty() && visible != target) {
+        painter.setPen(QPen(QColor(255, 255, 0), 1));
+        painter.setBrush(QColor(255, 255, 0, 40));
+        painter.drawRect(visible.adjusted(0, 0, -1, -1));
+    }
+}
+
+void MinimapWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    render_overlay();
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        m_dragging = true;
+        pan_to(event->pos());
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event) {
+    if (m_dragging) {
+        pan_to(event->pos());
+    }
+}
+
+void MinimapWidget::mouseReleaseEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        m_dragging = false;
+    }
+}
+
+void MinimapWidget::pan_to(const QPoint &pos) {
+    QRectF target = image_rect();
+    if (target.isEmpty()) {
+        return;
+    }
+    double scale = target.width() / m_imageSize.width();
+    m_view->center_on((QPointF(pos) - target.topLeft()) / scale);
+}
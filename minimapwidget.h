@@ -0,0 +1,47 @@
+#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QRectF>
+
+class AnnotationGraphicsView;
+
+// 导航图控件
+// 显示当前图片的低分辨率副本、全部标注与视图的可见区域，点击或拖动可平移视图。
+// 低分辨率副本只在切换图片时生成一次；标注改变时只重绘标注层，
+// 可见区域改变时只重绘控件，都不重新缩放图片。
+class MinimapWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MinimapWidget(AnnotationGraphicsView *view, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    void on_image_changed();
+    void on_annotations_changed();
+    void on_viewport_changed(const QRectF &rect);
+
+    QRectF image_rect() const;
+    void render_overlay();
+    void pan_to(const QPoint &pos);
+
+    AnnotationGraphicsView *m_view;
+    QPixmap m_base;      // 低分辨率图片
+    QPixmap m_overlay;   // 标注层，与 image_rect 同尺寸
+    QSize m_imageSize;   // 原图尺寸
+    QRectF m_viewport;   // 视图可见区域（场景坐标）
+    bool m_dragging;
+};
+
+#endif // MINIMAPWIDGET_H
@@ -0,0 +1,580 @@
+#include "remotesource.h"
+#include "folderscanner.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QMessageAuthenticationCode>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadStorage>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QXmlStreamReader>
+#include <algorithm>
+
+namespace {
+// 单个 Range 请求的大小；列表中大小已知的对象一次发出所有 Range 请求
+const qint64 kRangeSize = 1 << 20;
+// 一组请求的超时时间
+const int kTimeoutMs = 30000;
+// 同时进行的预读请求数
+const int kMaxPrefetch = 8;
+// 默认本地缓存上限 2 GB；超过上限时删除到上限的 90%
+const qint64 kDefaultCacheLimit = qint64(2048) << 20;
+const double kEvictRatio = 0.9;
+// 挂载时下载的非图片文件（标注等）：数量过多时只下载 classes.txt
+const int kMaxExtractFiles = 5000;
+const int kExtractBatch = 64;
+const qint64 kMaxExtractSize = 16 << 20;
+const char kManifest[] = "files.txt";
+
+// 同步读取可能来自任意线程，每个线程使用自己的 QNetworkAccessManager
+QNetworkAccessManager *thread_manager() {
+    static QThreadStorage<QNetworkAccessManager *> managers;
+    if (!managers.hasLocalData()) {
+        managers.setLocalData(new QNetworkAccessManager());
+    }
+    return managers.localData();
+}
+
+// 等待一组请求全部完成，超时后中止
+void wait_replies(const QList<QNetworkReply *> &replies) {
+    QEventLoop loop;
+    int pending = 0;
+    for (QNetworkReply *reply: replies) {
+        if (!reply->isFinished()) {
+            ++pending;
+            QObject::connect(reply, &QNetworkReply::finished, &loop, [&loop, &pending]() {
+                if (--pending == 0) {
+                    loop.quit();
+                }
+            });
+        }
+    }
+    if (pending == 0) {
+        return;
+    }
+
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &loop, [&replies]() {
+        for (QNetworkReply *reply: replies) {
+            reply->abort();
+        }
+    });
+    timer.start(kTimeoutMs);
+    // 主线程中等待时不处理用户输入，避免重入
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+}
+
+int status_code(QNetworkReply *reply) {
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+}
+
+// Content-Range: bytes 0-1048575/5242880
+qint64 content_total(QNetworkReply *reply) {
+    QByteArray range = reply->rawHeader("Content-Range");
+    int slash = range.lastIndexOf('/');
+    bool ok = false;
+    qint64 total = slash >= 0 ? range.mid(slash + 1).toLongLong(&ok) : -1;
+    return ok ? total : -1;
+}
+
+QByteArray hmac(const QByteArray &key, const QByteArray &message) {
+    return QMessageAuthenticationCode::hash(message, key, QCryptographicHash::Sha256);
+}
+
+QByteArray hex_sha256(const QByteArray &data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex();
+}
+}
+
+RemoteSource::RemoteSource(QObject *parent)
+    : QObject(parent), m_cacheLimit(kDefaultCacheLimit), m_cacheTotal(-1),
+      m_manager(new QNetworkAccessManager(this)) {
+}
+
+RemoteSource::~RemoteSource() {
+    for (QNetworkReply *reply: m_prefetching) {
+        reply->disconnect(this);
+        reply->abort();
+    }
+}
+
+bool RemoteSource::open(const QUrl &url) {
+    m_files.clear();
+    m_objects.clear();
+    m_prefix.clear();
+    m_base = url.adjusted(QUrl::RemoveQuery | QUrl::RemoveFragment | QUrl::StripTrailingSlash);
+    if (!m_base.isValid() || (m_base.scheme() != "http" && m_base.scheme() != "https")) {
+        return false;
+    }
+
+    m_accessKey = qgetenv("AWS_ACCESS_KEY_ID");
+    m_secretKey = qgetenv("AWS_SECRET_ACCESS_KEY");
+    m_region = qEnvironmentVariableIsSet("AWS_REGION") ? qgetenv("AWS_REGION") : QByteArray("us-east-1");
+
+    QByteArray key = QCryptographicHash::hash(m_base.toString().toUtf8(), QCryptographicHash::Sha1).toHex();
+    m_cacheFolder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/remote/" +
+                    QString::fromLatin1(key.left(16));
+    QDir().mkpath(m_cacheFolder);
+    m_cacheTotal = -1;
+
+    if (!list_objects() && !list_manifest()) {
+        qWarning() << "无法列出对象:" << m_base.toString();
+        return false;
+    }
+    return true;
+}
+
+QUrl RemoteSource::url() const {
+    return m_base;
+}
+
+QString RemoteSource::local_folder() const {
+    QString name = m_base.host() + m_base.path();
+    name.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/remote/" + name;
+}
+
+void RemoteSource::set_cache_limit(qint64 bytes) {
+    QMutexLocker locker(&m_cacheMutex);
+    m_cacheLimit = qMax<qint64>(0, bytes);
+    evict();
+}
+
+QStringList RemoteSource::files() const {
+    return m_files;
+}
+
+bool RemoteSource::contains(const QString &member) const {
+    return m_objects.contains(member);
+}
+
+bool RemoteSource::stat(const QString &member, qint64 *size, qint64 *mtime) const {
+    auto it = m_objects.constFind(member);
+    if (it == m_objects.constEnd() || it->size < 0) {
+        return false;
+    }
+    *size = it->size;
+    *mtime = it->mtime;
+    return true;
+}
+
+bool RemoteSource::is_cached(const QString &member) const {
+    return QFile::exists(cache_path(member));
+}
+
+QUrl RemoteSource::object_url(const QString &member) const {
+    // 路径风格：http://主机/桶/前缀/成员；普通 HTTP 服务器同样是 基础地址/成员
+    QUrl url(m_base);
+    url.setPath(m_base.path() + "/" + member);
+    return url;
+}
+
+QNetworkRequest RemoteSource::make_request(const QUrl &url, qint64 first, qint64 last) const {
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    if (first >= 0) {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(first) + "-" +
+                                      (last >= 0 ? QByteArray::number(last) : QByteArray()));
+    }
+    if (m_accessKey.isEmpty() || m_secretKey.isEmpty()) {
+        return request;
+    }
+
+    // AWS Signature Version 4，负载不参与签名（UNSIGNED-PAYLOAD）
+    const QByteArray amz_date = QDateTime::currentDateTimeUtc().toString("yyyyMMdd'T'HHmmss'Z'").toLatin1();
+    const QByteArray date = amz_date.left(8);
+    const QByteArray payload = "UNSIGNED-PAYLOAD";
+    QByteArray host = url.host().toUtf8();
+    const int default_port = url.scheme() == "https" ? 443 : 80;
+    if (url.port() != -1 && url.port() != default_port) {
+        host += ":" + QByteArray::number(url.port());
+    }
+
+    // 规范查询串：参数按名称排序，名称与值按 RFC 3986 编码
+    QList<QPair<QString, QString>> items = QUrlQuery(url).queryItems(QUrl::FullyDecoded);
+    std::sort(items.begin(), items.end());
+    QByteArrayList query;
+    for (const auto &item: items) {
+        query.append(QUrl::toPercentEncoding(item.first) + "=" + QUrl::toPercentEncoding(item.second));
+    }
+    QByteArray path = QUrl::toPercentEncoding(url.path(QUrl::FullyDecoded), "/");
+    if (path.isEmpty()) {
+        path = "/";
+    }
+
+    const QByteArray signed_headers = "host;x-amz-content-sha256;x-amz-date";
+    const QByteArray canonical = "GET\n" + path + "\n" + query.join('&') + "\n" +
+                                 "host:" + host + "\n" +
+                                 "x-amz-content-sha256:" + payload + "\n" +
+                                 "x-amz-date:" + amz_date + "\n\n" +
+                                 signed_headers + "\n" + payload;
+    const QByteArray scope = date + "/" + m_region + "/s3/aws4_request";
+    const QByteArray string_to_sign = "AWS4-HMAC-SHA256\n" + amz_date + "\n" + scope + "\n" + hex_sha256(canonical);
+    QByteArray key = hmac("AWS4" + m_secretKey, date);
+    key = hmac(key, m_region);
+    key = hmac(key, "s3");
+    key = hmac(key, "aws4_request");
+
+    request.setRawHeader("x-amz-date", amz_date);
+    request.setRawHeader("x-amz-content-sha256", payload);
+    request.setRawHeader("Authorization", "AWS4-HMAC-SHA256 Credential=" + m_accessKey + "/" + scope +
+                                          ", SignedHeaders=" + signed_headers +
+                                          ", Signature=" + hmac(key, string_to_sign).toHex());
+    return request;
+}
+
+bool RemoteSource::list_objects() {
+    QStringList segments = m_base.path().split('/', Qt::SkipEmptyParts);
+    if (segments.isEmpty()) {
+        return false;
+    }
+    QUrl list_url(m_base);
+    list_url.setPath("/" + segments.first());
+    m_prefix = segments.mid(1).join('/');
+    if (!m_prefix.isEmpty()) {
+        m_prefix += "/";
+    }
+
+    QStringList files;
+    QHash<QString, Object> objects;
+    QString token;
+    bool truncated = false;
+    do {
+        // 续传标记是 base64，需要完整编码
+        QByteArray query = "list-type=2&prefix=" + QUrl::toPercentEncoding(m_prefix);
+        if (!token.isEmpty()) {
+            query += "&continuation-token=" + QUrl::toPercentEncoding(token);
+        }
+        list_url.setQuery(QString::fromLatin1(query));
+
+        QNetworkReply *reply = thread_manager()->get(make_request(list_url));
+        wait_replies({reply});
+        const int status = status_code(reply);
+        const QByteArray body = reply->readAll();
+        delete reply;
+        if (status != 200) {
+            return false;
+        }
+
+        QXmlStreamReader xml(body);
+        bool found = false;
+        QString key;
+        Object object{-1, 0, QByteArray()};
+        truncated = false;
+        token.clear();
+        while (!xml.atEnd()) {
+            xml.readNext();
+            if (xml.isStartElement()) {
+                if (xml.name() == QLatin1String("ListBucketResult")) {
+                    found = true;
+                } else if (xml.name() == QLatin1String("Key")) {
+                    key = xml.readElementText();
+                } else if (xml.name() == QLatin1String("Size")) {
+                    object.size = xml.readElementText().toLongLong();
+                } else if (xml.name() == QLatin1String("ETag")) {
+                    object.etag = xml.readElementText().toUtf8();
+                } else if (xml.name() == QLatin1String("LastModified")) {
+                    object.mtime = QDateTime::fromString(xml.readElementText(), Qt::ISODateWithMs)
+                                       .toMSecsSinceEpoch();
+                } else if (xml.name() == QLatin1String("IsTruncated")) {
+                    truncated = xml.readElementText() == "true";
+                } else if (xml.name() == QLatin1String("NextContinuationToken")) {
+                    token = xml.readElementText();
+                }
+            } else if (xml.isEndElement() && xml.name() == QLatin1String("Contents")) {
+                // 以 '/' 结尾的是文件夹占位对象
+                if (key.startsWith(m_prefix) && !key.endsWith('/')) {
+                    QString member = key.mid(m_prefix.size());
+                    files.append(member);
+                    objects.insert(member, object);
+                }
+                key.clear();
+                object = Object{-1, 0, QByteArray()};
+            }
+        }
+        if (!found || xml.hasError()) {
+            return false;
+        }
+    } while (truncated && !token.isEmpty());
+
+    m_files = files;
+    m_objects = objects;
+    return true;
+}
+
+bool RemoteSource::list_manifest() {
+    QNetworkReply *reply = thread_manager()->get(make_request(object_url(kManifest)));
+    wait_replies({reply});
+    const int status = status_code(reply);
+    const QByteArray body = reply->readAll();
+    delete reply;
+    if (status != 200) {
+        return false;
+    }
+
+    // 每行：相对路径[\t大小[\t修改时间毫秒]]
+    for (const QByteArray &raw: body.split('\n')) {
+        QStringList fields = QString::fromUtf8(raw).trimmed().split('\t');
+        QString path = fields.first().trimmed();
+        while (path.startsWith("./")) {
+            path.remove(0, 2);
+        }
+        if (path.isEmpty() || path.startsWith('#') || path.endsWith('/') || m_objects.contains(path)) {
+            continue;
+        }
+        bool ok = false;
+        Object object{-1, 0, QByteArray()};
+        if (fields.size() > 1) {
+            object.size = fields.at(1).toLongLong(&ok);
+            if (!ok) {
+                object.size = -1;
+            }
+        }
+        if (fields.size() > 2) {
+            object.mtime = fields.at(2).toLongLong();
+        }
+        m_files.append(path);
+        m_objects.insert(path, object);
+    }
+    return true;
+}
+
+QByteArray RemoteSource::read(const QString &member, qint64 limit) const {
+    if (!contains(member)) {
+        return QByteArray();
+    }
+    QByteArray data = read_cache(member, limit);
+    if (!data.isEmpty()) {
+        return data;
+    }
+    data = fetch(member, limit);
+    if (limit < 0 && !data.isEmpty()) {
+        write_cache(member, data);
+    }
+    return data;
+}
+
+QByteArray RemoteSource::fetch(const QString &member, qint64 limit) const {
+    const QUrl url = object_url(member);
+    QNetworkAccessManager *manager = thread_manager();
+
+    // 只读取文件头
+    if (limit >= 0) {
+        QNetworkReply *reply = manager->get(make_request(url, 0, qMax<qint64>(0, limit - 1)));
+        wait_replies({reply});
+        const int status = status_code(reply);
+        const QByteArray body = reply->readAll();
+        delete reply;
+        return status == 200 || status == 206 ? body.left(static_cast<int>(limit)) : QByteArray();
+    }
+
+    // 大小未知时先请求第一段，从 Content-Range 得到总大小
+    qint64 size = m_objects.value(member).size;
+    QByteArray data;
+    if (size < 0) {
+        QNetworkReply *reply = manager->get(make_request(url, 0, kRangeSize - 1));
+        wait_replies({reply});
+        const int status = status_code(reply);
+        data = reply->readAll();
+        size = content_total(reply);
+        delete reply;
+        // 200 表示服务器不支持 Range，返回了整个对象
+        if (status == 200) {
+            return data;
+        }
+        if (status != 206) {
+            return QByteArray();
+        }
+        if (size <= data.size()) {
+            return data;
+        }
+    }
+
+    // 其余部分按 kRangeSize 拆分，并行请求
+    QList<QNetworkReply *> replies;
+    for (qint64 offset = data.size(); offset < size; offset += kRangeSize) {
+        replies.append(manager->get(make_request(url, offset, qMin(offset + kRangeSize, size) - 1)));
+    }
+    wait_replies(replies);
+
+    data.reserve(static_cast<int>(size));
+    bool ok = true;
+    for (QNetworkReply *reply: replies) {
+        const int status = status_code(reply);
+        if (status == 200) {
+            data = reply->readAll();
+            break;
+        }
+        if (status != 206) {
+            ok = false;
+            break;
+        }
+        data += reply->readAll();
+    }
+    qDeleteAll(replies);
+    if (!ok || data.size() != size) {
+        qWarning() << "下载对象失败:" << url.toString();
+        return QByteArray();
+    }
+    return data;
+}
+
+QString RemoteSource::cache_path(const QString &member) const {
+    // 对象改变后大小、ETag 或修改时间随之改变，不再命中旧的缓存文件
+    const Object object = m_objects.value(member);
+    const QByteArray id = member.toUtf8() + '\n' + QByteArray::number(object.size) + '\n' + object.etag + '\n' +
+                          QByteArray::number(object.mtime);
+    QByteArray key = QCryptographicHash::hash(id, QCryptographicHash::Sha1).toHex();
+    return m_cacheFolder + "/" + QString::fromLatin1(key);
+}
+
+QByteArray RemoteSource::read_cache(const QString &member, qint64 limit) const {
+    QFile file(cache_path(member));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    if (limit >= 0) {
+        return file.read(limit);
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    const qint64 size = m_objects.value(member).size;
+    if (size >= 0 && data.size() != size) {
+        return QByteArray();
+    }
+
+    // 更新修改时间，淘汰时按最久未使用删除
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return data;
+}
+
+void RemoteSource::write_cache(const QString &member, const QByteArray &data) const {
+    const QString path = cache_path(member);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return;
+    }
+    // 预读与前台读取可能写入同一成员，替换时减去原文件的大小
+    QMutexLocker locker(&m_cacheMutex);
+    QFileInfo old_info(path);
+    const qint64 old_size = old_info.exists() ? old_info.size() : 0;
+    if (!file.commit()) {
+        return;
+    }
+    if (m_cacheTotal >= 0) {
+        m_cacheTotal += data.size() - old_size;
+    }
+    evict();
+}
+
+void RemoteSource::evict() const {
+    // 调用时已持有 m_cacheMutex；打开前还没有缓存文件夹
+    if (m_cacheFolder.isEmpty()) {
+        return;
+    }
+    QDir dir(m_cacheFolder);
+    if (m_cacheTotal < 0) {
+        m_cacheTotal = 0;
+        for (const QFileInfo &info: dir.entryInfoList(QDir::Files)) {
+            m_cacheTotal += info.size();
+        }
+    }
+    if (m_cacheTotal <= m_cacheLimit) {
+        return;
+    }
+
+    const qint64 target = static_cast<qint64>(m_cacheLimit * kEvictRatio);
+    for (const QFileInfo &info: dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed)) {
+        if (m_cacheTotal <= target) {
+            break;
+        }
+        if (QFile::remove(info.absoluteFilePath())) {
+            m_cacheTotal -= info.size();
+        }
+    }
+}
+
+void RemoteSource::prefetch(const QStringList &members) {
+    // 导航方向改变后，不再需要的预读请求直接取消
+    for (auto it = m_prefetching.begin(); it != m_prefetching.end();) {
+        if (!members.contains(it.key())) {
+            QNetworkReply *reply = it.value();
+            it = m_prefetching.erase(it);
+            reply->abort();
+        } else {
+            ++it;
+        }
+    }
+
+    for (const QString &member: members) {
+        if (m_prefetching.size() >= kMaxPrefetch) {
+            break;
+        }
+        if (!contains(member) || m_prefetching.contains(member) || QFile::exists(cache_path(member))) {
+            continue;
+        }
+        QNetworkReply *reply = m_manager->get(make_request(object_url(member)));
+        m_prefetching.insert(member, reply);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, member]() {
+            on_prefetched(reply, member);
+        });
+    }
+}
+
+void RemoteSource::on_prefetched(QNetworkReply *reply, const QString &member) {
+    reply->deleteLater();
+    if (m_prefetching.value(member) == reply) {
+        m_prefetching.remove(member);
+    }
+    if (reply->error() == QNetworkReply::NoError && status_code(reply) == 200) {
+        write_cache(member, reply->readAll());
+    }
+}
+
+void RemoteSource::extract_missing(const QString &folder) {
+    QStringList missing;
+    for (const QString &file: m_files) {
+        if (!FolderScanner::is_image_file(file) && m_objects.value(file).size <= kMaxExtractSize &&
+            !QFile::exists(folder + "/" + file)) {
+            missing.append(file);
+        }
+    }
+    if (missing.size() > kMaxExtractFiles) {
+        qWarning() << "远程标注文件过多，只下载 classes.txt:" << missing.size();
+        missing = missing.filter(QRegularExpression("(^|/)classes\\.txt$"));
+    }
+
+    // 分批并行下载（QNetworkAccessManager 对同一主机最多同时建立 6 个连接）
+    QNetworkAccessManager *manager = thread_manager();
+    for (int start = 0; start < missing.size(); start += kExtractBatch) {
+        const QStringList batch = missing.mid(start, kExtractBatch);
+        QList<QNetworkReply *> replies;
+        for (const QString &file: batch) {
+            replies.append(manager->get(make_request(object_url(file))));
+        }
+        wait_replies(replies);
+        for (int i = 0; i < batch.size(); ++i) {
+            if (status_code(replies.at(i)) != 200) {
+                continue;
+            }
+            QFile output(folder + "/" + batch.at(i));
+            if (output.open(QIODevice::WriteOnly)) {
+                output.write(replies.at(i)->readAll());
+            }
+        }
+        qDeleteAll(replies);
+    }
+}
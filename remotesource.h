@@ -0,0 +1,83 @@
+#ifndef REMOTESOURCE_H
+#define REMOTESOURCE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QUrl>
+#include "datasetsource.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+
+// 对象存储数据源
+// 通过 HTTP 读取 S3 兼容存储（如 MinIO）中的图片，地址为 http(s)://主机/桶/前缀（路径风格）。
+// 打开时用 ListObjectsV2 列出前缀下的所有对象及其大小、ETag 与修改时间；不是 S3 服务时改为读取前缀下的
+// files.txt（每行一个相对路径，可用制表符附加大小与修改时间毫秒数），因此也可以用普通 HTTP 文件服务器测试。
+// 环境变量 AWS_ACCESS_KEY_ID / AWS_SECRET_ACCESS_KEY（可选 AWS_REGION）存在时按 SigV4 签名请求。
+//
+// 大对象拆成多个 Range 请求并行下载；下载的对象保存在有大小上限的本地缓存中（按最久未使用淘汰），
+// 缓存以成员路径、大小、ETag 与修改时间为键，对象改变后不再使用旧的缓存。
+// prefetch 在后台按导航方向预读后面的图片。标注保存在本地挂载文件夹中，不上传。
+class RemoteSource : public QObject, public DatasetSource
+{
+    Q_OBJECT
+
+public:
+    explicit RemoteSource(QObject *parent = nullptr);
+    ~RemoteSource();
+
+    bool open(const QUrl &url);
+    QUrl url() const;
+    // 保存标注、索引的本地文件夹
+    QString local_folder() const;
+    void set_cache_limit(qint64 bytes);
+
+    QStringList files() const override;
+    bool contains(const QString &member) const override;
+    QByteArray read(const QString &member, qint64 limit = -1) const override;
+    bool stat(const QString &member, qint64 *size, qint64 *mtime) const override;
+    bool is_cached(const QString &member) const override;
+    void prefetch(const QStringList &members) override;
+
+protected:
+    void extract_missing(const QString &folder) override;
+
+private:
+    struct Object {
+        qint64 size;      // 未知为 -1
+        qint64 mtime;     // 毫秒，未知为 0
+        QByteArray etag;
+    };
+
+    QUrl object_url(const QString &member) const;
+    QNetworkRequest make_request(const QUrl &url, qint64 first = -1, qint64 last = -1) const;
+    bool list_objects();
+    bool list_manifest();
+    QByteArray fetch(const QString &member, qint64 limit) const;
+
+    QString cache_path(const QString &member) const;
+    QByteArray read_cache(const QString &member, qint64 limit) const;
+    void write_cache(const QString &member, const QByteArray &data) const;
+    void evict() const;
+    void on_prefetched(QNetworkReply *reply, const QString &member);
+
+    QUrl m_base;
+    QString m_prefix;                 // 对象键的公共前缀
+    QByteArray m_accessKey;
+    QByteArray m_secretKey;
+    QByteArray m_region;
+    QStringList m_files;
+    QHash<QString, Object> m_objects;
+
+    QString m_cacheFolder;
+    mutable QMutex m_cacheMutex;
+    qint64 m_cacheLimit;
+    mutable qint64 m_cacheTotal;      // -1 表示尚未统计
+
+    QNetworkAccessManager *m_manager; // 主线程中的预读请求
+    QHash<QString, QNetworkReply *> m_prefetching;
+};
+
+#endif // REMOTESOURCE_H
@@ -0,0 +1,459 @@
+#include "shardexporter.h"
+#include "datasetsource.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <cstdio>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// tar 块大小
+const int kBlockSize = 512;
+// 划分分片时每个样本除图片外的估计开销：两个成员头与标注文件
+const qint64 kSampleOverhead = 3 * kBlockSize;
+// 每处理这么多样本报告一次进度
+const int kProgressInterval = 64;
+// 无法在内核中复制时每次读写的字节数
+const qint64 kCopyBlockSize = 1 << 20;
+
+void write_octal(char *field, int width, qint64 value) {
+    // 宽度包含结尾的 '\0'
+    std::snprintf(field, static_cast<size_t>(width), "%0*llo", width - 1, static_cast<unsigned long long>(value));
+}
+
+QByteArray header_block(const QByteArray &name, const QByteArray &prefix, qint64 size, qint64 mtime, char type) {
+    QByteArray block(kBlockSize, '\0');
+    char *h = block.data();
+    std::memcpy(h, name.constData(), static_cast<size_t>(qMin(name.size(), 100)));
+    write_octal(h + 100, 8, 0644);
+    write_octal(h + 108, 8, 0);
+    write_octal(h + 116, 8, 0);
+    write_octal(h + 124, 12, size);
+    write_octal(h + 136, 12, mtime);
+    h[156] = type;
+    std::memcpy(h + 257, "ustar", 6);
+    std::memcpy(h + 263, "00", 2);
+    std::memcpy(h + 345, prefix.constData(), static_cast<size_t>(qMin(prefix.size(), 155)));
+
+    // 校验和按校验和字段为空格计算
+    std::memset(h + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (int i = 0; i < kBlockSize; ++i) {
+        checksum += static_cast<unsigned char>(h[i]);
+    }
+    std::snprintf(h + 148, 8, "%06o", checksum);
+    h[155] = ' ';
+    return block;
+}
+
+// 共用容器中的标注转换为 YOLO 文本，与 YOLO 格式写出的内容一致
+QByteArray yolo_text(const QSize &size, const QList<LabelShape> &shapes) {
+    QByteArray text;
+    for (const LabelShape &shape: shapes) {
+        text += QByteArray::number(shape.class_id);
+        if (shape.is_polygon()) {
+            for (const QPointF &point: shape.points) {
+                text += " " + QByteArray::number(point.x() / size.width(), 'f', 6);
+                text += " " + QByteArray::number(point.y() / size.height(), 'f', 6);
+            }
+        } else {
+            text += " " + QByteArray::number((shape.box.x() + shape.box.width() / 2.0) / size.width(), 'f', 6);
+            text += " " + QByteArray::number((shape.box.y() + shape.box.height() / 2.0) / size.height(), 'f', 6);
+            text += " " + QByteArray::number(shape.box.width() / size.width(), 'f', 6);
+            text += " " + QByteArray::number(shape.box.height() / size.height(), 'f', 6);
+        }
+        text += "\n";
+    }
+    return text;
+}
+}
+
+// 后台分片任务：按顺序把一段图片及其标注写入一个 tar 文件
+class ShardExporter::ShardTask : public QRunnable {
+public:
+    ShardTask(ShardExporter *exporter, int generation, int index, const QString &folder, const QStringList &files,
+              const QStringList &keys, const QSharedPointer<ClassRegistry> &registry, const QString &path)
+        : m_exporter(exporter), m_generation(generation), m_index(index), m_folder(folder), m_files(files),
+          m_keys(keys), m_registry(registry), m_path(path), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        QSaveFile output(m_path);
+        if (!output.open(QIODevice::WriteOnly)) {
+            report_finished(false, 0, QObject::tr("无法创建文件 %1").arg(m_path));
+            return;
+        }
+
+        int unreported = 0;
+        for (int i = 0; i < m_files.size(); ++i) {
+            if (m_exporter->m_generation.load() != m_generation) {
+                output.cancelWriting();
+                return;
+            }
+
+            const QString &file = m_files.at(i);
+            const QString &key = m_keys.at(i);
+            QString image_path = m_folder + "/" + file;
+            if (!ShardExporter::append_member(&output, key + "." + QFileInfo(file).suffix().toLower(), image_path)) {
+                output.cancelWriting();
+                report_finished(false, 0, QObject::tr("写入文件失败: %1").arg(image_path));
+                return;
+            }
+
+            if (m_format->per_image_files()) {
+                QString label_path = m_format->label_path(image_path);
+                if (QFile::exists(label_path) &&
+                    !ShardExporter::append_member(&output, key + "." + QFileInfo(label_path).suffix(), label_path)) {
+                    output.cancelWriting();
+                    report_finished(false, 0, QObject::tr("写入文件失败: %1").arg(label_path));
+                    return;
+                }
+            } else {
+                QSize size = ImageProbe::image_size(image_path);
+                QList<LabelShape> shapes;
+                if (!size.isEmpty() && m_registry->read(m_format, image_path, size, nullptr, &shapes) &&
+                    !shapes.isEmpty() &&
+                    !ShardExporter::append_member(&output, key + ".txt", yolo_text(size, shapes),
+                                                  QDateTime::currentSecsSinceEpoch())) {
+                    output.cancelWriting();
+                    report_finished(false, 0, QObject::tr("写入文件失败: %1").arg(m_path));
+                    return;
+                }
+            }
+
+            if (++unreported == kProgressInterval) {
+                report_progress(unreported);
+                unreported = 0;
+            }
+        }
+        report_progress(unreported);
+
+        // tar 以两个全零块结束
+        output.write(QByteArray(2 * kBlockSize, '\0'));
+        qint64 bytes = output.pos();
+        if (!output.commit()) {
+            report_finished(false, 0, QObject::tr("写入文件失败: %1").arg(output.errorString()));
+            return;
+        }
+        report_finished(true, bytes, QString());
+    }
+
+private:
+    void report_progress(int done) {
+        ShardExporter *exporter = m_exporter;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(exporter, [exporter, generation, done]() {
+            exporter->on_progress(generation, done);
+        }, Qt::QueuedConnection);
+    }
+
+    void report_finished(bool ok, qint64 bytes, const QString &error) {
+        ShardExporter *exporter = m_exporter;
+        int generation = m_generation;
+        int index = m_index;
+        QMetaObject::invokeMethod(exporter, [exporter, generation, index, ok, bytes, error]() {
+            exporter->on_shard_finished(generation, index, ok, bytes, error);
+        }, Qt::QueuedConnection);
+    }
+
+    ShardExporter *m_exporter;
+    int m_generation;
+    int m_index;
+    QString m_folder;
+    QStringList m_files;
+    QStringList m_keys;
+    QSharedPointer<ClassRegistry> m_registry;
+    QString m_path;
+    const LabelFormat *m_format;
+};
+
+ShardExporter::ShardExporter(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_generation(0)
+      , m_pendingShards(0)
+      , m_done(0)
+      , m_totalBytes(0)
+      , m_running(false) {
+}
+
+ShardExporter::~ShardExporter() {
+    cancel();
+}
+
+bool ShardExporter::start(const QString &folder, const QStringList &files, const QList<qint64> &sizes,
+                          const QStringList &classes, const QString &output, qint64 shard_bytes) {
+    if (is_running() || !QDir().mkpath(output)) {
+        return false;
+    }
+
+    m_folder = folder;
+    m_output = output;
+    m_files = files;
+    // 所有分片任务共用类别表，新出现的类别名称保存到 classes.txt
+    m_registry.reset(new ClassRegistry(folder, classes));
+    m_shards.clear();
+    m_renamed.clear();
+
+    // 不同图片可能得到相同的样本键（同名不同扩展名、'.' 与 '_'），重复的键加序号，并记录到 index.json
+    m_keys.clear();
+    m_keys.reserve(files.size());
+    QSet<QString> used;
+    used.reserve(files.size());
+    for (const QString &file: files) {
+        const QString base = sample_key(file);
+        QString key = base;
+        for (int n = 1; used.contains(key); ++n) {
+            key = base + "_" + QString::number(n);
+        }
+        used.insert(key);
+        m_keys.append(key);
+        if (key != base) {
+            m_renamed.insert(file, key);
+        }
+    }
+    m_done = 0;
+    m_totalBytes = 0;
+
+    // 按文件大小依次划分分片，一个样本不会跨分片
+    Shard shard;
+    qint64 shard_size = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        qint64 size = i < sizes.size() && sizes.at(i) > 0 ? sizes.at(i) : QFileInfo(folder + "/" + files.at(i)).size();
+        size += kSampleOverhead;
+        if (shard.count > 0 && shard_size + size > shard_bytes) {
+            m_shards.append(shard);
+            shard = Shard();
+            shard.first = i;
+            shard_size = 0;
+        }
+        ++shard.count;
+        shard_size += size;
+    }
+    if (shard.count > 0) {
+        m_shards.append(shard);
+    }
+
+    m_running = true;
+    m_timer.start();
+    m_pendingShards = m_shards.size();
+    if (m_shards.isEmpty()) {
+        finish();
+        return true;
+    }
+
+    for (int i = 0; i < m_shards.size(); ++i) {
+        Shard &planned = m_shards[i];
+        planned.name = QString("shard-%1.tar").arg(i, 6, 10, QChar('0'));
+        m_jobs.start(new ShardTask(this, m_generation.load(), i, m_folder, m_files.mid(planned.first, planned.count),
+                                   m_keys.mid(planned.first, planned.count), m_registry,
+                                   m_output + "/" + planned.name));
+    }
+    return true;
+}
+
+void ShardExporter::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_running = false;
+}
+
+bool ShardExporter::is_running() const {
+    return m_running;
+}
+
+QStringList ShardExporter::classes() const {
+    return m_registry ? m_registry->classes() : QStringList();
+}
+
+void ShardExporter::on_progress(int generation, int done) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+    m_done += done;
+    emit progress(m_done, m_files.size());
+}
+
+void ShardExporter::on_shard_finished(int generation, int index, bool ok, qint64 bytes, const QString &error) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+    if (!ok) {
+        fail(error);
+        return;
+    }
+
+    m_shards[index].bytes = bytes;
+    m_totalBytes += bytes;
+    if (--m_pendingShards == 0) {
+        finish();
+    }
+}
+
+void ShardExporter::finish() {
+    // 分片索引：每个分片对应的样本范围（按导出时的图片顺序）与大小
+    QJsonArray shards;
+    for (const Shard &shard: m_shards) {
+        QJsonObject object;
+        object["name"] = shard.name;
+        object["first"] = shard.first;
+        object["count"] = shard.count;
+        object["bytes"] = static_cast<double>(shard.bytes);
+        shards.append(object);
+    }
+    QJsonObject root;
+    root["format"] = "webdataset";
+    root["samples"] = m_files.size();
+    root["classes"] = QJsonArray::fromStringList(m_registry->classes());
+    root["shards"] = shards;
+    // 为避免重复而改名的样本：图片路径 -> 样本键
+    if (!m_renamed.isEmpty()) {
+        QJsonObject renamed;
+        for (auto it = m_renamed.constBegin(); it != m_renamed.constEnd(); ++it) {
+            renamed[it.key()] = it.value();
+        }
+        root["renamed_keys"] = renamed;
+    }
+
+    QSaveFile index(m_output + "/index.json");
+    QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    if (!index.open(QIODevice::WriteOnly) || index.write(data) != data.size() || !index.commit()) {
+        fail(tr("写入文件失败: %1").arg(index.fileName()));
+        return;
+    }
+
+    double seconds = qMax<qint64>(m_timer.elapsed(), 1) / 1000.0;
+    QString message = tr("已导出 %1 个样本到 %2 个分片, %3 MB/s")
+        .arg(m_files.size()).arg(m_shards.size())
+        .arg(m_totalBytes / 1048576.0 / seconds, 0, 'f', 1);
+    m_running = false;
+    m_files.clear();
+    m_keys.clear();
+    emit finished(true, message);
+}
+
+void ShardExporter::fail(const QString &message) {
+    ++m_generation;
+    m_jobs.clear();
+    m_running = false;
+    m_files.clear();
+    m_keys.clear();
+    emit finished(false, message);
+}
+
+QString ShardExporter::sample_key(const QString &file) {
+    // WebDataset 以文件名中第一个 '.' 分隔样本键与扩展名，键中的 '.' 替换为 '_'
+    QFileInfo info(file);
+    QString base = info.completeBaseName().replace('.', '_');
+    int slash = file.lastIndexOf('/');
+    return slash < 0 ? base : file.left(slash + 1) + base;
+}
+
+QByteArray ShardExporter::tar_header(const QString &name, qint64 size, qint64 mtime) {
+    QByteArray path = name.toUtf8();
+    if (path.size() <= 100) {
+        return header_block(path, QByteArray(), size, mtime, '0');
+    }
+
+    // ustar：在 '/' 处拆分为 prefix(155) 与 name(100)
+    for (int slash = path.indexOf('/'); slash >= 0 && slash <= 155; slash = path.indexOf('/', slash + 1)) {
+        if (path.size() - slash - 1 <= 100) {
+            return header_block(path.mid(slash + 1), path.left(slash), size, mtime, '0');
+        }
+    }
+
+    // 仍然过长时使用 GNU 长文件名扩展
+    QByteArray long_name = path + '\0';
+    QByteArray header = header_block("././@LongLink", QByteArray(), long_name.size(), 0, 'L');
+    header += long_name;
+    header += QByteArray((kBlockSize - long_name.size() % kBlockSize) % kBlockSize, '\0');
+    header += header_block(path.left(100), QByteArray(), size, mtime, '0');
+    return header;
+}
+
+bool ShardExporter::append_member(QFileDevice *output, const QString &name, const QString &path) {
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        // 挂载的数据来源中的图片
+        QByteArray data;
+        return DatasetSource::read_mounted(path, &data) && append_member(output, name, data, 0);
+    }
+
+    qint64 size = input.size();
+    QByteArray header = tar_header(name, size, QFileInfo(path).lastModified().toSecsSinceEpoch());
+    return output->write(header) == header.size() && copy_file(output, &input, size) && pad_block(output, size);
+}
+
+bool ShardExporter::append_member(QFileDevice *output, const QString &name, const QByteArray &data, qint64 mtime) {
+    QByteArray header = tar_header(name, data.size(), mtime);
+    return output->write(header) == header.size() && output->write(data) == data.size() &&
+           pad_block(output, data.size());
+}
+
+bool ShardExporter::copy_file(QFileDevice *output, QFileDevice *input, qint64 size) {
+    qint64 remaining = size;
+#ifdef Q_OS_LINUX
+    // 文件内容在内核中复制，不经过用户态缓冲；使用显式偏移，之后同步 QFileDevice 的位置
+    if (!output->flush()) {
+        return false;
+    }
+    loff_t in_offset = 0;
+    loff_t out_offset = output->pos();
+#ifdef SYS_copy_file_range
+    while (remaining > 0) {
+        ssize_t copied = static_cast<ssize_t>(syscall(SYS_copy_file_range, input->handle(), &in_offset,
+                                                      output->handle(), &out_offset,
+                                                      static_cast<size_t>(remaining), 0u));
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= copied;
+    }
+#endif
+    // 内核不支持 copy_file_range（或跨文件系统）时改用 sendfile
+    if (remaining > 0 && lseek(output->handle(), out_offset, SEEK_SET) == out_offset) {
+        off_t offset = static_cast<off_t>(in_offset);
+        while (remaining > 0) {
+            ssize_t copied = sendfile(output->handle(), input->handle(), &offset, static_cast<size_t>(remaining));
+            if (copied <= 0) {
+                break;
+            }
+            remaining -= copied;
+            out_offset += copied;
+        }
+        in_offset = offset;
+    }
+    if (!output->seek(out_offset) || !input->seek(in_offset)) {
+        return false;
+    }
+#endif
+
+    // 其他平台或以上方式失败时按块读写
+    while (remaining > 0) {
+        QByteArray block = input->read(qMin(remaining, kCopyBlockSize));
+        if (block.isEmpty() || output->write(block) != block.size()) {
+            return false;
+        }
+        remaining -= block.size();
+    }
+    return true;
+}
+
+bool ShardExporter::pad_block(QFileDevice *output, qint64 size) {
+    int padding = static_cast<int>((kBlockSize - size % kBlockSize) % kBlockSize);
+    return padding == 0 || output->write(QByteArray(padding, '\0')) == padding;
+}
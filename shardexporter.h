@@ -0,0 +1,81 @@
+#ifndef SHARDEXPORTER_H
+#define SHARDEXPORTER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "jobscheduler.h"
+
+class ClassRegistry;
+class QFileDevice;
+
+// WebDataset 分片导出类
+// 按图片文件大小把数据集划分为大小固定的 tar 分片，每个样本包含图片原始字节与标注文件，
+// 不重新编码。各分片在线程池中并行写入，Linux 下用 copy_file_range / sendfile 在内核中复制文件内容。
+// 全部完成后在输出文件夹写入 index.json，记录每个分片的样本范围与大小。
+class ShardExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ShardExporter(QObject *parent = nullptr);
+    ~ShardExporter();
+
+    // files 为相对于 folder 的图片路径，sizes 为已知的图片文件大小（0 时读取文件信息）
+    bool start(const QString &folder, const QStringList &files, const QList<qint64> &sizes,
+               const QStringList &classes, const QString &output, qint64 shard_bytes);
+    void cancel();
+    bool is_running() const;
+    // 包含导出时新出现的类别名称（已保存到 classes.txt）
+    QStringList classes() const;
+
+signals:
+    void progress(int done, int total);
+    void finished(bool ok, const QString &message);
+
+private:
+    class ShardTask;
+
+    // 一个分片：files 中 [first, first + count) 的图片
+    struct Shard {
+        int first = 0;
+        int count = 0;
+        QString name;
+        qint64 bytes = 0;   // 写入后的实际大小
+    };
+
+    void on_progress(int generation, int done);
+    void on_shard_finished(int generation, int index, bool ok, qint64 bytes, const QString &error);
+    void finish();
+    void fail(const QString &message);
+
+    static QString sample_key(const QString &file);
+    static QByteArray tar_header(const QString &name, qint64 size, qint64 mtime);
+    static bool append_member(QFileDevice *output, const QString &name, const QString &path);
+    static bool append_member(QFileDevice *output, const QString &name, const QByteArray &data, qint64 mtime);
+    static bool copy_file(QFileDevice *output, QFileDevice *input, qint64 size);
+    static bool pad_block(QFileDevice *output, qint64 size);
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+
+    QString m_folder;
+    QString m_output;
+    QStringList m_files;
+    QStringList m_keys;             // 每张图片的样本键，已去重
+    QMap<QString, QString> m_renamed; // 去重时改名的图片 -> 样本键
+    QSharedPointer<ClassRegistry> m_registry;
+    QVector<Shard> m_shards;
+    int m_pendingShards;
+    int m_done;
+    qint64 m_totalBytes;
+    QElapsedTimer m_timer;
+    bool m_running;
+};
+
+#endif // SHARDEXPORTER_H
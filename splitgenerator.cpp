@@ -0,0 +1,372 @@
+#include "splitgenerator.h"
+#include "imageprobe.h"
+#include "labelformat.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+namespace {
+// 每个生成任务处理的图片数量
+const int kLinkChunkSize = 2048;
+// 有标注的图片主要按类别缺口分配，图片数量缺口只用于平衡
+const double kImageWeight = 0.1;
+
+const char *const kSplitNames[SplitGenerator::SplitCount] = {"train", "val", "test"};
+}
+
+// 后台划分任务：计算每张图片所属的子集
+class SplitGenerator::AssignTask : public QRunnable {
+public:
+    AssignTask(SplitGenerator *generator, int generation, const QList<QMap<int, int>> &class_counts,
+               const QVector<double> &ratios, quint32 seed)
+        : m_generator(generator), m_generation(generation), m_classCounts(class_counts), m_ratios(ratios),
+          m_seed(seed) {
+    }
+
+    void run() override {
+        QVector<int> splits = SplitGenerator::assign(m_classCounts, m_ratios, m_seed);
+        SplitGenerator *generator = m_generator;
+        int generation = m_generation;
+        QMetaObject::invokeMethod(generator, [generator, generation, splits]() {
+            generator->on_assigned(generation, splits);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SplitGenerator *m_generator;
+    int m_generation;
+    QList<QMap<int, int>> m_classCounts;
+    QVector<double> m_ratios;
+    quint32 m_seed;
+};
+
+// 后台生成任务：为一块图片创建图片与标注文件的链接
+class SplitGenerator::LinkTask : public QRunnable {
+public:
+    LinkTask(SplitGenerator *generator, int generation, const QString &folder, const QString &output,
+             const QStringList &files, const QVector<int> &splits, const QSharedPointer<ClassRegistry> &registry)
+        : m_generator(generator), m_generation(generation), m_folder(folder), m_output(output), m_files(files),
+          m_splits(splits), m_registry(registry), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        // YOLO 标注直接链接，其他格式转换为 YOLO 文本
+        const LabelFormat *yolo = LabelFormat::format("yolo");
+        QVector<int> methods(LinkMethodCount, 0);
+        QSet<QString> created_dirs;
+        for (int i = 0; i < m_files.size(); ++i) {
+            if (m_generator->m_generation.load() != m_generation) {
+                return;
+            }
+
+            const QString &file = m_files.at(i);
+            const QString split = kSplitNames[m_splits.at(i)];
+            QString image_path = m_folder + "/" + file;
+            QString image_target = m_output + "/images/" + split + "/" + file;
+            QString label_image = m_output + "/labels/" + split + "/" + file;
+            make_dir(QFileInfo(image_target).absolutePath(), &created_dirs);
+            methods[SplitGenerator::link_file(image_path, image_target)]++;
+
+            if (m_format == yolo) {
+                QString label_path = yolo->label_path(image_path);
+                if (QFile::exists(label_path)) {
+                    make_dir(QFileInfo(label_image).absolutePath(), &created_dirs);
+                    methods[SplitGenerator::link_file(label_path, yolo->label_path(label_image))]++;
+                }
+                continue;
+            }
+
+            QSize size = ImageProbe::image_size(image_path);
+            QStringList known_classes;
+            QList<LabelShape> shapes;
+            if (size.isEmpty() || !m_registry->read(m_format, image_path, size, &known_classes, &shapes) ||
+                shapes.isEmpty()) {
+                continue;
+            }
+            make_dir(QFileInfo(label_image).absolutePath(), &created_dirs);
+            methods[yolo->write(label_image, size, known_classes, shapes) ? Converted : Failed]++;
+        }
+
+        SplitGenerator *generator = m_generator;
+        int generation = m_generation;
+        int done = m_files.size();
+        QMetaObject::invokeMethod(generator, [generator, generation, done, methods]() {
+            generator->on_chunk_finished(generation, done, methods);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    static void make_dir(const QString &dir, QSet<QString> *created) {
+        if (!created->contains(dir)) {
+            QDir().mkpath(dir);
+            created->insert(dir);
+        }
+    }
+
+    SplitGenerator *m_generator;
+    int m_generation;
+    QString m_folder;
+    QString m_output;
+    QStringList m_files;
+    QVector<int> m_splits;
+    QSharedPointer<ClassRegistry> m_registry;
+    const LabelFormat *m_format;
+};
+
+SplitGenerator::SplitGenerator(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Background)
+      , m_generation(0)
+      , m_pendingTasks(0)
+      , m_done(0)
+      , m_running(false) {
+}
+
+SplitGenerator::~SplitGenerator() {
+    cancel();
+}
+
+bool SplitGenerator::start(const QString &folder, const QStringList &files, const QList<QMap<int, int>> &class_counts,
+                           const QStringList &classes, const QVector<double> &ratios, const QString &output,
+                           quint32 seed) {
+    if (is_running() || ratios.size() != SplitCount || !QDir().mkpath(output)) {
+        return false;
+    }
+
+    m_folder = folder;
+    m_output = QDir(output).absolutePath();
+    m_files = files;
+    // 转换标注的任务共用类别表，不同文件中的同一新类别得到相同的序号
+    m_registry.reset(new ClassRegistry(folder, classes));
+    m_ratios = ratios;
+    m_splits.clear();
+    m_methodCounts = QVector<int>(LinkMethodCount, 0);
+    m_pendingTasks = 0;
+    m_done = 0;
+    m_running = true;
+    m_timer.start();
+
+    m_jobs.start(new AssignTask(this, m_generation.load(), class_counts, ratios, seed));
+    return true;
+}
+
+QStringList SplitGenerator::classes() const {
+    return m_registry ? m_registry->classes() : QStringList();
+}
+
+void SplitGenerator::cancel() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_running = false;
+}
+
+bool SplitGenerator::is_running() const {
+    return m_running;
+}
+
+QVector<int> SplitGenerator::assign(const QList<QMap<int, int>> &class_counts, const QVector<double> &ratios,
+                                    quint32 seed) {
+    const int count = class_counts.size();
+    double ratio_sum = 0;
+    for (double ratio: ratios) {
+        ratio_sum += qMax(0.0, ratio);
+    }
+    QVector<double> ratio(SplitCount, 0.0);
+    for (int s = 0; s < SplitCount && ratio_sum > 0; ++s) {
+        ratio[s] = qMax(0.0, ratios.value(s)) / ratio_sum;
+    }
+
+    // 每个类别的标注总数，分配过程中累计各子集已分配的数量
+    QHash<int, qint64> totals;
+    for (const QMap<int, int> &counts: class_counts) {
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            totals[it.key()] += it.value();
+        }
+    }
+    QHash<int, QVector<qint64>> assigned;
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        assigned.insert(it.key(), QVector<qint64>(SplitCount, 0));
+    }
+
+    // 随机打乱后按图片中最稀有类别的总数排序，稀有类别先分配；没有标注的图片最后分配
+    QVector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 random(seed);
+    std::shuffle(order.begin(), order.end(), random);
+    QVector<qint64> rarity(count, std::numeric_limits<qint64>::max());
+    for (int i = 0; i < count; ++i) {
+        for (auto it = class_counts.at(i).constBegin(); it != class_counts.at(i).constEnd(); ++it) {
+            rarity[i] = qMin(rarity[i], totals.value(it.key()));
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&rarity](int lhs, int rhs) {
+        return rarity.at(lhs) < rarity.at(rhs);
+    });
+
+    QVector<int> splits(count, Train);
+    QVector<int> image_counts(SplitCount, 0);
+    for (int index: order) {
+        const QMap<int, int> &counts = class_counts.at(index);
+        int best = -1;
+        double best_score = 0;
+        for (int s = 0; s < SplitCount; ++s) {
+            if (ratio[s] <= 0) {
+                continue;
+            }
+
+            // 类别缺口按类别总数归一化，稀有类别的权重更高
+            double score = 0;
+            for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+                double total = static_cast<double>(totals.value(it.key()));
+                double deficit = ratio[s] * total - assigned.value(it.key()).at(s);
+                score += it.value() * deficit / total;
+            }
+            double image_deficit = (ratio[s] * count - image_counts.at(s)) / qMax(1.0, ratio[s] * count);
+            score += image_deficit * (counts.isEmpty() ? 1.0 : kImageWeight);
+            if (best < 0 || score > best_score) {
+                best = s;
+                best_score = score;
+            }
+        }
+        if (best < 0) {
+            best = Train;
+        }
+
+        splits[index] = best;
+        image_counts[best]++;
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            assigned[it.key()][best] += it.value();
+        }
+    }
+    return splits;
+}
+
+void SplitGenerator::on_assigned(int generation, const QVector<int> &splits) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+
+    m_splits = splits;
+    for (int first = 0; first < m_files.size(); first += kLinkChunkSize) {
+        m_jobs.start(new LinkTask(this, generation, m_folder, m_output, m_files.mid(first, kLinkChunkSize),
+                                  m_splits.mid(first, kLinkChunkSize), m_registry));
+        ++m_pendingTasks;
+    }
+    if (m_pendingTasks == 0) {
+        finish();
+    }
+}
+
+void SplitGenerator::on_chunk_finished(int generation, int done, const QVector<int> &methods) {
+    if (generation != m_generation.load() || !m_running) {
+        return;
+    }
+
+    m_done += done;
+    for (int i = 0; i < LinkMethodCount; ++i) {
+        m_methodCounts[i] += methods.at(i);
+    }
+    emit progress(m_done, m_files.size());
+
+    if (--m_pendingTasks == 0) {
+        finish();
+    }
+}
+
+void SplitGenerator::finish() {
+    m_running = false;
+    if (!write_yaml()) {
+        emit finished(false, tr("写入文件失败: %1").arg(m_output + "/data.yaml"));
+        return;
+    }
+
+    QVector<int> split_counts(SplitCount, 0);
+    for (int split: m_splits) {
+        split_counts[split]++;
+    }
+    QString message = tr("划分完成 (%1 秒): train %2, val %3, test %4; 硬链接 %5, reflink %6, 复制 %7, 转换 %8, 失败 %9")
+        .arg(m_timer.elapsed() / 1000.0, 0, 'f', 1)
+        .arg(split_counts.at(Train)).arg(split_counts.at(Val)).arg(split_counts.at(Test))
+        .arg(m_methodCounts.at(HardLink)).arg(m_methodCounts.at(Reflink)).arg(m_methodCounts.at(Copy))
+        .arg(m_methodCounts.at(Converted)).arg(m_methodCounts.at(Failed));
+    m_files.clear();
+    m_splits.clear();
+    emit finished(m_methodCounts.at(Failed) == 0, message);
+}
+
+bool SplitGenerator::write_yaml() {
+    QSaveFile file(m_output + "/data.yaml");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    // 名称用单引号包围，其中的单引号写成两个
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "path: '" << QString(m_output).replace("'", "''") << "'\n";
+    for (int s = 0; s < SplitCount; ++s) {
+        if (m_ratios.value(s) > 0) {
+            out << kSplitNames[s] << ": images/" << kSplitNames[s] << "\n";
+        }
+    }
+    const QStringList classes = m_registry->classes();
+    out << "\nnc: " << classes.size() << "\n";
+    out << "names:\n";
+    for (int i = 0; i < classes.size(); ++i) {
+        out << "  " << i << ": '" << QString(classes.at(i)).replace("'", "''") << "'\n";
+    }
+    out.flush();
+    return file.commit();
+}
+
+SplitGenerator::LinkMethod SplitGenerator::link_file(const QString &source, const QString &target) {
+    QFile::remove(target);
+#ifdef Q_OS_WIN
+    if (CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(target).utf16()),
+                        reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(source).utf16()), nullptr)) {
+        return HardLink;
+    }
+#else
+    if (link(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0) {
+        return HardLink;
+    }
+#endif
+
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    // 不支持硬链接时尝试写时复制（btrfs / XFS 等）
+    int source_fd = open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (source_fd >= 0) {
+        int target_fd = open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool cloned = target_fd >= 0 && ioctl(target_fd, FICLONE, source_fd) == 0;
+        if (target_fd >= 0) {
+            close(target_fd);
+        }
+        close(source_fd);
+        if (cloned) {
+            return Reflink;
+        }
+        QFile::remove(target);
+    }
+#endif
+
+    return QFile::copy(source, target) ? Copy : Failed;
+}
@@ -0,0 +1,89 @@
+#ifndef SPLITGENERATOR_H
+#define SPLITGENERATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "jobscheduler.h"
+
+class ClassRegistry;
+
+// 数据集划分类
+// 按各类别的标注数量分层划分 train / val / test：稀有类别的图片优先分配，
+// 每张图片放入其类别缺口最大的子集，使各子集的类别分布接近设定比例。
+// 划分结果按 YOLO 目录结构（images/<split>、labels/<split>）以硬链接生成，
+// 无法硬链接时依次尝试 reflink 与复制，最后写入 data.yaml。
+class SplitGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Split {
+        Train = 0,
+        Val,
+        Test,
+        SplitCount
+    };
+
+    explicit SplitGenerator(QObject *parent = nullptr);
+    ~SplitGenerator();
+
+    // class_counts 与 files 一一对应（来自数据集索引），ratios 为 train / val / test 的比例
+    bool start(const QString &folder, const QStringList &files, const QList<QMap<int, int>> &class_counts,
+               const QStringList &classes, const QVector<double> &ratios, const QString &output, quint32 seed);
+    void cancel();
+    bool is_running() const;
+    // 包含转换标注时新出现的类别名称（已保存到 classes.txt）
+    QStringList classes() const;
+
+    // 分层划分，返回每张图片所属的子集
+    static QVector<int> assign(const QList<QMap<int, int>> &class_counts, const QVector<double> &ratios,
+                               quint32 seed);
+
+signals:
+    void progress(int done, int total);
+    void finished(bool ok, const QString &message);
+
+private:
+    class AssignTask;
+    class LinkTask;
+
+    // 文件的生成方式
+    enum LinkMethod {
+        HardLink = 0,
+        Reflink,
+        Copy,
+        Converted,  // 标注文件由其他格式转换为 YOLO 文本
+        Failed,
+        LinkMethodCount
+    };
+
+    void on_assigned(int generation, const QVector<int> &splits);
+    void on_chunk_finished(int generation, int done, const QVector<int> &methods);
+    void finish();
+    bool write_yaml();
+
+    static LinkMethod link_file(const QString &source, const QString &target);
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+
+    QString m_folder;
+    QString m_output;
+    QStringList m_files;
+    QSharedPointer<ClassRegistry> m_registry;
+    QVector<double> m_ratios;
+    QVector<int> m_splits;
+    QVector<int> m_methodCounts;
+    int m_pendingTasks;
+    int m_done;
+    QElapsedTimer m_timer;
+    bool m_running;
+};
+
+#endif // SPLITGENERATOR_H
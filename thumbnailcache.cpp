@@ -0,0 +1,249 @@
+#include "thumbnailcache.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QSaveFile>
+#include <QSet>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'I', 'T', 'H', 'C'};
+const quint32 kVersion = 1;
+// 文件头：magic + 版本
+const qint64 kHeaderSize = 8;
+// 缩略图 JPEG 质量
+const int kJpegQuality = 85;
+// 无效数据超过这个大小且超过有效数据时重写
+const qint64 kCompactThreshold = 4 << 20;
+
+qint64 aligned(qint64 size) {
+    return (size + 7) & ~qint64(7);
+}
+}
+
+ThumbnailCache::ThumbnailCache()
+    : m_base(nullptr), m_mappedSize(0), m_fileSize(0), m_deadBytes(0) {
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    close();
+}
+
+bool ThumbnailCache::open(const QString &folder) {
+    close();
+
+    QWriteLocker locker(&m_lock);
+    m_path = folder + "/.thumbnails.bin";
+    if (!load_records()) {
+        return false;
+    }
+    compact_if_needed();
+    return m_file.isOpen();
+}
+
+void ThumbnailCache::close() {
+    QWriteLocker locker(&m_lock);
+    unmap();
+    m_file.close();
+    m_slots.clear();
+    m_fileSize = 0;
+    m_deadBytes = 0;
+}
+
+QImage ThumbnailCache::find(const QString &file, qint64 mtime) const {
+    QByteArray key = file.toUtf8();
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_slots.constFind(key);
+        if (it == m_slots.constEnd() || it->mtime != mtime) {
+            return QImage();
+        }
+        if (it->offset + it->size <= m_mappedSize) {
+            return QImage::fromData(m_base + it->offset, static_cast<int>(it->size), "JPG");
+        }
+    }
+
+    // 记录在上次映射之后追加，重新映射整个文件
+    QWriteLocker locker(&m_lock);
+    auto it = m_slots.constFind(key);
+    if (it == m_slots.constEnd() || it->mtime != mtime || !ensure_mapped(it->offset + it->size)) {
+        return QImage();
+    }
+    return QImage::fromData(m_base + it->offset, static_cast<int>(it->size), "JPG");
+}
+
+bool ThumbnailCache::insert(const QString &file, qint64 mtime, const QImage &thumbnail) {
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!thumbnail.save(&buffer, "JPG", kJpegQuality)) {
+        return false;
+    }
+
+    QByteArray key = file.toUtf8();
+    Record record;
+    record.name_size = static_cast<quint32>(key.size());
+    record.data_size = static_cast<quint32>(data.size());
+    record.mtime = mtime;
+    QByteArray bytes(reinterpret_cast<const char *>(&record), sizeof(Record));
+    bytes.append(key);
+    bytes.append(data);
+    bytes.append(QByteArray(static_cast<int>(aligned(bytes.size()) - bytes.size()), '\0'));
+
+    QWriteLocker locker(&m_lock);
+    if (!m_file.isOpen() || !m_file.seek(m_fileSize) || m_file.write(bytes) != bytes.size()) {
+        qWarning() << "无法写入缩略图缓存:" << m_path;
+        return false;
+    }
+
+    auto it = m_slots.find(key);
+    if (it != m_slots.end()) {
+        m_deadBytes += aligned(sizeof(Record) + key.size() + it->size);
+    }
+    m_slots.insert(key, {m_fileSize + static_cast<qint64>(sizeof(Record)) + key.size(), record.data_size, mtime});
+    m_fileSize += bytes.size();
+    return true;
+}
+
+void ThumbnailCache::prune(const QStringList &files) {
+    QSet<QByteArray> live;
+    live.reserve(files.size());
+    for (const QString &file: files) {
+        live.insert(file.toUtf8());
+    }
+
+    QWriteLocker locker(&m_lock);
+    if (!m_file.isOpen()) {
+        return;
+    }
+    for (auto it = m_slots.begin(); it != m_slots.end();) {
+        if (live.contains(it.key())) {
+            ++it;
+        } else {
+            m_deadBytes += aligned(sizeof(Record) + it.key().size() + it->size);
+            it = m_slots.erase(it);
+        }
+    }
+    compact_if_needed();
+}
+
+bool ThumbnailCache::load_records() {
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "无法打开缩略图缓存:" << m_path;
+        return false;
+    }
+
+    QByteArray header = m_file.read(kHeaderSize);
+    quint32 version = 0;
+    if (header.size() == kHeaderSize) {
+        std::memcpy(&version, header.constData() + 4, sizeof(version));
+    }
+    if (header.size() != kHeaderSize || std::memcmp(header.constData(), kMagic, 4) != 0 || version != kVersion) {
+        // 新文件或旧版本：清空重写文件头
+        header = QByteArray(kMagic, 4);
+        header.append(reinterpret_cast<const char *>(&kVersion), sizeof(kVersion));
+        if (!m_file.resize(0) || !m_file.seek(0) || m_file.write(header) != kHeaderSize || !m_file.flush()) {
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_fileSize = m_file.size();
+    if (!ensure_mapped(m_fileSize)) {
+        m_file.close();
+        return false;
+    }
+
+    // 依次读取记录，同一图片以最后一条为准；末尾写了一半的记录截掉
+    qint64 offset = kHeaderSize;
+    while (offset + static_cast<qint64>(sizeof(Record)) <= m_fileSize) {
+        Record record;
+        std::memcpy(&record, m_base + offset, sizeof(Record));
+        qint64 length = aligned(sizeof(Record) + record.name_size + record.data_size);
+        if (offset + length > m_fileSize) {
+            break;
+        }
+
+        QByteArray key(reinterpret_cast<const char *>(m_base + offset + sizeof(Record)),
+                       static_cast<int>(record.name_size));
+        auto it = m_slots.find(key);
+        if (it != m_slots.end()) {
+            m_deadBytes += aligned(sizeof(Record) + record.name_size + it->size);
+        }
+        m_slots.insert(key, {offset + static_cast<qint64>(sizeof(Record)) + record.name_size, record.data_size,
+                             record.mtime});
+        offset += length;
+    }
+    if (offset != m_fileSize) {
+        unmap();
+        m_file.resize(offset);
+        m_fileSize = offset;
+    }
+    return true;
+}
+
+bool ThumbnailCache::compact() {
+    QSaveFile output(m_path);
+    if (!ensure_mapped(m_fileSize) || !output.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray header(kMagic, 4);
+    header.append(reinterpret_cast<const char *>(&kVersion), sizeof(kVersion));
+    output.write(header);
+    for (auto it = m_slots.constBegin(); it != m_slots.constEnd(); ++it) {
+        Record record;
+        record.name_size = static_cast<quint32>(it.key().size());
+        record.data_size = it->size;
+        record.mtime = it->mtime;
+        QByteArray bytes(reinterpret_cast<const char *>(&record), sizeof(Record));
+        bytes.append(it.key());
+        bytes.append(reinterpret_cast<const char *>(m_base + it->offset), static_cast<int>(it->size));
+        bytes.append(QByteArray(static_cast<int>(aligned(bytes.size()) - bytes.size()), '\0'));
+        output.write(bytes);
+    }
+
+    // 替换前关闭原文件（Windows 不能替换已映射的文件）
+    unmap();
+    m_file.close();
+    m_slots.clear();
+    m_deadBytes = 0;
+    if (!output.commit()) {
+        qWarning() << "无法重写缩略图缓存:" << m_path;
+    }
+    return load_records();
+}
+
+void ThumbnailCache::compact_if_needed() {
+    if (m_deadBytes > kCompactThreshold && m_deadBytes > m_fileSize - m_deadBytes) {
+        compact();
+    }
+}
+
+bool ThumbnailCache::ensure_mapped(qint64 end) const {
+    if (end <= m_mappedSize) {
+        return true;
+    }
+
+    unmap();
+    m_file.flush();
+    qint64 size = m_file.size();
+    if (size < end) {
+        return false;
+    }
+    m_base = m_file.map(0, size);
+    if (!m_base) {
+        qWarning() << "无法映射缩略图缓存:" << m_path;
+        return false;
+    }
+    m_mappedSize = size;
+    return true;
+}
+
+void ThumbnailCache::unmap() const {
+    if (m_base) {
+        m_file.unmap(const_cast<uchar *>(m_base));
+        m_base = nullptr;
+    }
+    m_mappedSize = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+
+// 缩略图磁盘缓存
+// 每个文件夹一个 .thumbnails.bin，按 图片相对路径 + 修改时间 保存 JPEG 编码的缩略图。
+// 新缩略图追加到文件末尾，读取时通过内存映射直接解码；同一图片的旧记录与已删除图片的记录
+// 在打开或清理时无效数据超过一半则整体重写。可在多个工作线程中同时读写。
+class ThumbnailCache {
+public:
+    ThumbnailCache();
+    ~ThumbnailCache();
+
+    bool open(const QString &folder);
+    void close();
+
+    // 没有缓存或图片已修改时返回空图片
+    QImage find(const QString &file, qint64 mtime) const;
+    bool insert(const QString &file, qint64 mtime, const QImage &thumbnail);
+    // 丢弃不在 files 中的图片的缩略图
+    void prune(const QStringList &files);
+
+private:
+    // 记录头，后接文件名与 JPEG 数据，整条记录按 8 字节对齐
+    struct Record {
+        quint32 name_size;
+        quint32 data_size;
+        qint64 mtime;
+    };
+
+    struct Slot {
+        qint64 offset;  // JPEG 数据在文件中的位置
+        quint32 size;
+        qint64 mtime;
+    };
+
+    bool load_records();
+    bool compact();
+    void compact_if_needed();
+    bool ensure_mapped(qint64 end) const;
+    void unmap() const;
+
+    QString m_path;
+    mutable QReadWriteLock m_lock;
+    mutable QFile m_file;
+    mutable const uchar *m_base;
+    mutable qint64 m_mappedSize;
+    qint64 m_fileSize;
+    qint64 m_deadBytes;
+    QHash<QByteArray, Slot> m_slots;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,197 @@
+#include "thumbnailprovider.h"
+#include "datasetsource.h"
+#include "imageprobe.h"
+#include "imagescaler.h"
+#include "labelformat.h"
+#include <QPainter>
+#include <QPolygonF>
+
+namespace {
+// 内存中保留的缩略图数量
+const int kPixmapCacheSize = 1024;
+// 比最新请求早这么多的请求已经滚出视图，不再生成
+const int kMaxQueuedRequests = 256;
+}
+
+// 后台生成任务：读取或生成一张缩略图并叠加标注框
+class ThumbnailProvider::RenderTask : public QRunnable {
+public:
+    RenderTask(ThumbnailProvider *provider, int generation, int request, const QString &folder, const QString &file,
+               int row, const QStringList &classes)
+        : m_provider(provider), m_generation(generation), m_request(request), m_folder(folder), m_file(file),
+          m_row(row), m_classes(classes), m_format(LabelFormat::folder_format(folder)) {
+    }
+
+    void run() override {
+        if (m_provider->m_generation.load() != m_generation) {
+            return;
+        }
+        if (m_provider->m_latestRequest.load() - m_request > kMaxQueuedRequests) {
+            report(QImage(), true);
+            return;
+        }
+
+        QString image_path = m_folder + "/" + m_file;
+        // 校验值由大小与修改时间合成；压缩包中的图片使用压缩包的修改时间，压缩包替换后缩略图随之失效
+        qint64 file_size = 0;
+        qint64 file_mtime = 0;
+        DatasetSource::file_stamp(image_path, &file_size, &file_mtime);
+        const qint64 mtime = file_mtime ^ (file_size << 24);
+        QSize size = ImageProbe::image_size(image_path);
+        QImage image = m_provider->m_cache.find(m_file, mtime);
+        if (image.isNull()) {
+            image = decode(image_path, size);
+            if (image.isNull()) {
+                report(QImage(), false);
+                return;
+            }
+            m_provider->m_cache.insert(m_file, mtime, image);
+        }
+
+        // 标注框按缩略图比例绘制
+        QStringList known_classes = m_classes;
+        QList<LabelShape> shapes;
+        if (!size.isEmpty() && m_format->read(image_path, size, &known_classes, &shapes) && !shapes.isEmpty()) {
+            image = image.convertToFormat(QImage::Format_RGB32);
+            double sx = static_cast<double>(image.width()) / size.width();
+            double sy = static_cast<double>(image.height()) / size.height();
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            QColor colors[] = {Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::gray};
+            for (const LabelShape &shape: shapes) {
+                painter.setPen(QPen(colors[qAbs(shape.class_id) % 7], 1));
+                if (shape.is_polygon()) {
+                    QPolygonF polygon;
+                    for (const QPointF &point: shape.points) {
+                        polygon.append(QPointF(point.x() * sx, point.y() * sy));
+                    }
+                    painter.drawPolygon(polygon);
+                } else {
+                    painter.drawRect(QRectF(shape.box.x() * sx, shape.box.y() * sy,
+                                            shape.box.width() * sx, shape.box.height() * sy));
+                }
+            }
+        }
+        report(image, false);
+    }
+
+private:
+    static QImage decode(const QString &path, const QSize &size) {
+        // 只缩小不放大；JPEG 直接按比例解码
+        QSize target = size;
+        if (size.width() > kThumbnailSize || size.height() > kThumbnailSize) {
+            target = size.scaled(kThumbnailSize, kThumbnailSize, Qt::KeepAspectRatio);
+        }
+        SourceImageReader reader(path);
+        if (reader.format() == "jpeg" && !target.isEmpty()) {
+            reader.setScaledSize(target);
+        }
+        QImage image = reader.read();
+        if (!image.isNull() && !target.isEmpty() && image.size() != target) {
+            image = ImageScaler::downscale(image, target);
+        }
+        return image;
+    }
+
+    void report(const QImage &image, bool dropped) {
+        ThumbnailProvider *provider = m_provider;
+        int generation = m_generation;
+        QString file = m_file;
+        int row = m_row;
+        QMetaObject::invokeMethod(provider, [provider, generation, file, row, image, dropped]() {
+            provider->on_rendered(generation, file, row, image, dropped);
+        }, Qt::QueuedConnection);
+    }
+
+    ThumbnailProvider *m_provider;
+    int m_generation;
+    int m_request;
+    QString m_folder;
+    QString m_file;
+    int m_row;
+    QStringList m_classes;
+    const LabelFormat *m_format;
+};
+
+ThumbnailProvider::ThumbnailProvider(QObject *parent)
+    : QObject(parent)
+      , m_jobs(JobScheduler::Thumbnail)
+      , m_generation(0)
+      , m_latestRequest(0)
+      , m_requestCounter(0)
+      , m_pixmaps(kPixmapCacheSize) {
+}
+
+ThumbnailProvider::~ThumbnailProvider() {
+    close();
+}
+
+void ThumbnailProvider::open(const QString &folder) {
+    close();
+    m_folder = folder;
+    m_cache.open(folder);
+}
+
+void ThumbnailProvider::close() {
+    ++m_generation;
+    m_jobs.clear();
+    m_jobs.wait();
+    m_cache.close();
+    m_folder.clear();
+    m_pixmaps.clear();
+    m_pending.clear();
+}
+
+void ThumbnailProvider::set_classes(const QStringList &classes) {
+    m_classes = classes;
+}
+
+QPixmap ThumbnailProvider::thumbnail(const QString &file, int row) {
+    if (m_folder.isEmpty()) {
+        return QPixmap();
+    }
+
+    QPixmap *pixmap = m_pixmaps.object(file);
+    if (pixmap) {
+        return *pixmap;
+    }
+    if (!m_pending.contains(file)) {
+        // 优先级递增：最近请求（当前可见）的缩略图先生成
+        m_pending.insert(file);
+        int request = ++m_requestCounter;
+        m_latestRequest = request;
+        m_jobs.start(new RenderTask(this, m_generation.load(), request, m_folder, file, row, m_classes), request);
+    }
+    return QPixmap();
+}
+
+void ThumbnailProvider::invalidate(const QString &file) {
+    m_pixmaps.remove(file);
+}
+
+void ThumbnailProvider::prune(const QStringList &files) {
+    if (m_folder.isEmpty()) {
+        return;
+    }
+    // 优先级低于所有缩略图请求；关闭或切换文件夹时未执行的任务被丢弃
+    const int generation = m_generation.load();
+    m_jobs.start([this, generation, files]() {
+        if (m_generation.load() == generation) {
+            m_cache.prune(files);
+        }
+    }, 0);
+}
+
+void ThumbnailProvider::on_rendered(int generation, const QString &file, int row, const QImage &image, bool dropped) {
+    if (generation != m_generation.load()) {
+        return;
+    }
+
+    m_pending.remove(file);
+    if (dropped) {
+        return;
+    }
+    // 无法解码的图片也记录下来（空缩略图），避免每次重绘都重新请求
+    m_pixmaps.insert(file, new QPixmap(QPixmap::fromImage(image)));
+    emit thumbnail_ready(file, row);
+}
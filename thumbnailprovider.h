@@ -0,0 +1,60 @@
+#ifndef THUMBNAILPROVIDER_H
+#define THUMBNAILPROVIDER_H
+
+#include <QObject>
+#include <QCache>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
+#include <atomic>
+#include "thumbnailcache.h"
+#include "jobscheduler.h"
+
+// 缩略图提供类
+// 图片列表的网格模式按需请求缩略图：内存中已有时直接返回，否则在线程池中生成，
+// 完成后发出 thumbnail_ready。生成时先查磁盘缓存（ThumbnailCache），
+// 没有时缩小解码图片并写入缓存；标注框在返回前叠加绘制，不写入磁盘缓存。
+// 后请求的优先处理，滚动过去很久的请求直接丢弃。
+class ThumbnailProvider : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 缩略图的最长边
+    static const int kThumbnailSize = 128;
+
+    explicit ThumbnailProvider(QObject *parent = nullptr);
+    ~ThumbnailProvider();
+
+    void open(const QString &folder);
+    void close();
+    void set_classes(const QStringList &classes);
+
+    // row 原样随 thumbnail_ready 返回，便于定位列表行
+    QPixmap thumbnail(const QString &file, int row);
+    // 标注改变后重新绘制
+    void invalidate(const QString &file);
+    // 扫描完成后在后台清理已不在文件夹中的图片的磁盘缓存
+    void prune(const QStringList &files);
+
+signals:
+    void thumbnail_ready(const QString &file, int row);
+
+private:
+    class RenderTask;
+
+    void on_rendered(int generation, const QString &file, int row, const QImage &image, bool dropped);
+
+    JobGroup m_jobs;
+    std::atomic<int> m_generation;
+    std::atomic<int> m_latestRequest;
+    int m_requestCounter;
+
+    QString m_folder;
+    QStringList m_classes;
+    ThumbnailCache m_cache;
+    QCache<QString, QPixmap> m_pixmaps;
+    QSet<QString> m_pending;
+};
+
+#endif // THUMBNAILPROVIDER_H